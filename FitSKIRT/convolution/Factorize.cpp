@@ -57,7 +57,7 @@ void Factorize::factorize(const int n, int* n_factors, int factors[], int* imple
 bool Factorize::is_optimal(int n, int* implemented_factors)
 {
     // We check that n is not a multiple of 4*4*4*2
-    if (n % 4*4*4*2 == 0) return false;
+    if (n % (4*4*4*2) == 0) return false;
 
     int nf=0;
     int factors[64];
@@ -10,7 +10,7 @@
 
 ////////////////////////////////////////////////////////////////////
 
-/** This namespace provides some convenience functions used by the WorkSpace class. */
+/** This namespace provides some convenience functions used by the FourierTransform class. */
 namespace Factorize
 {
     // The code for this function is adapted from the GNU Scientific Library / fft / factorize.c
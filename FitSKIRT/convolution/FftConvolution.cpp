@@ -4,57 +4,279 @@
 ///////////////////////////////////////////////////////////////// */
 
 #include "FftConvolution.hpp"
-#include "WorkSpace.hpp"
+#include "FatalError.hpp"
+#ifdef BUILD_WITH_FFT
+#include <fftw3.h>
+#include <mutex>
+#endif
 
 ////////////////////////////////////////////////////////////////////
 
-FftConvolution::FftConvolution(int input_xsize, int input_ysize, int kernel_xsize, int kernel_ysize)
+namespace
 {
+    typedef FftConvolution::Complex Complex;
+
 #ifdef BUILD_WITH_FFT
-    // Create a new workspace
-    _ws = new WorkSpace();
+    // the intermediate results for a convolution; reused by subsequent convolutions in the same thread.
+    // the arrays are allocated with fftw_malloc so that they have the alignment assumed by the plans
+    struct Workspace
+    {
+        double* data{nullptr};              // the padded input data, and eventually the padded output data
+        fftw_complex* spectrum{nullptr};    // the (half) transform of the padded input data
+        size_t dataSize{0};
+        size_t spectrumSize{0};
 
-    // Initialize the workspace
-    _ws->initialize(ConvolutionMode::LINEAR_SAME, input_xsize, input_ysize, kernel_xsize, kernel_ysize);
+        void reserve(size_t numData, size_t numSpectrum)
+        {
+            if (numData > dataSize)
+            {
+                fftw_free(data);
+                data = static_cast<double*>(fftw_malloc(sizeof(double) * numData));
+                dataSize = numData;
+            }
+            if (numSpectrum > spectrumSize)
+            {
+                fftw_free(spectrum);
+                spectrum = static_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * numSpectrum));
+                spectrumSize = numSpectrum;
+            }
+        }
+
+        ~Workspace() { fftw_free(data); fftw_free(spectrum); }
+    };
+    thread_local Workspace workspace;
+
+    // the FFTW3 library is not re-entrant when creating or destroying plans
+    std::mutex planMutex;
 #else
-    _ws = nullptr;
-    (void)input_xsize; (void)input_ysize; (void)kernel_xsize; (void)kernel_ysize;
+    // the intermediate results for a convolution; reused by subsequent convolutions in the same thread
+    struct Workspace
+    {
+        vector<Complex> spectrum;   // the (half) transform of the padded input data, in row-major order
+        vector<Complex> buffer;     // a buffer holding two rows or two columns
+    };
+    thread_local Workspace workspace;
 #endif
 }
 
 ////////////////////////////////////////////////////////////////////
 
-FftConvolution::~FftConvolution()
-{
 #ifdef BUILD_WITH_FFT
-    // Clear the workspace
-    _ws->clear();
+// the FFTW plans used by a convolution object
+struct FftConvolution::FftwPlans
+{
+    fftw_plan forward;      // the real-to-complex transform of the padded data
+    fftw_plan backward;     // the complex-to-real transform of the padded spectrum
 
-    // Delete the workspace
-    delete _ws;
+    ~FftwPlans()
+    {
+        std::unique_lock<std::mutex> lock(planMutex);
+        fftw_destroy_plan(forward);
+        fftw_destroy_plan(backward);
+    }
+};
+#else
+// FFTW is not used in this build
+struct FftConvolution::FftwPlans
+{
+};
 #endif
-}
 
 ////////////////////////////////////////////////////////////////////
 
-void FftConvolution::perform(const Array& input, const Array& kernel, Array& output)
+FftConvolution::FftConvolution(int input_xsize, int input_ysize, const Array& kernel, int kernel_xsize, int kernel_ysize)
+    : _nx(input_xsize), _ny(input_ysize), _cx((kernel_xsize-1)/2), _cy((kernel_ysize-1)/2),
+      _px(paddedSize(input_xsize, kernel_xsize)), _py(paddedSize(input_ysize, kernel_ysize)), _hx(_px/2+1),
+      _rowTransform(_px), _columnTransform(_py)
 {
+    if (kernel.size() != static_cast<size_t>(kernel_xsize)*kernel_ysize)
+        throw FATALERROR("Kernel size does not match the specified dimensions");
+
 #ifdef BUILD_WITH_FFT
-    // Do the convolution
-    _ws->convolve(input, kernel, output);
+    // create the plans, using the workspace of this thread; since the plans are created with the
+    // FFTW_ESTIMATE flag, the contents of the arrays are not touched during planning
+    Workspace& ws = workspace;
+    ws.reserve(_py*_px, _py*_hx);
+    _fftw.reset(new FftwPlans);
+    {
+        std::unique_lock<std::mutex> lock(planMutex);
+        _fftw->forward = fftw_plan_dft_r2c_2d(_py, _px, ws.data, ws.spectrum, FFTW_ESTIMATE);
+        _fftw->backward = fftw_plan_dft_c2r_2d(_py, _px, ws.spectrum, ws.data, FFTW_ESTIMATE);
+    }
+
+    // transform the zero-padded kernel
+    std::fill(ws.data, ws.data + _py*_px, 0.);
+    for (int y = 0; y < kernel_ysize; y++)
+        std::copy(&kernel[y*kernel_xsize], &kernel[y*kernel_xsize] + kernel_xsize, ws.data + y*_px);
+    fftw_execute(_fftw->forward);
+
+    // store the kernel transform, and include the normalization of the inverse transform
+    _kernelSpectrum.resize(_py*_hx);
+    double norm = 1. / (static_cast<double>(_px)*_py);
+    const Complex* spectrum = reinterpret_cast<const Complex*>(ws.spectrum);
+    for (int i = 0; i < _py*_hx; i++) _kernelSpectrum[i] = spectrum[i] * norm;
 #else
-    (void)input; (void)kernel; (void)output;
+    // transform the kernel rows
+    vector<Complex> spectrum(_py*_hx);
+    vector<Complex> buffer(2*max(_px,_py));
+    forwardRows(&kernel[0], kernel_xsize, kernel_ysize, spectrum.data(), buffer.data());
+
+    // transform the kernel columns, and include the normalization of the inverse transform
+    _kernelSpectrum.resize(_py*_hx);
+    double norm = 1. / (static_cast<double>(_px)*_py);
+    for (int k = 0; k < _hx; k++)
+    {
+        Complex* column = &_kernelSpectrum[k*_py];
+        _columnTransform.transform(spectrum.data()+k, column, false, _hx);
+        for (int j = 0; j < _py; j++) column[j] *= norm;
+    }
 #endif
 }
 
 ////////////////////////////////////////////////////////////////////
 
-bool FftConvolution::enabled()
+FftConvolution::~FftConvolution()
+{
+}
+
+////////////////////////////////////////////////////////////////////
+
+int FftConvolution::paddedSize(int input_size, int kernel_size)
+{
+    // the padding must be at least as large as the part of the kernel extending beyond the data
+    // on one side, i.e. excluding the center pixel and the part extending on the other side
+    int center = (kernel_size-1)/2;
+    return FourierTransform::optimalLength(max(kernel_size, input_size+kernel_size-1-center));
+}
+
+////////////////////////////////////////////////////////////////////
+
+double FftConvolution::operationCount(int input_xsize, int input_ysize, int kernel_xsize, int kernel_ysize)
+{
+    // a complex transform of length n takes about 5 n log2(n) operations; the input and output rows
+    // are transformed in pairs, and half of the columns are transformed forward and backward
+    double px = paddedSize(input_xsize, kernel_xsize);
+    double py = paddedSize(input_ysize, kernel_ysize);
+    double rows = input_ysize * 5. * px * std::log2(px);
+    double columns = (px/2+1) * (2 * 5. * py * std::log2(py) + 6. * py);
+    return rows + columns;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void FftConvolution::forwardRows(const double* data, int xsize, int ysize, Complex* spectrum, Complex* rows) const
+{
+    Complex* z = rows;
+    Complex* Z = rows + _px;
+
+    for (int r = 0; r < _py; r += 2)
+    {
+        Complex* a = spectrum + r*_hx;
+        Complex* b = a + _hx;
+        bool pair = r+1 < _py;
+
+        // the padding rows are zero
+        if (r >= ysize)
+        {
+            std::fill(a, a + (pair ? 2 : 1)*_hx, Complex());
+            continue;
+        }
+
+        // pack two real rows into a single complex sequence and transform it
+        const double* ra = data + r*xsize;
+        const double* rb = r+1 < ysize ? ra + xsize : nullptr;
+        for (int x = 0; x < xsize; x++) z[x] = Complex(ra[x], rb ? rb[x] : 0.);
+        std::fill(z + xsize, z + _px, Complex());
+        _rowTransform.transform(z, Z);
+
+        // separate the transforms of the two rows using their Hermitian symmetry
+        for (int k = 0; k < _hx; k++)
+        {
+            Complex Zk = Z[k];
+            Complex Zc = std::conj(Z[k ? _px-k : 0]);
+            a[k] = 0.5*(Zk + Zc);
+            if (pair) b[k] = Complex(0.5*(Zk.imag() - Zc.imag()), -0.5*(Zk.real() - Zc.real()));
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
+void FftConvolution::perform(const Array& input, Array& output) const
 {
+    if (input.size() != static_cast<size_t>(_nx)*_ny)
+        throw FATALERROR("Input data size does not match the dimensions of the convolution");
+
 #ifdef BUILD_WITH_FFT
-    return true;
+    // copy the input into the zero-padded data array of this thread's workspace
+    Workspace& ws = workspace;
+    ws.reserve(_py*_px, _py*_hx);
+    std::fill(ws.data, ws.data + _py*_px, 0.);
+    for (int y = 0; y < _ny; y++) std::copy(&input[y*_nx], &input[y*_nx] + _nx, ws.data + y*_px);
+
+    // transform, multiply by the kernel transform, and transform back; the arrays in the workspace
+    // have the same alignment as those used for creating the plans
+    fftw_execute_dft_r2c(_fftw->forward, ws.data, ws.spectrum);
+    Complex* spectrum = reinterpret_cast<Complex*>(ws.spectrum);
+    for (int i = 0; i < _py*_hx; i++) spectrum[i] = FourierTransform::multiply(spectrum[i], _kernelSpectrum[i]);
+    fftw_execute_dft_c2r(_fftw->backward, ws.spectrum, ws.data);
+
+    // copy the appropriate section to the output
+    output.resize(_nx*_ny);
+    for (int y = 0; y < _ny; y++)
+        std::copy(ws.data + (_cy+y)*_px + _cx, ws.data + (_cy+y)*_px + _cx + _nx, &output[y*_nx]);
 #else
-    return false;
+    // prepare the workspace for this thread
+    Workspace& ws = workspace;
+    ws.spectrum.resize(_py*_hx);
+    ws.buffer.resize(2*max(_px,_py));
+    Complex* spectrum = ws.spectrum.data();
+
+    // transform the input rows
+    forwardRows(&input[0], _nx, _ny, spectrum, ws.buffer.data());
+
+    // for each column: transform, multiply by the kernel transform, and transform back;
+    // only the rows that end up in the output are stored
+    Complex* in = ws.buffer.data();
+    Complex* out = in + _py;
+    for (int k = 0; k < _hx; k++)
+    {
+        _columnTransform.transform(spectrum+k, in, false, _hx);
+        const Complex* kernel = &_kernelSpectrum[k*_py];
+        for (int j = 0; j < _py; j++) in[j] = FourierTransform::multiply(in[j], kernel[j]);
+        _columnTransform.transform(in, out, true);
+        for (int j = _cy; j < _cy+_ny; j++) spectrum[j*_hx+k] = out[j];
+    }
+
+    // transform the output rows back, two at a time, and copy the appropriate section to the output
+    output.resize(_nx*_ny);
+    Complex* z = ws.buffer.data();
+    Complex* Z = z + _px;
+    for (int y = 0; y < _ny; y += 2)
+    {
+        const Complex* a = spectrum + (_cy+y)*_hx;
+        const Complex* b = a + _hx;
+        bool pair = y+1 < _ny;
+
+        // combine the half transforms of the two real rows into the full transform of a complex sequence
+        for (int k = 0; k < _hx; k++)
+            Z[k] = pair ? Complex(a[k].real() - b[k].imag(), a[k].imag() + b[k].real()) : a[k];
+        for (int k = _hx; k < _px; k++)
+        {
+            const Complex& ak = a[_px-k];
+            Z[k] = pair ? Complex(ak.real() + b[_px-k].imag(), -ak.imag() + b[_px-k].real()) : std::conj(ak);
+        }
+        _rowTransform.transform(Z, z, true);
+
+        // the real and imaginary parts hold the two output rows
+        double* oa = &output[y*_nx];
+        for (int x = 0; x < _nx; x++) oa[x] = z[_cx+x].real();
+        if (pair)
+        {
+            double* ob = oa + _nx;
+            for (int x = 0; x < _nx; x++) ob[x] = z[_cx+x].imag();
+        }
+    }
 #endif
 }
 
@@ -7,38 +7,92 @@
 #define FFTCONVOLUTION_HPP
 
 #include "Array.hpp"
-class WorkSpace;
+#include "FourierTransform.hpp"
 
 ////////////////////////////////////////////////////////////////////
 
 /** This class can be used to compute the convolution of 2D data using the Fast Fourier
-    Transform method. */
+    Transform method. An FftConvolution object is constructed for a given kernel and for input
+    data of given dimensions. The constructor calculates the Fourier transform of the kernel, so
+    that it can be reused for any number of convolutions with the same kernel.
+
+    The data and the kernel are zero-padded to dimensions that are efficient for the
+    FourierTransform class and that are sufficiently large to avoid wrap-around effects. The
+    transforms of the (real) data are calculated by transforming two rows at the same time as the
+    real and imaginary parts of a single complex sequence, and by storing only the non-redundant
+    half of each row spectrum. The result of the convolution has the same dimensions as the input
+    data, and equals the result of a linear convolution with the kernel centered on pixel
+    \f$((k_x-1)/2, (k_y-1)/2)\f$, assuming zero values outside of the input data.
+
+    By default, the transforms are calculated by the in-tree FourierTransform class. If the code
+    is built with the BUILD_WITH_FFT option, which requires the FFTW3 library to be installed on
+    the system, the real-to-complex and complex-to-real transforms of that library are used
+    instead. The padded dimensions and the result of the convolution are the same in both cases,
+    and so is the layout of this class, so that client code does not depend on the option.
+
+    The perform() function does not modify the FftConvolution object, so that it can be called
+    from multiple threads at the same time. The intermediate results are stored in a workspace
+    that is allocated separately for each thread and that is reused by subsequent calls from the
+    same thread. */
 class FftConvolution
 {
+public:
+    /** The complex number type used for the Fourier transforms. */
+    typedef FourierTransform::Complex Complex;
+
     //============= Construction - Setup - Destruction =============
 
 public:
-    /** The constructor initializes the workspace which is used to compute the convolution. */
-    FftConvolution(int input_xsize, int input_ysize, int kernel_xsize, int kernel_ysize);
+    /** The constructor prepares the convolution of input data with the specified dimensions, and
+        calculates the Fourier transform of the specified kernel, which has the specified
+        dimensions. In both the input data and the kernel, the x index runs fastest. */
+    FftConvolution(int input_xsize, int input_ysize, const Array& kernel, int kernel_xsize, int kernel_ysize);
 
-    /** The destructor clears the workspace which was used to compute the convolution. */
+    /** The destructor releases the FFTW plans, if any. */
     ~FftConvolution();
 
     //======================== Other Functions =======================
 
-    /** This function perform the convolution. As its first two arguments, it takes const references to
-        the input Array and the kernel Array. The third argument is a reference to the output Array,
-        which will contain the results after the convolution is completed. */
-    void perform(const Array& input, const Array& kernel, Array& output);
+    /** This function returns the size of the zero-padded data in one direction, given the size
+        of the input data and of the kernel in that direction. */
+    static int paddedSize(int input_size, int kernel_size);
 
-    /** This function returns whether FFT convolution is enabled (the required external library is
-        present) or not. */
-    static bool enabled();
+    /** This function returns an estimate of the number of floating point operations performed by
+        the perform() function for input data and a kernel with the specified dimensions. It can
+        be used to compare the cost of an FFT convolution with that of other methods. */
+    static double operationCount(int input_xsize, int input_ysize, int kernel_xsize, int kernel_ysize);
+
+    /** This function returns the size of the input data in the x direction. */
+    int inputSizeX() const { return _nx; }
+
+    /** This function returns the size of the input data in the y direction. */
+    int inputSizeY() const { return _ny; }
+
+    /** This function performs the convolution of the specified input Array with the kernel
+        specified in the constructor, and stores the result in the output Array, which is resized
+        if needed. */
+    void perform(const Array& input, Array& output) const;
+
+private:
+    /** This function calculates the Fourier transform of the specified real input data, which
+        has the dimensions of the input data or of the kernel, after zero-padding to the
+        transform dimensions. The non-redundant half of the transform is stored in the spectrum
+        array in row-major order. The row buffer must have room for two padded rows. */
+    void forwardRows(const double* data, int xsize, int ysize, Complex* spectrum, Complex* rows) const;
 
     //======================== Data Members ========================
 
 private:
-    WorkSpace* _ws;
+    int _nx, _ny;       // the dimensions of the input and output data
+    int _cx, _cy;       // the offsets of the center pixel of the kernel
+    int _px, _py;       // the dimensions of the zero-padded data
+    int _hx;            // the number of non-redundant spectrum elements in each row
+    FourierTransform _rowTransform;
+    FourierTransform _columnTransform;
+    vector<Complex> _kernelSpectrum;    // the normalized kernel transform, stored column by column
+                                        // (or row by row when using FFTW)
+    struct FftwPlans;
+    std::unique_ptr<FftwPlans> _fftw;   // the FFTW plans, if built with the BUILD_WITH_FFT option
 };
 
 ////////////////////////////////////////////////////////////////////
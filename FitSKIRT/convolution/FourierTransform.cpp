@@ -0,0 +1,179 @@
+/*//////////////////////////////////////////////////////////////////
+////     The SKIRT project -- advanced radiative transfer       ////
+////       © Astronomical Observatory, Ghent University         ////
+///////////////////////////////////////////////////////////////// */
+
+#include "FourierTransform.hpp"
+#include "Factorize.hpp"
+#include "FatalError.hpp"
+
+////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    // the factors for which there is a specialized butterfly; end with zero to detect the end of the array
+    int BUTTERFLY_FACTORS[5] = {4,2,3,5,0};
+
+    // the factors in which the optimal lengths decompose
+    int OPTIMAL_FACTORS[4] = {5,3,2,0};
+
+    // the mathematical constant pi
+    const double pi = 3.14159265358979323846;
+}
+
+////////////////////////////////////////////////////////////////////
+
+FourierTransform::FourierTransform(int n)
+    : _n(n)
+{
+    if (n < 1) throw FATALERROR("Fourier transform length must be a positive integer");
+
+    // decompose the length into factors
+    int nf = 0;
+    int factors[64];
+    Factorize::factorize(n, &nf, factors, BUTTERFLY_FACTORS);
+    _factors.assign(factors, factors+nf);
+
+    // precalculate the twiddle factors
+    _twiddles.resize(n);
+    for (int k = 0; k < n; k++) _twiddles[k] = std::polar(1., -2.*pi*k/n);
+}
+
+////////////////////////////////////////////////////////////////////
+
+int FourierTransform::optimalLength(int minimum)
+{
+    return Factorize::find_closest_factor(max(minimum, 1), OPTIMAL_FACTORS);
+}
+
+////////////////////////////////////////////////////////////////////
+
+void FourierTransform::transform(const Complex* in, Complex* out, bool inverse, int stride) const
+{
+    work(out, in, 1, stride, 0, inverse);
+}
+
+////////////////////////////////////////////////////////////////////
+
+void FourierTransform::work(Complex* out, const Complex* in, int fstride, int stride, int level, bool inverse) const
+{
+    // the radix at this level and the length of each of the subsequences
+    int p = _factors[level];
+    int m = _n / (fstride*p);
+
+    // perform the transforms of the p decimated subsequences, or copy the input if the subsequences are trivial
+    if (m == 1)
+    {
+        for (int j = 0; j < p; j++) out[j] = in[j*fstride*stride];
+    }
+    else
+    {
+        for (int j = 0; j < p; j++) work(out + j*m, in + j*fstride*stride, fstride*p, stride, level+1, inverse);
+    }
+
+    // recombine the subsequence transforms using the butterfly for this radix
+    switch (p)
+    {
+    case 2:
+        for (int u = 0; u < m; u++)
+        {
+            Complex t = multiply(out[u+m], twiddle(u*fstride, inverse));
+            out[u+m] = out[u] - t;
+            out[u] += t;
+        }
+        break;
+    case 3:
+        {
+            double epi3 = twiddle(fstride*m, inverse).imag();
+            for (int u = 0; u < m; u++)
+            {
+                Complex s1 = multiply(out[u+m], twiddle(u*fstride, inverse));
+                Complex s2 = multiply(out[u+2*m], twiddle(2*u*fstride, inverse));
+                Complex s3 = s1 + s2;
+                Complex s0 = (s1 - s2) * epi3;
+                Complex h = out[u] - 0.5*s3;
+                out[u] += s3;
+                out[u+2*m] = Complex(h.real() + s0.imag(), h.imag() - s0.real());
+                out[u+m] = Complex(h.real() - s0.imag(), h.imag() + s0.real());
+            }
+        }
+        break;
+    case 4:
+        for (int u = 0; u < m; u++)
+        {
+            Complex s0 = multiply(out[u+m], twiddle(u*fstride, inverse));
+            Complex s1 = multiply(out[u+2*m], twiddle(2*u*fstride, inverse));
+            Complex s2 = multiply(out[u+3*m], twiddle(3*u*fstride, inverse));
+            Complex s5 = out[u] - s1;
+            out[u] += s1;
+            Complex s3 = s0 + s2;
+            Complex s4 = s0 - s2;
+            out[u+2*m] = out[u] - s3;
+            out[u] += s3;
+            if (inverse)
+            {
+                out[u+m] = Complex(s5.real() - s4.imag(), s5.imag() + s4.real());
+                out[u+3*m] = Complex(s5.real() + s4.imag(), s5.imag() - s4.real());
+            }
+            else
+            {
+                out[u+m] = Complex(s5.real() + s4.imag(), s5.imag() - s4.real());
+                out[u+3*m] = Complex(s5.real() - s4.imag(), s5.imag() + s4.real());
+            }
+        }
+        break;
+    case 5:
+        {
+            Complex ya = twiddle(fstride*m, inverse);
+            Complex yb = twiddle(2*fstride*m, inverse);
+            for (int u = 0; u < m; u++)
+            {
+                Complex s0 = out[u];
+                Complex s1 = multiply(out[u+m], twiddle(u*fstride, inverse));
+                Complex s2 = multiply(out[u+2*m], twiddle(2*u*fstride, inverse));
+                Complex s3 = multiply(out[u+3*m], twiddle(3*u*fstride, inverse));
+                Complex s4 = multiply(out[u+4*m], twiddle(4*u*fstride, inverse));
+                Complex s7 = s1 + s4;
+                Complex s10 = s1 - s4;
+                Complex s8 = s2 + s3;
+                Complex s9 = s2 - s3;
+                out[u] = s0 + s7 + s8;
+
+                Complex s5 = s0 + s7*ya.real() + s8*yb.real();
+                Complex s6(s10.imag()*ya.imag() + s9.imag()*yb.imag(), -s10.real()*ya.imag() - s9.real()*yb.imag());
+                out[u+m] = s5 - s6;
+                out[u+4*m] = s5 + s6;
+
+                Complex s11 = s0 + s7*yb.real() + s8*ya.real();
+                Complex s12(-s10.imag()*yb.imag() + s9.imag()*ya.imag(), s10.real()*yb.imag() - s9.real()*ya.imag());
+                out[u+2*m] = s11 + s12;
+                out[u+3*m] = s11 - s12;
+            }
+        }
+        break;
+    default:
+        {
+            vector<Complex> scratch(p);
+            for (int u = 0; u < m; u++)
+            {
+                for (int q = 0; q < p; q++) scratch[q] = out[u+q*m];
+                for (int q1 = 0; q1 < p; q1++)
+                {
+                    int k = u + q1*m;
+                    int index = 0;
+                    Complex sum = scratch[0];
+                    for (int q = 1; q < p; q++)
+                    {
+                        index += fstride*k;
+                        if (index >= _n) index %= _n;
+                        sum += multiply(scratch[q], twiddle(index, inverse));
+                    }
+                    out[k] = sum;
+                }
+            }
+        }
+        break;
+    }
+}
+
+////////////////////////////////////////////////////////////////////
@@ -0,0 +1,83 @@
+/*//////////////////////////////////////////////////////////////////
+////     The SKIRT project -- advanced radiative transfer       ////
+////       © Astronomical Observatory, Ghent University         ////
+///////////////////////////////////////////////////////////////// */
+
+#ifndef FOURIERTRANSFORM_HPP
+#define FOURIERTRANSFORM_HPP
+
+#include "Basics.hpp"
+#include <complex>
+
+////////////////////////////////////////////////////////////////////
+
+/** The FourierTransform class implements a one-dimensional complex discrete Fourier transform of a
+    given length, using a recursive mixed-radix Cooley-Tukey algorithm. The length is decomposed
+    into factors using the Factorize helper functions; there are specialized butterflies for the
+    factors 2, 3, 4 and 5, and a generic (slower) butterfly for any other factor. The lengths that
+    can be transformed most efficiently are returned by the optimalLength() function.
+
+    The constructor precalculates the factorization and the twiddle factors. After construction,
+    the object is never modified, so that a single instance can be used from multiple threads at
+    the same time, as long as each thread provides its own input and output arrays. */
+class FourierTransform
+{
+public:
+    /** The complex number type on which the transform operates. */
+    typedef std::complex<double> Complex;
+
+    //============= Construction - Setup - Destruction =============
+
+public:
+    /** The constructor prepares the transform for sequences of the specified length. */
+    explicit FourierTransform(int n);
+
+    //======================== Other Functions =======================
+
+public:
+    /** This function returns the smallest length not less than the specified minimum length that
+        can be decomposed entirely into the factors 2, 3 and 5, for which the transform is most
+        efficient. */
+    static int optimalLength(int minimum);
+
+    /** This function returns the length of the sequences handled by this transform. */
+    int length() const { return _n; }
+
+    /** This function calculates the discrete Fourier transform of the \f$n\f$ values starting at
+        \em in, spaced \em stride elements apart, and stores the result in the \f$n\f$ consecutive
+        elements starting at \em out. The input and output arrays must not overlap. The forward
+        transform uses the \f$\exp(-2\pi i jk/n)\f$ convention; the inverse transform uses the
+        opposite sign and is not normalized, i.e. a forward transform followed by an inverse
+        transform multiplies the original sequence by \f$n\f$. */
+    void transform(const Complex* in, Complex* out, bool inverse = false, int stride = 1) const;
+
+    /** This function returns the product of the specified complex numbers. Contrary to the
+        standard multiplication operator, it does not check for infinities and NaNs, which allows
+        the compiler to inline the calculation. */
+    static Complex multiply(Complex a, Complex b)
+    {
+        return Complex(a.real()*b.real() - a.imag()*b.imag(), a.real()*b.imag() + a.imag()*b.real());
+    }
+
+private:
+    /** This function recursively performs the transform for the subsequence handled at the
+        specified factorization level. */
+    void work(Complex* out, const Complex* in, int fstride, int stride, int level, bool inverse) const;
+
+    /** This function returns the twiddle factor with the specified index for the given direction. */
+    Complex twiddle(int index, bool inverse) const
+    {
+        return inverse ? std::conj(_twiddles[index]) : _twiddles[index];
+    }
+
+    //======================== Data Members ========================
+
+private:
+    int _n;
+    vector<int> _factors;       // the radix for each level, in order of application
+    vector<Complex> _twiddles;  // exp(-2 pi i k/n) for k = 0..n-1
+};
+
+////////////////////////////////////////////////////////////////////
+
+#endif
@@ -12,18 +12,175 @@
 #include "Log.hpp"
 #include "MonteCarloSimulation.hpp"
 #include "MultiFrameInstrument.hpp"
+#include "OligoMonteCarloSimulation.hpp"
 #include "OligoStellarComp.hpp"
+#include "BoolPropertyHandler.hpp"
+#include "DoublePropertyHandler.hpp"
+#include "ItemListPropertyHandler.hpp"
+#include "ItemPropertyHandler.hpp"
 #include "ParallelFactory.hpp"
+#include "Random.hpp"
+#include "SchemaDef.hpp"
 #include "SimulationItemRegistry.hpp"
 #include "StellarSystem.hpp"
 #include "StringUtils.hpp"
 #include "System.hpp"
 #include "Units.hpp"
 #include "XmlHierarchyCreator.hpp"
+#include <map>
 #include <streambuf>
 
 ////////////////////////////////////////////////////////////////////
 
+namespace
+{
+    // returns a dictionary mapping each label in the specified ski content to the names of the XML
+    // elements enclosing the labeled attribute value, starting with the simulation property (i.e. the
+    // element at nesting level 2, below the root element and the simulation element) and ending with
+    // the element carrying the attribute; the names alternate between property and type names; labels
+    // in attributes of the simulation element itself map to an empty list
+    std::map<string,vector<string>> labelPaths(const string& content)
+    {
+        std::map<string,vector<string>> result;
+        int depth = 0;          // nesting level of the next element
+        vector<string> path;    // names of the open elements at nesting level 2 and deeper
+        size_t index = 0;
+        while (true)
+        {
+            auto left = content.find('<', index);
+            if (left == string::npos) break;
+
+            // skip processing instructions and comments
+            if (content.compare(left, 2, "<?") == 0)
+            {
+                index = content.find("?>", left);
+                if (index == string::npos) break;
+                continue;
+            }
+            if (content.compare(left, 4, "<!--") == 0)
+            {
+                index = content.find("-->", left);
+                if (index == string::npos) break;
+                continue;
+            }
+
+            auto right = content.find('>', left);
+            if (right == string::npos) break;
+            index = right+1;
+
+            // end tag
+            if (content[left+1] == '/')
+            {
+                if (--depth >= 2) path.pop_back();
+                continue;
+            }
+
+            // start tag: get the element name and record the labels in its attribute values
+            string tag = content.substr(left+1, right-left-1);
+            string name = tag.substr(0, tag.find_first_of(" \t\r\n/"));
+            vector<string> labelPath = path;
+            if (depth >= 2) labelPath.push_back(name);
+            for (auto bracket = tag.find('['); bracket != string::npos; bracket = tag.find('[', bracket+1))
+            {
+                auto colon = tag.find(':', bracket);
+                if (colon != string::npos) result[tag.substr(bracket+1, colon-bracket-1)] = labelPath;
+            }
+
+            // regular start tag (as opposed to a self-closing tag)
+            if (tag.back() != '/')
+            {
+                if (depth >= 2) path.push_back(name);
+                ++depth;
+            }
+        }
+        return result;
+    }
+
+    // returns true if the specified element path, as returned by labelPaths(), lies within a dust mix
+    bool insideDustMix(const SchemaDef* schema, const vector<string>& path)
+    {
+        for (size_t i = 1; i < path.size(); i += 2) if (schema->inherits(path[i], "DustMix")) return true;
+        return false;
+    }
+
+    // recursively releases the dust mixes held by item properties in the hierarchy rooted at the specified item,
+    // and hands them to the specified list in the order of the item's properties; the properties still refer to
+    // the released mixes, so the hierarchy should be destroyed right away
+    void releaseDustMixes(const SchemaDef* schema, Item* item, vector<std::unique_ptr<Item>>& mixes)
+    {
+        for (string property : schema->properties(item->type()))
+        {
+            auto handler = schema->createPropertyHandler(item, property);
+            if (auto itemHandler = dynamic_cast<ItemPropertyHandler*>(handler.get()))
+            {
+                Item* value = itemHandler->value();
+                if (!value) continue;
+                if (schema->inherits(value->type(), "DustMix"))
+                {
+                    item->releaseChild(value);
+                    mixes.emplace_back(value);
+                }
+                else releaseDustMixes(schema, value, mixes);
+            }
+            else if (auto listHandler = dynamic_cast<ItemListPropertyHandler*>(handler.get()))
+            {
+                for (Item* value : listHandler->value()) releaseDustMixes(schema, value, mixes);
+            }
+        }
+    }
+
+    // recursively replaces the dust mixes in the hierarchy rooted at the specified item by the mixes in the
+    // specified list, in the same order as used by releaseDustMixes(); the replaced mixes are destroyed
+    void installDustMixes(const SchemaDef* schema, Item* item, vector<std::unique_ptr<Item>>& mixes, size_t& index)
+    {
+        for (string property : schema->properties(item->type()))
+        {
+            auto handler = schema->createPropertyHandler(item, property);
+            if (auto itemHandler = dynamic_cast<ItemPropertyHandler*>(handler.get()))
+            {
+                Item* value = itemHandler->value();
+                if (!value) continue;
+                if (schema->inherits(value->type(), "DustMix"))
+                {
+                    if (index >= mixes.size()) throw FATALERROR("Dust mixes kept for warm start do not match");
+                    itemHandler->setValue(mixes[index++].release());
+                }
+                else installDustMixes(schema, value, mixes, index);
+            }
+            else if (auto listHandler = dynamic_cast<ItemListPropertyHandler*>(handler.get()))
+            {
+                for (Item* value : listHandler->value()) installDustMixes(schema, value, mixes, index);
+            }
+        }
+    }
+
+    // recursively turns off the optional output of all dust mixes in the hierarchy rooted at the specified item;
+    // the dust mix properties are not needed by the fit and would otherwise be written for every individual
+    void disableDustMixOutput(const SchemaDef* schema, Item* item)
+    {
+        bool isMix = schema->inherits(item->type(), "DustMix");
+        for (string property : schema->properties(item->type()))
+        {
+            auto handler = schema->createPropertyHandler(item, property);
+            if (auto boolHandler = dynamic_cast<BoolPropertyHandler*>(handler.get()))
+            {
+                if (isMix && (property == "writeMix" || property == "writeMeanMix" || property == "writeSize"))
+                    boolHandler->setValue(false);
+            }
+            else if (auto itemHandler = dynamic_cast<ItemPropertyHandler*>(handler.get()))
+            {
+                if (itemHandler->value()) disableDustMixOutput(schema, itemHandler->value());
+            }
+            else if (auto listHandler = dynamic_cast<ItemListPropertyHandler*>(handler.get()))
+            {
+                for (Item* value : listHandler->value()) disableDustMixOutput(schema, value);
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
 void AdjustableSkirtSimulation::setupSelfBefore()
 {
     SimulationItem::setupSelfBefore();
@@ -57,6 +214,9 @@ void AdjustableSkirtSimulation::setupSelfBefore()
         find<Units>()->fluxOutputStyle() != simulation->find<Units>()->fluxOutputStyle())
         throw FATALERROR("Fit scheme and ski file must have the same type of unit system and flux output style");
 
+    // copy the number of photon packages from the default simulation
+    _numPackages = simulation->numPackages();
+
     // copy information about the stellar system from the default simulation
     StellarSystem* stelsys = simulation->find<StellarSystem>();
     _ncomponents = stelsys->numComponents();
@@ -77,6 +237,48 @@ void AdjustableSkirtSimulation::setupSelfBefore()
         _pixelSizeY.push_back(insFrame->fieldOfViewY()/insFrame->numPixelsY());
     }
 
+    // determine whether warm starts are possible, and which items must be replaced for each evaluation;
+    // list these items in the order in which they are set up in a regular simulation, because the setup
+    // of the dust grid relies on the stellar system, and the setup of the instruments on the dust system
+    if (warmStart())
+    {
+        _warm = true;
+        if (!dynamic_cast<OligoMonteCarloSimulation*>(simulation))
+        {
+            _warm = false;
+            find<Log>()->warning("Warm start is not possible because it is supported for oligochromatic simulations only");
+        }
+        bool dustLabels = false;
+        bool stellarLabels = false;
+        _reuseMixes = true;
+        if (_warm) for (const auto& pair : labelPaths(_skiContent))
+        {
+            string owner = pair.second.empty() ? string() : pair.second[0];
+            if (owner == "stellarSystem") stellarLabels = true;
+            else if (owner == "dustSystem")
+            {
+                dustLabels = true;
+                if (insideDustMix(schema, pair.second)) _reuseMixes = false;
+            }
+            else if (owner != "instrumentSystem")
+            {
+                _warm = false;
+                find<Log>()->warning("Warm start is not possible because label '" + pair.first + "' resides in "
+                                     + (owner.empty() ? string("the simulation element") : owner));
+                break;
+            }
+        }
+        if (_warm)
+        {
+            if (stellarLabels) _replacedItems.push_back("stellarSystem");
+            if (dustLabels) _replacedItems.push_back("dustSystem");
+            _replacedItems.push_back("instrumentSystem");
+            string reused = !dustLabels ? "wavelength grid and dust system"
+                                        : (_reuseMixes ? "wavelength grid and dust mixes" : "wavelength grid");
+            find<Log>()->info("Using warm start: the " + reused + " will be set up only once");
+        }
+    }
+
     // inform the user
     find<Log>()->info("Number of stellar components in this simulation: " + std::to_string(_ncomponents));
     find<Log>()->info("Number of wavelengths in this simulation: " + std::to_string(_nwavelengths));
@@ -141,12 +343,85 @@ double AdjustableSkirtSimulation::luminosity(int k, int ell) const
 
 ////////////////////////////////////////////////////////////////////
 
-void AdjustableSkirtSimulation::performWith(const ReplacementDict& replacements, string prefix)
+namespace
 {
+    // sets the number of photon packages for the specified simulation
+    void setNumPackages(const SchemaDef* schema, MonteCarloSimulation* simulation, double numPackages)
+    {
+        auto handler = schema->createPropertyHandler(simulation, "numPackages");
+        dynamic_cast<DoublePropertyHandler*>(handler.get())->setValue(numPackages);
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
+void AdjustableSkirtSimulation::performWith(const ReplacementDict& replacements, string prefix,
+                                            vector<vector<Array>>& frames, double packageFraction)
+{
+    // collect the frames for each stellar component from the instrument system in memory
+    frames.assign(_nwavelengths, vector<Array>(_ncomponents));
+    auto sink = [this, &frames] (string name, const Array& data)
+    {
+        for (size_t ell = 0; ell < _nwavelengths; ell++)
+        {
+            for (size_t k = 0; k < _ncomponents; k++)
+            {
+                if (name == _instrname + "_stellar_" + std::to_string(k) + "_" + std::to_string(ell))
+                    frames[ell][k] = data;
+            }
+        }
+    };
+
     // construct the simulation from the ski content after adjustment as requested
     auto schema = SimulationItemRegistry::getSchemaDef();
     auto topitem = XmlHierarchyCreator::readString(schema, adjustedSkiContent(replacements), _skiFilename);
     auto simulation = dynamic_cast<MonteCarloSimulation*>(topitem.get());
+    disableDustMixOutput(schema, simulation);
+
+    // look for the warm state kept from the first evaluation in this thread; the items in the simulation
+    // hierarchy (such as the parallel factory) can be used only from the thread that created them
+    WarmState* warmState = nullptr;
+    if (_warm)
+    {
+        std::lock_guard<std::mutex> lock(_warmMutex);
+        auto it = _warmStates.find(std::this_thread::get_id());
+        if (it != _warmStates.end()) warmState = &it->second;
+    }
+
+    // for a warm start, move the replaced items into the simulation hierarchy kept from the first evaluation,
+    // set them up, and run that simulation again; restore the random state before setting up any items so
+    // that each evaluation receives the same random sequences
+    if (warmState)
+    {
+        auto warm = dynamic_cast<MonteCarloSimulation*>(warmState->simulation.get());
+        vector<SimulationItem*> items;
+        for (string name : _replacedItems)
+        {
+            auto source = schema->createPropertyHandler(simulation, name);
+            auto target = schema->createPropertyHandler(warm, name);
+            Item* item = dynamic_cast<ItemPropertyHandler*>(source.get())->value();
+            simulation->releaseChild(item);
+            if (name == "dustSystem" && _reuseMixes)
+            {
+                size_t index = 0;
+                installDustMixes(schema, item, warmState->mixes, index);
+                if (index != warmState->mixes.size()) throw FATALERROR("Dust mixes kept for warm start do not match");
+                warmState->mixes.clear();
+            }
+            dynamic_cast<ItemPropertyHandler*>(target.get())->setValue(item);
+            items.push_back(dynamic_cast<SimulationItem*>(item));
+        }
+        warm->prepareForRerun();
+        warm->random()->restoreState();
+        for (SimulationItem* item : items) item->setup();
+        setNumPackages(schema, warm, _numPackages*packageFraction);
+        warm->filePaths()->setOutputPrefix(find<FilePaths>()->outputPrefix() + "_" + prefix);
+        warm->instrumentSystem()->setFrameSink(sink);
+        warm->run();
+        releaseReplacedItems(*warmState);
+        verifyFrames(frames);
+        return;
+    }
 
     // setup any simulation attributes that are not loaded from the ski content
     // -> copy file paths
@@ -159,9 +434,55 @@ void AdjustableSkirtSimulation::performWith(const ReplacementDict& replacements,
     simulation->parallelFactory()->setMaxThreadCount(find<FitScheme>()->parallelThreadCount());
     // -> suppress log messages
     simulation->log()->setLowestLevel(Log::Level::Error);
+    // -> adjust the number of photon packages
+    if (packageFraction != 1.) setNumPackages(schema, simulation, simulation->numPackages()*packageFraction);
+    // -> collect the frames in memory
+    simulation->instrumentSystem()->setFrameSink(sink);
 
-    // run the simulation
-    simulation->setupAndRun();
+    // run the simulation; for a warm start, keep the set-up simulation hierarchy for later evaluations
+    if (_warm)
+    {
+        simulation->setup();
+        simulation->random()->saveState();
+        simulation->run();
+        WarmState state;
+        state.simulation = std::move(topitem);
+        releaseReplacedItems(state);
+        std::lock_guard<std::mutex> lock(_warmMutex);
+        _warmStates[std::this_thread::get_id()] = std::move(state);
+    }
+    else simulation->setupAndRun();
+    verifyFrames(frames);
+}
+
+////////////////////////////////////////////////////////////////////
+
+void AdjustableSkirtSimulation::releaseReplacedItems(WarmState& state) const
+{
+    auto schema = SimulationItemRegistry::getSchemaDef();
+    for (string name : _replacedItems)
+    {
+        auto handler = schema->createPropertyHandler(state.simulation.get(), name);
+        auto itemHandler = dynamic_cast<ItemPropertyHandler*>(handler.get());
+        if (name == "dustSystem" && _reuseMixes && itemHandler->value())
+            releaseDustMixes(schema, itemHandler->value(), state.mixes);
+        itemHandler->setToNull();
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
+void AdjustableSkirtSimulation::verifyFrames(const vector<vector<Array>>& frames) const
+{
+    for (size_t ell = 0; ell < _nwavelengths; ell++)
+    {
+        for (size_t k = 0; k < _ncomponents; k++)
+        {
+            if (frames[ell][k].size() != _pixelsX[ell]*_pixelsY[ell])
+                throw FATALERROR("Simulation did not produce the frame for stellar component " + std::to_string(k)
+                                 + " at wavelength index " + std::to_string(ell));
+        }
+    }
 }
 
 ////////////////////////////////////////////////////////////////////
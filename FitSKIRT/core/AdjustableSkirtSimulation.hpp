@@ -7,19 +7,49 @@
 #define ADJUSTABLESKIRTSIMULATION_HPP
 
 #include "SimulationItem.hpp"
+#include "Array.hpp"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 
 ////////////////////////////////////////////////////////////////////
 
 /** The AdjustableSkirtSimulation class allows performing a SKIRT simulation loaded from a ski
     file. The contents of the ski file can be adjusted before the simulation hierarchy is actually
-    created, as described for the performWith() function. */
+    created, as described for the performWith() function.
+
+    If the \em warmStart option is enabled for an oligochromatic simulation, and all labeled
+    attribute values in the ski file reside in the stellar system, the dust system or the
+    instrument system, the simulation hierarchy created for the first evaluation is kept alive and
+    reused for subsequent evaluations. For each evaluation, only the items affected by the labels
+    are constructed and set up anew: the instrument system (which holds the results), the stellar
+    system if it contains labels, and the dust system if it contains labels. In the latter case,
+    the dust mixes that were set up for the first evaluation are moved into the new dust system,
+    unless a label resides inside a dust mix, so that only the geometry, the dust grid and the
+    cell densities are rebuilt. The wavelength grid and the other items are set up just once. The
+    state of the random number generator at the end of the initial setup is restored before
+    setting up the replaced items for each evaluation, so that all warm evaluations receive the
+    same random sequences.
+
+    Since simulations for multiple individuals may be performed concurrently by different slave
+    threads, and the items in a simulation hierarchy can be used only from the thread that created
+    them, a separate simulation hierarchy is kept for each thread. To limit the memory held by
+    these hierarchies between evaluations, the items that will be replaced in the next evaluation
+    (including the instrument system with its data cubes) are destroyed right after each run,
+    keeping only the reused dust mixes. If any label resides elsewhere in the ski file, or the
+    simulation is not oligochromatic, the option has no effect. */
 class AdjustableSkirtSimulation : public SimulationItem
 {
     ITEM_CONCRETE(AdjustableSkirtSimulation, SimulationItem, "an adjustable SKIRT simulation")
 
     PROPERTY_STRING(skiFilename, "the name of the ski file specifying the SKIRT simulation")
 
+    PROPERTY_BOOL(warmStart, "reuse the set-up dust system and wavelength grid across evaluations if possible")
+        ATTRIBUTE_DEFAULT_VALUE(warmStart, "false")
+        ATTRIBUTE_SILENT(warmStart)
+
     ITEM_END()
 
     //======== Construction - Setup - Run - Destruction  ===========
@@ -69,8 +99,15 @@ public:
 
     /** This function runs the SKIRT simulation specified by the previously loaded ski file after
         adjusting its contents as specified through the \em replacements dictionary argument (see
-        detailed description below). The prefix string, if present, is appended to the filename
-        prefix for all output files of this simulation run.
+        detailed description below). The prefix string is appended to the filename prefix for all
+        output files of this simulation run. The calibrated frames of the multi-frame instrument
+        for each stellar component are not written to FITS files, but handed over in memory
+        through a frame sink installed in the instrument system (see
+        InstrumentSystem::setFrameSink()). They are returned in the \em frames table, with a frame
+        per stellar component (inner index) for each wavelength (outer index). Each frame contains
+        the surface brightness values in output units, in the order used for FITS files. The
+        optional output of the dust mixes is turned off, since it is not needed for the fit; any
+        other output requested in the ski file is written to the output directory.
 
         The \em replacements dictionary contains a set of key/value pairs controlling replacement
         of labeled attribute values in the ski file. The key for each dictionary item is a string
@@ -93,21 +130,55 @@ public:
         If the label matches one of the keys in the replacement dictionary handed to this function,
         the corresponding value is substituted in the ski file, removing the brackets and the
         label. If the label does not match one of the keys in the replacement dictionary, a fatal
-        error is thrown. */
-    void performWith(const ReplacementDict& replacements, string prefix=string());
+        error is thrown.
+
+        If a warm start is possible (see the class description), the function reuses the set-up
+        simulation hierarchy from the previous evaluation, replacing only the items affected by
+        the replacements.
+
+        The optional \em packageFraction argument specifies the number of photon packages to be
+        launched as a fraction of the number specified in the ski file. A value below one allows
+        a quick (but noisier) evaluation of the adjusted simulation. */
+    void performWith(const ReplacementDict& replacements, string prefix, vector<vector<Array>>& frames,
+                     double packageFraction=1.);
 
 private:
     /** This private function performs the specified adjustments on the previously loaded ski
         content as described for the performWith() function, and returns the result. */
     string adjustedSkiContent(const ReplacementDict& replacements);
 
+    /** The state kept alive across evaluations for warm starts, for a single calling thread. */
+    struct WarmState
+    {
+        std::unique_ptr<Item> simulation;       // the set-up simulation hierarchy, without the replaced items
+        vector<std::unique_ptr<Item>> mixes;    // the set-up dust mixes released from the replaced dust system
+    };
+
+    /** This private function destroys the items in the specified warm simulation hierarchy that will
+        be replaced in the next evaluation, after releasing the dust mixes to be reused (if any)
+        into the warm state. */
+    void releaseReplacedItems(WarmState& state) const;
+
+    /** This private function verifies that the specified table contains a frame with the
+        appropriate size for each stellar component and wavelength, and throws a fatal error if
+        not. */
+    void verifyFrames(const vector<vector<Array>>& frames) const;
+
     //======================== Data Members ========================
 
 private:
     // initialized during setup
     string _skiContent;                 // the content of the ski file, without modifications
+    bool _warm{false};                  // true if warm starts are enabled and possible for this ski file
+    vector<string> _replacedItems;      // the names of the simulation properties replaced for each evaluation
+    bool _reuseMixes{false};            // true if the dust mixes are reused when the dust system is replaced
+
+    // the warm states kept alive across evaluations, one per calling thread
+    std::map<std::thread::id, WarmState> _warmStates;
+    std::mutex _warmMutex;              // protects the warm state map
 
     // information extracted from the default simulation hierarchy during setup
+    double _numPackages{0.};            // the number of photon packages per wavelength
     size_t _ncomponents{0};             // the number of stellar components
     size_t _nwavelengths{0};            // the number of wavelentghs/instrument frames
     string _instrname;                  // the name of the multi-frame instrument
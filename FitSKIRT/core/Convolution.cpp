@@ -5,75 +5,199 @@
 
 #include "Convolution.hpp"
 #include "ConvolutionKernel.hpp"
-#include "FatalError.hpp"
 #include "FftConvolution.hpp"
 #include "Image.hpp"
+#include "Parallel.hpp"
+#include "ParallelFactory.hpp"
 
 ////////////////////////////////////////////////////////////////////
 
-void Convolution::fft(Image& image, const ConvolutionKernel& kernel)
+namespace
 {
-    // Test whether FFT convolution is possible
-    if (!FftConvolution::enabled()) throw FATALERROR("The library required for FFT is not present");
+    // the number of output rows in a strip handled by a single parallel loop iteration
+    const int stripHeight = 8;
 
-    // Initialize an output array
-    Array output(image.size());
+    // the maximum number of output pixels in a row section accumulated over all kernel pixels
+    const int sectionWidth = 1024;
 
-    // Create an FftConvolution object
-    FftConvolution fftc(image.sizeX(), image.sizeY(), kernel.sizeX(), kernel.sizeY());
+    // the minimum number of operations for which the direct and separable methods use multiple threads
+    const double minParallelCost = 1e6;
 
-    // Perform the convolution
-    fftc.perform(image.data(), kernel.data(), output);
+    // the cost of a pass over an output row section for a single kernel row, expressed in multiply-adds
+    const double rowPassCost = 2.;
 
-    // Move the output array to the image
-    image.moveData(std::move(output));
-}
+    // the cost of an FFT operation relative to the cost of a multiply-add in the direct method
+    const double fftOperationCost = 1.7;
 
-////////////////////////////////////////////////////////////////////
+    // the factory for the parallel objects used by the current thread; it is constructed when first used
+    thread_local ParallelFactory factory;
 
-void Convolution::loop(Image& image, const ConvolutionKernel& kernel)
-{
-    // Initialize a convolved image
-    Array output(image.size());
-
-    // Do the convolution by looping over all input frame pixels and all kernel pixels
-    for (int l = 0; l < image.size(); l++)
+    // convolves the output rows in the range [y0,y1) as described for the direct() function; the input
+    // is zero-padded so that all kernel pixels can be applied to all output pixels without bounds checks
+    void convolveRows(const double* padded, double* output, int nx, const double* kernel, int kx, int ky,
+                      int y0, int y1)
     {
-        // Determine the x and y coordinate of the input image
-        int yi = l/image.sizeX();
-        int xi = l-image.sizeX()*yi;
+        int pw = nx + kx - 1;
 
-        // Loop over the kernel pixels in the x direction
-        for (int xk = 0; xk < kernel.sizeX(); xk++)
+        for (int x0 = 0; x0 < nx; x0 += sectionWidth)
         {
-            // Loop over the kernel pixels in the y direction
-            for (int yk = 0; yk < kernel.sizeY(); yk++)
+            int x1 = min(nx, x0+sectionWidth);
+            for (int y = y0; y < y1; y++)
             {
-                int startX = xi - (kernel.sizeX()-1)/2;
-                int startY = yi - (kernel.sizeY()-1)/2;
-
-                // Exclude pixels out of bound
-                if (startX + xk >= 0 && startY + yk >= 0 && startX + xk < image.sizeX() && startY + yk < image.sizeY())
+                double* out = output + y*nx;
+                for (int yk = 0; yk < ky; yk++)
                 {
-                    output[(startX + xk)+image.sizeX()*(startY + yk)] += image[xi+image.sizeX()*(yi)] * kernel(xk,yk);
+                    // the input row section for kernel pixel (xk,yk) starts at base - xk
+                    const double* base = padded + (y+ky-1-yk)*pw + kx-1;
+                    const double* k = kernel + yk*kx;
+
+                    // apply four kernel pixels at a time to limit the number of loads and stores of the output
+                    int xk = 0;
+                    for (; xk+4 <= kx; xk += 4)
+                    {
+                        double w0 = k[xk], w1 = k[xk+1], w2 = k[xk+2], w3 = k[xk+3];
+                        const double* s0 = base - xk;
+                        const double* s1 = s0 - 1;
+                        const double* s2 = s0 - 2;
+                        const double* s3 = s0 - 3;
+                        for (int x = x0; x < x1; x++) out[x] += w0*s0[x] + w1*s1[x] + w2*s2[x] + w3*s3[x];
+                    }
+                    for (; xk < kx; xk++)
+                    {
+                        double w = k[xk];
+                        const double* src = base - xk;
+                        for (int x = x0; x < x1; x++) out[x] += w*src[x];
+                    }
                 }
             }
         }
     }
 
+    // a target for parallel execution of a convolution, processing a strip of output rows per index
+    class ConvolutionTarget : public ParallelTarget
+    {
+    public:
+        ConvolutionTarget(const double* padded, double* output, int nx, int ny,
+                          const double* kernel, int kx, int ky)
+            : _padded(padded), _output(output), _nx(nx), _ny(ny), _kernel(kernel), _kx(kx), _ky(ky) { }
+
+        size_t numStrips() const { return (_ny + stripHeight - 1) / stripHeight; }
+
+        void body(size_t index) override
+        {
+            int y0 = static_cast<int>(index) * stripHeight;
+            convolveRows(_padded, _output, _nx, _kernel, _kx, _ky, y0, min(_ny, y0+stripHeight));
+        }
+
+    private:
+        const double* _padded;
+        double* _output;
+        int _nx, _ny;
+        const double* _kernel;
+        int _kx, _ky;
+    };
+
+    // convolves the input data with the kernel and returns the result, using the specified number of threads
+    Array convolveArray(const Array& input, int nx, int ny, const Array& kernel, int kx, int ky, int threadCount)
+    {
+        // copy the input into a zero-padded array, with the padding on each side matching the kernel extent
+        int cx = (kx-1)/2;
+        int cy = (ky-1)/2;
+        int pw = nx + kx - 1;
+        Array padded(pw * (ny + ky - 1));
+        for (int y = 0; y < ny; y++)
+            std::copy(&input[y*nx], &input[y*nx] + nx, &padded[(y+ky-1-cy)*pw + kx-1-cx]);
+
+        Array output(input.size());
+        ConvolutionTarget target(&padded[0], &output[0], nx, ny, &kernel[0], kx, ky);
+        if (threadCount > 1 && static_cast<double>(nx)*ny*kx*ky >= minParallelCost)
+        {
+            factory.parallel(threadCount)->call(&target, target.numStrips());
+        }
+        else
+        {
+            for (size_t index = 0; index < target.numStrips(); index++) target.body(index);
+        }
+        return output;
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
+void Convolution::fft(Image& image, const FftConvolution& fftc)
+{
+    // Initialize an output array
+    Array output(image.size());
+
+    // Perform the convolution
+    fftc.perform(image.data(), output);
+
     // Move the output array to the image
     image.moveData(std::move(output));
 }
 
 ////////////////////////////////////////////////////////////////////
 
-void Convolution::convolve(Image& image, const ConvolutionKernel& kernel)
+void Convolution::direct(Image& image, const ConvolutionKernel& kernel, int threadCount)
+{
+    image.moveData(convolveArray(image.data(), image.sizeX(), image.sizeY(),
+                                 kernel.data(), kernel.sizeX(), kernel.sizeY(), threadCount));
+}
+
+////////////////////////////////////////////////////////////////////
+
+void Convolution::separable(Image& image, const ConvolutionKernel& kernel, int threadCount)
 {
-    // Use the Fast Fourier Transform method for the convolution if the kernel is sufficiently large
-    if (kernel.size() > 200 && FftConvolution::enabled()) fft(image, kernel);
+    // Convolve the rows with the factors in the x direction, treated as a kernel with a single row
+    image.moveData(convolveArray(image.data(), image.sizeX(), image.sizeY(),
+                                 kernel.factorsX(), kernel.sizeX(), 1, threadCount));
 
-    // Else, use the standard nested loop that iterates over all image and kernel pixels
-    else loop(image, kernel);
+    // Convolve the columns with the factors in the y direction, treated as a kernel with a single column
+    image.moveData(convolveArray(image.data(), image.sizeX(), image.sizeY(),
+                                 kernel.factorsY(), 1, kernel.sizeY(), threadCount));
+}
+
+////////////////////////////////////////////////////////////////////
+
+Convolution::Method Convolution::method(const Image& image, const ConvolutionKernel& kernel, int threadCount)
+{
+    double numPixels = image.size();
+    double threads = max(threadCount, 1);
+
+    // Estimate the cost of each method, expressed in multiply-adds of the direct method
+    double kx = kernel.sizeX();
+    double ky = kernel.sizeY();
+    double directCost = numPixels * ky * (kx + rowPassCost) / threads;
+    double separableCost = kernel.isSeparable() ? numPixels * ((kx + rowPassCost) + ky * (1. + rowPassCost)) / threads
+                                                : std::numeric_limits<double>::infinity();
+    double fftCost = fftOperationCost * FftConvolution::operationCount(image.sizeX(), image.sizeY(),
+                                                                       kernel.sizeX(), kernel.sizeY());
+
+    // Select the cheapest method
+    if (fftCost < directCost && fftCost < separableCost) return Method::Fft;
+    if (separableCost < directCost) return Method::Separable;
+    return Method::Direct;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void Convolution::convolve(Image& image, const ConvolutionKernel& kernel, const FftConvolution* fftc,
+                           int threadCount)
+{
+    switch (method(image, kernel, threadCount))
+    {
+    case Method::Fft:
+        // Use the prepared kernel transform if it matches the image, or create a new one
+        if (fftc && fftc->inputSizeX() == image.sizeX() && fftc->inputSizeY() == image.sizeY()) fft(image, *fftc);
+        else fft(image, FftConvolution(image.sizeX(), image.sizeY(), kernel.data(), kernel.sizeX(), kernel.sizeY()));
+        break;
+    case Method::Separable:
+        separable(image, kernel, threadCount);
+        break;
+    case Method::Direct:
+        direct(image, kernel, threadCount);
+        break;
+    }
 }
 
 ////////////////////////////////////////////////////////////////////
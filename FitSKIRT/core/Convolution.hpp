@@ -9,26 +9,58 @@
 #include "Basics.hpp"
 class Image;
 class ConvolutionKernel;
+class FftConvolution;
 
 ////////////////////////////////////////////////////////////////////
 
 /** This static class offers functions to convolve a given image with a given convolution kernel.
-    */
+    Three methods are available: a direct convolution, a separable convolution for kernels that
+    can be written as the outer product of two vectors, and a convolution using the Fast Fourier
+    Transform (FFT). The direct and separable methods can use multiple execution threads. The
+    convolve() function selects the method with the lowest estimated cost. */
 class Convolution final
 {
+public:
+    /** This enumeration lists the available convolution methods. */
+    enum class Method { Direct, Separable, Fft };
+
 private:
-    /** This function convolves a given image with a given convolution kernel using the Fast
-        Fourier Transform (FFT) method. */
-    static void fft(Image& image, const ConvolutionKernel& kernel);
+    /** This function convolves a given image using the Fast Fourier Transform (FFT) method, with
+        the kernel for which the specified FftConvolution object has been prepared. */
+    static void fft(Image& image, const FftConvolution& fftc);
 
-    /** This function convolves a given image with a given convolution kernel using nested loops (a
-        loop over the image pixels inside a loop over the kernel pixels). */
-    static void loop(Image& image, const ConvolutionKernel& kernel);
+    /** This function convolves a given image with a given convolution kernel by calculating, for
+        each output pixel, the weighted sum of the surrounding input pixels. The output image is
+        divided into horizontal strips that are processed in parallel by the specified number of
+        threads. Within a strip, each output row is accumulated one kernel pixel at a time as a
+        scaled copy of the relevant input row section. These innermost loops run over consecutive
+        memory locations, allowing the compiler to use vector instructions, and are limited to
+        sections of limited width so that they operate on data in the processor cache. */
+    static void direct(Image& image, const ConvolutionKernel& kernel, int threadCount);
+
+    /** This function convolves a given image with a given separable convolution kernel by
+        performing a one-dimensional convolution along the rows, followed by a one-dimensional
+        convolution along the columns, using the same techniques as the direct() function. */
+    static void separable(Image& image, const ConvolutionKernel& kernel, int threadCount);
 
 public:
-    /** This function convolves a given image with a given convolution kernel using one of the
-        private methods defined in this class, depending on availability. */
-    static void convolve(Image& Image, const ConvolutionKernel& kernel);
+    /** This function returns the convolution method with the lowest estimated cost for convolving
+        an image with the dimensions of the given image with the given convolution kernel, using the
+        specified number of threads. The cost of the direct and separable methods is proportional
+        to the number of multiply-add operations, and is divided by the number of threads. The
+        cost of the FFT method is derived from the number of operations for the Fourier
+        transforms, and assumes that the transform of the kernel has been calculated beforehand.
+        */
+    static Method method(const Image& image, const ConvolutionKernel& kernel, int threadCount = 1);
+
+    /** This function convolves a given image with a given convolution kernel using the method
+        returned by the method() function, with the specified number of threads. If the FFT
+        method is selected, the function uses the specified FftConvolution object, if it has been
+        prepared for the given kernel and for images with the same dimensions as the given image.
+        This avoids recalculating the Fourier transform of the kernel for each convolution.
+        Otherwise, a temporary FftConvolution object is constructed. */
+    static void convolve(Image& image, const ConvolutionKernel& kernel, const FftConvolution* fftc = nullptr,
+                         int threadCount = 1);
 };
 
 ////////////////////////////////////////////////////////////////////
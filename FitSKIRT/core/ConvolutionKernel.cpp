@@ -19,6 +19,45 @@ void ConvolutionKernel::setupSelfAfter()
     SimulationItem::setupSelfAfter();
 
     (*this) /= (*this).sum();
+
+    // locate the pixel with the largest absolute value
+    int nx = sizeX();
+    int ny = sizeY();
+    int x0 = 0, y0 = 0;
+    double largest = 0.;
+    for (int y = 0; y < ny; y++)
+    {
+        for (int x = 0; x < nx; x++)
+        {
+            if (std::abs((*this)(x,y)) > largest)
+            {
+                largest = std::abs((*this)(x,y));
+                x0 = x;
+                y0 = y;
+            }
+        }
+    }
+    if (largest == 0.) return;
+
+    // use the row and column through that pixel as the factors, and verify that their outer
+    // product reproduces the kernel
+    _factorsX.resize(nx);
+    _factorsY.resize(ny);
+    for (int x = 0; x < nx; x++) _factorsX[x] = (*this)(x,y0);
+    for (int y = 0; y < ny; y++) _factorsY[y] = (*this)(x0,y) / (*this)(x0,y0);
+    _separable = true;
+    for (int y = 0; y < ny && _separable; y++)
+    {
+        for (int x = 0; x < nx && _separable; x++)
+        {
+            if (std::abs(_factorsX[x]*_factorsY[y] - (*this)(x,y)) > 1e-12*largest) _separable = false;
+        }
+    }
+    if (!_separable)
+    {
+        _factorsX.resize(0);
+        _factorsY.resize(0);
+    }
 }
 
 ////////////////////////////////////////////////////////////////////
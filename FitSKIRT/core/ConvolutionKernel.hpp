@@ -12,7 +12,10 @@
 ////////////////////////////////////////////////////////////////////
 
 /** The ConvolutionKernel class is used to describe a general convolution kernel. Subclasses of
-    this class represent specific types of convolution kernels. */
+    this class represent specific types of convolution kernels. After setup, the kernel also knows
+    whether it is separable, i.e. whether it can be written as the outer product of a column
+    vector and a row vector (a matrix of rank one). A convolution with a separable kernel can be
+    performed as two one-dimensional convolutions, which is much faster for larger kernels. */
 class ConvolutionKernel : public SimulationItem, public Image
 {
     ITEM_ABSTRACT(ConvolutionKernel, SimulationItem, "a convolution kernel")
@@ -26,8 +29,31 @@ protected:
     void setupSelfBefore() override;
 
     /** This function, only implemented in the base class, makes sure that the kernel is properly
-        normalized. */
+        normalized, and determines whether the kernel is separable. The kernel is considered to be
+        separable if the outer product of its factors reproduces each kernel value to within a
+        small fraction of the largest kernel value. */
     void setupSelfAfter() override;
+
+    //======================== Other Functions =======================
+
+public:
+    /** This function returns true if the kernel is separable. */
+    bool isSeparable() const { return _separable; }
+
+    /** If the kernel is separable, this function returns the factors for each pixel in the x
+        direction, i.e. the row vector of the outer product. */
+    const Array& factorsX() const { return _factorsX; }
+
+    /** If the kernel is separable, this function returns the factors for each pixel in the y
+        direction, i.e. the column vector of the outer product. */
+    const Array& factorsY() const { return _factorsY; }
+
+    //======================== Data Members ========================
+
+private:
+    bool _separable{false};
+    Array _factorsX;
+    Array _factorsY;
 };
 
 ////////////////////////////////////////////////////////////////////
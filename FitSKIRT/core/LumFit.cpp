@@ -0,0 +1,311 @@
+/*//////////////////////////////////////////////////////////////////
+////     The SKIRT project -- advanced radiative transfer       ////
+////       © Astronomical Observatory, Ghent University         ////
+///////////////////////////////////////////////////////////////// */
+
+#include "LumFit.hpp"
+#include "FatalError.hpp"
+#include "Image.hpp"
+
+////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    // the maximum number of Newton iterations
+    const int maxIterations = 100;
+
+    // the maximum number of step halvings in the line search of a single iteration
+    const int maxHalvings = 50;
+
+    // the relative change in the luminosities below which the iteration has converged
+    const double tolerance = 1e-10;
+
+    // the fraction of the predicted decrease required for accepting a step (Armijo condition)
+    const double sufficientDecrease = 1e-4;
+
+    // the following functions return the sum of the elements, of the products of the elements of two
+    // arrays, and of the products of the elements of three arrays; they use four partial sums so
+    // that the additions do not wait for each other
+    double sum(const double* a, size_t n)
+    {
+        double s0 = 0., s1 = 0., s2 = 0., s3 = 0.;
+        size_t m = 0;
+        for (; m+4 <= n; m += 4)
+        {
+            s0 += a[m]; s1 += a[m+1]; s2 += a[m+2]; s3 += a[m+3];
+        }
+        for (; m < n; m++) s0 += a[m];
+        return (s0+s1) + (s2+s3);
+    }
+
+    double dot(const double* a, const double* b, size_t n)
+    {
+        double s0 = 0., s1 = 0., s2 = 0., s3 = 0.;
+        size_t m = 0;
+        for (; m+4 <= n; m += 4)
+        {
+            s0 += a[m]*b[m]; s1 += a[m+1]*b[m+1]; s2 += a[m+2]*b[m+2]; s3 += a[m+3]*b[m+3];
+        }
+        for (; m < n; m++) s0 += a[m]*b[m];
+        return (s0+s1) + (s2+s3);
+    }
+
+    double dot(const double* a, const double* b, const double* c, size_t n)
+    {
+        double s0 = 0., s1 = 0., s2 = 0., s3 = 0.;
+        size_t m = 0;
+        for (; m+4 <= n; m += 4)
+        {
+            s0 += a[m]*b[m]*c[m]; s1 += a[m+1]*b[m+1]*c[m+1];
+            s2 += a[m+2]*b[m+2]*c[m+2]; s3 += a[m+3]*b[m+3]*c[m+3];
+        }
+        for (; m < n; m++) s0 += a[m]*b[m]*c[m];
+        return (s0+s1) + (s2+s3);
+    }
+
+    // solves the linear system A x = b of dimension n (with A in row-major order) using Gaussian
+    // elimination with partial pivoting; A and b are destroyed; the components of x corresponding
+    // to a vanishing pivot, i.e. to a direction in which the system is singular, are set to zero
+    vector<double> solve(vector<double>& A, vector<double>& b, size_t n)
+    {
+        double scale = 0.;
+        for (size_t i = 0; i < n; i++) scale = max(scale, abs(A[i*n+i]));
+        double threshold = 1e-14 * scale;
+
+        vector<bool> singular(n, false);
+        for (size_t k = 0; k < n; k++)
+        {
+            size_t p = k;
+            for (size_t i = k+1; i < n; i++) if (abs(A[i*n+k]) > abs(A[p*n+k])) p = i;
+            if (p != k)
+            {
+                for (size_t j = 0; j < n; j++) std::swap(A[k*n+j], A[p*n+j]);
+                std::swap(b[k], b[p]);
+            }
+            if (abs(A[k*n+k]) <= threshold)
+            {
+                singular[k] = true;
+                continue;
+            }
+            for (size_t i = k+1; i < n; i++)
+            {
+                double factor = A[i*n+k] / A[k*n+k];
+                for (size_t j = k; j < n; j++) A[i*n+j] -= factor * A[k*n+j];
+                b[i] -= factor * b[k];
+            }
+        }
+
+        vector<double> x(n, 0.);
+        for (size_t k = n; k-- > 0; )
+        {
+            if (singular[k]) continue;
+            double s = b[k];
+            for (size_t j = k+1; j < n; j++) s -= A[k*n+j] * x[j];
+            x[k] = s / A[k*n+k];
+        }
+        return x;
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
+void LumFit::setMinLuminosities(const vector<double>& value)
+{
+    _minLum = value;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void LumFit::setMaxLuminosities(const vector<double>& value)
+{
+    _maxLum = value;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void LumFit::gather(const Image& refframe, vector<Image>& frames)
+{
+    size_t ncomp = frames.size();
+    size_t size = refframe.size();
+    for (const Image& frame : frames)
+        if (frame.size() != refframe.size())
+            throw FATALERROR("Input frame and reference frame have different dimensions");
+
+    // count the pixels that are not masked
+    _numPixels = 0;
+    for (size_t m = 0; m < size; m++) if (refframe[m] != 0) _numPixels++;
+
+    // copy the values of these pixels, and take over the mask in the input frames
+    _ref.resize(_numPixels);
+    _frames.resize(ncomp*_numPixels);
+    for (size_t n = 0; n < ncomp; n++)
+    {
+        double* target = &_frames[n*_numPixels];
+        Image& frame = frames[n];
+        size_t i = 0;
+        for (size_t m = 0; m < size; m++)
+        {
+            if (refframe[m] != 0) target[i++] = frame[m];
+            else frame[m] = 0;
+        }
+    }
+    size_t i = 0;
+    for (size_t m = 0; m < size; m++) if (refframe[m] != 0) _ref[i++] = refframe[m];
+
+    _model.resize(_numPixels);
+    _d1.resize(_numPixels);
+    _d2.resize(_numPixels);
+}
+
+////////////////////////////////////////////////////////////////////
+
+double LumFit::evaluate(const vector<double>& lum, vector<double>* gradient, vector<double>* hessian)
+{
+    size_t ncomp = lum.size();
+    size_t M = _numPixels;
+    const double* ref = _ref.data();
+    double* model = _model.data();
+    double* d1 = _d1.data();
+    double* d2 = _d2.data();
+
+    // calculate the weighted sum of the frames
+    std::fill(model, model+M, 0.);
+    for (size_t n = 0; n < ncomp; n++)
+    {
+        const double* frame = &_frames[n*M];
+        double L = lum[n];
+        for (size_t m = 0; m < M; m++) model[m] += L * frame[m];
+    }
+
+    // calculate the chi2 contribution of each pixel and its derivatives with respect to the model value;
+    // with u = r - s and v = |r| + s, the contribution is u^2/v, the first derivative is -(u/v)(2+u/v),
+    // and the second derivative is 2(|r|+r)^2/v^3; the model values are replaced by the contributions
+    for (size_t m = 0; m < M; m++)
+    {
+        double r = ref[m];
+        double v = abs(r) + model[m];
+        double q = (r - model[m]) / v;
+        double w = (abs(r) + r) / v;
+        d1[m] = -q * (2. + q);
+        d2[m] = 2. * w * w / v;
+        model[m] = (r - model[m]) * q;
+    }
+    double chi2 = sum(model, M);
+
+    // calculate the gradient and the Hessian matrix through the chain rule
+    if (gradient && hessian)
+    {
+        gradient->resize(ncomp);
+        hessian->resize(ncomp*ncomp);
+        for (size_t n = 0; n < ncomp; n++)
+        {
+            const double* fn = &_frames[n*M];
+            (*gradient)[n] = dot(d1, fn, M);
+            for (size_t k = 0; k <= n; k++)
+            {
+                double h = dot(d2, fn, &_frames[k*M], M);
+                (*hessian)[n*ncomp+k] = h;
+                (*hessian)[k*ncomp+n] = h;
+            }
+        }
+    }
+    return chi2;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void LumFit::optimize(const Image& refframe, vector<Image>& frames, vector<double>& luminosities, double& chi2)
+{
+    size_t ncomp = frames.size();
+    if (_minLum.size() != ncomp || _maxLum.size() != ncomp)
+        throw FATALERROR("Number of luminosities and components do not match");
+
+    gather(refframe, frames);
+
+    // start from the geometric mean of the boundaries
+    vector<double> lum(ncomp);
+    for (size_t n = 0; n < ncomp; n++) lum[n] = sqrt(_minLum[n]*_maxLum[n]);
+
+    vector<double> gradient, hessian, trial(ncomp);
+    double chi = evaluate(lum, &gradient, &hessian);
+    for (int iteration = 0; iteration < maxIterations; iteration++)
+    {
+        // the free luminosities are those that are not held at a boundary by the gradient
+        vector<size_t> freeIndices;
+        for (size_t n = 0; n < ncomp; n++)
+        {
+            bool atMin = lum[n] <= _minLum[n] && gradient[n] > 0;
+            bool atMax = lum[n] >= _maxLum[n] && gradient[n] < 0;
+            if (!atMin && !atMax) freeIndices.push_back(n);
+        }
+        if (freeIndices.empty()) break;
+
+        // determine the Newton step for the free luminosities
+        size_t nfree = freeIndices.size();
+        vector<double> A(nfree*nfree), b(nfree);
+        for (size_t i = 0; i < nfree; i++)
+        {
+            b[i] = -gradient[freeIndices[i]];
+            for (size_t j = 0; j < nfree; j++) A[i*nfree+j] = hessian[freeIndices[i]*ncomp+freeIndices[j]];
+        }
+        vector<double> step = solve(A, b, nfree);
+
+        // shorten the step until the projection on the box sufficiently decreases chi2
+        bool accepted = false;
+        bool converged = false;
+        double trialChi = chi;
+        double t = 1.;
+        for (int halving = 0; halving < maxHalvings && !accepted; halving++, t *= 0.5)
+        {
+            trial = lum;
+            for (size_t i = 0; i < nfree; i++)
+            {
+                size_t n = freeIndices[i];
+                trial[n] = min(_maxLum[n], max(_minLum[n], lum[n] + t*step[i]));
+            }
+
+            // stop if the step no longer changes the luminosities significantly
+            converged = true;
+            double slope = 0.;
+            for (size_t n = 0; n < ncomp; n++)
+            {
+                if (abs(trial[n]-lum[n]) > tolerance*abs(lum[n])) converged = false;
+                slope += gradient[n] * (trial[n]-lum[n]);
+            }
+            if (converged) break;
+
+            trialChi = evaluate(trial, nullptr, nullptr);
+            accepted = trialChi <= chi + sufficientDecrease*slope;
+        }
+        if (!accepted) break;
+
+        lum = trial;
+        chi = evaluate(lum, &gradient, &hessian);
+    }
+
+    luminosities = lum;
+    chi2 = chi;
+}
+
+////////////////////////////////////////////////////////////////////
+
+double LumFit::chi2Variance(const vector<double>& luminosities, const vector<double>& noiseFactors)
+{
+    size_t ncomp = luminosities.size();
+    size_t M = _numPixels;
+    if (_frames.size() != ncomp*M || noiseFactors.size() != ncomp)
+        throw FATALERROR("Number of luminosities and components do not match");
+
+    // calculate the derivatives of chi2 with respect to the model values for these luminosities
+    evaluate(luminosities, nullptr, nullptr);
+    for (size_t m = 0; m < M; m++) _d2[m] = _d1[m] * _d1[m];
+
+    double variance = 0.;
+    for (size_t n = 0; n < ncomp; n++)
+    {
+        variance += luminosities[n] * luminosities[n] * noiseFactors[n] * dot(_d2.data(), &_frames[n*M], M);
+    }
+    return variance;
+}
+
+////////////////////////////////////////////////////////////////////
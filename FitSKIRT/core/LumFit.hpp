@@ -0,0 +1,83 @@
+/*//////////////////////////////////////////////////////////////////
+////     The SKIRT project -- advanced radiative transfer       ////
+////       © Astronomical Observatory, Ghent University         ////
+///////////////////////////////////////////////////////////////// */
+
+#ifndef LUMFIT_HPP
+#define LUMFIT_HPP
+
+#include "Basics.hpp"
+class Image;
+
+////////////////////////////////////////////////////////////////////
+
+/** The LumFit class determines the luminosity multiplicators for an arbitrary number of input
+    frames so that their weighted sum optimally matches a reference frame. The quality of the match
+    is measured by \f[ \chi^2 = \sum_m \frac{(r_m - s_m)^2}{|r_m| + s_m}, \qquad s_m = \sum_n L_n
+    f_{n,m}, \f] where the sum runs over the pixels \f$m\f$ that are not masked in the reference
+    frame \f$r\f$, \f$f_n\f$ are the input frames and \f$L_n\f$ the luminosity multiplicators,
+    each of which is constrained to a given interval.
+
+    The pixel values needed by the optimization are gathered in a single pass over the images,
+    omitting the masked pixels and storing the values for each frame in a consecutive array. The
+    function \f$\chi^2(L)\f$ is convex for non-negative frames, so that its minimum is found by a
+    projected Newton method, which uses the analytical gradient and Hessian and usually converges
+    in a few iterations. Each iteration consists of a few loops over the compacted arrays, which
+    the compiler can translate to vector instructions. */
+class LumFit
+{
+    //======================== Setters and Getters =======================
+
+public:
+    /** Sets the minimal values for the luminosity multiplicators. */
+    void setMinLuminosities(const vector<double>& value);
+
+    /** Sets the maximal values for the luminosity multiplicators. */
+    void setMaxLuminosities(const vector<double>& value);
+
+    //======================== Other Functions =======================
+
+public:
+    /** This function returns the luminosity multiplicators that best match the weighted sum of the
+        input frames to the reference frame, and the corresponding \f$\chi^2\f$ value. The input
+        frames are adjusted to contain the same mask as the reference frame. */
+    void optimize(const Image& refframe, vector<Image>& frames, vector<double>& luminosities, double& chi2);
+
+    /** This function returns an estimate of the variance of the \f$\chi^2\f$ value caused by the
+        Monte Carlo noise on the input frames most recently passed to the optimize() function, for
+        the specified luminosities. The variance of each input frame pixel is assumed to be
+        proportional to its value, with the specified proportionality factor for each frame. The
+        noise is propagated to \f$\chi^2\f$ to first order, i.e. \f[ \sigma^2_{\chi^2} = \sum_m
+        \left(\frac{\partial\chi^2}{\partial s_m}\right)^2 \sum_n L_n^2\,\rho_n f_{n,m}, \f]
+        where \f$\rho_n\f$ are the proportionality factors. */
+    double chi2Variance(const vector<double>& luminosities, const vector<double>& noiseFactors);
+
+private:
+    /** This function copies the values of the pixels that are not masked in the reference frame
+        to the compacted arrays, and sets the masked pixels in the input frames to zero. */
+    void gather(const Image& refframe, vector<Image>& frames);
+
+    /** This function returns the \f$\chi^2\f$ value for the given luminosities. If the \em
+        gradient and \em hessian pointers are not null, the function also stores the gradient and
+        the Hessian matrix (in row-major order) of \f$\chi^2\f$ with respect to the luminosities in
+        the vectors they point to. */
+    double evaluate(const vector<double>& lum, vector<double>* gradient, vector<double>* hessian);
+
+    //======================== Data Members ========================
+
+private:
+    vector<double> _minLum;
+    vector<double> _maxLum;
+
+    // the compacted pixel data, omitting the masked pixels
+    size_t _numPixels{0};
+    vector<double> _ref;        // the reference frame values
+    vector<double> _frames;     // the input frame values, one consecutive array per frame
+    vector<double> _model;      // the weighted sum of the input frames for the current luminosities
+    vector<double> _d1;         // the first derivative of chi2 per pixel with respect to the model value
+    vector<double> _d2;         // the second derivative of chi2 per pixel with respect to the model value
+};
+
+////////////////////////////////////////////////////////////////////
+
+#endif
@@ -76,6 +76,13 @@ int MasterSlaveCommunicator::localSlaveCount() const
 
 ////////////////////////////////////////////////////////////////////
 
+int MasterSlaveCommunicator::slaveCount() const
+{
+    return isMultiProc() ? size()-1 : localSlaveCount();
+}
+
+////////////////////////////////////////////////////////////////////
+
 void MasterSlaveCommunicator::setMaxMessageSize(size_t value)
 {
     if (_acquired) throw FATALERROR("Slaves are already acquired");
@@ -224,6 +231,67 @@ vector<SerializedData> MasterSlaveCommunicator::performTask(const vector<Seriali
 
 ////////////////////////////////////////////////////////////////////
 
+namespace
+{
+    // simple class to serve as a target for local parallel execution of a stream of items;
+    // each invocation of the body processes items until the source runs dry
+    class LocalStreamTarget : public ParallelTarget
+    {
+    public:
+        LocalStreamTarget(MasterSlaveCommunicator::Task& task, MasterSlaveCommunicator::Source& source,
+                          MasterSlaveCommunicator::Sink& sink)
+            : _task(task), _source(source), _sink(sink) { }
+        void body(size_t /*index*/)
+        {
+            while (true)
+            {
+                SerializedData input;
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    if (!_source(input)) return;
+                }
+                SerializedData output = _task(input);
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _sink(input, output);
+                }
+            }
+        }
+    private:
+        MasterSlaveCommunicator::Task& _task;
+        MasterSlaveCommunicator::Source& _source;
+        MasterSlaveCommunicator::Sink& _sink;
+        std::mutex _mutex;
+    };
+}
+
+////////////////////////////////////////////////////////////////////
+
+void MasterSlaveCommunicator::performTaskStream(int taskIndex, Source source, Sink sink)
+{
+    if (std::this_thread::get_id() != _mainThread)
+        throw FATALERROR("Must be invoked from the thread that initialized the first MasterSlaveCommunicator");
+    if (_performing) throw FATALERROR("Already performing tasks");
+    if (isSlave()) throw FATALERROR("Only the master can command the slaves");
+    if (taskIndex < 0 || static_cast<size_t>(taskIndex) >= _tasks.size()) throw FATALERROR("Task index out of range");
+
+    // bracket performing tasks with flag to control return value of isMaster() / isSlave()
+    SetFlag flag(&_performing);
+
+    if (isMultiProc())
+    {
+        doMasterStreamLoop(taskIndex, source, sink);
+    }
+    else
+    {
+        LocalStreamTarget target(_tasks[taskIndex], source, sink);
+        Parallel* parallel = _factory.parallel();
+        parallel->call(&target, parallel->threadCount());
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
 vector<SerializedData> MasterSlaveCommunicator::doMasterCommandLoop(int taskIndex,
                                                                     const vector<SerializedData>& inputVector)
 {
@@ -268,6 +336,42 @@ vector<SerializedData> MasterSlaveCommunicator::doMasterCommandLoop(int taskInde
 
 ////////////////////////////////////////////////////////////////////
 
+void MasterSlaveCommunicator::doMasterStreamLoop(int taskIndex, Source& source, Sink& sink)
+{
+    // prepare a vector to remember the most recent item handed out to each slave
+    vector<SerializedData> itemForSlave(size());
+
+    // hand out an item to each slave (unless the source runs dry), and count the busy slaves
+    int numbusy = 0;
+    for (int slave=1; slave<size(); slave++)
+    {
+        if (!source(itemForSlave[slave])) break;
+        ProcessManager::sendDoubleBuffer(itemForSlave[slave].data(), itemForSlave[slave].used(), slave, taskIndex);
+        numbusy++;
+    }
+
+    // receive results, handing out a new item to the slave that delivered each result
+    SerializedData output(_bufsize);
+    while (numbusy)
+    {
+        // receive a message from any slave and pass the result to the sink
+        int slave;
+        ProcessManager::receiveDoubleBuffer(output.data(), output.allocated(), slave);
+        numbusy--;
+        sink(itemForSlave[slave], output);
+
+        // if more items are available, hand one to this slave
+        itemForSlave[slave] = SerializedData();
+        if (source(itemForSlave[slave]))
+        {
+            ProcessManager::sendDoubleBuffer(itemForSlave[slave].data(), itemForSlave[slave].used(), slave, taskIndex);
+            numbusy++;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
 void MasterSlaveCommunicator::doSlaveObeyLoop()
 {
     SerializedData input(_bufsize);
@@ -170,6 +170,10 @@ public:
     /** Returns the number of slaves to be used when operating in local mode. */
     int localSlaveCount() const;
 
+    /** Returns the number of slaves performing tasks in parallel, i.e. the number of processes
+        excluding the master in multiprocessing mode, or the number of local slaves otherwise. */
+    int slaveCount() const;
+
     /** Sets the maximum size of a message (as a number of double values) exchanged between master
         and slave when operating in multiprocessing mode. This number is ignored when operating in
         singleprocessing mode. The number must be large enough to accomodate any of the
@@ -224,12 +228,36 @@ public:
         vector. Invokes the general performTask() function with a task index of zero. */
     vector<SerializedData> performTask(const vector<SerializedData>& data);
 
+    /** Definition of the type of a function providing the input data for the next item to be
+        processed by the performTaskStream() function. The function stores the input data in the
+        specified (empty) object and returns true, or returns false if there are no more items. */
+    using Source = std::function<bool (SerializedData& input)>;
+
+    /** Definition of the type of a function receiving the input and output data for an item
+        processed by the performTaskStream() function. */
+    using Sink = std::function<void (const SerializedData& input, const SerializedData& output)>;
+
+    /** Make the slaves perform the task with the specified index on the data items provided by the
+        specified source function, until the source function has no more items. Contrary to the
+        performTask() function, the items do not need to be known in advance: a slave requests a
+        new item from the source as soon as it has finished the previous one, and the result for
+        each item is passed to the specified sink function as soon as it becomes available, i.e. in
+        arbitrary order. Consequently, the source can produce new items that depend on the results
+        received so far. The source and sink functions are never invoked concurrently. In
+        multiprocessing mode, they are invoked from the master; in singleprocessing mode, they are
+        invoked from the slave threads, while holding a lock. Throws a fatal error if called while
+        slaves are not acquired, if called from a slave, or if the task index is out of range. */
+    void performTaskStream(int taskIndex, Source source, Sink sink);
+
     //====== Private Functions for multiprocessing Operation =======
 
 private:
     /** Implements the command loop for the master process. */
     vector<SerializedData> doMasterCommandLoop(int taskIndex, const vector<SerializedData>& inputVector);
 
+    /** Implements the command loop for the master process for the performTaskStream() function. */
+    void doMasterStreamLoop(int taskIndex, Source& source, Sink& sink);
+
     /** Implements the obey loop for a slave process. */
     void doSlaveObeyLoop();
 
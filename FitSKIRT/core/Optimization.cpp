@@ -17,16 +17,43 @@
 #include "StringUtils.hpp"
 #include "System.hpp"
 #include "Units.hpp"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
 
 //////////////////////////////////////////////////////////////////////
 
 namespace
 {
+    // the number of standard deviations subtracted from the surrogate model prediction (in log space)
+    // to obtain the lower confidence bound used for ranking candidates
+    const double confidenceFactor = 2.;
+
+    // the standard deviation of a parameter value scaled to the unit interval, for a uniform distribution
+    const double uniformSpread = 1./sqrt(12.);
+
     void evaluate(GAPopulation& p)
     {
         Optimization* opt = (Optimization*)p.userData();
         opt->evaluatePopulation(p);
     }
+
+    // returns the number of seconds elapsed since the specified time
+    double secondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // returns a message with the fraction of the elapsed time the slaves were busy; in asynchronous mode,
+    // evaluations straddling the start of the time interval are attributed to it entirely, so the
+    // calculated fraction may slightly exceed unity
+    string utilizationMessage(double busyTime, double elapsedTime, int numSlaves)
+    {
+        double utilization = elapsedTime > 0 ? min(1., busyTime / (elapsedTime * max(numSlaves, 1))) : 1.;
+        return "Slave utilization: " + StringUtils::toString(100.*utilization, 'f', 1) + "% of "
+                + std::to_string(numSlaves) + " slave(s) during " + StringUtils::toString(elapsedTime, 'f', 1) + " s";
+    }
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -74,6 +101,7 @@ void Optimization::setupSelfBefore()
     // must be done before initializing the GA
     MasterSlaveCommunicator* comm = find<MasterSlaveCommunicator>();
     comm->setLocalSlaveCount(find<FitScheme>()->parallelSimulationCount());
+    comm->setMaxMessageSize(max(comm->maxMessageSize(), maxMessageSize()));
     comm->registerTask([this] (SerializedData input) { return performSimulation(input); });
     if (comm->isMaster())
     {
@@ -96,13 +124,15 @@ void Optimization::initialize()
 
 void Optimization::step()
 {
-    _ga->step();
+    if (_asynchronous) evolveAsynchronously();
+    else _ga->step();
 }
 
 //////////////////////////////////////////////////////////////////////
 
 bool Optimization::done()
 {
+   if (_asynchronous) return _evolved || _numGenerations == 0;
    return _ga->done() != gaFalse;
 }
 
@@ -112,58 +142,106 @@ void Optimization::evaluatePopulation(GAPopulation& pop)
 {
     auto generationIndex = pop.geneticAlgorithm()->generation();
     find<Log>()->info("Evaluating generation " + std::to_string(generationIndex));
-    Units* units = find<Units>();
-    auto ranges = find<ParameterRanges>()->ranges();
 
-    // loop over all individuals and create replacement info for all unevaluated individuals
-    _genIndices.clear();
-    _genValues.clear();
-    _genUnitsValues.clear();
+    // loop over all individuals and select the unevaluated individuals
+    vector<int> candidates;
     for (int i=0; i<pop.size(); ++i)
     {
-        if (pop.individual(i).isEvaluated()==gaFalse)
-        {
-            GARealGenome& genome = (GARealGenome&)pop.individual(i);
+        if (pop.individual(i).isEvaluated()==gaFalse) candidates.push_back(i);
+    }
 
-            // loop over all parameters using the genome values to create the replacement info
-            vector<double> currentValues;
-            vector<double> currentUnitsValues;
-            for (size_t j=0; j < ranges.size(); ++j)
+    // if requested, let the surrogate model select the most promising or most uncertain candidates;
+    // the other candidates receive the score predicted by the model, unless that score is better than the
+    // best chi2 measured so far, so that a predicted score can never make an individual the best one
+    if (_surrogateFraction < 1. && candidates.size() > 1 && _surrogate.train())
+    {
+        vector<std::pair<double,int>> ranking;
+        for (int i : candidates)
+        {
+            double logMean, logSigma;
+            _surrogate.predict(scaledValues((GARealGenome&)pop.individual(i)), logMean, logSigma);
+            ranking.emplace_back(logMean - confidenceFactor*logSigma, i);
+            pop.individual(i).score(exp(logMean));
+        }
+        std::sort(ranking.begin(), ranking.end());
+        size_t numSelected = max(static_cast<size_t>(1), static_cast<size_t>(ceil(_surrogateFraction*ranking.size())));
+        size_t numPromoted = 0;
+        candidates.clear();
+        for (size_t k=0; k<ranking.size(); ++k)
+        {
+            int i = ranking[k].second;
+            if (k < numSelected) candidates.push_back(i);
+            else if (pop.individual(i).score() < _bestChi)
             {
-                double value = genome.gene(j);
-                currentValues.push_back(value);
-                string qty = ranges[j]->quantityString();
-                if (!qty.empty()) value = units->out(qty, value);
-                currentUnitsValues.push_back(value);
+                candidates.push_back(i);
+                numPromoted++;
             }
-            _genIndices.push_back(i);
-            _genValues.push_back(currentValues);
-            _genUnitsValues.push_back(currentUnitsValues);
         }
+        find<Log>()->info("Surrogate model selected " + std::to_string(numSelected) + " out of "
+                          + std::to_string(ranking.size()) + " new individuals for simulation");
+        if (numPromoted) find<Log>()->info("Also simulating " + std::to_string(numPromoted)
+                                           + " individuals predicted to improve on the best fit so far");
     }
 
-    // create a temporary directory to store the SKIRT simulation results
-    string tmpdirpath = find<FilePaths>()->output("tmp");
-    if (!System::makeDir(tmpdirpath))
-        throw FATALERROR("Can't create temporary directory " + tmpdirpath);
+    // create replacement info for the selected individuals
+    _genIndices.clear();
+    _genValues.clear();
+    _genUnitsValues.clear();
+    for (int i : candidates)
+    {
+        addIndividual((GARealGenome&)pop.individual(i));
+        _genIndices.push_back(i);
+    }
+    if (_genIndices.empty()) return;
 
     // perform the simulations and calculate the objective function values in parallel
-    performSimulations();
+    vector<size_t> indices(_genValues.size());
+    for (size_t i=0; i<indices.size(); ++i) indices[i] = i;
+    double fraction = packageFraction(pop);
+    if (fraction < 1.) find<Log>()->info("Using " + StringUtils::toString(100.*fraction, 'f', 1)
+                                         + "% of the photon packages for this generation");
+    performSimulations(indices, pilotThreshold(), fraction);
+
+    // re-evaluate the individuals that may be the best so far at full fidelity, i.e. those that are not
+    // significantly worse than the best one so far and than the best one in this generation
+    if (fraction < 1.)
+    {
+        double reference = _bestChi;
+        for (size_t i=0; i<_genIndices.size(); ++i)
+        {
+            if (!_genRejected[i]) reference = min(reference, _genScores[i] + confidenceFactor*sqrt(_genVariances[i]));
+        }
+        vector<size_t> promising;
+        for (size_t i=0; i<_genIndices.size(); ++i)
+        {
+            if (needsReevaluation(i, reference)) promising.push_back(i);
+        }
+        if (!promising.empty())
+        {
+            find<Log>()->info("Re-evaluating " + std::to_string(promising.size()) + " out of "
+                              + std::to_string(_genIndices.size()) + " individuals at full fidelity");
+            performSimulations(promising, 0., 1.);
+        }
+    }
 
-    // set the individual's scores and write a summary line for each simulation
+    // set the individual's scores and write a summary line for each simulation that was not rejected by a pilot
     find<Log>()->info("Setting Scores");
+    size_t numRejected = 0;
     for (size_t i=0; i<_genIndices.size(); ++i)
     {
         pop.individual(_genIndices[i]).score(_genScores[i]);
-        writeLine(_allstream, generationIndex, i);
+        if (_genRejected[i]) numRejected++;
+        else recordResult(generationIndex, i);
     }
+    if (numRejected) find<Log>()->info("Pilot simulations rejected " + std::to_string(numRejected) + " out of "
+                                       + std::to_string(_genIndices.size()) + " individuals");
 
-    // find the best (newly evaluated) individual in this population
+    // find the best (newly evaluated at full fidelity) individual in this population
     size_t bestIndex = 0;
-    double bestChi = _genScores[0];
-    for (size_t i=1; i<_genIndices.size(); ++i)
+    double bestChi = DBL_MAX;
+    for (size_t i=0; i<_genIndices.size(); ++i)
     {
-        if (_genScores[i] < bestChi)
+        if (!_genRejected[i] && _genFractions[i] == 1. && _genScores[i] < bestChi)
         {
              bestIndex = i;
              bestChi = _genScores[i];
@@ -176,49 +254,373 @@ void Optimization::evaluatePopulation(GAPopulation& pop)
         _bestChi = bestChi;
         writeBest(bestIndex);
     }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void Optimization::evolveAsynchronously()
+{
+    auto log = find<Log>();
+    auto comm = find<MasterSlaveCommunicator>();
+    log->info("Evaluating " + std::to_string(_numGenerations) + " generations asynchronously");
+
+    // work on a copy of the initial population, since the GA object offers no write access
+    GAPopulation pop(_ga->population());
+    pop.scale();
+
+    // the number of individuals per generation, and the total number to be evaluated
+    int numPerGeneration = _ga->nReplacement();
+    int numTotal = _numGenerations * numPerGeneration;
+
+    // the children currently being evaluated, indexed on individual index
+    std::map<int, GAGenome*> children;
+
+    _genIndices.clear();
+    _genValues.clear();
+    _genUnitsValues.clear();
+    _genScores.clear();
+    _genLuminosities.clear();
+    _genChis.clear();
+    _genVariances.clear();
+    _genFractions.clear();
+    _genRejected.clear();
+    _genTotals.clear();
+
+    // the fraction of photon packages used for new children; it is updated after each generation
+    double fraction = packageFraction(pop);
+
+    // the children evaluated at lower fidelity that may be the best so far, to be re-evaluated at full fidelity
+    std::deque<int> promising;
+
+    // if requested, train the surrogate model; it is retrained after each generation
+    bool screening = _surrogateFraction < 1. && _surrogate.train();
+    int numCandidates = static_cast<int>(ceil(1./_surrogateFraction - 1e-9));
+
+    // hand out a new child to a slave that becomes available, until the requested number has been handed out;
+    // when screening, the child is the most promising or most uncertain of several candidates; children
+    // waiting for re-evaluation at full fidelity take precedence
+    int numSent = 0;
+    auto source = [this, &pop, &children, &numSent, &screening, &fraction, &promising, numTotal, numCandidates]
+                  (SerializedData& input)
+    {
+        if (!promising.empty())
+        {
+            int index = promising.front();
+            promising.pop_front();
+            input.push(static_cast<double>(index));
+            input.push(_genValues[index]);
+            input.push(0.);
+            input.push(1.);
+            input.push(_bestChi);
+            return true;
+        }
+        if (numSent == numTotal) return false;
+        numSent++;
+
+        GAGenome* child = breed(pop);
+        if (screening)
+        {
+            double bestBound = DBL_MAX;
+            for (int c = 0; c < numCandidates; c++)
+            {
+                GAGenome* candidate = c ? breed(pop) : child;
+                double logMean, logSigma;
+                _surrogate.predict(scaledValues((GARealGenome&)*candidate), logMean, logSigma);
+                double bound = logMean - confidenceFactor*logSigma;
+                if (bound < bestBound)
+                {
+                    bestBound = bound;
+                    if (candidate != child) delete child;
+                    child = candidate;
+                }
+                else delete candidate;
+            }
+        }
+        int index = addIndividual((GARealGenome&)*child);
+        children[index] = child;
+        input.push(static_cast<double>(index));
+        input.push(_genValues[index]);
+        input.push(pilotThreshold());
+        input.push(fraction);
+        input.push(_bestChi);
+        return true;
+    };
+
+    // process the results in the order in which they come in
+    int numReceived = 0;
+    double busyTime = 0.;
+    auto windowStart = std::chrono::steady_clock::now();
+    auto sink = [this, log, comm, &pop, &children, &numReceived, &busyTime, &windowStart, &screening, &fraction,
+                 &promising, numPerGeneration] (const SerializedData& input, const SerializedData& output)
+    {
+        // deserialize the individual index and the results
+        SerializedData in = input;
+        vector<double> values;
+        in.pop();
+        in.pop();
+        in.pop();
+        in.pop(values);
+        int index = static_cast<int>(in.pop());
+        busyTime += storeResult(index, output);
+
+        // if the child may be the best so far, defer its processing until it has been re-evaluated
+        if (needsReevaluation(index, _bestChi))
+        {
+            promising.push_back(index);
+            return;
+        }
+
+        // let the child replace the worst individual in the population (which may be the child itself)
+        GAGenome* child = children[index];
+        children.erase(index);
+        child->score(_genScores[index]);
+        pop.add(child);
+        pop.scale();
+        delete pop.remove(GAPopulation::WORST, GAPopulation::SCALED);
+
+        // unless the child was rejected by a pilot simulation, write a summary line,
+        // and information about the child if it is the best one so far
+        int generationIndex = 1 + numReceived / numPerGeneration;
+        if (!_genRejected[index])
+        {
+            recordResult(generationIndex, index);
+            if (_genFractions[index] == 1. && _genScores[index] < _bestChi)
+            {
+                _bestChi = _genScores[index];
+                writeBest(index);
+            }
+        }
+        vector<double>().swap(_genTotals[index]);
+
+        // report on each completed generation
+        numReceived++;
+        if (numReceived % numPerGeneration == 0)
+        {
+            log->info("Completed generation " + std::to_string(generationIndex) + "; "
+                      + utilizationMessage(busyTime, secondsSince(windowStart), comm->slaveCount()));
+            busyTime = 0.;
+            windowStart = std::chrono::steady_clock::now();
+            if (screening) _surrogate.train();
+            fraction = packageFraction(pop);
+        }
+    };
+
+    comm->performTaskStream(0, source, sink);
+    _evolved = true;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+GAGenome* Optimization::breed(GAPopulation& pop) const
+{
+    while (true)
+    {
+        const GAGenome& mom = pop.select();
+        const GAGenome& dad = pop.select();
+
+        // perform crossover to obtain a single child, or copy one of the parents
+        GAGenome* child = mom.clone();
+        bool changed = false;
+        if (GAFlipCoin(_crossoverProbability))
+        {
+            (*_genome->sexual())(mom, dad, child, nullptr);
+            changed = true;
+        }
+        else if (GARandomBit())
+        {
+            child->copy(dad);
+        }
+
+        // mutate the child
+        if (child->mutate(_mutationProbability) > 0) changed = true;
+
+        if (changed) return child;
+        delete child;
+    }
+}
 
-    // remove all files in the temporary folder
-    for (string filename : System::filesInDirectory(tmpdirpath))
+//////////////////////////////////////////////////////////////////////
+
+int Optimization::addIndividual(const GARealGenome& genome)
+{
+    Units* units = find<Units>();
+    auto ranges = find<ParameterRanges>()->ranges();
+
+    // loop over all parameters using the genome values to create the replacement info
+    vector<double> currentValues;
+    vector<double> currentUnitsValues;
+    for (size_t j=0; j < ranges.size(); ++j)
     {
-        System::removeFile(StringUtils::joinPaths(tmpdirpath, filename));
+        double value = genome.gene(j);
+        currentValues.push_back(value);
+        string qty = ranges[j]->quantityString();
+        if (!qty.empty()) value = units->out(qty, value);
+        currentUnitsValues.push_back(value);
     }
+    _genValues.push_back(currentValues);
+    _genUnitsValues.push_back(currentUnitsValues);
+    return _genValues.size() - 1;
 }
 
 //////////////////////////////////////////////////////////////////////
 
-void Optimization::performSimulations()
+void Optimization::performSimulations(const vector<size_t>& indices, double threshold, double packageFraction)
 {
     // serialize input data for each of the simulations to perform
-    size_t n = _genValues.size();
+    size_t n = indices.size();
     vector<SerializedData> datav(n);
     for (size_t i = 0; i < n; ++i)
     {
-        datav[i].push(static_cast<double>(i));
-        datav[i].push(_genValues[i]);
+        datav[i].push(static_cast<double>(indices[i]));
+        datav[i].push(_genValues[indices[i]]);
+        datav[i].push(threshold);
+        datav[i].push(packageFraction);
+        datav[i].push(_bestChi);
     }
 
     // perform the simulations in parallel
     MasterSlaveCommunicator* comm = find<MasterSlaveCommunicator>();
+    auto start = std::chrono::steady_clock::now();
     datav = comm->performTask(datav);
+    double elapsedTime = secondsSince(start);
 
     // deserialize output data from each of the simulations
+    double busyTime = 0.;
+    for (size_t i = 0; i < n; ++i)
+    {
+        busyTime += storeResult(indices[i], datav[i]);
+    }
+    find<Log>()->info(utilizationMessage(busyTime, elapsedTime, comm->slaveCount()));
+}
+
+//////////////////////////////////////////////////////////////////////
+
+double Optimization::storeResult(size_t individualIndex, const SerializedData& output)
+{
+    size_t n = max(_genValues.size(), individualIndex+1);
     _genScores.resize(n);
     _genLuminosities.resize(n);
     _genChis.resize(n);
-    for (size_t i = 0; i < n; ++i)
+    _genVariances.resize(n);
+    _genFractions.resize(n);
+    _genRejected.resize(n);
+    _genTotals.resize(n);
+
+    SerializedData data = output;
+    double duration = data.pop();       // pop in reverse order!
+    data.pop(_genTotals[individualIndex]);
+    _genRejected[individualIndex] = data.pop() != 0.;
+    _genFractions[individualIndex] = data.pop();
+    _genVariances[individualIndex] = data.pop();
+    data.pop(_genChis[individualIndex]);
+    data.pop(_genLuminosities[individualIndex]);
+    data.pop(_genScores[individualIndex]);
+    return duration;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void Optimization::recordResult(int identifier, int individualIndex)
+{
+    writeLine(_allstream, identifier, individualIndex);
+    if (_surrogateFraction < 1. && _genScores[individualIndex] > 0.)
+        _surrogate.add(scaledValues(_genValues[individualIndex]), _genScores[individualIndex]);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+vector<double> Optimization::scaledValues(const vector<double>& values) const
+{
+    auto ranges = find<ParameterRanges>()->ranges();
+    vector<double> scaled;
+    for (size_t j=0; j < ranges.size(); ++j)
+    {
+        double width = ranges[j]->maxValue() - ranges[j]->minValue();
+        scaled.push_back(width > 0 ? (values[j] - ranges[j]->minValue()) / width : 0.);
+    }
+    return scaled;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+vector<double> Optimization::scaledValues(const GARealGenome& genome) const
+{
+    vector<double> values;
+    for (int j=0; j < genome.length(); ++j) values.push_back(genome.gene(j));
+    return scaledValues(values);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+double Optimization::packageFraction(const GAPopulation& pop) const
+{
+    if (_minPackageFraction >= 1.) return 1.;
+
+    // determine the average standard deviation of the scaled parameter values in the population
+    size_t numParams = find<ParameterRanges>()->ranges().size();
+    vector<double> sum(numParams, 0.), sum2(numParams, 0.);
+    for (int i=0; i<pop.size(); ++i)
+    {
+        vector<double> values = scaledValues((const GARealGenome&)pop.individual(i));
+        for (size_t j=0; j<numParams; ++j)
+        {
+            sum[j] += values[j];
+            sum2[j] += values[j]*values[j];
+        }
+    }
+    double spread = 0.;
+    for (size_t j=0; j<numParams; ++j)
     {
-        datav[i].pop(_genChis[i]);      // pop in reverse order!
-        datav[i].pop(_genLuminosities[i]);
-        datav[i].pop(_genScores[i]);
+        double mean = sum[j]/pop.size();
+        spread += sqrt(max(0., sum2[j]/pop.size() - mean*mean)) / numParams;
     }
+
+    // the Monte Carlo noise on chi2 must decrease proportionally to the differences between the individuals,
+    // which requires a number of photon packages inversely proportional to the square of the spread
+    if (spread <= 0.) return 1.;
+    return min(1., _minPackageFraction * (uniformSpread*uniformSpread) / (spread*spread));
+}
+
+//////////////////////////////////////////////////////////////////////
+
+size_t Optimization::maxMessageSize() const
+{
+    // each scalar occupies two doubles and each vector one more than its size; the total images make up
+    // most of the output message, and the other items are included with a generous margin
+    auto simulation = find<AdjustableSkirtSimulation>();
+    size_t numWavelengths = simulation->numWavelengths();
+    size_t numPixels = 0;
+    for (size_t ell=0; ell < numWavelengths; ++ell) numPixels += simulation->pixelsX(ell) * simulation->pixelsY(ell);
+    return numPixels + numWavelengths*(simulation->numComponents()+1) + find<ParameterRanges>()->ranges().size() + 64;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+bool Optimization::needsReevaluation(size_t individualIndex, double reference) const
+{
+    return _genFractions[individualIndex] < 1. && !_genRejected[individualIndex]
+            && _genScores[individualIndex] - confidenceFactor*sqrt(_genVariances[individualIndex]) < reference;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+double Optimization::pilotThreshold() const
+{
+    if (_pilotPackageFraction > 0. && _bestChi < DBL_MAX) return _pilotRejectionFactor * _bestChi;
+    return 0.;
 }
 
 //////////////////////////////////////////////////////////////////////
 
 SerializedData Optimization::performSimulation(const SerializedData& input)
 {
+    auto start = std::chrono::steady_clock::now();
+
     // deserialize input data
     SerializedData data = input;
+    double frameThreshold = data.pop();
+    double packageFraction = data.pop();
+    double threshold = data.pop();
     vector<double> genValues;
     data.pop(genValues);
     size_t individualIndex = static_cast<size_t>(data.pop());
@@ -231,57 +633,86 @@ SerializedData Optimization::performSimulation(const SerializedData& input)
         replacement[ranges[j]->label()] = std::make_pair(genValues[j], ranges[j]->quantityString());
     }
 
-    // perform the adjusted SKIRT simulation
-    // HACK: we issue messages directly to the console, bypassing the regular mechanism,
-    // to ensure that these messages are always logged even if sent from a slave process
-    string individualString = std::to_string(individualIndex);
-    string slaveString =  std::to_string(find<MasterSlaveCommunicator>()->slave());
-    Console::info("  Slave " + slaveString + " running SKIRT model for individual " + individualString);
-    auto simulation = find<AdjustableSkirtSimulation>();
-    simulation->performWith(replacement, "tmp/tmp_" + std::to_string(individualIndex));
-    Console::info("  Slave " + slaveString + " fitting luminosities for individual " + individualString);
-
-    // read the simulation output frames
+    // if requested, perform a pilot simulation with fewer photon packages to reject clearly bad individuals
     vector<vector<Image>> frames;
-    readSimulationOutputFrames(individualIndex, frames);
-
-    // determine the best fitting luminosities and lowest chi2 value
     vector<vector<double>> luminosities;
     vector<double> chis;
-    auto refImages = find<ReferenceImages>();
-    double chi_sum = refImages->optimizeLuminosities(frames, luminosities, chis);
+    double chi_sum = 0.;
+    double chi2Variance = 0.;
+    bool rejected = false;
+    if (threshold > 0.)
+    {
+        chi_sum = simulateAndFit(replacement, individualIndex, _pilotPackageFraction*packageFraction,
+                                 frames, luminosities, chis, chi2Variance);
+        rejected = chi_sum > threshold;
+    }
+
+    // perform the regular simulation
+    if (!rejected)
+        chi_sum = simulateAndFit(replacement, individualIndex, packageFraction,
+                                 frames, luminosities, chis, chi2Variance);
 
     // flatten the luminosities into a single vector
     vector<double> flatluminosities;
     for (const auto& vect : luminosities) for (double value : vect) flatluminosities.push_back(value);
 
+    // if this individual may become the best one so far, provide the best fitting total images to the master
+    vector<double> flattotals;
+    if (!rejected && packageFraction == 1. && chi_sum < frameThreshold)
+    {
+        vector<Image> totals;
+        find<ReferenceImages>()->getTotals(frames, luminosities, totals);
+        for (const Image& total : totals) for (double value : total.data()) flattotals.push_back(value);
+    }
+
     // serialize the output data
     data.push(chi_sum);
     data.push(flatluminosities);
     data.push(chis);
+    data.push(chi2Variance);
+    data.push(packageFraction);
+    data.push(rejected ? 1. : 0.);
+    data.push(flattotals);
+    data.push(secondsSince(start));
     return data;
 }
 
 //////////////////////////////////////////////////////////////////////
 
-void Optimization::readSimulationOutputFrames(int individualIndex, vector<vector<Image>>& outputFrames)
+double Optimization::simulateAndFit(const AdjustableSkirtSimulation::ReplacementDict& replacement,
+                                    size_t individualIndex, double packageFraction, vector<vector<Image>>& frames,
+                                    vector<vector<double>>& luminosities, vector<double>& chis,
+                                    double& chi2Variance)
 {
-    string prefix = "tmp_" + std::to_string(individualIndex);
-    string tmpdirpath = find<FilePaths>()->output("tmp");
+    // perform the adjusted SKIRT simulation
+    // HACK: we issue messages directly to the console, bypassing the regular mechanism,
+    // to ensure that these messages are always logged even if sent from a slave process
+    string individualString = std::to_string(individualIndex);
+    string slaveString =  std::to_string(find<MasterSlaveCommunicator>()->slave());
+    string modelString = packageFraction < 1. ? "SKIRT model with " + StringUtils::toString(100.*packageFraction, 'f', 1)
+                                                + "% of the photon packages" : "SKIRT model";
+    Console::info("  Slave " + slaveString + " running " + modelString + " for individual " + individualString);
     auto simulation = find<AdjustableSkirtSimulation>();
-    string instrname = simulation->instrumentName();
-    size_t numWavelengths = simulation->numWavelengths();
+    vector<vector<Array>> arrays;
+    simulation->performWith(replacement, "tmp_" + std::to_string(individualIndex), arrays, packageFraction);
+    Console::info("  Slave " + slaveString + " fitting luminosities for individual " + individualString);
 
-    outputFrames.resize(numWavelengths);
+    // move the simulation output frames into images
+    size_t numWavelengths = simulation->numWavelengths();
+    size_t numComponents = simulation->numComponents();
+    frames.assign(numWavelengths, vector<Image>(numComponents));
     for (size_t ell=0; ell < numWavelengths; ++ell)
     {
-        outputFrames[ell].clear();
-        for (size_t k = 0; k < simulation->numComponents(); k++)
+        for (size_t k=0; k < numComponents; ++k)
         {
-            string filename = prefix + "_" + instrname + "_stellar_" + std::to_string(k) + "_" + std::to_string(ell);
-            outputFrames[ell].emplace_back(this, filename, tmpdirpath, false);
+            frames[ell][k].resize(simulation->pixelsX(ell), simulation->pixelsY(ell));
+            frames[ell][k].moveData(std::move(arrays[ell][k]));
         }
     }
+
+    // determine the best fitting luminosities and lowest chi2 value
+    auto refImages = find<ReferenceImages>();
+    return refImages->optimizeLuminosities(frames, luminosities, chis, chi2Variance);
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -290,23 +721,25 @@ void Optimization::writeBest(int individualIndex)
 {
     find<Log>()->info("Found new best fit; serial nr " + std::to_string(_bestSerial));
 
-    // read the simulation output frames for the specified individual
-    vector<vector<Image>> frames;
-    readSimulationOutputFrames(individualIndex, frames);
-
-    // determine the best fitting luminosities
-    vector<vector<double>> luminosities;
-    vector<double> chis; // not used
-    auto refImages = find<ReferenceImages>();
-    refImages->optimizeLuminosities(frames, luminosities, chis);
+    // unflatten the best fitting total images provided by the slave for the specified individual
+    auto simulation = find<AdjustableSkirtSimulation>();
+    const vector<double>& flattotals = _genTotals[individualIndex];
+    if (flattotals.empty()) throw FATALERROR("No total images available for individual " + std::to_string(individualIndex));
+    vector<Image> totals(simulation->numWavelengths());
+    size_t offset = 0;
+    for (size_t ell=0; ell < totals.size(); ++ell)
+    {
+        totals[ell].resize(simulation->pixelsX(ell), simulation->pixelsY(ell));
+        Array data(&flattotals[offset], totals[ell].size());
+        totals[ell].moveData(std::move(data));
+        offset += totals[ell].size();
+    }
 
-    // calculate the total and residual images
-    vector<Image> totals;
+    // calculate the residual images
     vector<Image> residuals;
-    refImages->getTotalAndResidual(frames, luminosities, totals, residuals);
+    find<ReferenceImages>()->getResiduals(totals, residuals);
 
     // get information for saving
-    auto simulation = find<AdjustableSkirtSimulation>();
     auto units = find<Units>();
     string xyUnits = units->ulength();
     string sbUnits = units->usurfacebrightness();
@@ -7,11 +7,13 @@
 #define OPTIMIZATION_HPP
 
 #include "SimulationItem.hpp"
+#include "AdjustableSkirtSimulation.hpp"
 #include "Image.hpp"
 #include "GAPopulation.h"
 #include "GARealGenome.h"
 #include "GASStateGA.h"
 #include "SerializedData.hpp"
+#include "SurrogateModel.hpp"
 
 ////////////////////////////////////////////////////////////////////
 
@@ -21,7 +23,52 @@
     evaluatePopulation() function in this class is called-back by GAlib. It feeds the genome values
     to the adjustable SKIRT simulation residing in this fit scheme, and calculates the goal
     function from the simulation results. This is done in parallalel for all individuals over the
-    available threads or processes. */
+    available threads or processes.
+
+    By default, the individuals created in each generation of the steady-state genetic algorithm
+    are evaluated as a single batch, so that the slaves that finish early remain idle until the
+    slowest simulation of the generation has finished. If the \em asynchronous option is enabled,
+    each slave instead receives a new individual as soon as it finishes the previous one. Each new
+    individual is bred from the population as it is at that time, and each evaluated individual
+    replaces the worst individual of the population as soon as its result comes in, in whatever
+    order the results arrive. The number of evaluated individuals per generation and the total
+    number of generations are the same as for the batch mode. In both modes, the fraction of the
+    time that the slaves were busy is logged for each generation.
+
+    Two options allow avoiding full simulations for individuals that are unlikely to improve the
+    fit. If the \em surrogateFraction option is smaller than one, a Gaussian process model (see
+    the SurrogateModel class) is trained on all simulations performed so far. In batch mode, only
+    the given fraction of the new individuals in each generation is simulated, selecting the
+    individuals with the lowest lower confidence bound on the predicted \f$\chi^2\f$ value, i.e.
+    the individuals that are either promising or poorly constrained by the model; the other
+    individuals receive the predicted value as their score. Individuals for which the predicted
+    value is lower than the best \f$\chi^2\f$ value obtained so far are simulated as well, so
+    that a prediction can never take the place of the best measured value in the population. In
+    asynchronous mode, the reciprocal of the fraction determines the number of candidates bred for
+    each slot, of which the one with the lowest bound is simulated; the minimum fraction of 0.01
+    limits this number to 100. If the \em
+    pilotPackageFraction option is larger than zero, each individual is first simulated with the
+    given fraction of the number of photon packages, and the full simulation is skipped if the
+    resulting \f$\chi^2\f$ value exceeds the best value so far by more than the \em
+    pilotRejectionFactor. Individuals scored by the surrogate model or rejected by a pilot
+    simulation take part in the genetic algorithm, but they are not listed in the output files
+    and they are not used for training the model.
+
+    If the \em minPackageFraction option is smaller than one, the number of photon packages used
+    for each simulation follows a schedule. While the population is still spread out over the
+    parameter space, the differences in \f$\chi^2\f$ between individuals are large, and a noisy
+    simulation with fewer photon packages suffices to rank them. The fraction of the configured
+    number of photon packages is given by \f$f = f_\mathrm{min}\,(\sigma_0/\sigma)^2\f$, limited
+    to unity, where \f$\sigma\f$ is the average standard deviation of the (scaled) parameter
+    values in the current population, and \f$\sigma_0\f$ is the value for a uniform
+    distribution. The budget thus rises as the population contracts. Because the Monte Carlo
+    noise biases the \f$\chi^2\f$ value, only full-fidelity results are considered as the best
+    fit. Each simulation also provides an estimate of the standard deviation of its
+    \f$\chi^2\f$ value caused by the Monte Carlo noise on the frames (see
+    ReferenceImage::optimizeLuminosities()), and an individual is re-evaluated with all photon
+    packages if its lower-fidelity value, reduced by twice this standard deviation, is below the
+    best value so far (or, in the batch mode, also below the best upper bound in the generation).
+    */
 class Optimization: public SimulationItem
 {
     ITEM_CONCRETE(Optimization, SimulationItem, "The optimization setup")
@@ -46,6 +93,33 @@ class Optimization: public SimulationItem
         ATTRIBUTE_MAX_VALUE(pcross, "1[")
         ATTRIBUTE_DEFAULT_VALUE(pcross, "0.65")
 
+    PROPERTY_BOOL(asynchronous, "evaluate new individuals as soon as a slave becomes available")
+        ATTRIBUTE_DEFAULT_VALUE(asynchronous, "false")
+        ATTRIBUTE_SILENT(asynchronous)
+
+    PROPERTY_DOUBLE(surrogateFraction, "the fraction of new individuals selected for simulation by a surrogate model")
+        ATTRIBUTE_MIN_VALUE(surrogateFraction, "[0.01")
+        ATTRIBUTE_MAX_VALUE(surrogateFraction, "1]")
+        ATTRIBUTE_DEFAULT_VALUE(surrogateFraction, "1")
+        ATTRIBUTE_SILENT(surrogateFraction)
+
+    PROPERTY_DOUBLE(pilotPackageFraction, "the fraction of photon packages used for pilot simulations")
+        ATTRIBUTE_MIN_VALUE(pilotPackageFraction, "[0")
+        ATTRIBUTE_MAX_VALUE(pilotPackageFraction, "1[")
+        ATTRIBUTE_DEFAULT_VALUE(pilotPackageFraction, "0")
+        ATTRIBUTE_SILENT(pilotPackageFraction)
+
+    PROPERTY_DOUBLE(pilotRejectionFactor, "the factor on the best chi2 above which a pilot simulation rejects an individual")
+        ATTRIBUTE_MIN_VALUE(pilotRejectionFactor, "]1")
+        ATTRIBUTE_DEFAULT_VALUE(pilotRejectionFactor, "3")
+        ATTRIBUTE_SILENT(pilotRejectionFactor)
+
+    PROPERTY_DOUBLE(minPackageFraction, "the minimum fraction of photon packages used while the population is spread out")
+        ATTRIBUTE_MIN_VALUE(minPackageFraction, "]0")
+        ATTRIBUTE_MAX_VALUE(minPackageFraction, "1]")
+        ATTRIBUTE_DEFAULT_VALUE(minPackageFraction, "1")
+        ATTRIBUTE_SILENT(minPackageFraction)
+
     ITEM_END()
 
     //============= Construction - Setup - Destruction =============
@@ -64,35 +138,93 @@ public:
     /** Initializes the GA library. */
     void initialize();
 
-    /** Proceed one step in the GA optimization process. */
+    /** Proceed one step in the GA optimization process. If the \em asynchronous option is
+        enabled, this function performs all remaining generations at once. */
     void step();
 
     /** Checks if the GA optimization process is done. */
     bool done();
 
-    /** Evaluates all individuals of a certain population. This is done by creating a temporary
-        folder to store all simulations. The individual evaluations are parallelised over the
-        available number of threads or processes and the function values are stored. At the end of
-        each generation the contents of the temporary folder is removed, the scores for each
-        individual are set and the best solutions are stored. */
+    /** Evaluates all individuals of a certain population. The individual evaluations are
+        parallelised over the available number of threads or processes and the function values are
+        stored. The simulated frames are handed over in memory, so that no files need to be written
+        or cleaned up. At the end of each generation, the scores for each individual are set and the
+        best solutions are stored. */
     void evaluatePopulation(GAPopulation& pop);
 
 private:
+    /** Performs the remaining generations of the steady-state genetic algorithm in asynchronous
+        mode, as described in the class header. */
+    void evolveAsynchronously();
+
+    /** Creates a new individual from two parents selected from the specified population, using
+        crossover and mutation with the configured probabilities. Individuals that are identical to
+        one of their parents are discarded, so that the returned individual is always new. */
+    GAGenome* breed(GAPopulation& pop) const;
+
+    /** Appends the parameter values for the specified genome to the lists of values for the
+        individuals being evaluated, and returns the index of the new individual in these lists. */
+    int addIndividual(const GARealGenome& genome);
+
     /** Translates input/output variables to/from SerializedData and performs the SKIRT simulations
-        in parallel. */
-    void performSimulations();
+        for the individuals with the specified indices in parallel, using the specified pilot
+        rejection threshold (see pilotThreshold()) and fraction of the photon packages. */
+    void performSimulations(const vector<size_t>& indices, double threshold, double packageFraction);
+
+    /** Stores the results in the specified serialized output data for the individual with the
+        specified index, and returns the time spent by the slave on this evaluation. */
+    double storeResult(size_t individualIndex, const SerializedData& output);
+
+    /** Writes a summary line for the specified individual to the file listing all simulations, and
+        adds the result to the training data of the surrogate model, if applicable. */
+    void recordResult(int identifier, int individualIndex);
+
+    /** Returns the specified parameter values scaled to the unit interval of their range. */
+    vector<double> scaledValues(const vector<double>& values) const;
+
+    /** Returns the parameter values of the specified genome scaled to the unit interval of their
+        range. */
+    vector<double> scaledValues(const GARealGenome& genome) const;
+
+    /** Returns the maximum size of the messages exchanged with the slaves, as a number of double
+        values, which is dominated by the total images returned by performSimulation(). */
+    size_t maxMessageSize() const;
+
+    /** Returns the fraction of the configured number of photon packages to be used for evaluating
+        new individuals, given the current population, as described in the class header. */
+    double packageFraction(const GAPopulation& pop) const;
+
+    /** Returns true if the specified individual has been evaluated with a reduced number of photon
+        packages and its \f$\chi^2\f$ value may, given the Monte Carlo noise, be below the
+        specified reference value. */
+    bool needsReevaluation(size_t individualIndex, double reference) const;
+
+    /** Returns the \f$\chi^2\f$ value above which a pilot simulation rejects an individual, or
+        zero if no pilot simulations should be performed. */
+    double pilotThreshold() const;
 
     /** Performs the SKIRT simulation corresponding to the serialized input data, calculates the
         \f$\chi^2\f$ values and luminosities for the simulation result, and returns them in a
-        serialized data object. */
+        serialized data object, together with the estimated variance of the \f$\chi^2\f$ value,
+        the fraction of photon packages used, a flag indicating whether the individual was
+        rejected by a pilot simulation, and the time spent by the slave on this evaluation. If the
+        full-fidelity \f$\chi^2\f$ value is below the best value known to the master when it
+        handed out the individual, the best fitting total images are included as well, so that
+        the master can write them without repeating the simulation. */
     SerializedData performSimulation(const SerializedData& input);
 
-    /** Reads the simulation output frames for the specified individual into the given table. There
-        is a frame for each luminosity component (inner index) and for each wavelength (outer
-        index). */
-    void readSimulationOutputFrames(int individualIndex, vector<vector<Image>>& outputFrames);
+    /** Performs the SKIRT simulation for the specified replacement values and individual index,
+        using the specified fraction of the configured number of photon packages, and determines
+        the best fitting luminosities and \f$\chi^2\f$ values for the result. The simulation
+        hands its frames over in memory; they are returned in the \em frames table after being
+        convolved and masked as described for ReferenceImages::optimizeLuminosities(). Returns the
+        total \f$\chi^2\f$ value, and sets \em chi2Variance to the estimate of its variance. */
+    double simulateAndFit(const AdjustableSkirtSimulation::ReplacementDict& replacement, size_t individualIndex,
+                          double packageFraction, vector<vector<Image>>& frames,
+                          vector<vector<double>>& luminosities, vector<double>& chis, double& chi2Variance);
 
-    /** Write information about the specified individual as the best result so far. */
+    /** Write information about the specified individual as the best result so far, using the
+        best fitting total images provided by the slave that evaluated the individual. */
     void writeBest(int individualIndex);
 
     /** This function writes a series of comments lines to the specified output file, describing
@@ -108,6 +240,7 @@ private:
     //======================== Data Members ========================
 
 private:
+    bool _evolved{false};       // becomes true when the asynchronous evolution has been performed
     double _bestChi{DBL_MAX};
     int _bestSerial{0};
     GARealAlleleSetArray _allelesetarray;
@@ -121,6 +254,11 @@ private:
     vector<double> _genScores;
     vector<vector<double>> _genLuminosities;
     vector<vector<double>> _genChis;
+    vector<double> _genVariances;
+    vector<double> _genFractions;
+    vector<bool> _genRejected;
+    vector<vector<double>> _genTotals;
+    SurrogateModel _surrogate;
 };
 
 ////////////////////////////////////////////////////////////////////
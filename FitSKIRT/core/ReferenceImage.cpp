@@ -7,9 +7,41 @@
 #include "AdjustableSkirtSimulation.hpp"
 #include "Convolution.hpp"
 #include "FatalError.hpp"
-#include "LumFit1.hpp"
-#include "LumFit2.hpp"
-#include "LumFitN.hpp"
+#include "FitScheme.hpp"
+#include "LumFit.hpp"
+#include "ReferenceImages.hpp"
+
+////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    // returns an estimate of the ratio of the noise variance to the value of the pixels in the frame;
+    // for uncorrelated noise, the second difference of three horizontally adjacent pixels has six
+    // times the noise variance of a single pixel, while it vanishes for linear variations
+    double noiseFactor(const Image& frame)
+    {
+        int nx = frame.sizeX();
+        int ny = frame.sizeY();
+        double sumd2 = 0.;
+        double sumv = 0.;
+        for (int j = 0; j < ny; j++)
+        {
+            for (int i = 1; i+1 < nx; i++)
+            {
+                double left = frame(i-1,j);
+                double center = frame(i,j);
+                double right = frame(i+1,j);
+                if (left > 0 && center > 0 && right > 0)
+                {
+                    double d = left - 2.*center + right;
+                    sumd2 += d*d;
+                    sumv += center;
+                }
+            }
+        }
+        return sumv > 0 ? sumd2 / (6.*sumv) : 0.;
+    }
+}
 
 ////////////////////////////////////////////////////////////////////
 
@@ -35,63 +67,65 @@ void ReferenceImage::setupSelfBefore()
 
 ////////////////////////////////////////////////////////////////////
 
-double ReferenceImage::optimizeLuminosities(vector<Image>& inputFrames, vector<double>& luminosities) const
+void ReferenceImage::setupSelfAfter()
+{
+    SimulationItem::setupSelfAfter();
+
+    // Convolve with the threads used for each simulation, divided over the reference images that are
+    // handled in parallel
+    size_t numImages = find<ReferenceImages>()->images().size();
+    _threadCount = max(1, find<FitScheme>()->parallelThreadCount() / static_cast<int>(max(numImages, size_t(1))));
+
+    // Calculate the kernel transform once, since the same kernel is used for all input frames
+    if (Convolution::method(*this, *_kernel, _threadCount) == Convolution::Method::Fft)
+        _fftc.reset(new FftConvolution(sizeX(), sizeY(), _kernel->data(), _kernel->sizeX(), _kernel->sizeY()));
+}
+
+////////////////////////////////////////////////////////////////////
+
+double ReferenceImage::optimizeLuminosities(vector<Image>& inputFrames, vector<double>& luminosities,
+                                            double& chi2Variance) const
 {
     // verify the number of input frames
     size_t ncomp = _minLuminosities.size();
     if (inputFrames.size() != ncomp)
         throw FATALERROR("Number of input frames differs from number of components " + std::to_string(ncomp));
 
-    // convolve the input frames
+    // estimate the noise in the input frames, and convolve them; for a normalized kernel, the
+    // convolution reduces the noise variance by the sum of the squared kernel values
+    const Array& kernel = _kernel->data();
+    double kernelFactor = (kernel*kernel).sum();
+    vector<double> noiseFactors(ncomp);
     for (size_t k = 0; k < ncomp; k++)
     {
-        Convolution::convolve(inputFrames[k], *_kernel);
+        noiseFactors[k] = kernelFactor * noiseFactor(inputFrames[k]);
+        Convolution::convolve(inputFrames[k], *_kernel, _fftc.get(), _threadCount);
     }
 
-    // perform optimization algorithm depending on number of components
-    luminosities.clear();
+    // find the optimal luminosities
+    LumFit lumfit;
+    lumfit.setMinLuminosities(_minLuminosities);
+    lumfit.setMaxLuminosities(_maxLuminosities);
     double chi_value = 0.;
-    const Image& refImage = *this;
-    if (ncomp == 1)
-    {
-        LumFit1 lumfit;
-        lumfit.setMinLum(_minLuminosities[0]);
-        lumfit.setMaxLum(_maxLuminosities[0]);
-        double lum;
-        lumfit.optimize(refImage, inputFrames[0], lum, chi_value);
-        luminosities.push_back(lum);
-    }
-    else if (ncomp == 2)
-    {
-        LumFit2 lumfit;
-        lumfit.setMinLumA(_minLuminosities[0]);
-        lumfit.setMaxLumA(_maxLuminosities[0]);
-        lumfit.setMinLumB(_minLuminosities[1]);
-        lumfit.setMaxLumB(_maxLuminosities[1]);
-        double lumA, lumB;
-        lumfit.optimize(refImage, inputFrames[0], inputFrames[1], lumA, lumB, chi_value);
-        luminosities.push_back(lumA);
-        luminosities.push_back(lumB);
-    }
-    else
-    {
-        LumFitN lumfit;
-        lumfit.setMinLuminosities(_minLuminosities);
-        lumfit.setMaxLuminosities(_maxLuminosities);
-        lumfit.optimize(refImage, inputFrames, luminosities, chi_value);
-    }
+    lumfit.optimize(*this, inputFrames, luminosities, chi_value);
+    chi2Variance = lumfit.chi2Variance(luminosities, noiseFactors);
     return chi_value;
 }
 
 //////////////////////////////////////////////////////////////////////
 
-void ReferenceImage::getTotalAndResidual(const vector<Image>& inputFrames, const vector<double>& luminosities,
-                                         Image& totalImage, Image& residualImage) const
+void ReferenceImage::getTotal(const vector<Image>& inputFrames, const vector<double>& luminosities,
+                              Image& totalImage) const
 {
     size_t ncomp = inputFrames.size();
     totalImage = inputFrames[0]*luminosities[0];
     for (size_t k = 1; k < ncomp; k++) totalImage += inputFrames[k]*luminosities[k];
+}
 
+//////////////////////////////////////////////////////////////////////
+
+void ReferenceImage::getResidual(const Image& totalImage, Image& residualImage) const
+{
     const Image& refImage = *this;
     residualImage = ((refImage-totalImage)/refImage).abs();
 }
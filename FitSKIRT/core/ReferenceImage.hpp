@@ -9,6 +9,7 @@
 #include "SimulationItem.hpp"
 #include "Image.hpp"
 #include "ConvolutionKernel.hpp"
+#include "FftConvolution.hpp"
 
 ////////////////////////////////////////////////////////////////////
 
@@ -38,6 +39,13 @@ protected:
     /** This function reads the reference image file with the given name into memory. */
     void setupSelfBefore() override;
 
+    /** This function determines the number of threads used for convolving the input frames, i.e.
+        the number of threads used for each simulation divided by the number of reference images,
+        since these are handled in parallel by the ReferenceImages object. If the input frames will
+        be convolved using the FFT method, it also calculates the Fourier transform of the
+        convolution kernel, so that it can be reused for every convolution. */
+    void setupSelfAfter() override;
+
     //====================== Other functions =======================
 
 public:
@@ -47,15 +55,31 @@ public:
         optimal match, and sets the \em luminosities vector to the list of optimally matching
         luminosities (one per input frame). Furthermore, the \em inputFrames are altered in place:
         each frame is convolved with the reference image kernel and adjusted to contain the same
-        masks as the reference image. */
-    double optimizeLuminosities(vector<Image>& inputFrames, vector<double>& luminosities) const;
+        masks as the reference image.
+
+        The function also sets \em chi2Variance to an estimate of the variance of the
+        \f$\chi^2\f$ value caused by the Monte Carlo noise on the input frames. The noise
+        variance of each input frame pixel is assumed to be proportional to its value, as for a
+        Poisson process. The proportionality factor is estimated for each frame before convolution
+        from the second differences between horizontally adjacent pixels, which eliminate smooth
+        variations in the frame, and it is then reduced by the smoothing effect of the kernel. */
+    double optimizeLuminosities(vector<Image>& inputFrames, vector<double>& luminosities, double& chi2Variance) const;
 
     /** Given the adjusted input frames and the optimal luminosities returned by the
         optimizeLuminosities() function, this function calculates the the optimally matching total
-        image, i.e. a weighted sum of the input frames, and the residual image, i.e. the relative
-        difference between the total image and the reference image. */
-    void getTotalAndResidual(const vector<Image>& inputFrames, const vector<double>& luminosities,
-                             Image& totalImage, Image& residualImage) const;
+        image, i.e. a weighted sum of the input frames. */
+    void getTotal(const vector<Image>& inputFrames, const vector<double>& luminosities, Image& totalImage) const;
+
+    /** Given the total image returned by the getTotal() function, this function calculates the
+        residual image, i.e. the relative difference between the total image and the reference
+        image. */
+    void getResidual(const Image& totalImage, Image& residualImage) const;
+
+    //======================== Data Members ========================
+
+private:
+    int _threadCount{1};                    // the number of threads used for convolution
+    std::unique_ptr<FftConvolution> _fftc;  // the prepared FFT convolution, or null if not used
 };
 
 ////////////////////////////////////////////////////////////////////
@@ -7,11 +7,44 @@
 #include "AdjustableSkirtSimulation.hpp"
 #include "FatalError.hpp"
 #include "FilePaths.hpp"
+#include "FitScheme.hpp"
 #include "Log.hpp"
+#include "Parallel.hpp"
+#include "ParallelFactory.hpp"
 #include "Units.hpp"
 
 //////////////////////////////////////////////////////////////////////
 
+namespace
+{
+    // the factory for the parallel objects used by the current thread; it is constructed when first used
+    thread_local ParallelFactory factory;
+
+    // a target for parallel execution of the luminosity optimization, handling a reference image per index
+    class OptimizationTarget : public ParallelTarget
+    {
+    public:
+        OptimizationTarget(const vector<ReferenceImage*>& images, vector<vector<Image>>& inputFrames,
+                           vector<vector<double>>& luminosities, vector<double>& chis, vector<double>& variances)
+            : _images(images), _inputFrames(inputFrames), _luminosities(luminosities), _chis(chis),
+              _variances(variances) { }
+
+        void body(size_t ell) override
+        {
+            _chis[ell] = _images[ell]->optimizeLuminosities(_inputFrames[ell], _luminosities[ell], _variances[ell]);
+        }
+
+    private:
+        const vector<ReferenceImage*>& _images;
+        vector<vector<Image>>& _inputFrames;
+        vector<vector<double>>& _luminosities;
+        vector<double>& _chis;
+        vector<double>& _variances;
+    };
+}
+
+//////////////////////////////////////////////////////////////////////
+
 void ReferenceImages::setupSelfAfter()
 {
     SimulationItem::setupSelfAfter();
@@ -37,38 +70,61 @@ void ReferenceImages::setupSelfAfter()
 //////////////////////////////////////////////////////////////////////
 
 double ReferenceImages::optimizeLuminosities(vector<vector<Image>>& inputFrames,
-                                             vector<vector<double>>& luminosities, vector<double>& chis)
+                                             vector<vector<double>>& luminosities, vector<double>& chis,
+                                             double& chi2Variance)
 {
     if (inputFrames.size() != _images.size())
         throw FATALERROR("Number of input images does not match the number of reference images");
 
-    luminosities.clear();
-    chis.clear();
-    double chi2_sum = 0;
-    for (size_t ell=0; ell < _images.size() ; ++ell)
+    // handle the reference images in parallel, with at most as many threads as are used for each simulation
+    size_t numImages = _images.size();
+    luminosities.assign(numImages, vector<double>());
+    chis.assign(numImages, 0.);
+    vector<double> variances(numImages, 0.);
+    OptimizationTarget target(_images, inputFrames, luminosities, chis, variances);
+    int threadCount = min(find<FitScheme>()->parallelThreadCount(), static_cast<int>(numImages));
+    if (threadCount > 1)
     {
-        vector<double> lumin;
-        double chi = _images[ell]->optimizeLuminosities(inputFrames[ell], lumin);
-        luminosities.push_back(lumin);
-        chis.push_back(chi);
-        chi2_sum += chi;
+        factory.parallel(threadCount)->call(&target, numImages);
     }
+    else
+    {
+        for (size_t ell = 0; ell < numImages; ell++) target.body(ell);
+    }
+
+    // add the chi2 values (and their variances, since the noise is independent between the images)
+    // in a fixed order so that the result does not depend on the number of threads
+    double chi2_sum = 0;
+    for (double chi : chis) chi2_sum += chi;
+    chi2Variance = 0;
+    for (double variance : variances) chi2Variance += variance;
     return chi2_sum;
 }
 
 //////////////////////////////////////////////////////////////////////
 
-void ReferenceImages::getTotalAndResidual(const vector<vector<Image>>& inputFrames,
-                                          const vector<vector<double>>& luminosities,
-                                          vector<Image>& totalImages, vector<Image>& residualImages) const
+void ReferenceImages::getTotals(const vector<vector<Image>>& inputFrames, const vector<vector<double>>& luminosities,
+                                vector<Image>& totalImages) const
 {
     size_t numImages = _images.size();
     totalImages.resize(numImages);
+
+    for (size_t ell=0; ell < numImages ; ++ell)
+    {
+        _images[ell]->getTotal(inputFrames[ell], luminosities[ell], totalImages[ell]);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void ReferenceImages::getResiduals(const vector<Image>& totalImages, vector<Image>& residualImages) const
+{
+    size_t numImages = _images.size();
     residualImages.resize(numImages);
 
     for (size_t ell=0; ell < numImages ; ++ell)
     {
-        _images[ell]->getTotalAndResidual(inputFrames[ell], luminosities[ell], totalImages[ell], residualImages[ell]);
+        _images[ell]->getResidual(totalImages[ell], residualImages[ell]);
     }
 }
 
@@ -40,16 +40,23 @@ public:
         the \em luminosities table to optimally matching luminosities per luminosity component
         (inner index) and per wavelength (outer index). Furthermore, the \em inputFrames are
         altered in place: each frame is convolved with the reference image kernel and adjusted to
-        contain the same masks as the reference image. */
+        contain the same masks as the reference image. The reference images are handled in parallel,
+        using at most as many threads as are used for each simulation. Finally, the function sets
+        \em chi2Variance to an estimate of the variance of the returned \f$\chi^2\f$ value caused
+        by the Monte Carlo noise on the input frames (see ReferenceImage::optimizeLuminosities()). */
     double optimizeLuminosities(vector<vector<Image>>& inputFrames,
-                                vector<vector<double>>& luminosities, vector<double>& chis);
+                                vector<vector<double>>& luminosities, vector<double>& chis, double& chi2Variance);
 
     /** Given the adjusted input frames and the optimal luminosities returned by the
         optimizeLuminosities() function, this function calculates the the optimally matching total
-        images, i.e. a weighted sum of the input frames, and the residual images, i.e. the relative
-        difference between the total image and the reference image. */
-    void getTotalAndResidual(const vector<vector<Image>>& inputFrames, const vector<vector<double>>& luminosities,
-                             vector<Image>& totalImages, vector<Image>& residualImages) const;
+        images, i.e. a weighted sum of the input frames, for each wavelength. */
+    void getTotals(const vector<vector<Image>>& inputFrames, const vector<vector<double>>& luminosities,
+                   vector<Image>& totalImages) const;
+
+    /** Given the total images returned by the getTotals() function, this function calculates the
+        residual images, i.e. the relative difference between the total image and the reference
+        image, for each wavelength. */
+    void getResiduals(const vector<Image>& totalImages, vector<Image>& residualImages) const;
 };
 
 ////////////////////////////////////////////////////////////////////
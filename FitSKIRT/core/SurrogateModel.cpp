@@ -0,0 +1,176 @@
+/*//////////////////////////////////////////////////////////////////
+////     The SKIRT project -- advanced radiative transfer       ////
+////       © Astronomical Observatory, Ghent University         ////
+///////////////////////////////////////////////////////////////// */
+
+#include "SurrogateModel.hpp"
+#include "FatalError.hpp"
+
+////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    // the minimum number of points required for training the model
+    const size_t minTrainingPoints = 8;
+
+    // the maximum number of (most recent) points used for training the model
+    const size_t maxTrainingPoints = 300;
+
+    // the candidate length scales, in units of the (scaled) parameter range
+    const double lengthScales[] = { 0.05, 0.1, 0.2, 0.4, 0.8 };
+
+    // the candidate noise variances, relative to the variance of the training values
+    const double noiseVariances[] = { 1e-6, 1e-3, 1e-2, 1e-1 };
+
+    // returns the squared distance between two points
+    double distance2(const vector<double>& a, const vector<double>& b)
+    {
+        double d2 = 0.;
+        for (size_t i = 0; i < a.size(); i++) d2 += (a[i]-b[i])*(a[i]-b[i]);
+        return d2;
+    }
+
+    // replaces the symmetric positive definite matrix A of dimension n (in row-major order) by its
+    // lower-triangular Cholesky factor; returns false if the matrix is not positive definite
+    bool cholesky(vector<double>& A, size_t n)
+    {
+        for (size_t j = 0; j < n; j++)
+        {
+            double s = A[j*n+j];
+            for (size_t k = 0; k < j; k++) s -= A[j*n+k]*A[j*n+k];
+            if (s <= 0.) return false;
+            double d = sqrt(s);
+            A[j*n+j] = d;
+            for (size_t i = j+1; i < n; i++)
+            {
+                double t = A[i*n+j];
+                for (size_t k = 0; k < j; k++) t -= A[i*n+k]*A[j*n+k];
+                A[i*n+j] = t / d;
+            }
+            for (size_t k = j+1; k < n; k++) A[j*n+k] = 0.;
+        }
+        return true;
+    }
+
+    // solves L x = b in place, with L the lower-triangular matrix of dimension n
+    void forwardSubstitute(const vector<double>& L, vector<double>& b, size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            double s = b[i];
+            for (size_t k = 0; k < i; k++) s -= L[i*n+k]*b[k];
+            b[i] = s / L[i*n+i];
+        }
+    }
+
+    // solves L^T x = b in place, with L the lower-triangular matrix of dimension n
+    void backSubstitute(const vector<double>& L, vector<double>& b, size_t n)
+    {
+        for (size_t i = n; i-- > 0; )
+        {
+            double s = b[i];
+            for (size_t k = i+1; k < n; k++) s -= L[k*n+i]*b[k];
+            b[i] = s / L[i*n+i];
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
+void SurrogateModel::add(const vector<double>& point, double value)
+{
+    if (value <= 0) throw FATALERROR("Surrogate model values must be positive");
+    _points.push_back(point);
+    _values.push_back(value);
+}
+
+////////////////////////////////////////////////////////////////////
+
+size_t SurrogateModel::size() const
+{
+    return _points.size();
+}
+
+////////////////////////////////////////////////////////////////////
+
+bool SurrogateModel::train()
+{
+    _L.clear();
+    _alpha.clear();
+    if (_points.size() < minTrainingPoints) return false;
+
+    // normalize the logarithm of the most recent values
+    _first = _points.size() > maxTrainingPoints ? _points.size() - maxTrainingPoints : 0;
+    size_t n = _points.size() - _first;
+    vector<double> y(n);
+    double sum = 0., sum2 = 0.;
+    for (size_t i = 0; i < n; i++)
+    {
+        y[i] = log(_values[_first+i]);
+        sum += y[i];
+        sum2 += y[i]*y[i];
+    }
+    _mean = sum/n;
+    _scale = sqrt(max(sum2/n - _mean*_mean, 0.));
+    if (_scale <= 1e-12*max(1., abs(_mean))) _scale = 1.;
+    for (double& v : y) v = (v - _mean) / _scale;
+
+    // calculate the squared distances between the training points
+    vector<double> d2(n*n);
+    for (size_t i = 0; i < n; i++)
+        for (size_t j = 0; j <= i; j++)
+            d2[i*n+j] = d2[j*n+i] = distance2(_points[_first+i], _points[_first+j]);
+
+    // select the hyperparameters with the largest marginal likelihood
+    double bestLikelihood = -std::numeric_limits<double>::infinity();
+    for (double lengthScale : lengthScales)
+    {
+        for (double noise : noiseVariances)
+        {
+            vector<double> L(n*n);
+            for (size_t k = 0; k < n*n; k++) L[k] = exp(-0.5*d2[k]/(lengthScale*lengthScale));
+            for (size_t i = 0; i < n; i++) L[i*n+i] += noise;
+            if (!cholesky(L, n)) continue;
+
+            vector<double> alpha = y;
+            forwardSubstitute(L, alpha, n);
+            double likelihood = 0.;
+            for (size_t i = 0; i < n; i++) likelihood -= 0.5*alpha[i]*alpha[i] + log(L[i*n+i]);
+            if (likelihood > bestLikelihood)
+            {
+                bestLikelihood = likelihood;
+                backSubstitute(L, alpha, n);
+                _lengthScale = lengthScale;
+                _noise = noise;
+                _L = std::move(L);
+                _alpha = std::move(alpha);
+            }
+        }
+    }
+    return !_alpha.empty();
+}
+
+////////////////////////////////////////////////////////////////////
+
+void SurrogateModel::predict(const vector<double>& point, double& logMean, double& logSigma) const
+{
+    if (_alpha.empty()) throw FATALERROR("Surrogate model has not been trained");
+
+    // calculate the covariance with the training points
+    size_t n = _alpha.size();
+    vector<double> k(n);
+    for (size_t i = 0; i < n; i++)
+        k[i] = exp(-0.5*distance2(point, _points[_first+i])/(_lengthScale*_lengthScale));
+
+    // the mean is k^T alpha; the variance is k(x,x) - k^T K^-1 k = 1 - |L^-1 k|^2
+    double mean = 0.;
+    for (size_t i = 0; i < n; i++) mean += k[i]*_alpha[i];
+    forwardSubstitute(_L, k, n);
+    double variance = 1.;
+    for (size_t i = 0; i < n; i++) variance -= k[i]*k[i];
+
+    logMean = _mean + _scale*mean;
+    logSigma = _scale*sqrt(max(variance, 0.));
+}
+
+////////////////////////////////////////////////////////////////////
@@ -0,0 +1,69 @@
+/*//////////////////////////////////////////////////////////////////
+////     The SKIRT project -- advanced radiative transfer       ////
+////       © Astronomical Observatory, Ghent University         ////
+///////////////////////////////////////////////////////////////// */
+
+#ifndef SURROGATEMODEL_HPP
+#define SURROGATEMODEL_HPP
+
+#include "Basics.hpp"
+
+////////////////////////////////////////////////////////////////////
+
+/** The SurrogateModel class implements a Gaussian process regression model that approximates the
+    objective function of a fit, i.e. the \f$\chi^2\f$ value as a function of the fit parameters,
+    from the values obtained for previously evaluated parameter sets. The model can be used to
+    predict the objective function value for a new parameter set, including an estimate of the
+    uncertainty on the prediction, at a negligible cost compared to a full simulation.
+
+    The parameter values should be scaled to the unit interval by the caller. The model operates on
+    the logarithm of the objective function values, which usually span several orders of
+    magnitude, normalized to zero mean and unit variance. The covariance between two points is
+    given by a squared exponential kernel, \f[ k(x,x') = \exp\left(-\frac{|x-x'|^2}{2\ell^2}
+    \right) + \sigma_n^2\,\delta_{x,x'}, \f] where the length scale \f$\ell\f$ and the noise
+    variance \f$\sigma_n^2\f$ (which accounts for the Monte Carlo noise on the objective function)
+    are selected from a predefined grid by maximizing the marginal likelihood of the data. To limit
+    the cost of training, which scales as the cube of the number of points, the model uses only the
+    most recently added points up to a fixed maximum. */
+class SurrogateModel
+{
+    //======================== Other Functions =======================
+
+public:
+    /** This function adds a point to the training data of the model, given its coordinates (the
+        scaled parameter values) and the corresponding (positive) objective function value. The
+        function does not retrain the model. */
+    void add(const vector<double>& point, double value);
+
+    /** This function returns the number of points that have been added to the model. */
+    size_t size() const;
+
+    /** This function trains the model on the most recently added points. It returns true if the
+        model is ready for use, and false if there are not enough points for a meaningful model. */
+    bool train();
+
+    /** This function returns the prediction of the trained model for the specified point, in the
+        form of the mean and the standard deviation of the natural logarithm of the objective
+        function value. */
+    void predict(const vector<double>& point, double& logMean, double& logSigma) const;
+
+    //======================== Data Members ========================
+
+private:
+    // all points added to the model
+    vector<vector<double>> _points;
+    vector<double> _values;
+
+    // the trained model
+    size_t _first{0};           // the index of the first point used for training
+    double _lengthScale{0.};    // the selected length scale
+    double _noise{0.};          // the selected noise variance
+    double _mean{0.};           // the mean of the logarithm of the training values
+    double _scale{1.};          // the standard deviation of the logarithm of the training values
+    vector<double> _L;          // the Cholesky factor of the covariance matrix, in row-major order
+    vector<double> _alpha;      // the covariance matrix inverse times the normalized training values
+};
+
+////////////////////////////////////////////////////////////////////
+
+#endif
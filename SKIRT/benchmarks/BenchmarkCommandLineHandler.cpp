@@ -0,0 +1,395 @@
+/*//////////////////////////////////////////////////////////////////
+////     The SKIRT project -- advanced radiative transfer       ////
+////       © Astronomical Observatory, Ghent University         ////
+///////////////////////////////////////////////////////////////// */
+
+#include "BenchmarkCommandLineHandler.hpp"
+#include "BenchmarkModels.hpp"
+#include "BuildInfo.hpp"
+#include "DustMix.hpp"
+#include "DustSystem.hpp"
+#include "FatalError.hpp"
+#include "FilePaths.hpp"
+#include "Instrument.hpp"
+#include "InstrumentSystem.hpp"
+#include "MonteCarloSimulation.hpp"
+#include "Parallel.hpp"
+#include "ParallelFactory.hpp"
+#include "ParallelTarget.hpp"
+#include "PhotonPackage.hpp"
+#include "Profiler.hpp"
+#include "Random.hpp"
+#include "SchemaDef.hpp"
+#include "SimulationItemRegistry.hpp"
+#include "StringUtils.hpp"
+#include "System.hpp"
+#include "TreeDustGrid.hpp"
+#include "VoronoiDustGrid.hpp"
+#include "XmlHierarchyCreator.hpp"
+#include <chrono>
+
+////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    // the allowed options list, in the format consumed by the CommandLineArguments constructor
+    static const char* allowedOptions = "-t* -w* -o* -b*";
+
+    // the number of chunks in which the operations of a micro-benchmark are divided
+    const size_t numChunks = 100;
+
+    // returns the number of seconds elapsed since the specified time point
+    double secondsSince(std::chrono::steady_clock::time_point started)
+    {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+        return elapsed.count();
+    }
+
+    // returns the specified string as a quoted JSON string
+    string quoted(string value)
+    {
+        string result = "\"";
+        for (char c : value)
+        {
+            if (c=='"' || c=='\\') result += '\\';
+            if (static_cast<unsigned char>(c) >= 0x20) result += c;
+        }
+        return result + "\"";
+    }
+
+    // returns the specified floating point value as a JSON number
+    string number(double value)
+    {
+        return StringUtils::toString(value, 'e', 9);
+    }
+
+    // this parallel target invokes the operations function of a micro-benchmark for each chunk
+    class ChunkTarget : public ParallelTarget
+    {
+    public:
+        ChunkTarget(std::function<void (size_t count)> operations, size_t chunkSize)
+            : _operations(operations), _chunkSize(chunkSize) { }
+        void body(size_t /*index*/) override { _operations(_chunkSize); }
+
+    private:
+        std::function<void (size_t count)> _operations;
+        size_t _chunkSize;
+    };
+}
+
+////////////////////////////////////////////////////////////////////
+
+BenchmarkCommandLineHandler::BenchmarkCommandLineHandler()
+    : _args(System::arguments(), allowedOptions)
+{
+    // issue welcome message
+    _producerInfo = "SKIRT benchmarks " + BuildInfo::projectVersion()
+                    + " (" + BuildInfo::codeVersion() + " " + BuildInfo::timestamp() + ")";
+    _console.info("Welcome to " + _producerInfo);
+    _console.info("Running on " + System::hostname() + " for " + System::username());
+}
+
+////////////////////////////////////////////////////////////////////
+
+int BenchmarkCommandLineHandler::perform()
+{
+    // catch and properly report any exceptions
+    try
+    {
+        if (!_args.isValid() || _args.hasFilepaths())
+        {
+            _console.error("Invalid command line arguments");
+            _console.info("Usage: skirtbench [-t <threads>] [-w <factor>] [-o <dirpath>] [-b <names>]");
+            return EXIT_FAILURE;
+        }
+
+        // determine the series of thread counts: the powers of two up to the maximum, and the maximum itself
+        int maxThreads = _args.isPresent("-t") ? _args.intValue("-t") : ParallelFactory::defaultThreadCount();
+        if (maxThreads < 1) throw FATALERROR("The maximum number of threads must be a positive integer");
+        for (int threads = 1; threads < maxThreads; threads *= 2) _threadCounts.push_back(threads);
+        _threadCounts.push_back(maxThreads);
+
+        // get the workload factor and the output path
+        if (_args.isPresent("-w")) _workload = _args.doubleValue("-w");
+        if (_workload <= 0) throw FATALERROR("The workload factor must be a positive number");
+        _outpath = _args.value("-o");
+
+        // verify the benchmark selection
+        vector<string> known = BenchmarkModels::names();
+        for (string name : { "random", "treepath", "voronoipath", "scattering", "detect" }) known.push_back(name);
+        if (_args.isPresent("-b"))
+            for (string name : StringUtils::split(_args.value("-b"), ","))
+                if (!StringUtils::contains(known, name)) throw FATALERROR("Unknown benchmark: " + name);
+
+        vector<Curve> curves;
+
+        // perform the simulation benchmarks
+        for (string model : BenchmarkModels::names())
+        {
+            if (isSelected(model))
+            {
+                curves.push_back(doSimulationBenchmark(model));
+                reportCurve(curves.back());
+            }
+        }
+
+        // perform the micro-benchmarks
+        if (isSelected("random"))
+        {
+            curves.push_back(doMicroBenchmark("random", "Random::uniform()", "cartesian", 2e7,
+                [] (MonteCarloSimulation* simulation)
+            {
+                Random* random = simulation->random();
+                return [random] (size_t count)
+                {
+                    for (size_t i = 0; i != count; ++i) random->uniform();
+                };
+            }));
+            reportCurve(curves.back());
+        }
+        if (isSelected("treepath"))
+        {
+            curves.push_back(doMicroBenchmark("treepath", "TreeDustGrid::path()", "octtree", 5e5,
+                [] (MonteCarloSimulation* simulation)
+            {
+                Random* random = simulation->random();
+                auto grid = dynamic_cast<TreeDustGrid*>(simulation->find<DustSystem>()->dustGrid());
+                return [random, grid] (size_t count)
+                {
+                    DustGridPath path;
+                    Box box = grid->boundingBox();
+                    for (size_t i = 0; i != count; ++i)
+                    {
+                        path.setPosition(random->position(box));
+                        path.setDirection(random->direction());
+                        grid->path(&path);
+                    }
+                };
+            }));
+            reportCurve(curves.back());
+        }
+        if (isSelected("voronoipath"))
+        {
+            curves.push_back(doMicroBenchmark("voronoipath", "VoronoiMesh::path()", "voronoi", 5e5,
+                [] (MonteCarloSimulation* simulation)
+            {
+                Random* random = simulation->random();
+                auto grid = dynamic_cast<VoronoiDustGrid*>(simulation->find<DustSystem>()->dustGrid());
+                return [random, grid] (size_t count)
+                {
+                    DustGridPath path;
+                    Box box = grid->boundingBox();
+                    for (size_t i = 0; i != count; ++i)
+                    {
+                        path.setPosition(random->position(box));
+                        path.setDirection(random->direction());
+                        grid->path(&path);
+                    }
+                };
+            }));
+            reportCurve(curves.back());
+        }
+        if (isSelected("scattering"))
+        {
+            curves.push_back(doMicroBenchmark("scattering", "DustMix::scatteringDirectionAndPolarization()",
+                                              "polarized", 1e6, [] (MonteCarloSimulation* simulation)
+            {
+                Random* random = simulation->random();
+                DustMix* mix = simulation->find<DustSystem>()->mix(0);
+                return [random, mix] (size_t count)
+                {
+                    PhotonPackage pp;
+                    StokesVector sv;
+                    pp.launch(1., 0, Position(), random->direction());
+                    for (size_t i = 0; i != count; ++i)
+                    {
+                        Direction bfk = mix->scatteringDirectionAndPolarization(&sv, &pp);
+                        pp.launch(1., i%2, Position(), bfk);
+                    }
+                };
+            }));
+            reportCurve(curves.back());
+        }
+        if (isSelected("detect"))
+        {
+            curves.push_back(doMicroBenchmark("detect", "FullInstrument::detect()", "cartesian", 1e6,
+                [] (MonteCarloSimulation* simulation)
+            {
+                Random* random = simulation->random();
+                Box box = simulation->find<DustSystem>()->dustGrid()->boundingBox();
+                Instrument* instrument = simulation->find<InstrumentSystem>()->instruments()[0];
+                return [random, box, instrument] (size_t count)
+                {
+                    PhotonPackage pp;
+                    for (size_t i = 0; i != count; ++i)
+                    {
+                        Position bfr = random->position(box);
+                        pp.launch(1., i%2, bfr, instrument->bfkobs(bfr));
+                        pp.setStellarOrigin(0);
+                        instrument->detect(&pp);
+                    }
+                };
+            }));
+            reportCurve(curves.back());
+        }
+
+        writeReport(curves);
+        return EXIT_SUCCESS;
+    }
+    catch (FatalError& error)
+    {
+        for (string line : error.message()) _console.error(line);
+    }
+    catch (const std::exception& except)
+    {
+        _console.error("Standard Library Exception: " + string(except.what()));
+    }
+    return EXIT_FAILURE;
+}
+
+////////////////////////////////////////////////////////////////////
+
+bool BenchmarkCommandLineHandler::isSelected(string name) const
+{
+    return !_args.isPresent("-b") || StringUtils::contains(StringUtils::split(_args.value("-b"), ","), name);
+}
+
+////////////////////////////////////////////////////////////////////
+
+std::unique_ptr<Item> BenchmarkCommandLineHandler::createSimulation(string model, int threads) const
+{
+    auto schema = SimulationItemRegistry::getSchemaDef();
+    auto topitem = XmlHierarchyCreator::readString(schema, BenchmarkModels::skiContent(model, _workload),
+                                                   "benchmark model " + model);
+    auto simulation = dynamic_cast<MonteCarloSimulation*>(topitem.get());
+
+    simulation->filePaths()->setOutputPrefix("skirtbench_" + model);
+    simulation->filePaths()->setOutputPath(_outpath);
+    simulation->parallelFactory()->setMaxThreadCount(threads);
+    simulation->log()->setLowestLevel(Log::Level::Error);
+    return topitem;
+}
+
+////////////////////////////////////////////////////////////////////
+
+BenchmarkCommandLineHandler::Curve BenchmarkCommandLineHandler::doSimulationBenchmark(string model) const
+{
+    Curve curve{model, "simulation", BenchmarkModels::description(model), {}};
+    for (int threads : _threadCounts)
+    {
+        auto topitem = createSimulation(model, threads);
+        auto simulation = dynamic_cast<MonteCarloSimulation*>(topitem.get());
+
+        // enable the profiler so that we know the exact number of launched photon packages
+        simulation->profiler()->enable(_producerInfo);
+
+        auto started = std::chrono::steady_clock::now();
+        simulation->setup();
+        double setupSeconds = secondsSince(started);
+
+        started = std::chrono::steady_clock::now();
+        simulation->run();
+        double runSeconds = secondsSince(started);
+
+        Profiler* profiler = simulation->profiler();
+        curve.points.push_back(Point{threads, profiler->totalWallTime(),
+                                     profiler->totalCount(Profiler::Counter::Launches), setupSeconds, runSeconds});
+    }
+    return curve;
+}
+
+////////////////////////////////////////////////////////////////////
+
+BenchmarkCommandLineHandler::Curve BenchmarkCommandLineHandler::doMicroBenchmark(string name, string description,
+                                                                                 string model, double operations,
+                                                                                 Preparation prepare) const
+{
+    // set up a simulation for the largest number of threads; Parallel instances can use fewer threads
+    auto topitem = createSimulation(model, _threadCounts.back());
+    auto simulation = dynamic_cast<MonteCarloSimulation*>(topitem.get());
+    simulation->setup();
+
+    size_t chunkSize = max(static_cast<size_t>(1), static_cast<size_t>(operations*_workload/numChunks));
+    ChunkTarget target(prepare(simulation), chunkSize);
+
+    Curve curve{name, "micro", description + " for the " + model + " model", {}};
+    for (int threads : _threadCounts)
+    {
+        Parallel* parallel = simulation->parallelFactory()->parallel(threads);
+        auto started = std::chrono::steady_clock::now();
+        parallel->call(&target, numChunks);
+        double seconds = secondsSince(started);
+        curve.points.push_back(Point{threads, seconds, static_cast<double>(chunkSize*numChunks), 0., 0.});
+    }
+    return curve;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void BenchmarkCommandLineHandler::reportCurve(const Curve& curve)
+{
+    _console.info("Benchmark " + curve.name + ": " + curve.description);
+    double base = curve.points[0].operations / curve.points[0].seconds;
+    for (const Point& point : curve.points)
+    {
+        double rate = point.operations / point.seconds;
+        string message = "  " + StringUtils::toString(point.threads, 'd', 0, 3) + " threads: "
+                         + StringUtils::toString(rate, 'e', 3) + (curve.kind=="simulation" ? " packages/s" : " calls/s")
+                         + " -- speedup " + StringUtils::toString(rate/base, 'f', 2)
+                         + " -- efficiency " + StringUtils::toString(100.*rate/base/point.threads, 'f', 1) + "%";
+        if (curve.kind=="simulation")
+            message += " -- setup " + StringUtils::toString(point.setupSeconds, 'f', 2) + " s"
+                       + " -- run " + StringUtils::toString(point.runSeconds, 'f', 2) + " s";
+        _console.info(message);
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
+void BenchmarkCommandLineHandler::writeReport(const vector<Curve>& curves)
+{
+    string filepath = StringUtils::joinPaths(_outpath, "skirtbench.json");
+    _console.info("Writing benchmark report to " + filepath + "...");
+    std::ofstream out = System::ofstream(filepath);
+
+    out << "{\n";
+    out << "  \"producer\": " << quoted(_producerInfo) << ",\n";
+    out << "  \"host\": " << quoted(System::hostname()) << ",\n";
+    out << "  \"time\": " << quoted(System::timestamp(true)) << ",\n";
+    out << "  \"logicalCores\": " << ParallelFactory::defaultThreadCount() << ",\n";
+    out << "  \"workload\": " << number(_workload) << ",\n";
+    out << "  \"benchmarks\": [";
+    for (size_t c=0; c!=curves.size(); ++c)
+    {
+        const Curve& curve = curves[c];
+        bool simulation = curve.kind=="simulation";
+        double base = curve.points[0].operations / curve.points[0].seconds;
+
+        out << (c ? "," : "") << "\n    {\n";
+        out << "      \"name\": " << quoted(curve.name) << ",\n";
+        out << "      \"kind\": " << quoted(curve.kind) << ",\n";
+        out << "      \"description\": " << quoted(curve.description) << ",\n";
+        out << "      \"unit\": " << quoted(simulation ? "packages/s" : "calls/s") << ",\n";
+        out << "      \"scaling\": [";
+        for (size_t p=0; p!=curve.points.size(); ++p)
+        {
+            const Point& point = curve.points[p];
+            double rate = point.operations / point.seconds;
+            out << (p ? "," : "") << "\n        {"
+                << " \"threads\": " << point.threads
+                << ", \"operations\": " << number(point.operations)
+                << ", \"seconds\": " << number(point.seconds)
+                << ", \"throughput\": " << number(rate)
+                << ", \"speedup\": " << number(rate/base)
+                << ", \"efficiency\": " << number(rate/base/point.threads);
+            if (simulation)
+                out << ", \"setupSeconds\": " << number(point.setupSeconds)
+                    << ", \"runSeconds\": " << number(point.runSeconds);
+            out << " }";
+        }
+        out << "\n      ]\n    }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+////////////////////////////////////////////////////////////////////
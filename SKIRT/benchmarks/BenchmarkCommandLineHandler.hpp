@@ -0,0 +1,141 @@
+/*//////////////////////////////////////////////////////////////////
+////     The SKIRT project -- advanced radiative transfer       ////
+////       © Astronomical Observatory, Ghent University         ////
+///////////////////////////////////////////////////////////////// */
+
+#ifndef BENCHMARKCOMMANDLINEHANDLER_HPP
+#define BENCHMARKCOMMANDLINEHANDLER_HPP
+
+#include "CommandLineArguments.hpp"
+#include "ConsoleLog.hpp"
+#include <functional>
+#include <memory>
+class Item;
+class MonteCarloSimulation;
+
+////////////////////////////////////////////////////////////////////
+
+/**
+This class processes the command line arguments for the SKIRT performance benchmarks and
+performs the requested benchmarks according to the following syntax:
+
+\verbatim
+ skirtbench [-t <threads>] [-w <factor>] [-o <dirpath>] [-b <names>]
+\endverbatim
+
+- The -t option specifies the maximum number of parallel threads. The default value is the
+  number of logical cores on the computer running the benchmarks.
+
+- The -w option specifies a workload factor by which the number of photon packages in the
+  simulation benchmarks and the number of operations in the micro-benchmarks are multiplied. The
+  default value is one, which is appropriate for a quick regression check. Use a larger value
+  for more accurate results, especially with many threads.
+
+- The -o option specifies the absolute or relative path for the output directory, which will
+  contain the JSON report and the output files of the benchmark simulations. The default is the
+  current directory.
+
+- The -b option specifies a comma-separated list of the benchmarks to be performed, using the
+  names listed below. By default, all benchmarks are performed.
+
+There are two kinds of benchmarks. A simulation benchmark performs a complete simulation for one
+of the synthetic reference models offered by the BenchmarkModels class, and measures the
+photon package throughput. The benchmark names are the model names: \c octtree, \c voronoi, \c
+cartesian, \c polarized and \c panchromatic. A micro-benchmark repeatedly invokes a single
+hot-path function on a simulation that has been set up (but not run) for one of the reference
+models, and measures the number of invocations per second. The micro-benchmarks are:
+
+- \c random: Random::uniform() for the \c cartesian model.
+- \c treepath: TreeDustGrid::path() for random positions and directions in the \c octtree model.
+- \c voronoipath: VoronoiDustGrid::path(), which forwards to VoronoiMesh::path(), for random
+  positions and directions in the \c voronoi model.
+- \c scattering: DustMix::scatteringDirectionAndPolarization() for the electron mix in the \c
+  polarized model.
+- \c detect: FullInstrument::detect() for peel-off photon packages emitted at random positions in
+  the \c cartesian model, including the calculation of the optical depth towards the instrument.
+
+Each benchmark is performed for a series of thread counts (the powers of two up to the maximum
+number of threads, and the maximum itself), yielding a thread-scaling curve with the throughput,
+the speedup relative to a single thread, and the parallel efficiency for each thread count. For
+the simulation benchmarks, the throughput is the number of photon packages launched (including
+those for dust emission) divided by the wall time spent in the photon shooting phases, as
+recorded by the Profiler; the setup and total run times are reported as well. The results are
+written to the console and to a JSON file called <tt>skirtbench.json</tt> in the output
+directory, so that the reports for different builds or computers can be easily compared.
+*/
+class BenchmarkCommandLineHandler
+{
+public:
+    /** The constructor parses the command line arguments and issues a welcome message. */
+    BenchmarkCommandLineHandler();
+
+    /** This function performs the benchmarks requested on the command line. It returns an exit
+        value that can be returned from main(). */
+    int perform();
+
+private:
+    /** A Point holds the result of a benchmark for a particular number of threads. */
+    struct Point
+    {
+        int threads;            // the number of threads
+        double seconds;         // the wall time for the timed operations
+        double operations;      // the number of operations (photon packages or function invocations)
+        double setupSeconds;    // the setup time (simulation benchmarks only)
+        double runSeconds;      // the total run time (simulation benchmarks only)
+    };
+
+    /** A Curve holds the thread-scaling curve for a particular benchmark. */
+    struct Curve
+    {
+        string name;            // the benchmark name
+        string kind;            // "simulation" or "micro"
+        string description;     // a one-line description
+        vector<Point> points;   // the results for each number of threads, in increasing order
+    };
+
+    /** This function returns true if the benchmark with the specified name should be performed. */
+    bool isSelected(string name) const;
+
+    /** This function constructs a simulation for the reference model with the specified name,
+        configured to use the specified number of threads. */
+    std::unique_ptr<Item> createSimulation(string model, int threads) const;
+
+    /** This function performs the simulation benchmark for the reference model with the specified
+        name. */
+    Curve doSimulationBenchmark(string model) const;
+
+    /** Definition of the type of a function performing the specified number of operations for a
+        micro-benchmark. The function is invoked from multiple threads in parallel. */
+    using Operations = std::function<void (size_t count)>;
+
+    /** Definition of the type of a function that returns the operations function for a
+        micro-benchmark, given a simulation that has been set up for the appropriate reference
+        model. */
+    using Preparation = std::function<Operations (MonteCarloSimulation* simulation)>;
+
+    /** This function performs a micro-benchmark with the specified name and description, using
+        a simulation set up for the specified reference model. The specified preparation
+        function returns the function performing the operations. The specified number of
+        operations is multiplied by the workload factor. */
+    Curve doMicroBenchmark(string name, string description, string model, double operations,
+                           Preparation prepare) const;
+
+    /** This function reports the specified curve on the console. */
+    void reportCurve(const Curve& curve);
+
+    /** This function writes the JSON report for the specified curves. */
+    void writeReport(const vector<Curve>& curves);
+
+private:
+    // data members
+    ConsoleLog _console;
+    CommandLineArguments _args;
+    string _producerInfo;
+    string _outpath;
+    double _workload{1.};
+    vector<int> _threadCounts;
+};
+
+////////////////////////////////////////////////////////////////////
+
+#endif
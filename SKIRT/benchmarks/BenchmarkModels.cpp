@@ -0,0 +1,224 @@
+/*//////////////////////////////////////////////////////////////////
+////     The SKIRT project -- advanced radiative transfer       ////
+////       © Astronomical Observatory, Ghent University         ////
+///////////////////////////////////////////////////////////////// */
+
+#include "BenchmarkModels.hpp"
+#include "FatalError.hpp"
+#include "StringUtils.hpp"
+
+////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    // the ski content for the oligochromatic models, with placeholders for the number of photon packages,
+    // the dust mix and the dust grid
+    const char* oligoTemplate = R"(<?xml version="1.0" encoding="UTF-8"?>
+<skirt-simulation-hierarchy type="MonteCarloSimulation" format="8" producer="skirtbench">
+    <OligoMonteCarloSimulation numPackages="[NUMPACKAGES]" minWeightReduction="1e4" minScattEvents="0" scattBias="0.5" continuousScattering="false">
+        <random type="Random">
+            <Random seed="4357"/>
+        </random>
+        <units type="Units">
+            <ExtragalacticUnits/>
+        </units>
+        <wavelengthGrid type="OligoWavelengthGrid">
+            <OligoWavelengthGrid wavelengths="0.45 micron, 0.55 micron"/>
+        </wavelengthGrid>
+        <stellarSystem type="StellarSystem">
+            <StellarSystem emissionBias="0.5">
+                <components type="StellarComp">
+                    <OligoStellarComp luminosities="1, 1">
+                        <geometry type="Geometry">
+                            <ExpDiskGeometry scaleLength="3000 pc" scaleHeight="300 pc" minRadius="0 pc" maxRadius="0 pc" maxZ="0 pc"/>
+                        </geometry>
+                    </OligoStellarComp>
+                </components>
+            </StellarSystem>
+        </stellarSystem>
+        <dustSystem type="OligoDustSystem">
+            <OligoDustSystem numSamples="10" writeConvergence="false" writeDensity="false" writeDepthMap="false" writeQuality="false" writeCellProperties="false" writeCellsCrossed="false" writeStellarDensity="false" writeMeanIntensity="false">
+                <dustDistribution type="DustDistribution">
+                    <CompDustDistribution>
+                        <components type="DustComp">
+                            <DustComp>
+                                <geometry type="Geometry">
+                                    <ExpDiskGeometry scaleLength="4000 pc" scaleHeight="200 pc" minRadius="0 pc" maxRadius="0 pc" maxZ="0 pc"/>
+                                </geometry>
+                                <mix type="DustMix">
+                                    [DUSTMIX]
+                                </mix>
+                                <normalization type="DustCompNormalization">
+                                    <FaceOnDustCompNormalization wavelength="0.55 micron" opticalDepth="1"/>
+                                </normalization>
+                            </DustComp>
+                        </components>
+                    </CompDustDistribution>
+                </dustDistribution>
+                <dustGrid type="DustGrid">
+                    [DUSTGRID]
+                </dustGrid>
+            </OligoDustSystem>
+        </dustSystem>
+        <instrumentSystem type="InstrumentSystem">
+            <InstrumentSystem>
+                <instruments type="Instrument">
+                    <FullInstrument instrumentName="full" distance="10 Mpc" inclination="60 deg" azimuth="0 deg" positionAngle="0 deg" fieldOfViewX="40000 pc" numPixelsX="200" centerX="0 pc" fieldOfViewY="40000 pc" numPixelsY="200" centerY="0 pc" numScatteringLevels="0"/>
+                </instruments>
+            </InstrumentSystem>
+        </instrumentSystem>
+    </OligoMonteCarloSimulation>
+</skirt-simulation-hierarchy>
+)";
+
+    // the ski content for the panchromatic model, with a placeholder for the number of photon packages
+    const char* panTemplate = R"(<?xml version="1.0" encoding="UTF-8"?>
+<skirt-simulation-hierarchy type="MonteCarloSimulation" format="8" producer="skirtbench">
+    <PanMonteCarloSimulation numPackages="[NUMPACKAGES]" minWeightReduction="1e4" minScattEvents="0" scattBias="0.5" continuousScattering="false">
+        <random type="Random">
+            <Random seed="4357"/>
+        </random>
+        <units type="Units">
+            <ExtragalacticUnits/>
+        </units>
+        <wavelengthGrid type="PanWavelengthGrid">
+            <LogWavelengthGrid minWavelength="0.1 micron" maxWavelength="1000 micron" numWavelengths="30"/>
+        </wavelengthGrid>
+        <stellarSystem type="StellarSystem">
+            <StellarSystem emissionBias="0.5">
+                <components type="StellarComp">
+                    <PanStellarComp>
+                        <geometry type="Geometry">
+                            <ExpDiskGeometry scaleLength="4000 pc" scaleHeight="400 pc" minRadius="0 pc" maxRadius="0 pc" maxZ="0 pc"/>
+                        </geometry>
+                        <sed type="StellarSED">
+                            <SunSED/>
+                        </sed>
+                        <normalization type="StellarCompNormalization">
+                            <BolLuminosityStellarCompNormalization luminosity="1e10 Lsun"/>
+                        </normalization>
+                    </PanStellarComp>
+                </components>
+            </StellarSystem>
+        </stellarSystem>
+        <dustSystem type="PanDustSystem">
+            <PanDustSystem numSamples="10" writeConvergence="false" writeDensity="false" writeDepthMap="false" writeQuality="false" writeCellProperties="false" writeCellsCrossed="false" writeStellarDensity="false" includeSelfAbsorption="true" writeTemperature="false" writeEmissivity="false" writeISRF="false" writeSpectralAbsorption="false">
+                <dustDistribution type="DustDistribution">
+                    <CompDustDistribution>
+                        <components type="DustComp">
+                            <DustComp>
+                                <geometry type="Geometry">
+                                    <ExpDiskGeometry scaleLength="4000 pc" scaleHeight="200 pc" minRadius="0 pc" maxRadius="0 pc" maxZ="0 pc"/>
+                                </geometry>
+                                <mix type="DustMix">
+                                    <ZubkoDustMix numGraphiteSizes="3" numSilicateSizes="3" numPAHSizes="3"/>
+                                </mix>
+                                <normalization type="DustCompNormalization">
+                                    <DustMassDustCompNormalization dustMass="5e7 Msun"/>
+                                </normalization>
+                            </DustComp>
+                        </components>
+                    </CompDustDistribution>
+                </dustDistribution>
+                <dustGrid type="DustGrid">
+                    <Cylinder2DDustGrid writeGrid="false" maxRadius="20000 pc" minZ="-2000 pc" maxZ="2000 pc">
+                        <meshRadial type="Mesh">
+                            <LinMesh numBins="30"/>
+                        </meshRadial>
+                        <meshZ type="MoveableMesh">
+                            <LinMesh numBins="30"/>
+                        </meshZ>
+                    </Cylinder2DDustGrid>
+                </dustGrid>
+                <dustEmissivity type="DustEmissivity">
+                    <TransientDustEmissivity/>
+                </dustEmissivity>
+                <dustLib type="DustLib">
+                    <Dim2DustLib numTemperatures="10" numWavelengths="6"/>
+                </dustLib>
+            </PanDustSystem>
+        </dustSystem>
+        <instrumentSystem type="InstrumentSystem">
+            <InstrumentSystem>
+                <instruments type="Instrument">
+                    <SEDInstrument instrumentName="sed" distance="10 Mpc" inclination="60 deg" azimuth="0 deg" positionAngle="0 deg"/>
+                    <FrameInstrument instrumentName="frame" distance="10 Mpc" inclination="60 deg" azimuth="0 deg" positionAngle="0 deg" fieldOfViewX="40000 pc" numPixelsX="100" centerX="0 pc" fieldOfViewY="40000 pc" numPixelsY="100" centerY="0 pc"/>
+                </instruments>
+            </InstrumentSystem>
+        </instrumentSystem>
+    </PanMonteCarloSimulation>
+</skirt-simulation-hierarchy>
+)";
+
+    // the spatial extent shared by all box dust grids
+    const char* boxExtent = R"(minX="-20000 pc" maxX="20000 pc" minY="-20000 pc" maxY="20000 pc" minZ="-2000 pc" maxZ="2000 pc")";
+
+    // the dust grids
+    const char* octTreeGrid = R"(<OctTreeDustGrid writeGrid="false" [EXTENT] minLevel="3" maxLevel="8" searchMethod="Neighbor" numSamples="100" maxOpticalDepth="0" maxMassFraction="1e-4" maxDensityDispersion="0" writeTree="false" useBarycentric="false"/>)";
+    const char* voronoiGrid = R"(<VoronoiDustGrid writeGrid="false" [EXTENT] numParticles="5000" distribution="Uniform"/>)";
+    const char* cartesianGrid = R"(<CartesianDustGrid writeGrid="false" [EXTENT]>
+                        <meshX type="MoveableMesh">
+                            <LinMesh numBins="100"/>
+                        </meshX>
+                        <meshY type="MoveableMesh">
+                            <LinMesh numBins="100"/>
+                        </meshY>
+                        <meshZ type="MoveableMesh">
+                            <LinMesh numBins="20"/>
+                        </meshZ>
+                    </CartesianDustGrid>)";
+
+    // the dust mixes
+    const char* interstellarMix = R"(<InterstellarDustMix/>)";
+    const char* electronMix = R"(<ElectronDustMix addCircularPolarization="true"/>)";
+
+    // returns the oligochromatic ski content with the specified dust grid and dust mix
+    string oligoContent(string grid, string mix)
+    {
+        string content = StringUtils::replace(oligoTemplate, "[DUSTGRID]", grid);
+        content = StringUtils::replace(content, "[DUSTMIX]", mix);
+        return StringUtils::replace(content, "[EXTENT]", boxExtent);
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
+vector<string> BenchmarkModels::names()
+{
+    return vector<string>{ "octtree", "voronoi", "cartesian", "polarized", "panchromatic" };
+}
+
+////////////////////////////////////////////////////////////////////
+
+string BenchmarkModels::description(string name)
+{
+    if (name=="octtree") return "exponential disk in an octtree dust grid";
+    if (name=="voronoi") return "exponential disk in a Voronoi dust grid on uniform random sites";
+    if (name=="cartesian") return "exponential disk in a cartesian dust grid";
+    if (name=="polarized") return "exponential disk of polarizing electrons in a cartesian dust grid";
+    if (name=="panchromatic") return "exponential disk with transient dust emission and self-absorption";
+    throw FATALERROR("Unknown benchmark model: " + name);
+}
+
+////////////////////////////////////////////////////////////////////
+
+string BenchmarkModels::skiContent(string name, double packageFactor)
+{
+    string content;
+    double numPackages = 2e4;
+    if (name=="octtree") content = oligoContent(octTreeGrid, interstellarMix);
+    else if (name=="voronoi") content = oligoContent(voronoiGrid, interstellarMix);
+    else if (name=="cartesian") content = oligoContent(cartesianGrid, interstellarMix);
+    else if (name=="polarized") content = oligoContent(cartesianGrid, electronMix);
+    else if (name=="panchromatic")
+    {
+        content = panTemplate;
+        numPackages = 2e3;
+    }
+    else throw FATALERROR("Unknown benchmark model: " + name);
+
+    numPackages = max(1., round(numPackages*packageFactor));
+    return StringUtils::replace(content, "[NUMPACKAGES]", StringUtils::toString(numPackages, 'd'));
+}
+
+////////////////////////////////////////////////////////////////////
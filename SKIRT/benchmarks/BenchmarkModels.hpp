@@ -0,0 +1,47 @@
+/*//////////////////////////////////////////////////////////////////
+////     The SKIRT project -- advanced radiative transfer       ////
+////       © Astronomical Observatory, Ghent University         ////
+///////////////////////////////////////////////////////////////// */
+
+#ifndef BENCHMARKMODELS_HPP
+#define BENCHMARKMODELS_HPP
+
+#include "Basics.hpp"
+
+////////////////////////////////////////////////////////////////////
+
+/** This class offers the synthetic reference models used by the SKIRT performance benchmarks.
+    Each model is identified by a short name and is defined by ski file content embedded in the
+    source code, so that the benchmarks do not depend on any external data (other than the
+    resources built into SKIRT itself). The models are intentionally small so that a complete
+    benchmark run finishes within minutes; the number of photon packages can be scaled by the
+    caller. The available models are:
+
+    - \c octtree: an exponential disk in an octtree dust grid with 2 wavelengths.
+    - \c voronoi: the same disk in a Voronoi dust grid with uniformly distributed random sites.
+    - \c cartesian: the same disk in a regular cartesian dust grid.
+    - \c polarized: the same disk and cartesian grid, filled with a polarizing electron "dust" mix.
+    - \c panchromatic: an exponential disk with transient dust emission and self-absorption in a
+      2D cylindrical dust grid.
+
+    With the exception of the panchromatic model, the models record the photon packages with a
+    FullInstrument so that all detection paths are exercised. */
+class BenchmarkModels final
+{
+public:
+    /** This function returns the names of the available models, in the order in which they should
+        be benchmarked. */
+    static vector<string> names();
+
+    /** This function returns a one-line description of the model with the specified name. */
+    static string description(string name);
+
+    /** This function returns the ski file content for the model with the specified name, with the
+        number of photon packages per wavelength scaled by the specified factor. If there is no
+        model with the specified name, the function throws a fatal error. */
+    static string skiContent(string name, double packageFactor = 1.);
+};
+
+////////////////////////////////////////////////////////////////////
+
+#endif
@@ -329,6 +329,7 @@ void AdaptiveMesh::path(DustGridPath* path) const
             wall = (kz<0.0) ? AdaptiveMeshNode::BOTTOM : AdaptiveMeshNode::TOP;
         }
         path->addSegment(node->cellIndex(), ds);
+        if (path->isComplete()) return;
         r += (ds+_eps)*(path->direction());
 
         // try the most likely neighbor of the current node, and use top-down search as a fall-back
@@ -6,6 +6,7 @@
 #include "AllSkyInstrument.hpp"
 #include "FatalError.hpp"
 #include "FITSInOut.hpp"
+#include "InstrumentSystem.hpp"
 #include "LockFree.hpp"
 #include "Log.hpp"
 #include "PhotonPackage.hpp"
@@ -155,6 +156,13 @@ void AllSkyInstrument::detect(PhotonPackage* pp)
 
 ////////////////////////////////////////////////////////////////////
 
+void AllSkyInstrument::startCommunication()
+{
+    _ftotv.startCompleteCube();
+}
+
+////////////////////////////////////////////////////////////////////
+
 void AllSkyInstrument::write()
 {
     Units* units = find<Units>();
@@ -175,12 +183,17 @@ void AllSkyInstrument::write()
         (*completeCube)[m] = units->osurfacebrightness(lambda, (*completeCube)[m]*front/dlambda);
     }
 
-    // Write a FITS file containing the data cube
+    // Schedule writing a FITS file containing the data cube, concurrently with the files of other instruments
     string filename = instrumentName() + "_total";
     string description = "total flux";
-    FITSInOut::write(this, description, filename, *completeCube, _Nx, _Ny, Nlambda,
-                     units->olength(_s), units->olength(_s), 0., 0.,
-                     units->usurfacebrightness(), units->ulength());
+    int Nx = _Nx, Ny = _Ny;
+    double size = units->olength(_s);
+    string usb = units->usurfacebrightness(), ulength = units->ulength();
+    find<InstrumentSystem>()->scheduleOutput([=]()
+    {
+        FITSInOut::write(this, description, filename, *completeCube, Nx, Ny, Nlambda, size, size, 0., 0.,
+                         usb, ulength);
+    });
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -98,6 +98,9 @@ protected:
     /** This function simulates the detection of a photon package by the instrument. */
     void detect(PhotonPackage* pp) override;
 
+    /** This function starts the summation of the data cube across processes. */
+    void startCommunication() override;
+
     /** This function calibrates and outputs the instrument data. */
     void write() override;
 
@@ -184,6 +184,7 @@ void CartesianDustGrid::path(DustGridPath* path) const
         {
             ds = dsx;
             path->addSegment(m, ds);
+            if (path->isComplete()) return;
             i += (kx<0.0) ? -1 : 1;
             if (i>=_Nx || i<0) return;
             else
@@ -197,6 +198,7 @@ void CartesianDustGrid::path(DustGridPath* path) const
         {
             ds = dsy;
             path->addSegment(m, ds);
+            if (path->isComplete()) return;
             j += (ky<0.0) ? -1 : 1;
             if (j>=_Ny || j<0) return;
             else
@@ -210,6 +212,7 @@ void CartesianDustGrid::path(DustGridPath* path) const
         {
             ds = dsz;
             path->addSegment(m, ds);
+            if (path->isComplete()) return;
             k += (kz<0.0) ? -1 : 1;
             if (k>=_Nz || k<0) return;
             else
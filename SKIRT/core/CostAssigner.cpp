@@ -0,0 +1,89 @@
+/*//////////////////////////////////////////////////////////////////
+////     The SKIRT project -- advanced radiative transfer       ////
+////       © Astronomical Observatory, Ghent University         ////
+///////////////////////////////////////////////////////////////// */
+
+#include "CostAssigner.hpp"
+#include "FatalError.hpp"
+#include "PeerToPeerCommunicator.hpp"
+#include <numeric>
+
+////////////////////////////////////////////////////////////////////
+
+CostAssigner::CostAssigner(const Array& costv, SimulationItem* parent)
+    : ProcessAssigner(costv.size(), parent)
+{
+    if (!communicator()) throw FATALERROR("Could not find an object of type PeerToPeerCommunicator in the simulation hierarchy");
+    size_t size = costv.size();
+    int Nprocs = communicator()->size();
+    int rank = communicator()->rank();
+
+    // Sort the indices in order of decreasing cost, keeping the original order for equal costs
+    vector<size_t> order(size);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&costv](size_t i, size_t j) { return costv[i] > costv[j]; });
+
+    // Assign each index to the process with the smallest load so far (and the fewest indices in case of a tie)
+    _assignment.resize(size);
+    vector<double> loadv(Nprocs, 0.);
+    vector<size_t> countv(Nprocs, 0);
+    for (size_t i : order)
+    {
+        int best = 0;
+        for (int r = 1; r < Nprocs; r++)
+        {
+            if (loadv[r] < loadv[best] || (loadv[r] == loadv[best] && countv[r] < countv[best])) best = r;
+        }
+        _assignment[i] = best;
+        loadv[best] += max(0., costv[i]);
+        countv[best]++;
+    }
+
+    // Determine the values assigned to this process
+    _relative.resize(size, 0);
+    for (size_t j = 0; j < size; j++)
+    {
+        if (_assignment[j] == rank)
+        {
+            _relative[j] = _values.size();
+            _values.push_back(j);
+        }
+    }
+
+    // Determine the expected imbalance factor
+    double total = std::accumulate(loadv.begin(), loadv.end(), 0.);
+    if (total > 0) _imbalance = *std::max_element(loadv.begin(), loadv.end()) * Nprocs / total;
+
+    // Set the number of values assigned to this process
+    setAssigned(_values.size());
+}
+
+////////////////////////////////////////////////////////////////////
+
+size_t CostAssigner::absoluteIndex(size_t relativeIndex) const
+{
+    return _values[relativeIndex];
+}
+
+////////////////////////////////////////////////////////////////////
+
+size_t CostAssigner::relativeIndex(size_t absoluteIndex) const
+{
+    return _relative[absoluteIndex];
+}
+
+////////////////////////////////////////////////////////////////////
+
+int CostAssigner::rankForIndex(size_t index) const
+{
+    return _assignment[index];
+}
+
+////////////////////////////////////////////////////////////////////
+
+double CostAssigner::expectedImbalance() const
+{
+    return _imbalance;
+}
+
+////////////////////////////////////////////////////////////////////
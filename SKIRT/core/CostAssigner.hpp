@@ -0,0 +1,79 @@
+/*//////////////////////////////////////////////////////////////////
+////     The SKIRT project -- advanced radiative transfer       ////
+////       © Astronomical Observatory, Ghent University         ////
+///////////////////////////////////////////////////////////////// */
+
+#ifndef COSTASSIGNER_HPP
+#define COSTASSIGNER_HPP
+
+#include "ProcessAssigner.hpp"
+#include "Array.hpp"
+
+//////////////////////////////////////////////////////////////////////
+
+/** The CostAssigner class is a subclass of the ProcessAssigner class, representing objects that
+    assign work to different processes. An object of the CostAssigner class distributes the work
+    amongst the different processes so that the expected cost (e.g. the wall time) of the work
+    assigned to each process is approximately the same, based on an estimate of the cost for each
+    part of the work provided by the caller. This is useful if the cost varies substantially
+    between the different parts of the work in a way that is not captured by a simple pattern, for
+    example when the CPU time needed to simulate the life cycle of photon packages varies by orders
+    of magnitude with wavelength. The assignment uses the greedy "longest processing time first"
+    scheme: the parts of work are considered in order of decreasing cost, and each part is assigned
+    to the process with the smallest total cost assigned so far. Because the algorithm is
+    deterministic, every process arrives at the same assignment without any communication, as long
+    as all processes pass the same cost estimates. */
+class CostAssigner : public ProcessAssigner
+{
+    //============= Construction - Setup - Destruction =============
+
+public:
+    /** This constructor can be invoked by SKIRT classes that wish to hard-code the creation of a
+        new ProcessAssigner object of this type. Before the constructor returns, the newly created
+        object is hooked up as a child to the specified parent in the simulation hierarchy (so it
+        will automatically be deleted) and the setup of the ProcessAssigner base class is invoked.
+        The first argument specifies the estimated cost for each part of work; its size determines
+        the number of parts of work \f$n\f$. Negative cost estimates are treated as zero. When
+        several processes have the same total cost so far, the part of work is assigned to the
+        process with the fewest parts, so that each process receives at least one part of work if
+        \f$n\f$ is at least the number of processes. The constructor determines the rank of the
+        process assigned to each part of work (stored in the _assignment vector), and the list of
+        absolute indices assigned to this process in increasing order (stored in the _values
+        vector). */
+    explicit CostAssigner(const Array& costv, SimulationItem* parent);
+
+    //======================== Other Functions =======================
+
+public:
+    /** This function takes the relative index of a certain part of the work assigned to this process
+        as an argument and returns the absolute index of that part, by looking up the value in the
+        _values list. */
+    size_t absoluteIndex(size_t relativeIndex) const override;
+
+    /** This function takes the absolute index of a certain part of the work as an argument and
+        returns the relative index of that part for this process, by looking up the value in the
+        _relative list. */
+    size_t relativeIndex(size_t absoluteIndex) const override;
+
+    /** This function returns the rank of the process that is assigned to a certain part of the work.
+        This part is identified by its absolute index, passed to this function as an argument. This is
+        done by simply looking up the corresponding rank in the _assignment vector. */
+    int rankForIndex(size_t index) const override;
+
+    /** This function returns the ratio of the largest total estimated cost assigned to a single
+        process to the mean total estimated cost per process, according to the cost estimates
+        passed to the constructor. A value of one indicates perfect balance. */
+    double expectedImbalance() const;
+
+    //======================== Data Members ========================
+
+private:
+    vector<int> _assignment;   // for each value, this vector defines the rank of the assigned process
+    vector<size_t> _values;    // a list of the values assigned to this process, in increasing order
+    vector<size_t> _relative;  // for each value assigned to this process, the relative index
+    double _imbalance{1.};     // the expected imbalance factor
+};
+
+//////////////////////////////////////////////////////////////////////
+
+#endif
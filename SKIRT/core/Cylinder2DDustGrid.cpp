@@ -186,6 +186,7 @@ void Cylinder2DDustGrid::path(DustGridPath* path) const
                 {
                     ds = dsq;
                     path->addSegment(m, ds);
+                    if (path->isComplete()) return;
                     i--;
                     q = qN;
                     z += kz*ds;
@@ -196,6 +197,7 @@ void Cylinder2DDustGrid::path(DustGridPath* path) const
                 {
                     ds = dsz;
                     path->addSegment(m, ds);
+                    if (path->isComplete()) return;
                     k++;
                     if (k>=_Nz) return;
                     else
@@ -218,6 +220,7 @@ void Cylinder2DDustGrid::path(DustGridPath* path) const
             {
                 ds = dsq;
                 path->addSegment(m, ds);
+                if (path->isComplete()) return;
                 i++;
                 if (i>=_NR) return;
                 else
@@ -232,6 +235,7 @@ void Cylinder2DDustGrid::path(DustGridPath* path) const
             {
                 ds = dsz;
                 path->addSegment(m, ds);
+                if (path->isComplete()) return;
                 k++;
                 if (k>=_Nz) return;
                 else
@@ -263,6 +267,7 @@ void Cylinder2DDustGrid::path(DustGridPath* path) const
                 {
                     ds = dsq;
                     path->addSegment(m, ds);
+                    if (path->isComplete()) return;
                     i--;
                     q = qN;
                     z += kz*ds;
@@ -273,6 +278,7 @@ void Cylinder2DDustGrid::path(DustGridPath* path) const
                 {
                     ds = dsz;
                     path->addSegment(m, ds);
+                    if (path->isComplete()) return;
                     k--;
                     if (k<0) return;
                     else
@@ -295,6 +301,7 @@ void Cylinder2DDustGrid::path(DustGridPath* path) const
             {
                 ds = dsq;
                 path->addSegment(m, ds);
+                if (path->isComplete()) return;
                 i++;
                 if (i>=_NR) return;
                 else
@@ -309,6 +316,7 @@ void Cylinder2DDustGrid::path(DustGridPath* path) const
             {
                 ds = dsz;
                 path->addSegment(m, ds);
+                if (path->isComplete()) return;
                 k--;
                 if (k<0) return;
                 else
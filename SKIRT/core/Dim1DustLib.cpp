@@ -7,8 +7,11 @@
 #include "ISRF.hpp"
 #include "Log.hpp"
 #include "PanDustSystem.hpp"
+#include "Parallel.hpp"
+#include "ParallelFactory.hpp"
 #include "StringUtils.hpp"
 #include "WavelengthGrid.hpp"
+#include <mutex>
 
 ////////////////////////////////////////////////////////////////////
 
@@ -19,36 +22,95 @@ int Dim1DustLib::numEntries() const
 
 ////////////////////////////////////////////////////////////////////
 
+namespace
+{
+    // the number of dust cells handled by a single invocation of the parallel loop body
+    const int Nchunk = 1000;
+
+    // Private class to calculate the strength of the radiation field for all dust cells in parallel
+    class FieldStrengthCalculator : public ParallelTarget
+    {
+    private:
+        // data members initialized in constructor
+        const PanDustSystem* _ds;
+        double _JtotMW;
+        int _Ncells;
+
+        // results, protected by a mutex when combined across threads
+        vector<double>& _Ucellv;
+        double _Umin{DBL_MAX};
+        double _Umax{0.0};
+        std::mutex _mutex;
+
+    public:
+        // constructor
+        FieldStrengthCalculator(const PanDustSystem* ds, vector<double>& Ucellv)
+            : _ds(ds), _Ucellv(Ucellv)
+        {
+            WavelengthGrid* lambdagrid = ds->find<WavelengthGrid>();
+            _JtotMW = ( ISRF::mathis(lambdagrid) * lambdagrid->dlambdav() ).sum();
+            _Ncells = ds->numCells();
+        }
+
+        // returns the number of chunks to be handled by the parallel loop
+        size_t numChunks() const { return (_Ncells + Nchunk - 1) / Nchunk; }
+
+        // returns the smallest and largest field strengths found
+        double Umin() const { return _Umin; }
+        double Umax() const { return _Umax; }
+
+        // the parallized loop body; calculates the results for a chunk of dust cells
+        void body(size_t chunk)
+        {
+            // keep track of the extremes for this chunk to minimize synchronization
+            double chunkUmin = DBL_MAX;
+            double chunkUmax = 0.0;
+
+            int mbegin = chunk*Nchunk;
+            int mend = min(mbegin+Nchunk, _Ncells);
+            for (int m=mbegin; m<mend; m++)
+            {
+                double U = _ds->bolometricMeanIntensity(m)/_JtotMW;
+                // ignore cells with extremely small radiation fields (compared to the average in the Milky Way)
+                // to avoid wasting library grid points on fields that won't change simulation results anyway
+                if (U > 1e-6)
+                {
+                    _Ucellv[m] = U;
+                    chunkUmin = min(chunkUmin,U);
+                    chunkUmax = max(chunkUmax,U);
+                }
+            }
+
+            // combine the extremes for this chunk with the overall results
+            std::unique_lock<std::mutex> lock(_mutex);
+            _Umin = min(_Umin,chunkUmin);
+            _Umax = max(_Umax,chunkUmax);
+        }
+    };
+}
+
+////////////////////////////////////////////////////////////////////
+
 vector<int> Dim1DustLib::mapping() const
 {
-    // get basic information about the wavelength grid and the dust system
-    WavelengthGrid* lambdagrid = find<WavelengthGrid>();
+    // get basic information about the dust system
     PanDustSystem* ds = find<PanDustSystem>();
     int Ncells = ds->numCells();
 
-    // calculate the properties of the ISRF in all cells of the dust system;
+    // calculate the properties of the ISRF in all cells of the dust system (in parallel);
     // remember the minimum and maximum values of the strength of the ISRF
-    double JtotMW = ( ISRF::mathis(lambdagrid) * lambdagrid->dlambdav() ).sum();
-    double Umin = DBL_MAX;
-    double Umax = 0.0;
     vector<double> Ucellv(Ncells);
-    for (int m=0; m<Ncells; m++)
-    {
-        double Jtot = ( ds->meanIntensity(m) * lambdagrid->dlambdav() ).sum();
-        double U = Jtot/JtotMW;
-        // ignore cells with extremely small radiation fields (compared to the average in the Milky Way)
-        // to avoid wasting library grid points on fields that won't change simulation results anyway
-        if (U > 1e-6)
-        {
-            Ucellv[m] = U;
-            Umin = min(Umin,U);
-            Umax = max(Umax,U);
-        }
-    }
+    FieldStrengthCalculator calc(ds, Ucellv);
+    find<ParallelFactory>()->parallel()->call(&calc, calc.numChunks());
+    double Umin = calc.Umin();
+    double Umax = calc.Umax();
     find<Log>()->info("ISRF strengths vary from U = " + StringUtils::toString(Umin)
                                          + " to U = " + StringUtils::toString(Umax) + ".");
 
     // determine for every dust cell m the corresponding library entry n
+    double logUmin = log10(Umin);
+    double logUmax = log10(Umax);
+    double dlogU = (logUmax-logUmin)/_numFieldStrengths;
     vector<int> nv(Ncells);
     for (int m=0; m<Ncells; m++)
     {
@@ -56,9 +118,6 @@ vector<int> Dim1DustLib::mapping() const
         if (U>0.0)
         {
             double logU = log10(U);
-            double logUmin = log10(Umin);
-            double logUmax = log10(Umax);
-            double dlogU = (logUmax-logUmin)/_numFieldStrengths;
             nv[m] = max(0, min(_numFieldStrengths-1, static_cast<int>((logU-logUmin)/dlogU) ));
         }
         else
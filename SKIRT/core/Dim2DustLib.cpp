@@ -7,9 +7,11 @@
 #include "DustMix.hpp"
 #include "Log.hpp"
 #include "PanDustSystem.hpp"
+#include "Parallel.hpp"
+#include "ParallelFactory.hpp"
 #include "StringUtils.hpp"
 #include "Units.hpp"
-#include "WavelengthGrid.hpp"
+#include <mutex>
 
 ////////////////////////////////////////////////////////////////////
 
@@ -20,57 +22,115 @@ int Dim2DustLib::numEntries() const
 
 ////////////////////////////////////////////////////////////////////
 
+namespace
+{
+    // the number of dust cells handled by a single invocation of the parallel loop body
+    const int Nchunk = 1000;
+
+    // Private class to calculate the mean temperature and mean wavelength for all dust cells in parallel
+    class MeanFieldCalculator : public ParallelTarget
+    {
+    private:
+        // data members initialized in constructor
+        const PanDustSystem* _ds;
+        int _Ncells;
+        int _Ncomp;
+
+        // results, protected by a mutex when combined across threads
+        Array& _Tmeanv;
+        Array& _lambdameanv;
+        double _Tmin{DBL_MAX};
+        double _Tmax{0.0};
+        double _lambdamin{DBL_MAX};
+        double _lambdamax{0.0};
+        std::mutex _mutex;
+
+    public:
+        // constructor
+        MeanFieldCalculator(const PanDustSystem* ds, Array& Tmeanv, Array& lambdameanv)
+            : _ds(ds), _Tmeanv(Tmeanv), _lambdameanv(lambdameanv)
+        {
+            _Ncells = ds->numCells();
+            _Ncomp = ds->numComponents();
+        }
+
+        // returns the number of chunks to be handled by the parallel loop
+        size_t numChunks() const { return (_Ncells + Nchunk - 1) / Nchunk; }
+
+        // return the extremes of the mean temperature and mean wavelength found
+        double Tmin() const { return _Tmin; }
+        double Tmax() const { return _Tmax; }
+        double lambdamin() const { return _lambdamin; }
+        double lambdamax() const { return _lambdamax; }
+
+        // the parallized loop body; calculates the results for a chunk of dust cells
+        void body(size_t chunk)
+        {
+            // keep track of the extremes for this chunk to minimize synchronization
+            double chunkTmin = DBL_MAX;
+            double chunkTmax = 0.0;
+            double chunklambdamin = DBL_MAX;
+            double chunklambdamax = 0.0;
+
+            int mbegin = chunk*Nchunk;
+            int mend = min(mbegin+Nchunk, _Ncells);
+            for (int m=mbegin; m<mend; m++)
+            {
+                if (_ds->absorbedLuminosity(m) > 0.0)
+                {
+                    double sumrho = 0.;
+                    double Tmean = 0.;
+                    double lambdamean = 0.;
+                    for (int h=0; h<_Ncomp; h++)
+                    {
+                        double rho = _ds->density(m,h);
+                        Tmean += rho * _ds->mix(h)->invplanckabs(_ds->planckabs(m,h));
+                        lambdamean += rho * _ds->meanAbsorbedWavelength(m,h);
+                        sumrho += rho;
+                    }
+                    Tmean /= sumrho;
+                    lambdamean /= sumrho;
+                    _Tmeanv[m] = Tmean;
+                    _lambdameanv[m] = lambdamean;
+
+                    chunkTmin = min(chunkTmin,Tmean);
+                    chunkTmax = max(chunkTmax,Tmean);
+                    chunklambdamin = min(chunklambdamin,lambdamean);
+                    chunklambdamax = max(chunklambdamax,lambdamean);
+                }
+            }
+
+            // combine the extremes for this chunk with the overall results
+            std::unique_lock<std::mutex> lock(_mutex);
+            _Tmin = min(_Tmin,chunkTmin);
+            _Tmax = max(_Tmax,chunkTmax);
+            _lambdamin = min(_lambdamin,chunklambdamin);
+            _lambdamax = max(_lambdamax,chunklambdamax);
+        }
+    };
+}
+
+////////////////////////////////////////////////////////////////////
+
 vector<int> Dim2DustLib::mapping() const
 {
-    // get basic information about the wavelength grid and the dust system
-    WavelengthGrid* lambdagrid = find<WavelengthGrid>();
+    // get basic information about the dust system
     PanDustSystem* ds = find<PanDustSystem>();
-    int Nlambda = lambdagrid->numWavelengths();
     int Ncells = ds->numCells();
-    int Ncomp = ds->numComponents();
     Log* log = find<Log>();
     Units* units = find<Units>();
 
-    // calculate the properties of the ISRF in all cells of the dust system;
+    // calculate the properties of the ISRF in all cells of the dust system (in parallel);
     // determine the minimum and maximum values of the mean temperature and mean wavelength
-    double Tmin = DBL_MAX;
-    double Tmax = 0.0;
-    double lambdamin = DBL_MAX;
-    double lambdamax = 0.0;
     Array Tmeanv(Ncells);
     Array lambdameanv(Ncells);
-    for (int m=0; m<Ncells; m++)
-    {
-        if (ds->absorbedLuminosity(m) > 0.0)
-        {
-            const Array& Jv = ds->meanIntensity(m);
-            double sumrho = 0.;
-            for (int h=0; h<Ncomp; h++)
-            {
-                double sum0 = 0.0;
-                double sum1 = 0.0;
-                for (int ell=0; ell<Nlambda; ell++)
-                {
-                    double lambda = lambdagrid->lambda(ell);
-                    double dlambda = lambdagrid->dlambda(ell);
-                    double sigmaJ = ds->mix(h)->sigmaabs(ell) * Jv[ell];
-                    sum0 += sigmaJ * dlambda;
-                    sum1 += sigmaJ * lambda * dlambda;
-                }
-                double rho = ds->density(m,h);
-                Tmeanv[m] += rho * ds->mix(h)->invplanckabs(sum0);
-                lambdameanv[m] += rho * (sum1/sum0);
-                sumrho += rho;
-            }
-            Tmeanv[m] /= sumrho;
-            lambdameanv[m] /= sumrho;
+    MeanFieldCalculator calc(ds, Tmeanv, lambdameanv);
+    find<ParallelFactory>()->parallel()->call(&calc, calc.numChunks());
+    double Tmin = calc.Tmin();
+    double Tmax = calc.Tmax();
+    double lambdamin = calc.lambdamin();
+    double lambdamax = calc.lambdamax();
 
-            Tmin = min(Tmin,Tmeanv[m]);
-            Tmax = max(Tmax,Tmeanv[m]);
-            lambdamin = min(lambdamin,lambdameanv[m]);
-            lambdamax = max(lambdamax,lambdameanv[m]);
-        }
-    }
     log->info("Temperatures vary"
               " from T = " + StringUtils::toString(units->otemperature(Tmin)) + " " + units->utemperature() +
               " to T = " + StringUtils::toString(units->otemperature(Tmax)) + " " + units->utemperature() + ".");
@@ -79,20 +139,20 @@ vector<int> Dim2DustLib::mapping() const
               " to λ = " + StringUtils::toString(units->owavelength(lambdamax)) + " " + units->uwavelength() + ".");
 
     // determine for every dust cell m the corresponding library entry n
+    double dT = (Tmax-Tmin)/_numTemperatures;
+    double loglambdamin = log10(lambdamin);
+    double loglambdamax = log10(lambdamax);
+    double dloglambdamean = (loglambdamax-loglambdamin)/_numWavelengths;
     vector<int> nv(Ncells);
     for (int m=0; m<Ncells; m++)
     {
         if (Tmeanv[m] > 0.0 && lambdameanv[m] > 0.0)
         {
             double T = Tmeanv[m];
-            double dT = (Tmax-Tmin)/_numTemperatures;
             int i = max(0, min(_numTemperatures-1, static_cast<int>((T-Tmin)/dT) ));
 
             double lambdamean = lambdameanv[m];
             double loglambdamean = log10(lambdamean);
-            double loglambdamin = log10(lambdamin);
-            double loglambdamax = log10(lambdamax);
-            double dloglambdamean = (loglambdamax-loglambdamin)/_numWavelengths;
             int j = max(0, min(_numWavelengths-1, static_cast<int>((loglambdamean-loglambdamin)/dloglambdamean) ));
 
             nv[m] = i + _numTemperatures*j;
@@ -7,7 +7,7 @@
 #define DUSTEMISSIVITY_HPP
 
 #include "SimulationItem.hpp"
-#include "Array.hpp"
+#include "ArrayTable.hpp"
 class DustMix;
 
 //////////////////////////////////////////////////////////////////////
@@ -30,6 +30,15 @@ public:
         \f$\ell\f$ for a dust mix of the specified type residing in the specified mean radiation
         field \f$J_\ell\f$, assuming the simulation's wavelength grid. */
     virtual Array emissivity(const DustMix* mix, const Array& Jv) const = 0;
+
+    /** This function calculates the dust emissivities for a dust mix of the specified type
+        residing in each of a batch of mean radiation fields. The radiation fields are specified as
+        the rows of the table \em Jvv, indexed on field and wavelength index. The function resizes
+        the table \em evv to the same dimensions and stores the emissivity for each field in the
+        corresponding row. The default implementation simply calls the emissivity() function for
+        each field. Subclasses for which the calculation can be organized more efficiently for many
+        radiation fields at once can override this function. */
+    virtual void emissivities(const DustMix* mix, const ArrayTable<2>& Jvv, ArrayTable<2>& evv) const;
 };
 
 ////////////////////////////////////////////////////////////////////
@@ -4,6 +4,7 @@
 ///////////////////////////////////////////////////////////////// */
 
 #include "DustGrid.hpp"
+#include "DustGridPath.hpp"
 #include "DustGridPlotFile.hpp"
 #include "FatalError.hpp"
 #include "MonteCarloSimulation.hpp"
@@ -74,6 +75,16 @@ double DustGrid::weight(int m) const
 
 //////////////////////////////////////////////////////////////////////
 
+double DustGrid::opticalDepth(DustGridPath* path, const std::function<double(int)>& kapparho,
+                              double distance, double taumax) const
+{
+    path->beginAccumulation(&kapparho, distance, taumax);
+    this->path(path);
+    return path->endAccumulation();
+}
+
+//////////////////////////////////////////////////////////////////////
+
 void DustGrid::write_xy(DustGridPlotFile* /*outfile*/) const
 {
 }
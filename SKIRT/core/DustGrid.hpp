@@ -9,6 +9,7 @@
 #include "SimulationItem.hpp"
 #include "Box.hpp"
 #include "Position.hpp"
+#include <functional>
 class DustGridPath;
 class DustGridPlotFile;
 
@@ -94,6 +95,21 @@ public:
         the end of each cell is encountered. */
     virtual void path(DustGridPath* path) const = 0;
 
+    /** This function returns the optical depth along a path through the grid, starting at the
+        position \f${\bf{r}}\f$ and in the direction \f${\bf{k}}\f$ specified by the DustGridPath
+        object passed as an argument, using the multiplication factors \f$(\kappa\rho)_m\f$
+        provided by the caller through a call-back function. Rather than first calculating and
+        storing the complete path, the function accumulates the optical depth while the path is
+        being traversed, and ends the traversal as soon as the path length exceeds the specified
+        distance or the optical depth exceeds the specified maximum. The result is then identical
+        to that of DustGridPath::opticalDepth() for the complete path, except that it may be
+        smaller for optical depths beyond the specified maximum. The path segments are not stored
+        in the DustGridPath object, which is left empty. The early termination relies on the
+        path() implementation of each subclass calling DustGridPath::isComplete(); a subclass that
+        does not do so yields the same result after traversing the complete path. */
+    double opticalDepth(DustGridPath* path, const std::function<double(int)>& kapparho,
+                        double distance, double taumax) const;
+
 protected:
     /** This virtual function writes the intersection of the dust grid with the xy plane to the
         specified DustGridPlotFile object. The default implementation does nothing. */
@@ -36,6 +36,8 @@ void DustGridPath::clear()
 {
     _s = 0;
     _v.clear();
+    _tau = 0;
+    _complete = false;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -45,12 +47,39 @@ void DustGridPath::addSegment(int m, double ds)
     if (ds>0)
     {
         _s += ds;
-        _v.push_back(Segment{m,ds,_s,0,0});
+        if (!_kapparho)
+        {
+            _v.push_back(Segment{m,ds,_s,0,0});
+        }
+        else if (!_complete)
+        {
+            if (m>=0) _tau += (*_kapparho)(m) * ds;
+            if (_s > _distance || _tau > _taumax) _complete = true;
+        }
     }
 }
 
 //////////////////////////////////////////////////////////////////////
 
+void DustGridPath::beginAccumulation(const std::function<double(int)>* kapparho, double distance, double taumax)
+{
+    _kapparho = kapparho;
+    _distance = distance;
+    _taumax = taumax;
+    clear();
+}
+
+//////////////////////////////////////////////////////////////////////
+
+double DustGridPath::endAccumulation()
+{
+    _kapparho = nullptr;
+    _complete = false;
+    return _tau;
+}
+
+//////////////////////////////////////////////////////////////////////
+
 Position DustGridPath::moveInside(const Box& box, double eps)
 {
     // a position that is certainly not inside any box
@@ -8,6 +8,7 @@
 
 #include "Direction.hpp"
 #include "Position.hpp"
+#include <functional>
 class Box;
 
 //////////////////////////////////////////////////////////////////////
@@ -56,9 +57,33 @@ public:
     void clear();
 
     /** This function adds a segment in cell \f$m\f$ with length \f$\Delta s\f$ to the path,
-        assuming \f$\Delta s>0\f$. Otherwise the function does nothing. */
+        assuming \f$\Delta s>0\f$. Otherwise the function does nothing. If the path is in
+        accumulating mode (see beginAccumulation()), the segment is not stored; instead its
+        contribution to the optical depth is added to the running total. */
     void addSegment(int m, double ds);
 
+    /** This function returns true if the path is in accumulating mode and one of the limits
+        specified in beginAccumulation() has been reached, so that any further segments would be
+        ignored. DustGrid subclasses call this function after adding a segment to end the
+        calculation of the path early. */
+    bool isComplete() const { return _complete; }
+
+    // ------- Accumulating optical depth while calculating the path -------
+
+    /** This function puts the path in accumulating mode. Rather than storing the segments added
+        to the path, the optical depth along the path is accumulated as the segments are being
+        added, using the multiplication factors \f$(\kappa\rho)_m\f$ provided by the specified
+        call-back function, which must remain valid until endAccumulation() is called. The
+        accumulation stops, and the path is marked complete, as soon as the path length exceeds
+        the specified distance or the optical depth exceeds the specified maximum. As for the
+        opticalDepth() function, the segment that crosses the limit is fully included. Segments
+        outside of the grid (with cell number -1) do not contribute to the optical depth. */
+    void beginAccumulation(const std::function<double(int)>* kapparho, double distance, double taumax);
+
+    /** This function ends the accumulating mode started by beginAccumulation(), and returns the
+        optical depth accumulated since the path was last cleared. */
+    double endAccumulation();
+
     /** This function adds the segments to the path that are needed to move the initial position
         along the propagation direction (both specified in the constructor) inside a given box, and
         returns the final position. If the initial position is already inside the box, no segments
@@ -157,6 +182,13 @@ protected:
     Direction _bfk;
 private:
     double _s;
+
+    // data members used in accumulating mode
+    const std::function<double(int)>* _kapparho{nullptr};   // the call-back function, or null if not accumulating
+    double _distance{0};
+    double _taumax{0};
+    double _tau{0};
+    bool _complete{false};
     struct Segment
     {
         int m;
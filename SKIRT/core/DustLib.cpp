@@ -6,6 +6,9 @@
 #include "DustLib.hpp"
 #include "ArrayTable.hpp"
 #include "DustEmissivity.hpp"
+#include "DustMix.hpp"
+#include "FatalError.hpp"
+#include "FilePaths.hpp"
 #include "Log.hpp"
 #include "NR.hpp"
 #include "PanDustSystem.hpp"
@@ -14,42 +17,48 @@
 #include "PeerToPeerCommunicator.hpp"
 #include "StaggeredAssigner.hpp"
 #include "StringUtils.hpp"
+#include "System.hpp"
 #include "WavelengthGrid.hpp"
+#include <algorithm>
 #include <atomic>
+#include <fstream>
+#include <iomanip>
 #include <unordered_map>
 
 ////////////////////////////////////////////////////////////////////
 
 namespace
 {
+    // the number of library entries handled together in a single batch; the emissivities for the entries
+    // in a batch are calculated through a single call to the dust emissivity object for each dust component
+    const size_t Nbatch = 32;
+
     class EmissionCalculator : public ParallelTarget
     {
     private:
         // data members initialized in constructor
         ParallelTable& _Lvv;     // output luminosities indexed on m or n and ell (writable reference)
+        DustLib* _lib;           // the dust library that provides the emissivities
         std::unordered_multimap<int,int> _mh;    // hash map <n,m> of cells for each library entry
         Log* _log;
         PanDustSystem* _ds;
-        DustEmissivity* _de;
         WavelengthGrid* _lambdagrid;
         int _Nlambda;
         int _Ncomp;
-        int _Ntodo;
+        vector<int> _todo;       // the library entries to be calculated by this process, in order
         std::atomic<int> _Ndone;
 
     public:
         // constructor
-        EmissionCalculator(ParallelTable& Lvv, vector<int>& nv, int Nlib, SimulationItem* item)
-            : _Lvv(Lvv)
+        EmissionCalculator(ParallelTable& Lvv, vector<int>& nv, int Nlib, DustLib* item)
+            : _Lvv(Lvv), _lib(item)
         {
             // get basic information about the wavelength grid and the dust system
             _log = item->find<Log>();
             _ds = item->find<PanDustSystem>();
-            _de = item->find<DustEmissivity>();
             _lambdagrid = item->find<WavelengthGrid>();
             _Nlambda = _lambdagrid->numWavelengths();
             _Ncomp = _ds->numComponents();
-            _Ntodo = 1;     // will be initialized via call to setToDo()
             _Ndone = 0;
 
             // invert mapping vector into a temporary hash map
@@ -74,76 +83,132 @@ namespace
             _log->infoSetElapsed(3);
         }
 
-        // sets the number of library entries to be calculated by this process
-        void setToDo(int Ntodo)
+        // sets the library entries to be calculated by this process, as indicated by the specified assigner
+        void setToDo(const ProcessAssigner* assigner)
         {
-            _Ntodo = Ntodo;
+            size_t Ntodo = assigner->assigned();
+            _todo.resize(Ntodo);
+            for (size_t i=0; i<Ntodo; i++) _todo[i] = assigner->absoluteIndex(i);
         }
 
-        // the parallized loop body; calculates the emission for a single library entry
-        void body(size_t n)
+        // removes the library entries from the list set by setToDo() that are not mapped to by any of the cells
+        // flagged in the specified vector, and returns the number of remaining entries
+        size_t restrictToDo(const vector<char>& updatev)
         {
-            // get the list of dust cells that map to this library entry (absolute indices)
-            vector<int> mv;
-            auto range = _mh.equal_range(n);
-            for (auto it=range.first; it !=range.second; ++it) mv.push_back(it->second);
-            int Nmapped = mv.size();
-
-            // if this library entry is not used, skip the calculation
-            if (Nmapped > 0)
+            vector<int> todo;
+            for (int n : _todo)
             {
-                // calculate the average ISRF for this library entry from the ISRF of all dust cells that map to it
-                Array Jv(_Nlambda);
-                for (int m : mv) Jv += _ds->meanIntensity(m);
-                Jv /= Nmapped;
+                auto range = _mh.equal_range(n);
+                for (auto it=range.first; it!=range.second; ++it)
+                {
+                    if (updatev[it->second])
+                    {
+                        todo.push_back(n);
+                        break;
+                    }
+                }
+            }
+            _todo.swap(todo);
+            return _todo.size();
+        }
+
+        // returns the number of batches to be calculated by this process
+        size_t numBatches() const
+        {
+            return (_todo.size() + Nbatch - 1) / Nbatch;
+        }
 
-                // multiple dust components: calculate emission for each dust cell separately
-                if (_Ncomp > 1)
+        // the parallized loop body; calculates the emission for a single batch of library entries
+        void body(size_t b)
+        {
+            // determine the range of library entries in this batch
+            size_t first = b*Nbatch;
+            size_t last = min(first+Nbatch, _todo.size());
+
+            // get the list of dust cells that map to each library entry in this batch (absolute indices),
+            // skipping the entries that are not used
+            vector<int> nv;
+            vector<vector<int>> mvv;
+            for (size_t i=first; i<last; i++)
+            {
+                int n = _todo[i];
+                vector<int> mv;
+                auto range = _mh.equal_range(n);
+                for (auto it=range.first; it !=range.second; ++it) mv.push_back(it->second);
+                if (!mv.empty())
                 {
-                    // get emissivity for each dust component (i.e. for the corresponding dust mix)
-                    ArrayTable<2> evv(_Ncomp,0);
-                    for (int h=0; h<_Ncomp; h++) evv[h] = _de->emissivity(_ds->mix(h),Jv);
+                    nv.push_back(n);
+                    mvv.push_back(std::move(mv));
+                }
+            }
+            int Nused = nv.size();
 
-                    // combine emissivities into SED for each dust cell, and store the normalized SEDs
-                    for (int m : mv)
+            if (Nused > 0)
+            {
+                // calculate the average ISRF for each library entry from the ISRF of all dust cells that map to it
+                // (reusing a single work array for the cells to avoid allocating memory for each cell)
+                ArrayTable<2> Jvv(Nused,_Nlambda);
+                Array Jmv(_Nlambda);
+                for (int k=0; k<Nused; k++)
+                {
+                    Array& Jv = Jvv[k];
+                    for (int m : mvv[k])
                     {
-                        Array Lv(_Nlambda);
+                        _ds->meanIntensity(m, Jmv);
+                        Jv += Jmv;
+                    }
+                    Jv /= mvv[k].size();
+                }
 
-                        // calculate the emission for this cell
-                        for (int h=0; h<_Ncomp; h++) Lv += evv[h] * _ds->density(m,h);
+                // get emissivities for all library entries for each dust component (i.e. for the corresponding dust mix)
+                vector<ArrayTable<2>> evvv(_Ncomp);
+                for (int h=0; h<_Ncomp; h++) _lib->emissivities(h, Jvv, evvv[h]);
+
+                for (int k=0; k<Nused; k++)
+                {
+                    // multiple dust components: calculate emission for each dust cell separately
+                    if (_Ncomp > 1)
+                    {
+                        // combine emissivities into SED for each dust cell, and store the normalized SEDs
+                        for (int m : mvv[k])
+                        {
+                            Array Lv(_Nlambda);
+
+                            // calculate the emission for this cell
+                            for (int h=0; h<_Ncomp; h++) Lv += evvv[h][k] * _ds->density(m,h);
+
+                            // convert to luminosities and normalize the result
+                            Lv *= _lambdagrid->dlambdav();
+                            double total = Lv.sum();
+                            if (total>0) Lv /= total;
+
+                            // copy the output array to the corresponding row of the output table
+                            for (int ell=0; ell<_Nlambda; ell++) _Lvv(m,ell) = Lv[ell];
+                        }
+                    }
+                    // one dust component: remember just the library template, which serves for all mapped cells
+                    else
+                    {
+                        // get the emissivity of the library entry
+                        Array& Lv = evvv[0][k];
 
                         // convert to luminosities and normalize the result
                         Lv *= _lambdagrid->dlambdav();
                         double total = Lv.sum();
                         if (total>0) Lv /= total;
 
-                        // copy the output array to the corresponding row of the output table
-                        for (int ell=0; ell<_Nlambda; ell++) _Lvv(m,ell) = Lv[ell];
+                        for (int ell=0; ell<_Nlambda; ell++) _Lvv(nv[k],ell) = Lv[ell];
                     }
                 }
-                // one dust component: remember just the library template, which serves for all mapped cells
-                else
-                {
-                    Array Lv(_Nlambda);
-
-                    // get the emissivity of the library entry
-                    Lv = _de->emissivity(_ds->mix(0),Jv);
-
-                    // convert to luminosities and normalize the result
-                    Lv *= _lambdagrid->dlambdav();
-                    double total = Lv.sum();
-                    if (total>0) Lv /= total;
-
-                    for (int ell=0; ell<_Nlambda; ell++) _Lvv(n,ell) = Lv[ell];
-                }
             }
 
-            // log progress
-            int Ndone = ++_Ndone;
-            if (Ndone % 500 == 0)
+            // log progress each time another 500 library entries have been handled
+            int Nbefore = _Ndone.fetch_add(last-first);
+            int Ndone = Nbefore + (last-first);
+            if (Ndone/500 > Nbefore/500)
             {
                 _log->infoIfElapsed("Calculated dust emission spectra: "
-                                    + StringUtils::toString(Ndone*100./_Ntodo,'f',1) + "%");
+                                    + StringUtils::toString(Ndone*100./_todo.size(),'f',1) + "%");
             }
         }
     };
@@ -152,6 +217,13 @@ namespace
 ////////////////////////////////////////////////////////////////////
 
 void DustLib::calculate()
+{
+    calculate(vector<char>());
+}
+
+////////////////////////////////////////////////////////////////////
+
+void DustLib::calculate(const vector<char>& updatev)
 {
     PanDustSystem* ds = find<PanDustSystem>();
     WavelengthGrid* lambdagrid = find<WavelengthGrid>();
@@ -191,6 +263,14 @@ void DustLib::calculate()
     }
     _nIndexed = !dataParallel && Ncomp == 1;
 
+    // prepare the emissivity cache, if requested
+    if (cacheSpectra())
+    {
+        if (!_cacheInitialized) initializeCache();
+        _cacheHits = 0;
+        _cacheMisses = 0;
+    }
+
     // calculate the emissivity for each library entry
     EmissionCalculator calc(_Lvv, _nv, Nlib, this);
     Parallel* parallel = find<ParallelFactory>()->parallel();
@@ -200,21 +280,37 @@ void DustLib::calculate()
         // Each process only has data for a subset of dust cells. The available dust cells are indicated by the
         // cell assigner. The call below calculates the emission for those cells.
         // ONLY WORKS FOR ALLCELLSDUSTLIB AND THIS IS INTENDED
-        calc.setToDo(ds->assigner()->assigned());
-        parallel->call(&calc, ds->assigner());
+        calc.setToDo(ds->assigner());
     }
     else
     {
         // The processes have access to all the cells, and can hence use library subclasses other than AllCellsDustLib.
         // Divide the work over the processes per library entry, using an auxiliary assigner.
         if (!_libAssigner) _libAssigner = new StaggeredAssigner(Nlib, this);
-        calc.setToDo(_libAssigner->assigned());
-        parallel->call(&calc, _libAssigner);
+        calc.setToDo(_libAssigner);
+    }
+    if (!updatev.empty())
+    {
+        double Ntodo = calc.restrictToDo(updatev);
+        comm->sumAll(Ntodo);
+        find<Log>()->info("Recalculating " + StringUtils::toString(Ntodo, 'd')
+                          + " library entries for the updated cells");
     }
+    parallel->call(&calc, calc.numBatches());
 
     // Wait for the other processes to reach this point
     comm->wait("the emission spectra calculation");
     _Lvv.switchScheme();
+
+    // update, report on and preserve the emissivity cache
+    if (cacheSpectra())
+    {
+        int Nadded = addCandidates();
+        find<Log>()->info("Emissivities taken from cache: " + std::to_string(_cacheHits) + "; newly calculated: "
+                          + std::to_string(_cacheMisses) + "; added to cache: " + std::to_string(Nadded)
+                          + "; cache size: " + std::to_string(_cache.size()));
+        if (comm->isRoot()) writeCache();
+    }
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -231,3 +327,278 @@ double DustLib::luminosity(int m, int ell) const
 }
 
 ////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    // Adds the specified candidate to the specified map of cache candidates, unless the map already holds a better
+    // candidate for the same key. A candidate is better if its radiation field lies closer to the centre of the
+    // bin, or for equal distances, if its emissivity compares lexicographically smaller. This total order makes
+    // the outcome independent of the order in which the candidates are offered.
+    template<class Map, class Key> void offerCandidate(Map& candidates, const Key& key, double distance,
+                                                       const Array& ev)
+    {
+        auto it = candidates.find(key);
+        if (it == candidates.end())
+        {
+            candidates.emplace(key, std::make_pair(distance, ev));
+        }
+        else
+        {
+            double& bestDistance = it->second.first;
+            Array& bestEv = it->second.second;
+            if (distance < bestDistance || (distance == bestDistance && std::lexicographical_compare(
+                                            begin(ev), end(ev), begin(bestEv), end(bestEv))))
+            {
+                bestDistance = distance;
+                bestEv = ev;
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
+void DustLib::emissivities(int h, const ArrayTable<2>& Jvv, ArrayTable<2>& evv)
+{
+    PanDustSystem* ds = find<PanDustSystem>();
+    DustEmissivity* de = find<DustEmissivity>();
+    if (!cacheSpectra())
+    {
+        de->emissivities(ds->mix(h), Jvv, evv);
+        return;
+    }
+
+    // determine the cache key for each radiation field, and the squared distance of the field properties
+    // to the centre of the corresponding bin (in units of the bin width);
+    // a field that can't be characterized is never cached
+    int Nfields = Jvv.size(0);
+    vector<CacheKey> keyv(Nfields);
+    vector<double> distancev(Nfields);
+    vector<char> validv(Nfields);
+    const Array& sigmadlambdav = _sigmadlambdavv[h];
+    const Array& sigmalambdadlambdav = _sigmalambdadlambdavv[h];
+    double resolution = cacheResolution();
+    for (int k=0; k<Nfields; k++)
+    {
+        const Array& Jv = Jvv[k];
+        double sum0 = (sigmadlambdav * Jv).sum();
+        double sum1 = (sigmalambdadlambdav * Jv).sum();
+        validv[k] = sum0 > 0. && sum1 > 0.;
+        if (validv[k])
+        {
+            double x = log10(sum0)/resolution;
+            double y = log10(sum1/sum0)/resolution;
+            int i = static_cast<int>(floor(x));
+            int j = static_cast<int>(floor(y));
+            keyv[k] = std::make_tuple(h, i, j);
+            distancev[k] = (x-i-0.5)*(x-i-0.5) + (y-j-0.5)*(y-j-0.5);
+        }
+    }
+
+    // copy the cached emissivities and gather the fields that are not in the cache;
+    // the cache is not modified during the library calculation, so it can be consulted without locking
+    evv.resize(Nfields,0);
+    vector<int> missingv;
+    for (int k=0; k<Nfields; k++)
+    {
+        auto it = validv[k] ? _cache.find(keyv[k]) : _cache.end();
+        if (it != _cache.end()) evv[k] = it->second;
+        else missingv.push_back(k);
+    }
+    int Nmissing = missingv.size();
+    _cacheHits += Nfields - Nmissing;
+    _cacheMisses += Nmissing;
+    if (!Nmissing) return;
+
+    // calculate the missing emissivities in a single batch
+    ArrayTable<2> Jmvv(Nmissing,0);
+    for (int i=0; i<Nmissing; i++) Jmvv[i] = Jvv[missingv[i]];
+    ArrayTable<2> emvv;
+    de->emissivities(ds->mix(h), Jmvv, emvv);
+
+    // store the results and offer them as candidates for the cache
+    std::unique_lock<std::mutex> lock(_candidatesMutex);
+    for (int i=0; i<Nmissing; i++)
+    {
+        int k = missingv[i];
+        evv[k] = emvv[i];
+        if (validv[k]) offerCandidate(_candidates, keyv[k], distancev[k], emvv[i]);
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    // the first line of an emissivity cache file
+    const char* cacheFileHeader = "# SKIRT emissivity cache";
+}
+
+////////////////////////////////////////////////////////////////////
+
+void DustLib::initializeCache()
+{
+    PanDustSystem* ds = find<PanDustSystem>();
+    WavelengthGrid* lambdagrid = find<WavelengthGrid>();
+    int Nlambda = lambdagrid->numWavelengths();
+    int Ncomp = ds->numComponents();
+
+    // precalculate the absorption cross sections used to determine the cache keys
+    _sigmadlambdavv.resize(Ncomp,Nlambda);
+    _sigmalambdadlambdavv.resize(Ncomp,Nlambda);
+    for (int h=0; h<Ncomp; h++)
+    {
+        for (int ell=0; ell<Nlambda; ell++)
+        {
+            double sigmadlambda = ds->mix(h)->sigmaabs(ell) * lambdagrid->dlambda(ell);
+            _sigmadlambdavv(h,ell) = sigmadlambda;
+            _sigmalambdadlambdavv(h,ell) = sigmadlambda * lambdagrid->lambda(ell);
+        }
+    }
+    _cacheInitialized = true;
+
+    // load the cache file, if there is one
+    if (cacheFilename().empty()) return;
+    string filepath = find<FilePaths>()->input(cacheFilename());
+    if (!System::isFile(filepath)) return;
+    Log* log = find<Log>();
+    log->info("Reading emissivity cache from file " + filepath + "...");
+    std::ifstream in = System::ifstream(filepath);
+
+    // verify that the cache was created for the same resolution, wavelength grid and dust mixes;
+    // the values have been written with full precision so that they can be compared exactly
+    string header;
+    getline(in, header);
+    int fileNlambda = 0, fileNcomp = 0;
+    double fileResolution = 0.;
+    in >> fileNlambda >> fileNcomp >> fileResolution;
+    bool match = in && header == cacheFileHeader && fileNlambda == Nlambda && fileNcomp == Ncomp
+                 && fileResolution == cacheResolution();
+    for (int ell=0; match && ell<Nlambda; ell++)
+    {
+        double lambda = 0.;
+        in >> lambda;
+        match = in && lambda == lambdagrid->lambda(ell);
+    }
+    for (int h=0; match && h<Ncomp; h++)
+    {
+        for (int ell=0; match && ell<Nlambda; ell++)
+        {
+            double sigmaabs = 0.;
+            in >> sigmaabs;
+            match = in && sigmaabs == ds->mix(h)->sigmaabs(ell);
+        }
+    }
+    if (!match)
+    {
+        log->warning("Ignoring emissivity cache file that does not match this simulation");
+        return;
+    }
+
+    // read the cache entries
+    int h, i, j;
+    size_t capacity = cacheCapacity();
+    while (_cache.size() < capacity && in >> h >> i >> j)
+    {
+        Array ev(Nlambda);
+        for (int ell=0; ell<Nlambda; ell++) in >> ev[ell];
+        if (!in) throw FATALERROR("Emissivity cache file " + filepath + " is truncated");
+        _cache.emplace(std::make_tuple(h,i,j), ev);
+    }
+    log->info("Read " + std::to_string(_cache.size()) + " emissivities from cache file");
+}
+
+////////////////////////////////////////////////////////////////////
+
+int DustLib::addCandidates()
+{
+    PeerToPeerCommunicator* comm = find<PeerToPeerCommunicator>();
+    int Nlambda = find<WavelengthGrid>()->numWavelengths();
+    int Nvalues = 4+Nlambda;  // key (3 values), distance, emissivity
+
+    // share the candidates found by each process with all other processes, one sending process at a time
+    int Nprocs = comm->size();
+    int rank = comm->rank();
+    for (int sender=0; sender<Nprocs; sender++)
+    {
+        int Ncandidates = _candidates.size();
+        comm->broadcast(Ncandidates, sender);
+        if (!Ncandidates) continue;
+
+        Array packedv(Ncandidates*Nvalues);
+        if (rank == sender)
+        {
+            double* values = &packedv[0];
+            for (const auto& candidate : _candidates)
+            {
+                values[0] = std::get<0>(candidate.first);
+                values[1] = std::get<1>(candidate.first);
+                values[2] = std::get<2>(candidate.first);
+                values[3] = candidate.second.first;
+                std::copy(begin(candidate.second.second), end(candidate.second.second), values+4);
+                values += Nvalues;
+            }
+        }
+        comm->broadcast(packedv, sender);
+        if (rank != sender)
+        {
+            for (int c=0; c<Ncandidates; c++)
+            {
+                const double* values = &packedv[c*Nvalues];
+                CacheKey key = std::make_tuple(static_cast<int>(values[0]), static_cast<int>(values[1]),
+                                               static_cast<int>(values[2]));
+                Array ev(values+4, Nlambda);
+                offerCandidate(_candidates, key, values[3], ev);
+            }
+        }
+    }
+
+    // add the candidates to the cache in order of their keys, as long as the capacity allows
+    size_t capacity = cacheCapacity();
+    int Nadded = 0;
+    for (auto& candidate : _candidates)
+    {
+        if (_cache.size() >= capacity) break;
+        _cache.emplace(candidate.first, std::move(candidate.second.second));
+        Nadded++;
+    }
+    _candidates.clear();
+    return Nadded;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void DustLib::writeCache() const
+{
+    if (cacheFilename().empty()) return;
+
+    PanDustSystem* ds = find<PanDustSystem>();
+    WavelengthGrid* lambdagrid = find<WavelengthGrid>();
+    int Nlambda = lambdagrid->numWavelengths();
+    int Ncomp = ds->numComponents();
+
+    string filepath = find<FilePaths>()->output(cacheFilename());
+    std::ofstream out = System::ofstream(filepath);
+    out << std::setprecision(17);
+
+    // write the values that must match when the cache is read back
+    out << cacheFileHeader << '\n';
+    out << Nlambda << ' ' << Ncomp << ' ' << cacheResolution() << '\n';
+    for (int ell=0; ell<Nlambda; ell++) out << lambdagrid->lambda(ell) << (ell<Nlambda-1 ? ' ' : '\n');
+    for (int h=0; h<Ncomp; h++)
+        for (int ell=0; ell<Nlambda; ell++) out << ds->mix(h)->sigmaabs(ell) << (ell<Nlambda-1 ? ' ' : '\n');
+
+    // write the cache entries in order of their keys
+    vector<CacheKey> keyv;
+    keyv.reserve(_cache.size());
+    for (const auto& entry : _cache) keyv.push_back(entry.first);
+    std::sort(keyv.begin(), keyv.end());
+    for (const CacheKey& key : keyv)
+    {
+        out << std::get<0>(key) << ' ' << std::get<1>(key) << ' ' << std::get<2>(key);
+        for (double e : _cache.at(key)) out << ' ' << e;
+        out << '\n';
+    }
+}
+
+////////////////////////////////////////////////////////////////////
@@ -7,7 +7,13 @@
 #define DUSTLIB_HPP
 
 #include "SimulationItem.hpp"
+#include "ArrayTable.hpp"
 #include "ParallelTable.hpp"
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
 class ProcessAssigner;
 
 //////////////////////////////////////////////////////////////////////
@@ -22,10 +28,56 @@ class ProcessAssigner;
     dust SEDs encountered in the simulation. In other words, the library should span the entire
     parameter space of interstellar radiation fields. Different subclasses of the DustLib class
     achieve this goal to different degrees of sophistication (with a better coverage of the
-    parameter space typically at the cost of a more CPU expensive library construction). */
+    parameter space typically at the cost of a more CPU expensive library construction).
+
+    If the \em cacheSpectra option is enabled, the emissivities calculated for each dust mix are
+    stored in a cache that persists across consecutive library calculations, i.e. across the
+    dust self-absorption iterations and the dust emission phase. The cache is keyed on the dust
+    component and on the quantized values of two properties of the radiation field: the strength
+    of the field as seen by the dust mix, \f$\sum_\ell \varsigma_\ell^{\text{abs}}\,J_\ell\,
+    (\Delta\lambda)_\ell\f$, and the mean absorbed wavelength, each quantized in logarithmic
+    steps given by the \em cacheResolution option. When a radiation field falls in a bin that is
+    already present in the cache, the cached emissivity is used rather than calling the
+    DustEmissivity object. This is an approximation of the same nature as the one made by the
+    Dim1DustLib and Dim2DustLib subclasses, with a resolution that can be controlled independently
+    of the library grid. The cache is not modified while the library is being calculated. Instead,
+    the emissivities calculated for fields that are not yet in the cache are collected as
+    candidates, and after the calculation, the candidates found by all processes are shared, so
+    that all processes keep the same cache. For each new key, the cache stores the emissivity of
+    the field that lies closest to the centre of the corresponding bin, so that the results do not
+    depend on the order of execution or on the number of threads and processes. New entries are
+    added in order of their keys for as long as the number of entries does not exceed the \em
+    cacheCapacity option. If the \em cacheFilename option is specified, the cache is read from the
+    file with that name in the input path (if it exists and matches the current wavelength grid and
+    dust mixes) before the first library calculation, and it is written to the file with that name
+    (preceded by the simulation prefix as usual) in the output path after each library
+    calculation, so that it can be reused by later simulation runs. */
 class DustLib : public SimulationItem
 {
     ITEM_ABSTRACT(DustLib, SimulationItem, "a dust library")
+
+    PROPERTY_BOOL(cacheSpectra, "cache the emissivities across library calculations")
+        ATTRIBUTE_DEFAULT_VALUE(cacheSpectra, "false")
+        ATTRIBUTE_SILENT(cacheSpectra)
+
+    PROPERTY_DOUBLE(cacheResolution, "the quantization step for the emissivity cache keys, in dex")
+        ATTRIBUTE_RELEVANT_IF(cacheResolution, "cacheSpectra")
+        ATTRIBUTE_MIN_VALUE(cacheResolution, "]0")
+        ATTRIBUTE_MAX_VALUE(cacheResolution, "1]")
+        ATTRIBUTE_DEFAULT_VALUE(cacheResolution, "0.01")
+        ATTRIBUTE_SILENT(cacheResolution)
+
+    PROPERTY_INT(cacheCapacity, "the maximum number of emissivities in the cache")
+        ATTRIBUTE_RELEVANT_IF(cacheCapacity, "cacheSpectra")
+        ATTRIBUTE_MIN_VALUE(cacheCapacity, "1")
+        ATTRIBUTE_DEFAULT_VALUE(cacheCapacity, "10000")
+        ATTRIBUTE_SILENT(cacheCapacity)
+
+    PROPERTY_STRING(cacheFilename, "the name of the file preserving the emissivity cache across runs")
+        ATTRIBUTE_RELEVANT_IF(cacheFilename, "cacheSpectra")
+        ATTRIBUTE_OPTIONAL(cacheFilename)
+        ATTRIBUTE_SILENT(cacheFilename)
+
     ITEM_END()
 
     //======================== Other Functions =======================
@@ -41,36 +93,73 @@ public:
         number, assign different library entries to different processes. The subsequent calculations
         are then performed in parallel by the different processes, which in turn use an instance of the
         Parallel class to distribute the work amongst different threads. The smallest unit of
-        parallelization here is obviously the calculation of the %SED for one particular library entry.
-        The calculation itself is implemented in a helper class, called EmissionCalculator. For a
-        particular library entry, the EmissionCalculator object first determines the mean %ISRF by
-        averaging the ISRFs of all the dust cells that map onto it. Then, it calls on the
-        DustEmissivity object held by the dust system to actually calculate the emissivities
-        corresponding to the library entry. If the dust system contains multiple dust components
-        \f$h\f$, each with its own dust mix, the emissivity \f$\varepsilon_{n,h,\ell}\f$ is calculated
-        for each dust component \f$h\f$ seperately, and the results are combined into the complete
-        emission spectrum for a dust cell \f$m\f$ through \f[ j_{m,\ell} =
-        \sum_{h=0}^{N_{\text{comp}}-1} \rho_{m,h} \, \varepsilon_{n,h,\ell} \f] where \f$\ell\f$ is the
-        wavelength index. Finally, this spectrum is normalized to unity and stored for later retrieval
-        by luminosity(). Since the densities \f$\rho_{m,h}\f$ differ for each dust cell, the result
-        must be calculated and stored for each dust cell separately. If the dust system has only a
-        single dust component, the above formula reduces to \f$j_{m,\ell} =\rho_m\,
-        \varepsilon_{n,\ell}\f$, so that the normalized emission spectrum is identical for all dust
-        cells that map to a certain library entry. In this case, it is sufficient to just normalize and
-        store the library templates and have luminosity() perform the mapping from dust cell to library
-        entry. For each dust cell (or library entry in the latter case), the emissivities are converted
-        to luminosities, yielding an emission spectrum or emission SED. After each process has
-        calculated these SEDs for the library entries (and mapped dust cells) it was assigned to, the
-        necessary communications are performed by calling the sync function on the table containing the
-        results.*/
+        parallelization here is the calculation of the %SEDs for a small batch of consecutive library
+        entries assigned to the process. The calculation itself is implemented in a helper class,
+        called EmissionCalculator. For each library entry in the batch, the EmissionCalculator object
+        first determines the mean %ISRF by averaging the ISRFs of all the dust cells that map onto it.
+        Then, it calls on the DustEmissivity object held by the dust system to actually calculate
+        the emissivities corresponding to all library entries in the batch at once, which allows
+        emissivity implementations to organize the calculation more efficiently. If the dust system
+        contains multiple dust components \f$h\f$, each with its own dust mix, the emissivity
+        \f$\varepsilon_{n,h,\ell}\f$ is calculated for each dust component \f$h\f$ seperately, and
+        the results are combined into the complete emission spectrum for a dust cell \f$m\f$ through
+        \f[ j_{m,\ell} = \sum_{h=0}^{N_{\text{comp}}-1} \rho_{m,h} \, \varepsilon_{n,h,\ell} \f]
+        where \f$\ell\f$ is the wavelength index. Finally, this spectrum is normalized to unity and
+        stored for later retrieval by luminosity(). Since the densities \f$\rho_{m,h}\f$ differ for
+        each dust cell, the result must be calculated and stored for each dust cell separately. If
+        the dust system has only a single dust component, the above formula reduces to \f$j_{m,\ell}
+        =\rho_m\, \varepsilon_{n,\ell}\f$, so that the normalized emission spectrum is identical for
+        all dust cells that map to a certain library entry. In this case, it is sufficient to just
+        normalize and store the library templates and have luminosity() perform the mapping from
+        dust cell to library entry. For each dust cell (or library entry in the latter case), the
+        emissivities are converted to luminosities, yielding an emission spectrum or emission SED.
+        After each process has calculated these SEDs for the library entries (and mapped dust cells)
+        it was assigned to, the necessary communications are performed by calling the sync function
+        on the table containing the results.*/
     void calculate();
 
+    /** This function is similar to the function above, but it calculates only the library
+        entries that are mapped to by at least one of the dust cells with a nonzero flag in the
+        specified vector, which is indexed on the absolute cell index. The spectra for those cells
+        are thus the same as they would be after a full calculation, while the spectra for the
+        other cells are undefined until the next full calculation. This allows the incremental dust
+        self-absorption iterations to update the emission of only the cells for which the
+        absorbed luminosity changed significantly. If the specified vector is empty, all entries
+        are calculated. */
+    void calculate(const vector<char>& updatev);
+
     /** This function returns the luminosity fraction \f$L_\ell\f$ at the wavelength index
         \f$\ell\f$ in the normalized dust emission spectrum corresponding to the dust cell with
         dust cell number \f$m\f$. The function simply looks up the appropriate value in the cached
         results produced by calculate(). */
     double luminosity(int m, int ell) const;
 
+    /** This function calculates the emissivities for the dust mix of the dust component \f$h\f$
+        residing in each of a batch of mean radiation fields, as described for the
+        DustEmissivity::emissivities() function. If the \em cacheSpectra option is enabled, the
+        emissivities are taken from the cache where possible, and the newly calculated emissivities
+        are offered as candidates for the cache. This function is intended for use by the helper
+        class that performs the library calculation, and may be called concurrently from multiple
+        threads. */
+    void emissivities(int h, const ArrayTable<2>& Jvv, ArrayTable<2>& evv);
+
+private:
+    /** This function prepares the emissivity cache for use, loading its contents from the cache
+        file if one has been specified and it exists. It is called before the first library
+        calculation if the \em cacheSpectra option is enabled. */
+    void initializeCache();
+
+    /** This function shares the candidates for new cache entries found by each process with all
+        other processes, and adds the candidates to the cache as described in the class header. It
+        is called after each library calculation, and it must be called collectively. The function
+        returns the number of entries added to the cache. */
+    int addCandidates();
+
+    /** This function writes the contents of the emissivity cache, sorted by key, to the cache file
+        in the output path, if a cache filename has been specified. It is called after each library
+        calculation, by the root process only. */
+    void writeCache() const;
+
 protected:
     /** This function returns the number of entries in the library. It must be implemented by each
         subclass to provide this information to the base class. */
@@ -91,6 +180,27 @@ private:
     ParallelTable _Lvv;      // results of calculate(), used by luminosity()
     bool _nIndexed{false};   // indicates whether the output is stored per library index n or per cell index m
     ProcessAssigner* _libAssigner{nullptr};  // an assigner to parallelize the calculation of the library entries
+
+    // the emissivity cache, used only if the cacheSpectra option is enabled
+    using CacheKey = std::tuple<int,int,int>;       // component index and quantized field properties
+    struct CacheKeyHash
+    {
+        size_t operator()(const CacheKey& key) const
+        {
+            size_t hash = static_cast<size_t>(std::get<0>(key));
+            hash = hash*1000003 + static_cast<size_t>(std::get<1>(key));
+            return hash*1000003 + static_cast<size_t>(std::get<2>(key));
+        }
+    };
+    using Candidate = std::pair<double,Array>;      // distance to the bin centre and emissivity
+    bool _cacheInitialized{false};
+    ArrayTable<2> _sigmadlambdavv;                  // sigma_abs * dlambda, indexed on h and ell
+    ArrayTable<2> _sigmalambdadlambdavv;            // sigma_abs * lambda * dlambda, indexed on h and ell
+    std::unordered_map<CacheKey,Array,CacheKeyHash> _cache;  // emissivity for each key
+    std::map<CacheKey,Candidate> _candidates;       // best candidate for each new key in the current calculation
+    std::mutex _candidatesMutex;                    // guards access to _candidates
+    std::atomic<int> _cacheHits{0};                 // number of emissivities taken from the cache
+    std::atomic<int> _cacheMisses{0};               // number of emissivities calculated
 };
 
 ////////////////////////////////////////////////////////////////////
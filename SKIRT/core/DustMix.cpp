@@ -86,6 +86,12 @@ void DustMix::setupSelfAfter()
 
     if (_polarization)
     {
+        // verify that the subclass filled all Mueller matrix tables used by the scattering code
+        size_t N = static_cast<size_t>(_Nlambda)*_Ntheta;
+        if (_S11vv.size() != N || _S12vv.size() != N || _S22vv.size() != N ||
+            _S33vv.size() != N || _S34vv.size() != N || _S44vv.size() != N)
+            throw FATALERROR("Polarized dust mixture does not define all Mueller matrix coefficients");
+
         // create a table containing the theta value corresponding to each index
         _thetav.resize(_Ntheta);
         double dt = M_PI/(_Ntheta-1);
@@ -325,6 +331,8 @@ void DustMix::addPolarization(const Table<2>& S11vv, const Table<2>& S12vv,
         _S12vv.resize(_Nlambda,_Ntheta);
         _S33vv.resize(_Nlambda,_Ntheta);
         _S34vv.resize(_Nlambda,_Ntheta);
+        _S22vv.resize(_Nlambda,_Ntheta);
+        _S44vv.resize(_Nlambda,_Ntheta);
     }
 
     // verify the incoming table sizes
@@ -345,6 +353,10 @@ void DustMix::addPolarization(const Table<2>& S11vv, const Table<2>& S12vv,
             _S12vv(ell,t) += S12vv(ell,t);
             _S33vv(ell,t) += S33vv(ell,t);
             _S34vv(ell,t) += S34vv(ell,t);
+
+            // for spherical grains, S22 equals S11 and S44 equals S33
+            _S22vv(ell,t) += S11vv(ell,t);
+            _S44vv(ell,t) += S33vv(ell,t);
         }
     }
 }
@@ -19,6 +19,7 @@
 #include "ParallelFactory.hpp"
 #include "PeerToPeerCommunicator.hpp"
 #include "PhotonPackage.hpp"
+#include "Profiler.hpp"
 #include "Random.hpp"
 #include "ShortArray.hpp"
 #include "StaggeredAssigner.hpp"
@@ -46,16 +47,37 @@ void DustSystem::setupSelfAfter()
             throw FATALERROR("All dust mixes must consistenly support polarization, or not support polarization");
     }
 
-    // Resize the tables that hold essential dust cell properties
-    _volumev.resize(_Ncells);
-    _rhovv.resize(_Ncells,_Ncomp);
+    // Allocate the tables that hold essential dust cell properties, once per node in shared-memory mode
+    PeerToPeerCommunicator* comm = find<PeerToPeerCommunicator>();
+    size_t Nrho = static_cast<size_t>(_Ncells)*_Ncomp;
+    if (comm->sharedMemory())
+    {
+        _volume = comm->allocateNodeShared(_Ncells, _volumeWindow);
+        _rho = comm->allocateNodeShared(Nrho, _rhoWindow);
+        if (comm->isNodeLeader()) std::fill(_rho, _rho+Nrho, 0.);
+    }
+    else
+    {
+        _volumev.resize(_Ncells);
+        _rhovv.resize(_Ncells,_Ncomp);
+        _volume = &_volumev[0];
+        _rho = &_rhovv.data()[0];
+    }
 
-    // Set the volume of the cells (parallelized over different threads, except when multiprocessing is enabled)
+    // Set the volume of the cells (parallelized over different threads, except when multiprocessing is enabled);
+    // in shared-memory mode the node leader calculates the volumes using all threads, while the other processes wait
     find<Log>()->info("Calculating the volume of the cells...");
-    PeerToPeerCommunicator* comm = find<PeerToPeerCommunicator>();
     ParallelFactory* pfactory = find<ParallelFactory>();
-    size_t nthreads = comm->isMultiProc() ? 1 : pfactory->maxThreadCount();
-    pfactory->parallel(nthreads)->call(this, &DustSystem::setVolumeBody, _Ncells);
+    if (comm->sharedMemory())
+    {
+        if (comm->isNodeLeader()) pfactory->parallel()->call(this, &DustSystem::setVolumeBody, _Ncells);
+        comm->waitNode();
+    }
+    else
+    {
+        size_t nthreads = comm->isMultiProc() ? 1 : pfactory->maxThreadCount();
+        pfactory->parallel(nthreads)->call(this, &DustSystem::setVolumeBody, _Ncells);
+    }
 
     // use a StaggeredAssigner to calculate the densities
     _setupAssigner = new StaggeredAssigner(_Ncells, this);
@@ -105,7 +127,7 @@ void DustSystem::setupSelfAfter()
 // parallelized body used above
 void DustSystem::setVolumeBody(size_t m)
 {
-    _volumev[m] = (_grid->weight(m) > 0) ? _grid->volume(m) : 0;
+    _volume[m] = (_grid->weight(m) > 0) ? _grid->volume(m) : 0;
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -114,7 +136,7 @@ void DustSystem::setVolumeBody(size_t m)
 void DustSystem::setGridDensityBody(size_t m)
 {
     for (int h=0; h<_Ncomp; h++)
-        _rhovv(m,h) = _gdi->density(h,m);
+        _rho[m*_Ncomp+h] = _gdi->density(h,m);
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -140,12 +162,12 @@ void DustSystem::setSampleDensityBody(size_t m)
         }
         for (int h=0; h<_Ncomp; h++)
         {
-            _rhovv(m,h) = weight*sumv[h]/_numSamples;
+            _rho[m*_Ncomp+h] = weight*sumv[h]/_numSamples;
         }
     }
     else
     {
-        for (int h=0; h<_Ncomp; h++) _rhovv(m,h) = 0;
+        for (int h=0; h<_Ncomp; h++) _rho[m*_Ncomp+h] = 0;
     }
 }
 
@@ -159,8 +181,10 @@ void DustSystem::assemble()
     Log* log = find<Log>();
     TimeLogger logger(log->verbose() && comm->isMultiProc() ? log : 0, "communication of the dust densities");
 
-    // Sum the densities array across all processes
-    comm->sumAll(_rhovv.data());
+    // Sum the densities array across all processes; in shared-memory mode, the node tables already hold
+    // the contributions of all processes on the node, so that only the node leaders need to communicate
+    if (comm->sharedMemory()) comm->sumAllNodeShared(_rho, static_cast<size_t>(_Ncells)*_Ncomp);
+    else comm->sumAll(_rhovv.data());
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -433,6 +457,10 @@ void DustSystem::doWriteDensity() const
 // Private class to encapsulate the call-back function for calculating optical depths
 namespace
 {
+    // the optical depth beyond which the calculation of the optical depth along a path may be terminated early,
+    // because the transmission exp(-tau) along the path is negligible
+    const double maxOpticalDepth = 40.;
+
     class KappaRho
     {
     private:
@@ -608,6 +636,7 @@ void DustSystem::doWriteCellProperties() const
 
     // Create a text file
     TextOutFile file(this, "ds_cellprops", "dust cell properties");
+    if (writeBinaryTables()) file.setBinaryColumns(_Ncells);
 
     // Write the header
     file.addColumn("dust cell index", 'd');
@@ -767,14 +796,14 @@ Position DustSystem::randomPositionInCell(int m) const
 
 double DustSystem::volume(int m) const
 {
-    return _volumev[m];
+    return _volume[m];
 }
 
 //////////////////////////////////////////////////////////////////////
 
 double DustSystem::density(int m, int h) const
 {
-    return m >= 0 ? _rhovv(m,h) : 0;
+    return m >= 0 ? _rho[m*_Ncomp+h] : 0;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -783,17 +812,18 @@ double DustSystem::density(int m) const
 {
     double rho = 0;
     if (m >= 0)
-        for (int h=0; h<_Ncomp; h++) rho += _rhovv(m,h);
+        for (int h=0; h<_Ncomp; h++) rho += _rho[m*_Ncomp+h];
     return rho;
 }
 
 //////////////////////////////////////////////////////////////////////
 
-Array DustSystem::meanIntensity(int m) const
+double DustSystem::meanIntensity(int m, Array& Jv) const
 {
     WavelengthGrid* lambdagrid = find<WavelengthGrid>();
     int Nlambda = lambdagrid->numWavelengths();
-    Array Jv(Nlambda);
+    if (Jv.size() != static_cast<size_t>(Nlambda)) Jv.resize(Nlambda);
+    double Labstot = 0.0;
     double fac = 4.0*M_PI*volume(m);
     for (int ell=0; ell<Nlambda; ell++)
     {
@@ -804,19 +834,24 @@ Array DustSystem::meanIntensity(int m) const
             double rho = density(m,h);
             kappaabsrho += kappaabs*rho;
         }
-        double J = absorbedLuminosity(m,ell) / (kappaabsrho*fac) / lambdagrid->dlambda(ell);
+        double Labs = absorbedLuminosity(m,ell);
+        Labstot += Labs;
+        double J = Labs / (kappaabsrho*fac) / lambdagrid->dlambda(ell);
         // guard against (rare) situations where both Labs and kappa*fac are zero
         Jv[ell] = std::isfinite(J) ? J : 0.0;
     }
-    return Jv;
+    return Labstot;
 }
 
 //////////////////////////////////////////////////////////////////////
 
-void DustSystem::fillOpticalDepth(PhotonPackage* pp)
+void DustSystem::fillOpticalDepth(PhotonPackage* pp, Profiler::Slot* slot)
 {
+    Profiler::Sample sample(slot, Profiler::Timer::FillOpticalDepth);
+
     // determine the path and store the geometric details in the photon package
     _grid->path(pp);
+    if (slot) slot->countPath(pp->size());
 
     // if such statistics are requested, keep track of the number of cells crossed
     if (_writeCellsCrossed)
@@ -839,22 +874,49 @@ void DustSystem::fillOpticalDepth(PhotonPackage* pp)
 
 //////////////////////////////////////////////////////////////////////
 
-double DustSystem::opticalDepth(PhotonPackage* pp, double distance)
+double DustSystem::opticalDepth(PhotonPackage* pp, double distance, double taumax)
 {
-    // determine the path and store the geometric details in the photon package
-    _grid->path(pp);
-
-    // if such statistics are requested, keep track of the number of cells crossed
+    // if such statistics are requested, determine the complete path and keep track of the number of cells crossed
     if (_writeCellsCrossed)
     {
-        std::unique_lock<std::mutex> lock(_crossedMutex);
-        unsigned int index = pp->size();
-        if (index >= _crossed.size()) _crossed.resize(index+1);
-        _crossed[index] += 1;
+        _grid->path(pp);
+        {
+            std::unique_lock<std::mutex> lock(_crossedMutex);
+            unsigned int index = pp->size();
+            if (index >= _crossed.size()) _crossed.resize(index+1);
+            _crossed[index] += 1;
+        }
+        return pp->opticalDepth(KappaRho(this, pp->ell()), distance);
     }
 
-    // calculate and return the optical depth at the specified distance
-    return pp->opticalDepth(KappaRho(this, pp->ell()), distance);
+    // otherwise, accumulate the optical depth while traversing the path,
+    // stopping at the specified distance or as soon as the transmission becomes negligible
+    // (the call-back function refers to the functor object, avoiding a copy into a heap-allocated buffer)
+    KappaRho functor(this, pp->ell());
+    std::function<double(int)> kapparho = [&functor](int m) { return functor(m); };
+    return _grid->opticalDepth(pp, kapparho, distance, min(taumax, maxOpticalDepth));
+}
+
+////////////////////////////////////////////////////////////////////
+
+void DustSystem::resetRunState()
+{
+    _crossed.clear();
+}
+
+////////////////////////////////////////////////////////////////////
+
+void DustSystem::releaseSharedMemory()
+{
+    if (!_volumeWindow && !_rhoWindow) return;
+
+    PeerToPeerCommunicator* comm = find<PeerToPeerCommunicator>();
+    comm->freeNodeShared(_rhoWindow);
+    comm->freeNodeShared(_volumeWindow);
+    _rhoWindow = 0;
+    _volumeWindow = 0;
+    _rho = nullptr;
+    _volume = nullptr;
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -11,6 +11,7 @@
 #include "Array.hpp"
 #include "Position.hpp"
 #include "Table.hpp"
+#include "Profiler.hpp"
 #include <mutex>
 class DustGridDensityInterface;
 class DustMix;
@@ -67,6 +68,10 @@ class DustSystem : public SimulationItem
         ATTRIBUTE_DEFAULT_VALUE(writeStellarDensity, "false")
         ATTRIBUTE_SILENT(writeStellarDensity)
 
+    PROPERTY_BOOL(writeBinaryTables, "write large per-cell data files in binary columnar format")
+        ATTRIBUTE_DEFAULT_VALUE(writeBinaryTables, "false")
+        ATTRIBUTE_SILENT(writeBinaryTables)
+
     ITEM_END()
 
     /** \fn writeStellarDensity
@@ -78,6 +83,12 @@ class DustSystem : public SimulationItem
         and/or particles or cells of the input distribution. If the flag is enabled with an
         unsupported stellar system, a fatal error occurs during setup. */
 
+    /** \fn writeBinaryTables
+        If the writeBinaryTables flag is enabled, the values in the data files with a row for
+        each dust cell or grid node (the cell properties, cell temperatures, ISRF, absorption
+        spectra and tree data) are written in binary columnar format rather than as text; see the
+        TextOutFile class for more information. */
+
     //============= Construction - Setup - Destruction =============
 
 protected:
@@ -91,7 +102,13 @@ protected:
         calculated as the mean of the density values (found using a call to the corresponding
         function of the dust distribution) in these points. The calculation of both volume and
         density is parallellized. Finally, the function optionally invokes various writeXXX()
-        functions depending on the state of the corresponding write flags. */
+        functions depending on the state of the corresponding write flags.
+
+        In shared-memory mode (see PeerToPeerCommunicator::sharedMemory()), the cell volumes and
+        densities are stored only once per compute node. The volumes are calculated by the node
+        leader; each process writes the densities of its assigned cells directly into the shared
+        table, after which the node tables are summed across nodes. Other data, including the
+        dust grid structure and the dust mix tables, is still kept separately by each process. */
     void setupSelfAfter() override;
 
 private:
@@ -242,14 +259,18 @@ public:
         the value zero is returned. */
     double density(int m) const;
 
-    /** This function returns a vector with the mean radiation field \f$J_{\ell,m}\f$ at all
-        wavelength indices in the dust cell with cell number \f$m\f$. It is calculated as \f[
+    /** This function stores the mean radiation field \f$J_{\ell,m}\f$ at all wavelength indices
+        in the dust cell with cell number \f$m\f$ into the specified array, and returns the total
+        (bolometric) absorbed luminosity in the cell. The mean radiation field is calculated as \f[
         J_{\ell,m} = \frac{ L_{\ell,m}^{\text{abs}} }{ 4\pi\, V_m\, (\Delta\lambda)_\ell \sum_h
         \kappa_{\ell,h}^{\text{abs}}\, \rho_{m,h} } \f] with \f$L_{\ell,m}^{\text{abs}}\f$ the
         absorbed luminosity, \f$\kappa_{\ell,h}^{\text{abs}}\f$ the absorption coefficient
         corresponding to the \f$h\f$'th dust component, \f$\rho_{m,h}\f$ the dust density
-        corresponding to the \f$h\f$'th dust component, and \f$V_m\f$ the volume of the cell. */
-    Array meanIntensity(int m) const;
+        corresponding to the \f$h\f$'th dust component, and \f$V_m\f$ the volume of the cell.
+        Both results are obtained in a single sweep over the absorbed luminosities. The array is
+        resized only if it does not yet have the appropriate size, so that callers can reuse the
+        same array for many cells without allocating memory. */
+    double meanIntensity(int m, Array& Jv) const;
 
     /** This function calculates the optical depth
         \f$\tau_{\ell,{\text{path}}}({\boldsymbol{r}},{\boldsymbol{k}})\f$ at wavelength index
@@ -273,22 +294,29 @@ public:
         depth covered within the \f$m\f$'th dust cell, \f[ (\Delta\tau_\ell)_m = (\Delta s)_m
         \sum_h \kappa_{\ell,h}^{\text{ext}}\, \rho_m, \f] and the total optical depth
         \f$\tau_{\ell,m}\f$ covered between the starting point \f${\boldsymbol{r}}\f$ and the
-        boundary of the cell. */
-    void fillOpticalDepth(PhotonPackage* pp);
+        boundary of the cell. The last argument specifies the profiler slot for the current thread,
+        or null if profiling is not active. */
+    void fillOpticalDepth(PhotonPackage* pp, Profiler::Slot* slot);
 
     /** This function returns the optical depth
         \f$\tau_{\ell,{\text{d}}}({\boldsymbol{r}},{\boldsymbol{k}})\f$ at wavelength index
         \f$\ell\f$ along a path through the dust system starting at the position
         \f${\boldsymbol{r}}\f$ into the direction \f${\boldsymbol{k}}\f$ for a distance \f$d\f$,
         where \f$\ell\f$, \f${\boldsymbol{r}}\f$ and \f${\boldsymbol{k}}\f$ are obtained from the
-        specified PhotonPackage object. The function first determines the photon package's path
-        through the dust grid, storing the geometric information about the path segments through
-        each cell into the photon package, and then calculates the optical depth at the specified
-        distance. The calculation proceeds as described for the fillOpticalDepth() function; the
-        differences being that the path length is limited to the specified distance, and that this
-        function does not store the optical depth information back into the PhotonPackage object.
-        */
-    double opticalDepth(PhotonPackage* pp, double distance);
+        specified PhotonPackage object. The calculation proceeds as described for the
+        fillOpticalDepth() function; the differences being that the path length is limited to the
+        specified distance, and that this function does not store the optical depth information
+        back into the PhotonPackage object. The function uses the DustGrid::opticalDepth() function
+        to accumulate the optical depth while traversing the path, without storing the path
+        segments, and to terminate the traversal as soon as the specified distance has been
+        covered or the optical depth exceeds a value (currently 40) for which the transmission
+        \f$\exp(-\tau)\f$ is negligible. The returned optical depth may thus be smaller than the
+        actual value, but only when both are beyond that limit. If the writeCellsCrossed attribute
+        is true, the complete path is calculated and stored in the photon package instead, so that
+        the number of cells crossed can be recorded. If a smaller maximum optical depth is
+        specified as the last argument, the traversal is terminated as soon as that maximum is
+        exceeded, so that the returned value is a lower limit for the actual optical depth. */
+    double opticalDepth(PhotonPackage* pp, double distance, double taumax=DBL_MAX);
 
     /** If the writeCellsCrossed attribute is true, this function writes out a data file (named
         <tt>prefix_ds_crossed.dat</tt>) with statistics on the number of dust grid cells crossed
@@ -301,6 +329,23 @@ public:
         this base class. */
     virtual void write() const;
 
+    /** This function discards the results accumulated in the dust system during a previous run of
+        the simulation, so that a simulation that has been set up once can be run again (see
+        MonteCarloSimulation::prepareForRerun()). The implementation in this base class clears the
+        statistics on the number of cells crossed. This virtual function can be overridden in a
+        subclass that stores additional results; in that case, the overriding function must also
+        call the implementation in this base class. */
+    virtual void resetRunState();
+
+    /** In shared-memory mode, this function releases the node-shared memory holding the cell
+        volumes and densities; otherwise it does nothing. Because releasing node-shared memory
+        requires collective communication, this function must be called by all processes
+        together, after the simulation has completed and before the dust system is destroyed. It
+        is not called from the destructor, because the destruction of a simulation hierarchy is
+        not guaranteed to happen at a collective point. Node-shared memory that has not been
+        released explicitly is released when the process manager finalizes MPI. */
+    void releaseSharedMemory();
+
     /** This pure virtual function must be implemented in each subclass to indicate whether dust
         emission is turned on for this dust system. The function returns true if dust emission is
         turned on, and false otherwise. It is provided in this base class because it is invoked
@@ -337,8 +382,12 @@ private:
     ProcessAssigner* _setupAssigner{nullptr};
     int _Ncomp{0};      // cached number of components (index h) in dust distribution
     int _Ncells{0};     // cached number of cells (index m) in dust grid
-    Array _volumev;     // volume for each cell (indexed on m)
-    Table<2> _rhovv;    // density for each cell and each dust component (indexed on m,h)
+    Array _volumev;     // volume for each cell (indexed on m), unless in shared-memory mode
+    Table<2> _rhovv;    // density for each cell and each dust component (indexed on m,h), unless in shared-memory mode
+    double* _volume{nullptr};  // points to the cell volumes, in _volumev or in node-shared memory
+    double* _rho{nullptr};     // points to the cell densities, in _rhovv or in node-shared memory (indexed on m*Ncomp+h)
+    int _volumeWindow{0};      // identifier of the node-shared memory holding the volumes, or zero
+    int _rhoWindow{0};         // identifier of the node-shared memory holding the densities, or zero
     vector<int64_t> _crossed;
     std::mutex _crossedMutex;
 };
@@ -10,6 +10,7 @@
 #include "PeerToPeerCommunicator.hpp"
 #include "System.hpp"
 #include "fitsio.h"
+#include <map>
 #include <mutex>
 
 ////////////////////////////////////////////////////////////////////
@@ -55,9 +56,25 @@ void FITSInOut::write(const SimulationItem* item, string description, string fil
 
 namespace
 {
-    // mutex to guard the FITS input/output operations
+    // mutex to guard the FITS input/output operations if the cfitsio library is not reentrant,
+    // and to guard the list of per-file mutexes otherwise
     std::mutex _mutex;
 
+    // mutexes to guard the FITS input/output operations on each file, indexed on file path
+    std::map<string, std::mutex> _fileMutexes;
+
+    // function to acquire a lock for the FITS input/output operations on the specified file; if the cfitsio
+    // library was built with reentrant support, operations on different files can proceed concurrently
+    std::unique_lock<std::mutex> acquireLock(string filepath)
+    {
+        if (!fits_is_reentrant()) return std::unique_lock<std::mutex>(_mutex);
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        std::mutex& fileMutex = _fileMutexes[filepath];
+        lock.unlock();
+        return std::unique_lock<std::mutex>(fileMutex);
+    }
+
     // function to report cfitsio errors
     void report_error(string filepath, string action, int status)
     {
@@ -71,8 +88,8 @@ namespace
 
 void FITSInOut::read(string filepath, Array& data, int& nx, int& ny, int& nz)
 {
-    // Acquire a global lock since the cfitsio library is not guaranteed to be reentrant
-    std::unique_lock<std::mutex> lock(_mutex);
+    // Acquire a lock since the cfitsio library is not guaranteed to be reentrant
+    std::unique_lock<std::mutex> lock = acquireLock(filepath);
 
     // Open the FITS file
     int status = 0;
@@ -115,9 +132,9 @@ void FITSInOut::write(string filepath, const Array& data, int nx, int ny, int nz
         throw FATALERROR("Inconsistent data size when creating FITS file " + filepath);
     long naxes[3] = {nx, ny, nz};
 
-    // Acquire a global lock since the cfitsio library is not guaranteed to be reentrant
-    // (only when it is built with ./configure --enable-reentrant; make)
-    std::unique_lock<std::mutex> lock(_mutex);
+    // Acquire a lock since the cfitsio library is not guaranteed to be reentrant
+    // (only when it is built with -D_REENTRANT, in which case only operations on the same file are serialized)
+    std::unique_lock<std::mutex> lock = acquireLock(filepath);
 
     // Generate time stamp and temporaries
     string stamp = System::timestamp(true);
@@ -169,8 +186,8 @@ void FITSInOut::write(string filepath, const Array& data, int nx, int ny, int nz
 
 void FITSInOut::readColumn(string filepath, Array& data, int n)
 {
-    // Acquire a global lock since the cfitsio library is not guaranteed to be reentrant
-    std::unique_lock<std::mutex> lock(_mutex);
+    // Acquire a lock since the cfitsio library is not guaranteed to be reentrant
+    std::unique_lock<std::mutex> lock = acquireLock(filepath);
 
     // Open the FITS file
     int status = 0;
@@ -267,6 +267,7 @@ void FileTreeDustGrid::path(DustGridPath* path) const
             else if (dsy<=dsx && dsy<=dsz) ds = dsy;
             else ds = dsz;
             path->addSegment(cellNumber(node), ds);
+            if (path->isComplete()) return;
             x += (ds+_eps)*kx;
             y += (ds+_eps)*ky;
             z += (ds+_eps)*kz;
@@ -328,6 +329,7 @@ void FileTreeDustGrid::path(DustGridPath* path) const
                 wall = (kz<0.0) ? TreeNode::BOTTOM : TreeNode::TOP;
             }
             path->addSegment(cellNumber(node), ds);
+            if (path->isComplete()) return;
             x += (ds+_eps)*kx;
             y += (ds+_eps)*ky;
             z += (ds+_eps)*kz;
@@ -390,6 +392,7 @@ void FileTreeDustGrid::path(DustGridPath* path) const
             if (dsx<=dsy && dsx<=dsz)
             {
                 path->addSegment(_cellnumberv[l], dsx);
+                if (path->isComplete()) return;
                 x = xnext;
                 y += ky*dsx;
                 z += kz*dsx;
@@ -428,6 +431,7 @@ void FileTreeDustGrid::path(DustGridPath* path) const
             else if (dsy<dsx && dsy<=dsz)
             {
                 path->addSegment(_cellnumberv[l], dsy);
+                if (path->isComplete()) return;
                 x += kx*dsy;
                 y  = ynext;
                 z += kz*dsy;
@@ -465,6 +469,7 @@ void FileTreeDustGrid::path(DustGridPath* path) const
             else if (dsz< dsx && dsz< dsy)
             {
                 path->addSegment(_cellnumberv[l], dsz);
+                if (path->isComplete()) return;
                 x += kx*dsz;
                 y += ky*dsz;
                 z  = znext;
@@ -35,13 +35,20 @@ void FrameInstrument::detect(PhotonPackage* pp)
 
 ////////////////////////////////////////////////////////////////////
 
+void FrameInstrument::startCommunication()
+{
+    _distftotv.startCompleteCube();
+}
+
+////////////////////////////////////////////////////////////////////
+
 void FrameInstrument::write()
 {
     // sum the flux data cubes element-wise across the different processes
     std::shared_ptr<Array> completeCube = _distftotv.constructCompleteCube();
 
     // construct a list of data cube pointers and the corresponding file names
-    vector<Array*> farrays({ completeCube.get() });
+    vector<std::shared_ptr<Array>> farrays({ completeCube });
     vector<string> fnames({ "total" });
 
     // calibrate and output the result
@@ -34,6 +34,9 @@ protected:
         See SimpleInstrument::detect() for more information. */
     void detect(PhotonPackage* pp) override;
 
+    /** This function starts the summation of the data cube across processes. */
+    void startCommunication() override;
+
     /** This function calibrates and outputs the instrument data.
         See SimpleInstrument::write() for more information. */
     void write() override;
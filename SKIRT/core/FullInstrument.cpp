@@ -143,8 +143,58 @@ void FullInstrument::detect(PhotonPackage* pp)
 
 ////////////////////////////////////////////////////////////////////
 
+vector<Array*> FullInstrument::sedArrays()
+{
+    vector<Array*> Farrays({ &_Ftrav, &_Fstrdirv, &_Fstrscav, &_Fdusdirv, &_Fdusscav });
+    if (_polarization)
+    {
+        Farrays.push_back(&_FtotQv);
+        Farrays.push_back(&_FtotUv);
+        Farrays.push_back(&_FtotVv);
+    }
+    if (_dustsystem)
+    {
+        for (int nscatt=0; nscatt<_numScatteringLevels; nscatt++) Farrays.push_back( &(_Fstrscavv[nscatt]) );
+    }
+    return Farrays;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void FullInstrument::startCommunication()
+{
+    // start the summation of the SED arrays and of all the (or only the necessary) cubes
+    beginSumResults(sedArrays());
+    _ftrav.startCompleteCube();
+    if (_dustsystem)
+    {
+        _fstrdirv.startCompleteCube();
+        _fstrscav.startCompleteCube();
+        if (_dustemission)
+        {
+            _fdusdirv.startCompleteCube();
+            _fdusscav.startCompleteCube();
+        }
+        if (_numScatteringLevels > 0)
+        {
+            for (auto& cube : _fstrscavv) cube.startCompleteCube();
+        }
+        if (_polarization)
+        {
+            _ftotQv.startCompleteCube();
+            _ftotUv.startCompleteCube();
+            _ftotVv.startCompleteCube();
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
 void FullInstrument::write()
 {
+    // sum the SED arrays element-wise across the different processes, before combining them
+    sumResults(sedArrays());
+
     // collect all the (or only the necessary) cubes
     std::shared_ptr<Array> ftravComp = _ftrav.constructCompleteCube();
     std::shared_ptr<Array> fstrdirvComp;
@@ -179,27 +229,27 @@ void FullInstrument::write()
     }
 
     // compute the total flux and the total dust flux in temporary arrays
-    Array ftotv;
+    auto ftotv = std::make_shared<Array>();
     Array Ftotv;
-    Array ftotdusv;
+    auto ftotdusv = std::make_shared<Array>();
     Array Ftotdusv;
     if (_dustemission)
     {
-        ftotv = *fstrdirvComp + *fstrscavComp + *fdusdirvComp + *fdusscavComp;
+        *ftotv = *fstrdirvComp + *fstrscavComp + *fdusdirvComp + *fdusscavComp;
         Ftotv = _Fstrdirv + _Fstrscav + _Fdusdirv + _Fdusscav;
-        ftotdusv = *fdusdirvComp + *fdusscavComp;
+        *ftotdusv = *fdusdirvComp + *fdusscavComp;
         Ftotdusv = _Fdusdirv + _Fdusscav;
     }
     else if (_dustsystem)
     {
-        ftotv = *fstrdirvComp + *fstrscavComp;
+        *ftotv = *fstrdirvComp + *fstrscavComp;
         Ftotv = _Fstrdirv + _Fstrscav;
     }
     else
     {
         // don't output transparent frame separately because it is identical to the total frame
-        ftotv = *ftravComp;
-        ftravComp->resize(0);
+        ftotv = ftravComp;
+        ftravComp = std::make_shared<Array>();
         // do output integrated fluxes to avoid confusing zeros
         Ftotv = _Ftrav;
         _Fstrdirv = _Ftrav;
@@ -224,34 +274,33 @@ void FullInstrument::write()
         }
     }
 
-    // sum the SED arrays element-wise across the different processes, and calibrate and output the result
-    sumResults(Farrays);
+    // calibrate and output the SED arrays
     calibrateAndWriteSEDs(Farrays, Fnames);
 
     // construct list of data cube pointers and the corresponding file names
-    vector<Array*> farrays({ &ftotv, ftravComp.get() });
+    vector<std::shared_ptr<Array>> farrays({ ftotv, ftravComp });
     vector<string> fnames({ "total", "transparent" });
     if (_dustsystem)
     {
-        farrays.push_back(fstrdirvComp.get());  fnames.push_back("direct");
-        farrays.push_back(fstrscavComp.get());  fnames.push_back("scattered");
+        farrays.push_back(fstrdirvComp);  fnames.push_back("direct");
+        farrays.push_back(fstrscavComp);  fnames.push_back("scattered");
         if (_dustemission)
         {
-            farrays.push_back(&ftotdusv);           fnames.push_back("dust");
-            farrays.push_back(fdusscavComp.get());  fnames.push_back("dustscattered");
+            farrays.push_back(ftotdusv);      fnames.push_back("dust");
+            farrays.push_back(fdusscavComp);  fnames.push_back("dustscattered");
         }
     }
     if (_polarization)
     {
-        farrays.push_back(ftotQvComp.get());  fnames.push_back("stokesQ");
-        farrays.push_back(ftotUvComp.get());  fnames.push_back("stokesU");
-        farrays.push_back(ftotVvComp.get());  fnames.push_back("stokesV");
+        farrays.push_back(ftotQvComp);  fnames.push_back("stokesQ");
+        farrays.push_back(ftotUvComp);  fnames.push_back("stokesU");
+        farrays.push_back(ftotVvComp);  fnames.push_back("stokesV");
     }
     if (_dustsystem)
     {
         for (int nscatt=0; nscatt<_numScatteringLevels; nscatt++)
         {
-            farrays.push_back(fstrscavvComp[nscatt].get());
+            farrays.push_back(fstrscavvComp[nscatt]);
             fnames.push_back("scatteringlevel" + std::to_string(nscatt+1));
         }
     }
@@ -76,6 +76,10 @@ protected:
         luminosity in the correct bin of both the 1D F-vectors and the 3D f-vectors. */
     void detect(PhotonPackage* pp) override;
 
+    /** This function starts the summation of the SED arrays and of the data cubes across
+        processes. */
+    void startCommunication() override;
+
     /** This function calibrates and outputs the instrument data. The calibration takes care of the
         conversion from bolometric luminosity units to flux density units (for the F-vector) and
         surface brightness units (for the f-vector). Depending on the characteristics of the
@@ -103,6 +107,11 @@ protected:
         actual units. */
     void write() override;
 
+private:
+    /** This function returns the list of SED arrays recorded by the instrument that need to be
+        summed across processes; the combined SEDs are calculated from these after summation. */
+    vector<Array*> sedArrays();
+
     //======================== Data Members ========================
 
 private:
@@ -5,9 +5,11 @@
 
 #include "Instrument.hpp"
 #include "DustSystem.hpp"
+#include "FatalError.hpp"
 #include "Log.hpp"
 #include "PeerToPeerCommunicator.hpp"
 #include "PhotonPackage.hpp"
+#include "Random.hpp"
 #include "TimeLogger.hpp"
 
 ////////////////////////////////////////////////////////////////////
@@ -18,6 +20,7 @@ void Instrument::setupSelfBefore()
 
     // get a pointer to the dust system, if present, without performing setup
     _ds = find<DustSystem>(false);
+    _random = find<Random>();
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -29,14 +32,76 @@ void Instrument::sumResults(const vector<Array*>& arrays)
     Log* log = find<Log>();
     TimeLogger logger(log->verbose() && comm->isMultiProc() ? log : 0, "communication of the observed fluxes");
 
-    for (Array* arr : arrays) if (arr->size()) comm->sum(*arr);
+    // complete the summation if it was started, or perform it now
+    if (_communicating)
+    {
+        if (arrays != _communicatedArrays)
+            throw FATALERROR("The arrays to be summed differ from those for which the summation was started");
+        finishSumResults(_requests);
+        _requests.clear();
+        _communicatedArrays.clear();
+        _communicating = false;
+    }
+    else finishSumResults(startSumResults(arrays));
+}
+
+////////////////////////////////////////////////////////////////////
+
+vector<int> Instrument::startSumResults(const vector<Array*>& arrays)
+{
+    PeerToPeerCommunicator* comm = find<PeerToPeerCommunicator>();
+
+    vector<int> requests;
+    for (Array* arr : arrays) requests.push_back(comm->startSum(*arr));
+    return requests;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void Instrument::finishSumResults(const vector<int>& requests)
+{
+    PeerToPeerCommunicator* comm = find<PeerToPeerCommunicator>();
+
+    for (int request : requests) comm->finish(request);
+}
+
+////////////////////////////////////////////////////////////////////
+
+void Instrument::beginSumResults(const vector<Array*>& arrays)
+{
+    if (_communicating) return;
+    _requests = startSumResults(arrays);
+    _communicatedArrays = arrays;
+    _communicating = true;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void Instrument::startCommunication()
+{
 }
 
 ////////////////////////////////////////////////////////////////////
 
 double Instrument::opticalDepth(PhotonPackage* pp, double distance) const
 {
-    return _ds ? _ds->opticalDepth(pp,distance) : 0;
+    if (!_ds) return 0;
+
+    // stop the calculation as soon as the optical depth exceeds the culling depth, if any
+    double taucull = pp->cullingDepth();
+    double tau = _ds->opticalDepth(pp, distance, taucull);
+    if (tau <= taucull) return tau;
+
+    // play Russian roulette with a survival probability based on the upper limit for the transmission
+    double p = exp(taucull - tau);
+    if (_random->uniform() >= p)
+    {
+        pp->setCulled();
+        return std::numeric_limits<double>::infinity();
+    }
+
+    // for a survivor, calculate the complete optical depth and include the weight factor 1/p
+    return _ds->opticalDepth(pp, distance) + taucull - tau;
 }
 
 ////////////////////////////////////////////////////////////////////
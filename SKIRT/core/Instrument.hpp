@@ -12,6 +12,7 @@
 #include "Position.hpp"
 class DustSystem;
 class PhotonPackage;
+class Random;
 
 ////////////////////////////////////////////////////////////////////
 
@@ -43,8 +44,29 @@ protected:
         processes. The resulting arrays with the total fluxes are stored in the memory of the root
         process, replacing the original fluxes. This function can be called a different number of
         times from different instrument leaf classes, depending on which information they have
-        gathered. */
+        gathered. The summations for all arrays in the list are started before waiting for any
+        of them, so that the communications proceed concurrently. If the summation for the list
+        has already been started by beginSumResults(), the function merely waits for it to
+        complete; in that case, the specified list must contain the same arrays, in the same
+        order, as the list passed to beginSumResults(), or a fatal error is thrown. */
     void sumResults(const vector<Array*>& arrays);
+
+    /** This function starts summing a list of flux arrays element-wise across the different
+        processes, as described for sumResults(), without waiting for the communication to
+        complete. It returns a list of request identifiers that must be passed to
+        finishSumResults() before the arrays are accessed again. This allows a caller to overlap
+        the communication with other work, such as writing the results of another array. */
+    vector<int> startSumResults(const vector<Array*>& arrays);
+
+    /** This function starts summing a list of flux arrays element-wise across the different
+        processes, as described for sumResults(), and remembers the outstanding requests, so that
+        a subsequent call to sumResults() for the same list merely waits for the communication to
+        complete. It is intended for use by startCommunication() implementations. */
+    void beginSumResults(const vector<Array*>& arrays);
+
+    /** This function waits for the completion of the summations started by startSumResults(). */
+    void finishSumResults(const vector<int>& requests);
+
     friend class InstrumentFrame;  // so that InstrumentFrame can use sumResults()
 
 public:
@@ -66,6 +88,15 @@ public:
         can be provided. */
     virtual void detect(PhotonPackage* pp) = 0;
 
+    /** This function starts the summation across processes of the results that will be output by
+        the instrument, without waiting for the communication to complete. InstrumentSystem::write()
+        calls this function for all instruments before calling write() for any of them, so that
+        the communication for the different instruments proceeds concurrently. The write()
+        function then waits for the communication to complete where needed. All processes must
+        call this function together. The default implementation does nothing, in which case
+        write() performs all communication itself. */
+    virtual void startCommunication();
+
     /** This function calibrates the instrument and writes down the entire contents to a set of
         files. Its implementation must be provided in a subclass. */
     virtual void write() = 0;
@@ -73,14 +104,30 @@ public:
     /** This function is provided for use in subclasses. It calculates and returns the optical
         depth over the specified distance along the current path of the specified photon package,
         at the photon package's wavelength. If the distance is not specified, the complete path is
-        taken into account. */
+        taken into account.
+
+        If the photon package has a culling depth \f$\tau_\text{cull}\f$ (see
+        PhotonPackage::setCullingDepth()), the calculation stops as soon as the optical depth
+        exceeds that value, yielding a lower limit \f$\tau_\text{lim}\f$ for the optical depth.
+        The transmission is then at most \f$p=\exp(\tau_\text{cull}-\tau_\text{lim})\f$ times
+        the transmission for which the peel off would be worth detecting, and Russian roulette is
+        played with survival probability \f$p\f$. A culled photon package is marked as such and
+        the function returns infinity, so that it does not contribute to the detected flux. For a
+        surviving photon package, the complete optical depth is calculated and increased by
+        \f$\ln p\f$, so that the transmission includes the weight factor \f$1/p\f$. This
+        avoids most of the path traversal for peel offs that are strongly extinguished on their
+        way to the instrument. */
     double opticalDepth(PhotonPackage* pp, double distance=DBL_MAX) const;
 
     //======================== Data Members ========================
 
 private:
     // other data members
-    DustSystem* _ds{nullptr};   // cached pointer to dust system to call opticalDepth() function
+    DustSystem* _ds{nullptr};           // cached pointer to dust system to call opticalDepth() function
+    Random* _random{nullptr};           // cached pointer to the random generator for culling peel offs
+    vector<int> _requests;              // the outstanding requests started by beginSumResults()
+    vector<Array*> _communicatedArrays; // the arrays for which beginSumResults() started the summation
+    bool _communicating{false};         // true if a summation has been started by beginSumResults()
 };
 
 ////////////////////////////////////////////////////////////////////
@@ -5,8 +5,10 @@
 
 #include "InstrumentFrame.hpp"
 #include "FITSInOut.hpp"
+#include "InstrumentSystem.hpp"
 #include "LockFree.hpp"
 #include "MultiFrameInstrument.hpp"
+#include "PeerToPeerCommunicator.hpp"
 #include "PhotonPackage.hpp"
 #include "StellarSystem.hpp"
 #include "Units.hpp"
@@ -87,12 +89,8 @@ void InstrumentFrame::detect(PhotonPackage* pp)
 
 ////////////////////////////////////////////////////////////////////
 
-void InstrumentFrame::calibrateAndWriteData(int ell)
+void InstrumentFrame::listDataFrames(vector<Array*>& farrays, vector<string>& fnames)
 {
-    // construct list of data cube pointers and the corresponding file names
-    vector<Array*> farrays;
-    vector<string> fnames;
-
     if (_writeTotal)
     {
         farrays.push_back(&_ftotv);
@@ -107,9 +105,39 @@ void InstrumentFrame::calibrateAndWriteData(int ell)
             fnames.push_back("stellar_" + std::to_string(k));
         }
     }
+}
+
+////////////////////////////////////////////////////////////////////
 
-    // Sum the flux arrays element-wise across the different processes
-    _instrument->sumResults(farrays);
+void InstrumentFrame::startCommunication()
+{
+    if (_communicating) return;
+
+    vector<Array*> farrays;
+    vector<string> fnames;
+    listDataFrames(farrays, fnames);
+
+    _requests = _instrument->startSumResults(farrays);
+    _communicating = true;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void InstrumentFrame::calibrateAndWriteData(int ell)
+{
+    // construct list of data cube pointers and the corresponding file names
+    vector<Array*> farrays;
+    vector<string> fnames;
+    listDataFrames(farrays, fnames);
+
+    // Sum the flux arrays element-wise across the different processes, or complete the summation if it was started
+    if (_communicating)
+    {
+        _instrument->finishSumResults(_requests);
+        _requests.clear();
+        _communicating = false;
+    }
+    else _instrument->sumResults(farrays);
 
     // calibrate and output the arrays
     calibrateAndWriteDataFrames(ell, farrays, fnames);
@@ -147,14 +175,34 @@ void InstrumentFrame::calibrateAndWriteDataFrames(int ell, const vector<Array*>&
         (*farr) *= (unitfactor / (dlambda * area * fourpid2));
     }
 
-    // Write a FITS file for each array
+    // Hand each array to the frame sink, if there is one
+    const InstrumentSystem::FrameSink& sink = find<InstrumentSystem>()->frameSink();
+    if (sink)
+    {
+        if (find<PeerToPeerCommunicator>()->isRoot())
+        {
+            for (size_t q = 0; q < farrays.size(); q++)
+                sink(_instrument->instrumentName() + "_" + fnames[q] + "_" + std::to_string(ell), *(farrays[q]));
+        }
+        return;
+    }
+
+    // Schedule writing a FITS file for each array, concurrently with the files of other frames and instruments;
+    // the arrays are data members, so they stay alive until they have been written
+    InstrumentSystem* instrumentSystem = find<InstrumentSystem>();
+    int Nxp = _Nxp, Nyp = _Nyp;
+    double xpsiz = units->olength(_xpsiz), ypsiz = units->olength(_ypsiz);
+    double xpc = units->olength(_xpc), ypc = units->olength(_ypc);
+    string usb = units->usurfacebrightness(), ulength = units->ulength();
     for (size_t q = 0; q < farrays.size(); q++)
     {
+        const Array* farr = farrays[q];
         string filename = _instrument->instrumentName() + "_" + fnames[q] + "_" + std::to_string(ell);
         string description = fnames[q] + " flux " + std::to_string(ell);
-        FITSInOut::write(this, description, filename, *(farrays[q]), _Nxp, _Nyp, 1,
-                         units->olength(_xpsiz), units->olength(_ypsiz), units->olength(_xpc), units->olength(_ypc),
-                         units->usurfacebrightness(), units->ulength());
+        instrumentSystem->scheduleOutput([=]()
+        {
+            FITSInOut::write(this, description, filename, *farr, Nxp, Nyp, 1, xpsiz, ypsiz, xpc, ypc, usb, ulength);
+        });
     }
 }
 
@@ -74,6 +74,14 @@ public:
         each stellar component seperately. */
     void detect(PhotonPackage* pp);
 
+    /** This function starts summing the flux arrays of the instrument frame element-wise across the
+        different processes, without waiting for the communication to complete. It allows the
+        parent multi-frame instrument to overlap the communication for a frame with the calibration
+        and output of the previous frame. Calling this function is optional; if it has not been
+        called, calibrateAndWriteData() performs the summation itself. Calling it again before the
+        data has been written has no effect. */
+    void startCommunication();
+
     /** This function properly calibrates and outputs the instrument data. It operates similarly to
         SimpleInstrument::write(), but for the single wavelength specified through its wavelength
         index \f$\ell\f$. If the parent multi-frame instrument has the writeTotal flag turned on,
@@ -81,10 +89,15 @@ public:
         multi-frame instrument has the writeStellarComps flag turned on, this function writes the
         flux for each stellar component in a seperate output file, with a name that includes the
         stellar component index. In all cases, the name of each output file includes the wavelength
-        index. */
+        index. If a frame sink has been installed in the instrument system, the calibrated frames
+        are handed to the sink instead (see InstrumentSystem::setFrameSink()). */
     void calibrateAndWriteData(int ell);
 
 private:
+    /** This private function constructs the list of flux arrays to be output, and the
+        corresponding file names, depending on the flags of the parent multi-frame instrument. */
+    void listDataFrames(vector<Array*>& farrays, vector<string>& fnames);
+
     /** This private function properly calibrates and outputs the instrument data. It is invoked
         from the public calibrateAndWriteData() function. */
     void calibrateAndWriteDataFrames(int ell, const vector<Array*>& farrays, const vector<string>& fnames);
@@ -121,6 +134,10 @@ private:
     // total flux per pixel
     Array _ftotv;
     ArrayTable<2> _fcompvv;
+
+    // outstanding requests for the summation of the flux arrays across processes
+    vector<int> _requests;
+    bool _communicating{false};
 };
 
 ////////////////////////////////////////////////////////////////////
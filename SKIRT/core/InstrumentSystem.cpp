@@ -4,12 +4,56 @@
 ///////////////////////////////////////////////////////////////// */
 
 #include "InstrumentSystem.hpp"
+#include "Parallel.hpp"
+#include "ParallelFactory.hpp"
 
 ////////////////////////////////////////////////////////////////////
 
 void InstrumentSystem::write()
 {
-    for (Instrument* instrument : _instruments) instrument->write();
+    // start the communication for all instruments before waiting for any of them
+    for (Instrument* instrument : _instruments) instrument->startCommunication();
+
+    // complete the communication and calibration for each instrument, and write its output files concurrently
+    // as soon as they are ready, so that only the data cubes of a single instrument are kept in memory
+    _scheduling = true;
+    for (Instrument* instrument : _instruments)
+    {
+        instrument->write();
+        if (!_outputTasks.empty())
+            find<ParallelFactory>()->parallel()->call(this, &InstrumentSystem::doOutputTask, _outputTasks.size());
+        _outputTasks.clear();
+    }
+    _scheduling = false;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void InstrumentSystem::scheduleOutput(OutputTask task)
+{
+    if (_scheduling) _outputTasks.push_back(task);
+    else task();
+}
+
+////////////////////////////////////////////////////////////////////
+
+void InstrumentSystem::doOutputTask(size_t index)
+{
+    _outputTasks[index]();
+}
+
+////////////////////////////////////////////////////////////////////
+
+void InstrumentSystem::setFrameSink(FrameSink sink)
+{
+    _frameSink = sink;
+}
+
+////////////////////////////////////////////////////////////////////
+
+const InstrumentSystem::FrameSink& InstrumentSystem::frameSink() const
+{
+    return _frameSink;
 }
 
 ////////////////////////////////////////////////////////////////////
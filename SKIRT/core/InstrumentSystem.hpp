@@ -7,12 +7,18 @@
 #define INSTRUMENTSYSTEM_HPP
 
 #include "Instrument.hpp"
+#include <functional>
 
 //////////////////////////////////////////////////////////////////////
 
 /** An InstrumentSystem instance keeps a list of zero or more instruments. The instruments can be
     of various nature (e.g. photometric, spectroscopic,...) and do not need to be located at the
-    same observing position. */
+    same observing position.
+
+    By default, the instruments write their calibrated frames and data cubes to FITS files. A
+    program embedding the simulation can instead install a frame sink, which receives each
+    calibrated array in memory, so that it can process the results without a round trip through
+    the file system. */
 class InstrumentSystem : public SimulationItem
 {
     ITEM_CONCRETE(InstrumentSystem, SimulationItem, "an instrument system")
@@ -26,9 +32,58 @@ class InstrumentSystem : public SimulationItem
     //======================== Other Functions =======================
 
 public:
-    /** This function writes down the results of the instrument system. It calls the write()
-        function for each of the instruments. */
+    /** This function writes down the results of the instrument system. It first calls the
+        startCommunication() function for each of the instruments, so that the summation of the
+        results across processes proceeds concurrently for all instruments, and then calls the
+        write() function for each of the instruments. After each of these calls, it performs the
+        output tasks scheduled by the instrument (see scheduleOutput()) concurrently, so that the
+        files of an instrument are written in parallel, while the data cubes of only a single
+        instrument are kept in memory at any time. */
     void write();
+
+    /** Definition of the type of a function that writes an output file for an instrument. The
+        function must keep the data it writes alive, e.g. by capturing a shared pointer. */
+    using OutputTask = std::function<void ()>;
+
+    /** This function is called by instruments from their write() function to schedule the
+        specified output task, rather than writing a (large) output file immediately. The tasks
+        scheduled in this way are performed concurrently after the instrument has completed its
+        collective communication and calibration. If this function is called outside of the
+        write() function of the instrument system, the task is performed immediately. Tasks are
+        performed in every process; the FITS output functions write data only in the root
+        process. */
+    void scheduleOutput(OutputTask task);
+
+    /** Definition of the type of a function receiving a calibrated frame or data cube. The first
+        argument is the name of the FITS file that would otherwise have been written, without
+        simulation output prefix and filename extension, e.g. <tt>instrument_total</tt>. The
+        second argument contains the calibrated surface brightness values, in the same order and
+        in the same output units as they would have been written to the FITS file. */
+    using FrameSink = std::function<void (string name, const Array& data)>;
+
+    /** This function installs the specified frame sink. If a sink is installed, the frames and
+        data cubes recorded by the instruments that support this feature (the SimpleInstrument,
+        FrameInstrument, FullInstrument and MultiFrameInstrument classes) are handed to the sink
+        rather than written to FITS files. Any other output, such as the SED text files, is
+        written as usual. In a multi-process simulation, the sink is invoked only in the root
+        process. The sink is never invoked concurrently. */
+    void setFrameSink(FrameSink sink);
+
+    /** This function returns the installed frame sink, or an empty function object if no sink has
+        been installed. */
+    const FrameSink& frameSink() const;
+
+private:
+    /** This function serves as the parallelization body for performing the scheduled output tasks.
+        */
+    void doOutputTask(size_t index);
+
+    //======================== Data Members ========================
+
+private:
+    FrameSink _frameSink;
+    bool _scheduling{false};            // true while the instruments are being written
+    vector<OutputTask> _outputTasks;    // the output tasks scheduled by the instrument being written
 };
 
 ////////////////////////////////////////////////////////////////////
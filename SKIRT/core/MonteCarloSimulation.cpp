@@ -10,21 +10,47 @@
 #include "FatalError.hpp"
 #include "Instrument.hpp"
 #include "InstrumentSystem.hpp"
+#include "LockFree.hpp"
 #include "Log.hpp"
 #include "Parallel.hpp"
 #include "ParallelFactory.hpp"
 #include "PeerToPeerCommunicator.hpp"
 #include "PhotonPackage.hpp"
 #include "ProcessAssigner.hpp"
+#include "Profiler.hpp"
 #include "Random.hpp"
 #include "ShortArray.hpp"
 #include "StellarSystem.hpp"
 #include "StringUtils.hpp"
+#include "TextOutFile.hpp"
 #include "TimeLogger.hpp"
+#include "Units.hpp"
 #include "WavelengthGrid.hpp"
 
 ////////////////////////////////////////////////////////////////////
 
+namespace
+{
+    // returns the luminosity of the specified photon package relative to its launch luminosity
+    double relativeLuminosity(const PhotonPackage* pp)
+    {
+        double L0 = pp->launchLuminosity();
+        return L0 ? abs(pp->luminosity()/L0) : 1.;
+    }
+
+    // the peel-off culling statistics gathered by the current thread since the end of its previous
+    // chunk, indexed on instrument; keeping these per thread avoids touching shared memory in the
+    // hot loop
+    struct CullingCounts
+    {
+        vector<uint64_t> considered;
+        vector<uint64_t> culled;
+    };
+    thread_local CullingCounts threadCulling;
+}
+
+////////////////////////////////////////////////////////////////////
+
 void MonteCarloSimulation::setupSelfBefore()
 {
     Simulation::setupSelfBefore();
@@ -33,6 +59,14 @@ void MonteCarloSimulation::setupSelfBefore()
     _lambdagrid = find<WavelengthGrid>(false);
     _ss = find<StellarSystem>(false);
     _ds = find<DustSystem>(false);  // dust system is optional
+
+    // allocate the peel-off culling statistics
+    if (peelOffCulling())
+    {
+        size_t Ninstruments = _instrumentSystem->instruments().size();
+        _peelOffConsideredv = std::vector<std::atomic<uint64_t>>(Ninstruments);
+        _peelOffCulledv = std::vector<std::atomic<uint64_t>>(Ninstruments);
+    }
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -102,6 +136,18 @@ bool MonteCarloSimulation::emulationMode()
 
 ////////////////////////////////////////////////////////////////////
 
+void MonteCarloSimulation::prepareForRerun()
+{
+    _ss = find<StellarSystem>(false);
+    _ds = find<DustSystem>(false);
+    if (_ds) _ds->resetRunState();
+    for (auto& count : _peelOffConsideredv) count = 0;
+    for (auto& count : _peelOffCulledv) count = 0;
+    _totalCostv.resize(0);
+}
+
+////////////////////////////////////////////////////////////////////
+
 int MonteCarloSimulation::dimension() const
 {
     return max(_ss->dimension(), _ds ? _ds->dimension() : 1);
@@ -113,11 +159,14 @@ void MonteCarloSimulation::initProgress(string phase)
 {
     _phase = phase;
     _Ndone = 0;
+    _costv.resize(_Nlambda);
+    if (_totalCostv.size() != _Nlambda) _totalCostv.resize(_Nlambda);
 
     log()->info(std::to_string(_Npp) + " photon packages for "
                + (_Nlambda==1 ? "a single wavelength" : "each of " + std::to_string(_Nlambda) + " wavelengths"));
 
     log()->infoSetElapsed(3);
+    profiler()->beginPhase(phase);
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -134,6 +183,38 @@ void MonteCarloSimulation::logProgress(uint64_t extraDone)
 
 ////////////////////////////////////////////////////////////////////
 
+void MonteCarloSimulation::recordChunkCost(int ell, std::chrono::steady_clock::time_point started)
+{
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+    LockFree::add(_costv[ell], elapsed.count());
+}
+
+////////////////////////////////////////////////////////////////////
+
+void MonteCarloSimulation::logLoadBalance()
+{
+    _totalCostv += _costv;
+
+    PeerToPeerCommunicator* comm = communicator();
+    if (!comm->isMultiProc()) return;
+
+    // gather the total chunk time for each process
+    Array timev(comm->size());
+    timev[comm->rank()] = _costv.sum();
+    comm->sumAll(timev);
+
+    double mean = timev.sum() / timev.size();
+    if (mean > 0)
+    {
+        size_t busiest = std::max_element(begin(timev), end(timev)) - begin(timev);
+        log()->info("Load imbalance factor for the " + _phase + " phase: "
+                    + StringUtils::toString(timev[busiest]/mean, 'f', 3)
+                    + " (busiest process " + std::to_string(busiest) + ")");
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
 void MonteCarloSimulation::runStellarEmission()
 {
     TimeLogger logger(log(), "the stellar emission phase");
@@ -148,18 +229,22 @@ void MonteCarloSimulation::runStellarEmission()
 
     // Wait for the other processes to reach this point
     communicator()->wait("the stellar emission phase");
+    profiler()->endPhase();
+    logLoadBalance();
 }
 
 ////////////////////////////////////////////////////////////////////
 
 void MonteCarloSimulation::doStellarEmissionChunk(size_t index)
 {
+    auto started = std::chrono::steady_clock::now();
     int ell = index % _Nlambda;
     double L = _ss->luminosity(ell)/_Npp;
     if (L > 0)
     {
         double Lthreshold = L / minWeightReduction();
         PhotonPackage pp,ppp;
+        Profiler::Slot* slot = profiler()->slot();
 
         uint64_t remaining = _chunksize;
         while (remaining > 0)
@@ -170,43 +255,52 @@ void MonteCarloSimulation::doStellarEmissionChunk(size_t index)
                 _ss->launch(&pp,ell,L);
                 if (pp.luminosity()>0)
                 {
-                    peelOffEmission(&pp,&ppp);
+                    peelOffEmission(&pp,&ppp,slot);
                     if (_ds) while (true)
                     {
-                        _ds->fillOpticalDepth(&pp);
-                        if (_continuousScattering) continuousPeelOffScattering(&pp,&ppp);
-                        simulateEscapeAndAbsorption(&pp,_ds->hasDustAbsorption());
+                        _ds->fillOpticalDepth(&pp,slot);
+                        if (_continuousScattering) continuousPeelOffScattering(&pp,&ppp,slot);
+                        simulateEscapeAndAbsorption(&pp,_ds->hasDustAbsorption(),slot);
                         if (pp.luminosity()<=0 || (pp.luminosity()<=Lthreshold && pp.numScatt()>=_minScattEvents)) break;
                         simulatePropagation(&pp);
-                        if (!_continuousScattering) peelOffScattering(&pp,&ppp);
-                        simulateScattering(&pp);
+                        if (!_continuousScattering) peelOffScattering(&pp,&ppp,slot);
+                        simulateScattering(&pp,slot);
                     }
                 }
             }
+            if (slot) slot->count(Profiler::Counter::Launches, count);
             logProgress(count);
             remaining -= count;
         }
+        if (peelOffCulling()) flushPeelOffCulling();
     }
     else logProgress(_chunksize);
+
+    recordChunkCost(ell, started);
 }
 
 ////////////////////////////////////////////////////////////////////
 
-void MonteCarloSimulation::peelOffEmission(const PhotonPackage* pp, PhotonPackage* ppp)
+void MonteCarloSimulation::peelOffEmission(const PhotonPackage* pp, PhotonPackage* ppp, Profiler::Slot* slot)
 {
     Position bfr = pp->position();
 
-    for (Instrument* instr : _instrumentSystem->instruments())
+    const vector<Instrument*>& instruments = _instrumentSystem->instruments();
+    size_t Ninstruments = instruments.size();
+    for (size_t i=0; i<Ninstruments; i++)
     {
+        Instrument* instr = instruments[i];
         Direction bfknew = instr->bfkobs(bfr);
         ppp->launchEmissionPeelOff(pp, bfknew);
+        Profiler::Sample sample(slot, Profiler::Timer::Detect);
         instr->detect(ppp);
+        if (slot) slot->countPeelOff(i);
     }
 }
 
 ////////////////////////////////////////////////////////////////////
 
-void MonteCarloSimulation::peelOffScattering(const PhotonPackage* pp, PhotonPackage* ppp)
+void MonteCarloSimulation::peelOffScattering(const PhotonPackage* pp, PhotonPackage* ppp, Profiler::Slot* slot)
 {
     int Ncomp = _ds->numComponents();
     int ell = pp->ell();
@@ -229,16 +323,33 @@ void MonteCarloSimulation::peelOffScattering(const PhotonPackage* pp, PhotonPack
     }
 
     // Now do the actual peel-off
-    for (Instrument* instr : _instrumentSystem->instruments())
+    const vector<Instrument*>& instruments = _instrumentSystem->instruments();
+    size_t Ninstruments = instruments.size();
+    for (size_t i=0; i<Ninstruments; i++)
     {
+        Instrument* instr = instruments[i];
         Direction bfkobs = instr->bfkobs(bfr);
         Direction bfkx = instr->bfkx();
         Direction bfky = instr->bfky();
+
+        // Evaluate the phase function weights and, if requested, play Russian roulette on the peel-off
+        ShortArray<4> phiv(Ncomp);
+        for (int h=0; h<Ncomp; h++) phiv[h] = wv[h] * _ds->mix(h)->phaseFunctionValue(pp, bfkobs);
+        double weight = 1.;
+        double importance = 0.;
+        if (peelOffCulling())
+        {
+            double phi = 0;
+            for (int h=0; h<Ncomp; h++) phi += phiv[h];
+            importance = phi*relativeLuminosity(pp);
+            if (!survivePeelOff(i, importance, weight)) continue;
+        }
+
         double I = 0, Q = 0, U = 0, V = 0;
         for (int h=0; h<Ncomp; h++)
         {
             DustMix* mix = _ds->mix(h);
-            double w = wv[h] * mix->phaseFunctionValue(pp, bfkobs);
+            double w = weight * phiv[h];
             StokesVector sv;
             mix->scatteringPeelOffPolarization(&sv, pp, bfkobs, bfkx, bfky);
             I += w * sv.stokesI();
@@ -248,13 +359,18 @@ void MonteCarloSimulation::peelOffScattering(const PhotonPackage* pp, PhotonPack
         }
         ppp->launchScatteringPeelOff(pp, bfkobs, I);
         ppp->setPolarized(I, Q, U, V, pp->normal());
+        if (peelOffCulling()) setCullingDepth(ppp, importance*weight);
+        Profiler::Sample sample(slot, Profiler::Timer::Detect);
         instr->detect(ppp);
+        if (ppp->culled()) threadCulling.culled[i]++;
+        if (slot) slot->countPeelOff(i);
     }
 }
 
 ////////////////////////////////////////////////////////////////////
 
-void MonteCarloSimulation::continuousPeelOffScattering(const PhotonPackage *pp, PhotonPackage *ppp)
+void MonteCarloSimulation::continuousPeelOffScattering(const PhotonPackage *pp, PhotonPackage *ppp,
+                                                       Profiler::Slot* slot)
 {
     int ell = pp->ell();
     Position bfr = pp->position();
@@ -297,16 +413,33 @@ void MonteCarloSimulation::continuousPeelOffScattering(const PhotonPackage *pp,
                 double factorm = albedo * exp(-tau0) * (-expm1(-dtau));
                 double s = s0 + random()->uniform()*ds;
                 Position bfrnew(bfr+s*bfk);
-                for (Instrument* instr : _instrumentSystem->instruments())
+                const vector<Instrument*>& instruments = _instrumentSystem->instruments();
+                size_t Ninstruments = instruments.size();
+                for (size_t i=0; i<Ninstruments; i++)
                 {
+                    Instrument* instr = instruments[i];
                     Direction bfkobs = instr->bfkobs(bfrnew);
                     Direction bfkx = instr->bfkx();
                     Direction bfky = instr->bfky();
+
+                    // Evaluate the phase function weights and, if requested, play Russian roulette
+                    ShortArray<4> phiv(Ncomp);
+                    for (int h=0; h<Ncomp; h++) phiv[h] = wv[h] * _ds->mix(h)->phaseFunctionValue(pp, bfkobs);
+                    double weight = 1.;
+                    double importance = 0.;
+                    if (peelOffCulling())
+                    {
+                        double phi = 0;
+                        for (int h=0; h<Ncomp; h++) phi += phiv[h];
+                        importance = factorm*phi*relativeLuminosity(pp);
+                        if (!survivePeelOff(i, importance, weight)) continue;
+                    }
+
                     double I = 0, Q = 0, U = 0, V = 0;
                     for (int h=0; h<Ncomp; h++)
                     {
                         DustMix* mix = _ds->mix(h);
-                        double w = wv[h] * mix->phaseFunctionValue(pp, bfkobs);
+                        double w = weight * phiv[h];
                         StokesVector sv;
                         mix->scatteringPeelOffPolarization(&sv, pp, bfkobs, bfkx, bfky);
                         I += w * sv.stokesI();
@@ -316,7 +449,11 @@ void MonteCarloSimulation::continuousPeelOffScattering(const PhotonPackage *pp,
                     }
                     ppp->launchScatteringPeelOff(pp, bfrnew, bfkobs, factorm*I);
                     ppp->setPolarized(I, Q, U, V, pp->normal());
+                    if (peelOffCulling()) setCullingDepth(ppp, importance*weight);
+                    Profiler::Sample sample(slot, Profiler::Timer::Detect);
                     instr->detect(ppp);
+                    if (ppp->culled()) threadCulling.culled[i]++;
+                    if (slot) slot->countPeelOff(i);
                 }
             }
         }
@@ -325,7 +462,8 @@ void MonteCarloSimulation::continuousPeelOffScattering(const PhotonPackage *pp,
 
 ////////////////////////////////////////////////////////////////////
 
-void MonteCarloSimulation::simulateEscapeAndAbsorption(PhotonPackage* pp, bool storeabsorptionrates)
+void MonteCarloSimulation::simulateEscapeAndAbsorption(PhotonPackage* pp, bool storeabsorptionrates,
+                                                       Profiler::Slot* slot)
 {
     double taupath = pp->tau();
     int ell = pp->ell();
@@ -351,7 +489,9 @@ void MonteCarloSimulation::simulateEscapeAndAbsorption(PhotonPackage* pp, bool s
                     double expfactorm = -expm1(-dtau);
                     double Lintm = L * exp(-taustart) * expfactorm;
                     double Labsm = (1.0-albedo) * Lintm;
+                    Profiler::Sample sample(slot, Profiler::Timer::Absorb);
                     _ds->absorb(m,ell,Labsm,ynstellar);
+                    if (slot) slot->count(Profiler::Counter::AbsorptionWrites);
                 }
             }
         }
@@ -396,7 +536,9 @@ void MonteCarloSimulation::simulateEscapeAndAbsorption(PhotonPackage* pp, bool s
                 if (storeabsorptionrates)
                 {
                     double Labsm = (1.0-albedo) * Lintm;
+                    Profiler::Sample sample(slot, Profiler::Timer::Absorb);
                     _ds->absorb(m,ell,Labsm,ynstellar);
+                    if (slot) slot->count(Profiler::Counter::AbsorptionWrites);
                 }
             }
         }
@@ -428,8 +570,11 @@ void MonteCarloSimulation::simulatePropagation(PhotonPackage* pp)
 
 ////////////////////////////////////////////////////////////////////
 
-void MonteCarloSimulation::simulateScattering(PhotonPackage* pp)
+void MonteCarloSimulation::simulateScattering(PhotonPackage* pp, Profiler::Slot* slot)
 {
+    Profiler::Sample sample(slot, Profiler::Timer::SimulateScattering);
+    if (slot) slot->count(Profiler::Counter::Scatterings);
+
     // Randomly select a dust mix; the probability of each dust component h is weighted by kappasca(h)*rho(m,h)
     DustMix* mix = _ds->randomMixForPosition(pp->position(), pp->ell());
 
@@ -440,11 +585,104 @@ void MonteCarloSimulation::simulateScattering(PhotonPackage* pp)
 
 ////////////////////////////////////////////////////////////////////
 
+bool MonteCarloSimulation::survivePeelOff(size_t i, double importance, double& weight)
+{
+    CullingCounts& counts = threadCulling;
+    if (counts.considered.size() <= i)
+    {
+        counts.considered.resize(i+1);
+        counts.culled.resize(i+1);
+    }
+    counts.considered[i]++;
+    double threshold = peelOffCullingThreshold();
+    if (importance >= threshold)
+    {
+        weight = 1.;
+        return true;
+    }
+    double p = importance/threshold;
+    if (p > 0 && random()->uniform() < p)
+    {
+        weight = 1./p;
+        return true;
+    }
+    counts.culled[i]++;
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void MonteCarloSimulation::setCullingDepth(PhotonPackage* ppp, double importance)
+{
+    // the transmission towards the instrument for which the importance would drop to the threshold
+    ppp->setCullingDepth(std::log(importance/peelOffCullingThreshold()));
+}
+
+////////////////////////////////////////////////////////////////////
+
+void MonteCarloSimulation::flushPeelOffCulling()
+{
+    CullingCounts& counts = threadCulling;
+    for (size_t i=0; i<counts.considered.size(); i++)
+    {
+        if (counts.considered[i])
+        {
+            _peelOffConsideredv[i] += counts.considered[i];
+            _peelOffCulledv[i] += counts.culled[i];
+            counts.considered[i] = 0;
+            counts.culled[i] = 0;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
+void MonteCarloSimulation::logPeelOffCulling()
+{
+    const vector<Instrument*>& instruments = _instrumentSystem->instruments();
+    size_t Ninstruments = instruments.size();
+
+    // Aggregate the statistics over all processes
+    Array countv(2*Ninstruments);
+    for (size_t i=0; i<Ninstruments; i++)
+    {
+        countv[2*i] = _peelOffConsideredv[i];
+        countv[2*i+1] = _peelOffCulledv[i];
+    }
+    communicator()->sumAll(countv);
+
+    for (size_t i=0; i<Ninstruments; i++)
+    {
+        if (countv[2*i] > 0)
+            log()->info("Instrument " + instruments[i]->instrumentName() + ": culled "
+                        + StringUtils::toString(countv[2*i+1]/countv[2*i]*100., 'f', 1) + "% of "
+                        + StringUtils::toString(countv[2*i], 'e', 2) + " scattering peel-offs");
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
 void MonteCarloSimulation::write()
 {
+    if (peelOffCulling()) logPeelOffCulling();
+
     TimeLogger logger(log(), "writing results");
     _instrumentSystem->write();
     if (_ds) _ds->write();
+
+    // Output the measured cost per wavelength in data parallelization mode, if requested
+    if (writeWavelengthCosts() && communicator()->dataParallel() && _totalCostv.size())
+    {
+        communicator()->sumAll(_totalCostv);
+        TextOutFile file(this, "wavelengthcosts", "wavelength costs");
+        file.addColumn("lambda (" + units()->uwavelength() + ")", 'e', 8);
+        file.addColumn("wall time spent on the wavelength by all processes (s)", 'e', 8);
+        for (size_t ell=0; ell<_Nlambda; ell++)
+            file.writeRow(vector<double>({ units()->owavelength(_lambdagrid->lambda(ell)), _totalCostv[ell] }));
+    }
+
+    // Output the performance profile, if requested
+    profiler()->write();
 }
 
 ////////////////////////////////////////////////////////////////////
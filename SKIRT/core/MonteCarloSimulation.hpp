@@ -9,6 +9,7 @@
 #include "Simulation.hpp"
 #include "InstrumentSystem.hpp"
 #include <atomic>
+#include <chrono>
 class DustSystem;
 class PhotonPackage;
 class ProcessAssigner;
@@ -58,12 +59,28 @@ class MonteCarloSimulation : public Simulation
         ATTRIBUTE_DEFAULT_VALUE(continuousScattering, "false")
         ATTRIBUTE_SILENT(continuousScattering)
 
+    PROPERTY_BOOL(peelOffCulling, "use Russian roulette to cull low-weight scattering peel-offs")
+        ATTRIBUTE_DEFAULT_VALUE(peelOffCulling, "false")
+        ATTRIBUTE_SILENT(peelOffCulling)
+
+    PROPERTY_DOUBLE(peelOffCullingThreshold, "the relative peel-off weight below which Russian roulette is played")
+        ATTRIBUTE_MIN_VALUE(peelOffCullingThreshold, "]0")
+        ATTRIBUTE_MAX_VALUE(peelOffCullingThreshold, "1]")
+        ATTRIBUTE_DEFAULT_VALUE(peelOffCullingThreshold, "0.01")
+        ATTRIBUTE_RELEVANT_IF(peelOffCullingThreshold, "peelOffCulling")
+        ATTRIBUTE_SILENT(peelOffCullingThreshold)
+
+    PROPERTY_BOOL(writeWavelengthCosts, "output the measured cost per wavelength")
+        ATTRIBUTE_DEFAULT_VALUE(writeWavelengthCosts, "false")
+        ATTRIBUTE_SILENT(writeWavelengthCosts)
+
     ITEM_END()
 
     //============= Construction - Setup - Destruction =============
 
 protected:
-    /** This function caches some frequently used pointers. */
+    /** This function caches some frequently used pointers and, if peel-off culling is enabled,
+        allocates the per-instrument culling statistics. */
     void setupSelfBefore() override;
 
     /** This function determines how the specified number of photon packages should be split over
@@ -132,6 +149,13 @@ protected:
         optial depth distribution after a scattering event that is a constant function
         of \f$\tau\f$ rather than an exponentially declining function. */
 
+    /** \fn writeWavelengthCosts
+        If this flag is enabled and the simulation runs in data parallelization mode, the measured
+        cost per wavelength, summed over all phases and processes, is written to a column text file
+        at the end of the simulation. This file can be specified as the assignmentCostsFilename
+        property of the wavelength grid in a subsequent run to balance its wavelength assignment
+        (see WavelengthGrid::assignmentCostsFilename()). */
+
 public:
     /** This function puts the simulation in emulation mode. Specifically, it sets an internal flag
         that can be queried other classes and it sets the number of photon packages to zero. */
@@ -140,6 +164,17 @@ public:
     /** This function returns true if the simulation has been put in emulation mode. */
     bool emulationMode();
 
+    /** This function prepares a simulation that has already been set up and run for running
+        again through the run() function, so that the expensive setup of items such as the dust
+        system and the wavelength grid can be reused (a warm start). Before calling this function,
+        the caller may have replaced the stellar system, the dust system and/or the instrument
+        system by new items, which must be set up only after calling this function, because their
+        setup may rely on the cached pointers to the other items. The function refreshes the
+        cached pointers to the stellar and dust systems, resets the peel-off culling statistics and
+        the accumulated wavelength costs, and asks the dust system to discard the results of the
+        previous run. Warm starts are supported for oligochromatic simulations only. */
+    void prepareForRerun();
+
     //======================== Other Functions =======================
 
 public:
@@ -152,7 +187,9 @@ public:
 
 protected:
     /** This function initializes the progress counter used in logprogress() for the specified
-        phase and logs the number of photon packages and wavelengths to be processed. */
+        phase and logs the number of photon packages and wavelengths to be processed. It also starts
+        the corresponding phase in the profiler; the caller should end that phase by calling
+        Profiler::endPhase() once all processes have completed the phase. */
     void initProgress(string phase);
 
     /** This function logs a progress message for the phase specified in the initprogress()
@@ -161,6 +198,19 @@ protected:
         number of photon packages processed since the most recent invocation in the same thread. */
     void logProgress(uint64_t extraDone);
 
+    /** This function adds the wall time elapsed since the specified starting time to the measured
+        cost of the specified wavelength index for the current phase. It should be called at the end
+        of each chunk body, with the starting time obtained at the beginning of the chunk. */
+    void recordChunkCost(int ell, std::chrono::steady_clock::time_point started);
+
+    /** This function should be called at the end of each photon shooting phase, after all
+        processes have completed the phase. When running with multiple processes, it logs the load
+        imbalance factor for the phase, i.e. the ratio of the largest total chunk time spent by a
+        single process to the mean over all processes. It also accumulates the measured
+        per-wavelength costs, which are written to file by the write() function if requested (see
+        writeWavelengthCosts()). */
+    void logLoadBalance();
+
     /** This function drives the stellar emission phase in a Monte Carlo simulation. It consists of
         a parallelized loop that iterates over \f$N_{\text{pp}}\times N_\lambda\f$ monochromatic
         photons packages. Within this loop, the function simulates the life cycle of a single
@@ -193,8 +243,9 @@ protected:
         that it is emitted in any other direction. For each instrument in the instrument system,
         the function creates such a peel-off photon package and feeds it to the instrument. The
         first argument specifies the photon package that was just emitted; the second argument
-        provides a placeholder peel off photon package for use by the function. */
-    void peelOffEmission(const PhotonPackage* pp, PhotonPackage* ppp);
+        provides a placeholder peel off photon package for use by the function; the last argument
+        specifies the profiler slot for the current thread, or null if profiling is not active. */
+    void peelOffEmission(const PhotonPackage* pp, PhotonPackage* ppp, Profiler::Slot* slot);
 
     /** This function simulates the peel-off of a photon package before a scattering event. This
         means that, just before a scattering event, we create peel-off or shadow photon packages,
@@ -227,8 +278,23 @@ protected:
         Stokes vector. For each instrument in the instrument system, the function creates such a
         peel-off photon package and feeds it to the instrument. The first argument specifies the
         photon package that was just emitted; the second argument provides a placeholder peel off
-        photon package for use by the function. */
-    void peelOffScattering(const PhotonPackage* pp, PhotonPackage* ppp);
+        photon package for use by the function. The last argument specifies the profiler slot for
+        the current thread, or null if profiling is not active.
+
+        If the \em peelOffCulling option is enabled, the function first estimates the importance of
+        each peel-off as the ratio of its expected luminosity (the luminosity of the photon package
+        multiplied by the phase function weight, using unity as an upper bound for the transmission
+        towards the observer) to the luminosity with which the photon package was launched. If
+        this ratio falls below the \em peelOffCullingThreshold, the peel-off survives with a
+        probability equal to the ratio divided by the threshold, and the luminosity of a surviving
+        peel-off is increased by the inverse of that probability. This Russian roulette preserves
+        the expectation value of the detected flux, while avoiding the polarization calculation and
+        the (costly) path determination for most negligible peel-offs. For the remaining peel-offs,
+        the actual transmission is bounded while the optical depth towards the instrument is being
+        calculated: the peel-off receives a culling depth for which its importance, including the
+        transmission, would drop to the threshold, and a second round of Russian roulette is played
+        as soon as the optical depth exceeds that value (see Instrument::opticalDepth()). */
+    void peelOffScattering(const PhotonPackage* pp, PhotonPackage* ppp, Profiler::Slot* slot);
 
     /** This function simulates the continuous peel-off of a series of photon packages along the
         path of the original photon package. It should be called before the
@@ -246,8 +312,32 @@ protected:
         the dust and \f$\tau_{\ell,n}\f$ the optical depth measured from the initial position of
         the path until the exit point of the \f$n\f$'th dust cell along the path. The second weight
         factor \f$w_{\text{obs}}\f$ compensates for the change in propagation direction, and is
-        determined as explained for the function peeloffscattering(). */
-    void continuousPeelOffScattering(const PhotonPackage* pp, PhotonPackage* ppp);
+        determined as explained for the function peeloffscattering(). If the \em peelOffCulling
+        option is enabled, low-weight peel-offs are culled as described for that function, with the
+        importance estimate including the weight factor \f$w_\text{cell}\f$. The last argument
+        specifies the profiler slot for the current thread, or null if profiling is not active. */
+    void continuousPeelOffScattering(const PhotonPackage* pp, PhotonPackage* ppp, Profiler::Slot* slot);
+
+    /** This function plays Russian roulette on a scattering peel-off towards the instrument with
+        index \em i, given the estimated importance of the peel-off relative to the launch
+        luminosity of the photon package. It returns false if the peel-off should be discarded.
+        Otherwise it returns true and sets \em weight to the factor by which the luminosity of the
+        surviving peel-off must be multiplied (unity if no roulette was played). The function also
+        updates the culling statistics for the instrument, which are kept per execution thread. */
+    bool survivePeelOff(size_t i, double importance, double& weight);
+
+    /** This function sets the culling depth of the specified peel-off photon package, given the
+        importance of the peel-off relative to the launch luminosity of the photon package,
+        including the weight factor resulting from survivePeelOff(). The culling depth is the
+        optical depth towards the instrument for which the importance drops to the \em
+        peelOffCullingThreshold (see Instrument::opticalDepth()). */
+    void setCullingDepth(PhotonPackage* ppp, double importance);
+
+    /** This function adds the peel-off culling statistics gathered by the current execution thread
+        to the totals for the simulation, and resets the statistics for the thread. It should be
+        called at the end of each chunk that may have performed scattering peel-offs, so that the
+        hot loop itself does not update shared memory. */
+    void flushPeelOffCulling();
 
     /** This function simulates the escape from the system and the absorption by dust of a fraction
         of the luminosity of a photon package. It actually splits the luminosity \f$L_\ell\f$ of
@@ -299,8 +389,9 @@ protected:
         cell to cell, \f[ L_\ell^{\text{sca}} = L_\ell\, \sum_{n=0}^{N-1} \varpi_{\ell,n} \left(
         {\text{e}}^{-\tau_{\ell,n-1}} - {\text{e}}^{-\tau_{\ell,n}} \right). \f] Also in this case,
         it is easy to see that \f[ L_\ell^{\text{esc}} + L_\ell^{\text{sca}} + \sum_{n=0}^{N-1}
-        L_{\ell,n}^{\text{abs}} = L_\ell. \f] */
-    void simulateEscapeAndAbsorption(PhotonPackage* pp, bool storeabsorptionrates);
+        L_{\ell,n}^{\text{abs}} = L_\ell. \f] The last argument specifies the profiler slot for the
+        current thread, or null if profiling is not active. */
+    void simulateEscapeAndAbsorption(PhotonPackage* pp, bool storeabsorptionrates, Profiler::Slot* slot);
 
     /** This function determines the next scattering location of a photon package and the simulates
         the propagation to this position. Given the total optical depth along the path of the
@@ -339,14 +430,21 @@ protected:
         \f$\kappa_{\ell,h}^{\text{sca}}\f$ is the scattering coefficient corresponding to the
         \f$h\f$'th dust component respectively. When a random dust component is generated, a random
         propagation direction and polarization state are obtained from the corresponding scattering
-        phase function. */
-    void simulateScattering(PhotonPackage* pp);
+        phase function. The last argument specifies the profiler slot for the current thread, or
+        null if profiling is not active. */
+    void simulateScattering(PhotonPackage* pp, Profiler::Slot* slot);
 
     /** This function performs the final step in a Monte Carlo simulation. It writes out the useful
         information in the instrument system and in the dust system so that the results of the
-        simulation can be analyzed. */
+        simulation can be analyzed. In data parallelization mode, and if the writeWavelengthCosts
+        property is enabled, it also writes the measured cost per wavelength, summed over all
+        phases and processes, to a text file. */
     void write();
 
+    /** This function logs, for each instrument, the fraction of scattering peel-offs that was
+        culled by Russian roulette, aggregated over all processes. */
+    void logPeelOffCulling();
+
     //======================== Data Members ========================
 
 protected:
@@ -369,6 +467,14 @@ private:
     string _phase;           // a string identifying the photon shooting phase for use in the log message
     std::atomic<uint64_t> _Ndone;  // the number of photon packages processed so far (for all wavelengths)
 
+    // *** data members used for measuring the cost per wavelength
+    Array _costv;        // the wall time spent on each wavelength in the current phase by this process
+    Array _totalCostv;   // the wall time spent on each wavelength in all phases so far by this process
+
+    // *** data members used for peel-off culling, indexed on instrument, updated once per chunk by flushPeelOffCulling()
+    std::vector<std::atomic<uint64_t>> _peelOffConsideredv;  // the number of scattering peel-offs considered
+    std::vector<std::atomic<uint64_t>> _peelOffCulledv;      // the number of scattering peel-offs discarded
+
     // *** data member to remember whether emulation mode is enabled
     bool _emulationMode{false};
 };
@@ -29,11 +29,22 @@ void MultiFrameInstrument::detect(PhotonPackage* pp)
 
 ////////////////////////////////////////////////////////////////////
 
+void MultiFrameInstrument::startCommunication()
+{
+    if (!_frames.empty()) _frames[0]->startCommunication();
+}
+
+////////////////////////////////////////////////////////////////////
+
 void MultiFrameInstrument::write()
 {
+    // start the communication for the next frame before calibrating and writing the current one,
+    // so that the summation across processes overlaps with the output
     int Nlambda = _frames.size();
+    if (Nlambda) _frames[0]->startCommunication();   // does nothing if startCommunication() was called
     for (int ell=0; ell<Nlambda; ell++)
     {
+        if (ell+1 < Nlambda) _frames[ell+1]->startCommunication();
         _frames[ell]->calibrateAndWriteData(ell);
     }
 }
@@ -50,9 +50,15 @@ protected:
         wavelengths are handed to different instrument frames. */
     void detect(PhotonPackage* pp) override;
 
+    /** This function starts the summation of the fluxes for the first wavelength across
+        processes. The summations for the other wavelengths are started by write(). */
+    void startCommunication() override;
+
     /** This function calibrates and outputs the instrument data. It operates similarly to
         SimpleInstrument::write(), except that a separate output file is written for each
-        wavelength, using filenames that include the wavelength index \f$\ell\f$. */
+        wavelength, using filenames that include the wavelength index \f$\ell\f$. The summation of
+        the fluxes for the next wavelength across processes is started before the current
+        wavelength is calibrated and written, so that communication and output overlap. */
     void write() override;
 };
 
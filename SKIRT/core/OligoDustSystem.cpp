@@ -52,6 +52,14 @@ double OligoDustSystem::absorbedLuminosity(int m, int ell) const
     return _Labsvv(m,ell);
 }
 
+//////////////////////////////////////////////////////////////////////
+
+void OligoDustSystem::resetRunState()
+{
+    DustSystem::resetRunState();
+    _Labsvv.setToZero();
+}
+
 ////////////////////////////////////////////////////////////////////
 
 // Private class to output a FITS file with the mean intensity of the radiation field
@@ -125,6 +133,7 @@ namespace
         void body(size_t j)
         {
             double z = zd ? (zbase + j*zpsize) : 0.;
+            Array JJv;
             for (int i=0; i<Np; i++)
             {
                 double x = xd ? (xbase + i*xpsize) : 0.;
@@ -133,7 +142,7 @@ namespace
                 int m = _grid->whichCell(bfr);
                 if (m!=-1)
                 {
-                    const Array& JJv = _ds->meanIntensity(m);
+                    _ds->meanIntensity(m, JJv);
                     for (int ell=0; ell<Nlambda; ell++)
                     {
                         int l = i + Np*j + Np*Np*ell;
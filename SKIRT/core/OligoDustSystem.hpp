@@ -53,6 +53,10 @@ public:
         simply reads the corresponding absorption rate counter. */
     double absorbedLuminosity(int m, int ell) const override;
 
+    /** This function discards the results of a previous run, including the absorption rates
+        accumulated in each cell if these are being recorded. */
+    void resetRunState() override;
+
     /** If the writeMeanIntensity attribute is true, this function writes out FITS files (named
         <tt>prefix_ds_JXX.fits</tt>) with the mean radiation field in the coordinate planes. Each
         of these maps contains 1024 x 1024 pixels, and covers as a field of view the total
@@ -20,6 +20,7 @@
 #include "TextOutFile.hpp"
 #include "Units.hpp"
 #include "WavelengthGrid.hpp"
+#include <thread>
 
 ////////////////////////////////////////////////////////////////////
 
@@ -131,6 +132,40 @@ void PanDustSystem::setupSelfAfter()
         }
     }
 
+    // allocate the per-cell cache for quantities derived from the radiation field
+    if (hasDustEmission())
+    {
+        int Ncomp = numComponents();
+        _sigmadlambdavv.resize(Ncomp,_Nlambda);
+        _sigmalambdadlambdavv.resize(Ncomp,_Nlambda);
+        for (int h=0; h<Ncomp; h++)
+        {
+            for (int ell=0; ell<_Nlambda; ell++)
+            {
+                _sigmadlambdavv(h,ell) = mix(h)->sigmaabs(ell) * wg->dlambda(ell);
+                _sigmalambdadlambdavv(h,ell) = _sigmadlambdavv(h,ell) * wg->lambda(ell);
+            }
+        }
+        // in data parallel mode, the cache holds only the cells assigned to this process
+        int Nowned = _assigner ? _assigner->assigned() : Ncells;
+        _summaryvv.resize(Nowned, 2+2*Ncomp);
+        _summaryStatev = vector<std::atomic<char>>(Nowned);
+
+        // the equilibrium temperatures are cached only if they will be needed for output
+        if (_writeTemperature)
+        {
+            int Npop = 0;
+            _popOffsetv.resize(Ncomp);
+            for (int h=0; h<Ncomp; h++)
+            {
+                _popOffsetv[h] = Npop;
+                Npop += mix(h)->numPopulations();
+            }
+            _Teqvv.resize(Nowned, Npop);
+            _TeqStatev = vector<std::atomic<char>>(Nowned);
+        }
+    }
+
     // write emissivities if so requested
     if (writeEmissivity())
     {
@@ -216,6 +251,16 @@ void PanDustSystem::absorb(int m, int ell, double DeltaL, bool ynstellar)
 void PanDustSystem::resetDustAbsorption()
 {
     _LabsDustvv.reset();
+    invalidateCache();
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void PanDustSystem::retainDustAbsorption()
+{
+    // Only callable after sumResults
+    _LabsDustvv.reopen();
+    invalidateCache();
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -226,7 +271,33 @@ double PanDustSystem::absorbedLuminosity(int m, int ell) const
     double sum = 0;
     if (_haveLabsStel) sum += _LabsStelvv(m,ell);
     if (_haveLabsDust) sum += _LabsDustvv(m,ell);
-    return sum;
+
+    // with incremental self-absorption, the accumulated corrections may cause a small negative result
+    return sum > 0. ? sum : 0.;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    // Returns true if the calling thread has claimed the cache entry with the specified state and should
+    // thus fill it, or false if the entry has already been filled. If another thread is filling the entry,
+    // this function waits until that thread is done.
+    bool claimCacheEntry(std::atomic<char>& state)
+    {
+        char expected = 0;
+        if (state.compare_exchange_strong(expected, 1)) return true;
+        while (state.load() != 2) std::this_thread::yield();
+        return false;
+    }
+
+    // Returns a work array for the mean intensity, private to the calling thread, so that the radiation field
+    // can be obtained for many cells without allocating memory for each cell.
+    Array& workArray()
+    {
+        thread_local Array Jv;
+        return Jv;
+    }
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -234,14 +305,47 @@ double PanDustSystem::absorbedLuminosity(int m, int ell) const
 double PanDustSystem::absorbedLuminosity(int m) const
 {
     // Only callable on cells assigned to this process, and after sumResults
-    double sum = 0;
+    cacheFieldSummaries(m);
+    return _summaryvv(cacheIndex(m),0);
+}
 
-    if (_haveLabsStel)
-        sum += _LabsStelvv.sumRow(m);
-    if (_haveLabsDust)
-        sum += _LabsDustvv.sumRow(m);
+//////////////////////////////////////////////////////////////////////
 
-    return sum;
+double PanDustSystem::bolometricMeanIntensity(int m) const
+{
+    cacheFieldSummaries(m);
+    return _summaryvv(cacheIndex(m),1);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+double PanDustSystem::planckabs(int m, int h) const
+{
+    cacheFieldSummaries(m);
+    return _summaryvv(cacheIndex(m),2+2*h);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+double PanDustSystem::meanAbsorbedWavelength(int m, int h) const
+{
+    cacheFieldSummaries(m);
+    return _summaryvv(cacheIndex(m),3+2*h);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+double PanDustSystem::equilibriumTemperature(int m, int h, int c) const
+{
+    if (_TeqStatev.empty())
+    {
+        Array& Jv = workArray();
+        meanIntensity(m, Jv);
+        return mix(h)->equilibrium(Jv,c);
+    }
+
+    cacheTemperatures(m);
+    return _Teqvv(cacheIndex(m),_popOffsetv[h]+c);
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -286,10 +390,95 @@ void PanDustSystem::calculateDustEmission()
 
 ////////////////////////////////////////////////////////////////////
 
+void PanDustSystem::calculateDustEmission(const vector<char>& updatev)
+{
+    if (_dustEmissivity)
+    {
+        sumResults();
+        _dustLib->calculate(updatev);
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
 void PanDustSystem::sumResults()
 {
-    if (_haveLabsStel) _LabsStelvv.switchScheme();
-    if (_haveLabsDust) _LabsDustvv.switchScheme();
+    // start the communication for both tables before waiting for either of them
+    if (_haveLabsStel) _LabsStelvv.startSwitchScheme();
+    if (_haveLabsDust) _LabsDustvv.startSwitchScheme();
+    if (_haveLabsStel) _LabsStelvv.finishSwitchScheme();
+    if (_haveLabsDust) _LabsDustvv.finishSwitchScheme();
+    invalidateCache();
+}
+
+////////////////////////////////////////////////////////////////////
+
+int PanDustSystem::cacheIndex(int m) const
+{
+    return _assigner ? _assigner->relativeIndex(m) : m;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void PanDustSystem::invalidateCache()
+{
+    for (auto& state : _summaryStatev) state = 0;
+    for (auto& state : _TeqStatev) state = 0;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void PanDustSystem::cacheFieldSummaries(int m) const
+{
+    int mc = cacheIndex(m);
+    if (claimCacheEntry(_summaryStatev[mc]))
+    {
+        // get the radiation field and the absorbed luminosity in a single sweep
+        Array& Jv = workArray();
+        _summaryvv(mc,0) = meanIntensity(m, Jv);
+
+        // calculate the bolometric summaries
+        const Array& dlambdav = find<WavelengthGrid>()->dlambdav();
+        double Jbol = 0.;
+        for (int ell=0; ell<_Nlambda; ell++) Jbol += Jv[ell] * dlambdav[ell];
+        _summaryvv(mc,1) = Jbol;
+
+        int Ncomp = numComponents();
+        for (int h=0; h<Ncomp; h++)
+        {
+            const Array& sigmadlambdav = _sigmadlambdavv[h];
+            const Array& sigmalambdadlambdav = _sigmalambdadlambdavv[h];
+            double sum0 = 0.;
+            double sum1 = 0.;
+            for (int ell=0; ell<_Nlambda; ell++)
+            {
+                sum0 += sigmadlambdav[ell] * Jv[ell];
+                sum1 += sigmalambdadlambdav[ell] * Jv[ell];
+            }
+            _summaryvv(mc,2+2*h) = sum0;
+            _summaryvv(mc,3+2*h) = sum1/sum0;
+        }
+        _summaryStatev[mc] = 2;
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
+void PanDustSystem::cacheTemperatures(int m) const
+{
+    int mc = cacheIndex(m);
+    if (claimCacheEntry(_TeqStatev[mc]))
+    {
+        Array& Jv = workArray();
+        meanIntensity(m, Jv);
+        int Ncomp = numComponents();
+        for (int h=0; h<Ncomp; h++)
+        {
+            int Npop = mix(h)->numPopulations();
+            for (int c=0; c<Npop; c++) _Teqvv(mc,_popOffsetv[h]+c) = mix(h)->equilibrium(Jv,c);
+        }
+        _TeqStatev[mc] = 2;
+    }
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -330,6 +519,9 @@ namespace
         // results vector, properly sized in constructor and initialized to zero in setup()
         Array tempv;
 
+        // index of the dust cell sampled by each pixel in the current plane, or -1 for none, set in body()
+        vector<int> cellv;
+
     public:
         // constructor
         WriteTempCut(const PanDustSystem* ds)
@@ -358,6 +550,7 @@ namespace
             for (int h=0; h<_ds->numComponents(); h++) Nmaps += _ds->mix(h)->numPopulations();
 
             tempv.resize(Np*Np*Nmaps);
+            cellv.resize(Np*Np);
         }
 
         // setup for calculating a specific coordinate plane
@@ -385,11 +578,11 @@ namespace
                 double y = yd ? (ybase + (zd ? i : j)*ypsize) : 0.;
                 Position bfr(x,y,z);
                 int m = _grid->whichCell(bfr);
+                cellv[i + Np*j] = m;
 
                 bool m_is_available = !_dataParallel || _cellAssigner->validIndex(m);
                 if (m_is_available && m!=-1 && _ds->absorbedLuminosity(m)>0.0)
                 {
-                    const Array& Jv = _ds->meanIntensity(m);
                     int p = 0;
                     for (int h=0; h<_ds->numComponents(); h++)
                     {
@@ -399,7 +592,7 @@ namespace
                         {
                             if (rho>0.0)
                             {
-                                double T = _ds->mix(h)->equilibrium(Jv,c);
+                                double T = _ds->equilibriumTemperature(m,h,c);
                                 int l = i + Np*j + Np*Np*p;
                                 tempv[l] = _units->otemperature(T);
                             }
@@ -413,8 +606,8 @@ namespace
         // Write the results to a FITS file with an appropriate name
         void write()
         {
-            // If we didn't have all the cells, sum the results first
-            if (_dataParallel) _comm->sum(tempv);
+            // If we didn't have all the cells, gather the results first
+            if (_dataParallel) gather();
 
             string filename = "ds_temp" + plane;
             string description = "dust temperatures";
@@ -423,6 +616,38 @@ namespace
                              _units->olength(xd?xcenter:ycenter), _units->olength(zd?zcenter:ycenter),
                              _units->utemperature(), _units->ulength());
         }
+
+    private:
+        // Gathers the values calculated by each process at the root process. Each pixel value is
+        // calculated only by the process owning the dust cell sampled by that pixel, so rather than
+        // summing the complete images, each process sends just the values for its own pixels.
+        void gather()
+        {
+            int Nprocs = _comm->size();
+            int rank = _comm->rank();
+            bool isRoot = _comm->isRoot();
+
+            // determine the indices of the values owned by each process (the root needs them all)
+            std::vector<std::vector<int>> displacements(Nprocs);
+            for (int p=0; p<Nmaps; p++)
+            {
+                for (int pixel=0; pixel<Np*Np; pixel++)
+                {
+                    int m = cellv[pixel];
+                    if (m == -1) continue;
+                    int r = _cellAssigner->rankForIndex(m);
+                    if (isRoot || r == rank) displacements[r].push_back(pixel + Np*Np*p);
+                }
+            }
+
+            // pack the values owned by this process
+            vector<double> sendv;
+            sendv.reserve(displacements[rank].size());
+            for (int l : displacements[rank]) sendv.push_back(tempv[l]);
+
+            // the values not owned by the root are zero at the root, so they can be received in place
+            _comm->gatherWithPattern(sendv.data(), sendv.size(), &tempv[0], _comm->root(), 1, displacements);
+        }
     };
 }
 
@@ -464,8 +689,6 @@ namespace
             // indicative temperature = average population equilibrium temperature weighed by population mass fraction
             if (_ds->absorbedLuminosity(m)>0.0)
             {
-                const Array& Jv = _ds->meanIntensity(m);
-
                 // average over dust components
                 double sumRho_h = 0;
                 double sumRhoT_h = 0;
@@ -480,7 +703,7 @@ namespace
                         for (int c=0; c<_ds->mix(h)->numPopulations(); c++)
                         {
                             double mu_c = _ds->mix(h)->mu(c);
-                            double T_c = _ds->mix(h)->equilibrium(Jv,c);
+                            double T_c = _ds->equilibriumTemperature(m,h,c);
                             sumMu_c += mu_c;
                             sumMuT_c += mu_c * T_c;
                         }
@@ -498,15 +721,24 @@ namespace
         void write()
         {
             PeerToPeerCommunicator* comm = _ds->find<PeerToPeerCommunicator>();
-            // Sum the calculated results if necessary
+            // Gather the temperatures calculated by each process for its own cells if necessary
             if (comm->dataParallel())
             {
-                comm->sum(_Tv);
-                comm->sum(_Mv);
+                const ProcessAssigner* assigner = _ds->assigner();
+                std::vector<std::vector<int>> displacements;
+                displacements.reserve(comm->size());
+                for (int r=0; r<comm->size(); r++) displacements.push_back(assigner->indicesForRank(r));
+
+                vector<double> sendv;
+                sendv.reserve(assigner->assigned());
+                for (int m : displacements[comm->rank()]) sendv.push_back(_Tv[m]);
+
+                comm->gatherWithPattern(sendv.data(), sendv.size(), &_Tv[0], comm->root(), 1, displacements);
             }
 
             // Create a text file
             TextOutFile file(_ds, "ds_celltemps", "dust cell temperatures");
+            if (_ds->writeBinaryTables()) file.setBinaryColumns(_Ncells);
 
             // Write the header
             file.addColumn("dust cell index", 'd');
@@ -523,6 +755,15 @@ namespace
 
 ////////////////////////////////////////////////////////////////////
 
+namespace
+{
+    // The maximum number of values gathered at the root process in a single collective operation
+    // when writing per-cell output in data-parallel mode
+    const size_t gatherBlockSize = 4*1024*1024;
+}
+
+////////////////////////////////////////////////////////////////////
+
 void PanDustSystem::write() const
 {
     DustSystem::write();
@@ -604,6 +845,7 @@ void PanDustSystem::write() const
 
         // Create a text file
         TextOutFile file(this, "ds_isrf", "ISRF");
+        if (writeBinaryTables()) file.setBinaryColumns(dustGrid()->numCells());
 
         // Write the header
         file.writeLine("# Mean field intensities for all dust cells");
@@ -616,33 +858,60 @@ void PanDustSystem::write() const
 
         // Write one line for each dust cell
         int Ncells = dustGrid()->numCells();
-        for (int m=0; m<Ncells; m++)
+        Array Jv(_Nlambda);
+        if (!dataParallel)
         {
-            if (!dataParallel)
+            for (int m=0; m<Ncells; m++)
             {
+                meanIntensity(m, Jv);
                 vector<double> values({ static_cast<double>(m), units->obolluminosity(absorbedLuminosity(m)) });
-                for (auto J : meanIntensity(m)) values.push_back(J);
+                for (auto J : Jv) values.push_back(J);
                 file.writeRow(values);
             }
-            // for distributed mode
-            else
+        }
+        // for distributed mode
+        else
+        {
+            // the cells are handled in blocks; for each block, the processes pack Labs and Jv for the cells they own,
+            // and a single collective operation gathers the values for the complete block at the root
+            int Nprocs = comm->size();
+            int rank = comm->rank();
+            bool isRoot = comm->isRoot();
+            int Nvalues = _Nlambda+1;
+            int Nblock = max(1, min(Ncells, static_cast<int>(gatherBlockSize / Nvalues)));
+            Array blockv(isRoot ? Nblock*Nvalues : 0);
+            for (int mbegin=0; mbegin<Ncells; mbegin+=Nblock)
             {
-                // the correct process gets Labs and Jv and broadcasts them
-                Array Labs(1);
-                Array Jv(_Nlambda);
-                if (_assigner->validIndex(m))
+                int mend = min(mbegin+Nblock, Ncells);
+
+                // determine the cells in this block owned by each process, relative to the start of the block
+                std::vector<std::vector<int>> displacements(Nprocs);
+                for (int m=mbegin; m<mend; m++) displacements[_assigner->rankForIndex(m)].push_back(m-mbegin);
+
+                // pack the values for the cells owned by this process
+                vector<double> sendv;
+                sendv.reserve(displacements[rank].size()*Nvalues);
+                for (int mrel : displacements[rank])
                 {
-                    Labs[0] = absorbedLuminosity(m);
-                    Jv = meanIntensity(m);
+                    int m = mbegin + mrel;
+                    meanIntensity(m, Jv);
+                    sendv.push_back(absorbedLuminosity(m));
+                    sendv.insert(sendv.end(), begin(Jv), end(Jv));
                 }
-                int sender = _assigner->rankForIndex(m);
-                comm->broadcast(Labs, sender);
-                comm->broadcast(Jv, sender);
+                comm->gatherWithPattern(sendv.data(), sendv.size(), isRoot ? &blockv[0] : nullptr, comm->root(),
+                                        Nvalues, displacements);
 
-                // write the line
-                vector<double> values({ static_cast<double>(m), units->obolluminosity(Labs[0]) });
-                for (auto J : Jv) values.push_back(J);
-                file.writeRow(values);
+                // write the lines
+                if (isRoot)
+                {
+                    for (int m=mbegin; m<mend; m++)
+                    {
+                        const double* cellv = &blockv[(m-mbegin)*Nvalues];
+                        vector<double> values({ static_cast<double>(m), units->obolluminosity(cellv[0]) });
+                        values.insert(values.end(), cellv+1, cellv+Nvalues);
+                        file.writeRow(values);
+                    }
+                }
             }
         }
     }
@@ -656,6 +925,7 @@ void PanDustSystem::write() const
 
         // Create a text file
         TextOutFile file(this, "ds_specabs", "absorption spectra");
+        if (writeBinaryTables()) file.setBinaryColumns(dustGrid()->numCells());
 
         // Write the header
         file.writeLine("# Absorption spectra for all dust cells");
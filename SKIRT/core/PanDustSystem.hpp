@@ -7,9 +7,11 @@
 #define PANDUSTSYSTEM_HPP
 
 #include "DustSystem.hpp"
+#include "ArrayTable.hpp"
 #include "DustEmissivity.hpp"
 #include "DustLib.hpp"
 #include "ParallelTable.hpp"
+#include <atomic>
 class ProcessAssigner;
 
 //////////////////////////////////////////////////////////////////////
@@ -19,7 +21,20 @@ class ProcessAssigner;
     and additionaly supports dust emission. It maintains information on the absorbed energy for
     each cell at each wavelength in a (potentially very large) table. It also holds a
     DustEmissivity object and a DustLib object used to calculate the dust emission spectrum for
-    dust cells. */
+    dust cells.
+
+    Several consumers (the dust library, the temperature and radiation field output) need the same
+    quantities derived from the radiation field in a given dust cell. To avoid recalculating these
+    quantities, which requires a sweep over all wavelengths for every request, the dust system
+    keeps a per-cell cache. The cache is filled lazily, i.e. the values for a particular cell are
+    calculated when they are first requested, and it is invalidated by sumResults() and
+    resetDustAbsorption(). The cache consists of two independent parts: bolometric summaries of the
+    radiation field (see absorbedLuminosity(), bolometricMeanIntensity(), planckabs() and
+    meanAbsorbedWavelength()), and the equilibrium temperatures of all dust populations (see
+    equilibriumTemperature()). The latter part is allocated only if temperature output has been
+    requested; otherwise the equilibrium temperatures are calculated on the fly. The full mean
+    intensity spectrum is not cached, because its memory requirements would equal those of the
+    absorption tables. All cache functions can be called concurrently from multiple threads. */
 class PanDustSystem : public DustSystem
 {
     ITEM_CONCRETE(PanDustSystem, DustSystem, "a dust system for use with panchromatic simulations")
@@ -84,6 +99,20 @@ class PanDustSystem : public DustSystem
         ATTRIBUTE_DEFAULT_VALUE(maxFractionOfPrevious, "0.03")
         ATTRIBUTE_SILENT(maxFractionOfPrevious)
 
+    PROPERTY_BOOL(incrementalSelfAbsorption, "re-emit only the change in dust emission in each self-absorption "
+                                             "iteration")
+        ATTRIBUTE_RELEVANT_IF(incrementalSelfAbsorption, "includeSelfAbsorption")
+        ATTRIBUTE_DEFAULT_VALUE(incrementalSelfAbsorption, "false")
+        ATTRIBUTE_SILENT(incrementalSelfAbsorption)
+
+    PROPERTY_DOUBLE(incrementalThreshold, "the relative change in absorbed luminosity above which the emission "
+                                          "of a dust cell is updated in an incremental self-absorption iteration")
+        ATTRIBUTE_RELEVANT_IF(incrementalThreshold, "incrementalSelfAbsorption")
+        ATTRIBUTE_MIN_VALUE(incrementalThreshold, "[0")
+        ATTRIBUTE_MAX_VALUE(incrementalThreshold, "1[")
+        ATTRIBUTE_DEFAULT_VALUE(incrementalThreshold, "0.01")
+        ATTRIBUTE_SILENT(incrementalThreshold)
+
     PROPERTY_BOOL(writeEmissivity, "output a data file with the dust mix emissivities in the local ISRF")
         ATTRIBUTE_RELEVANT_IF(writeEmissivity, "dustEmissivity")
         ATTRIBUTE_DEFAULT_VALUE(writeEmissivity, "false")
@@ -166,20 +195,62 @@ public:
         manner so this function may be concurrently called from multiple threads. */
     void absorb(int m, int ell, double DeltaL, bool ynstellar) override;
 
-    /** This function resets the absorbed dust luminosity to zero in all cells of the dust system.
-        */
+    /** This function resets the absorbed dust luminosity to zero in all cells of the dust system,
+        and invalidates the per-cell cache. */
     void resetDustAbsorption();
 
+    /** This function prepares the absorbed dust luminosity table for another round of absorption
+        while preserving its current contents, and invalidates the per-cell cache. Subsequent
+        absorption is thus added to the absorbed dust luminosity accumulated so far, rather than
+        replacing it as with resetDustAbsorption(). This allows the dust self-absorption phase to
+        accumulate the absorption caused by consecutive increments in the dust emission, rather
+        than recalculating the complete absorption in every iteration. No additional storage is
+        needed. The function must be called collectively, after sumResults(). */
+    void retainDustAbsorption();
+
     /** This function returns the absorbed luminosity \f$L_{\ell,m}\f$ at wavelength index
         \f$\ell\f$ in the dust cell with cell number \f$m\f$. For a panchromatic dust system, it sums
-        the individual absorption rate counters corresponding to the stellar and dust emission. */
+        the individual absorption rate counters corresponding to the stellar and dust emission.
+        With incremental self-absorption (see retainDustAbsorption()), the photon packages that
+        correct for a decrease in dust emission carry a negative luminosity, so that the
+        accumulated value may become slightly negative through Monte Carlo noise. A negative sum is
+        therefore clamped to zero, so that the mean intensity and all quantities derived from it
+        (including the emission spectra, temperatures and radiation field output) remain
+        physical. The bolometric values returned by absorbedLuminosity() and
+        absorbedDustLuminosity() are not clamped. */
     double absorbedLuminosity(int m, int ell) const override;
 
     /** This function returns the total (bolometric) absorbed luminosity in the dust cell with cell
         number \f$m\f$. It is calculated by summing the absorbed luminosity at all the wavelength
-        indices. */
+        indices. The result is cached as described in the class header. */
     double absorbedLuminosity(int m) const;
 
+    /** This function returns the bolometric mean intensity \f$J_m = \sum_\ell J_{\ell,m}\,
+        (\Delta\lambda)_\ell\f$ of the radiation field in the dust cell with cell number \f$m\f$,
+        where \f$J_{\ell,m}\f$ is defined as for the meanIntensity() function. The result is cached
+        as described in the class header. */
+    double bolometricMeanIntensity(int m) const;
+
+    /** This function returns the integral \f$\sum_\ell \varsigma_{\ell,h}^{\text{abs}}\,
+        J_{\ell,m}\, (\Delta\lambda)_\ell\f$ of the radiation field in the dust cell with cell
+        number \f$m\f$ weighted by the absorption cross section of the dust mix of component
+        \f$h\f$. This value can be passed to the DustMix::invplanckabs() function to obtain the mean
+        temperature of the dust mix. The result is cached as described in the class header. */
+    double planckabs(int m, int h) const;
+
+    /** This function returns the mean wavelength \f$\bar{\lambda}_{m,h} = \sum_\ell
+        \varsigma_{\ell,h}^{\text{abs}}\, J_{\ell,m}\, \lambda_\ell\, (\Delta\lambda)_\ell \,/\,
+        \sum_\ell \varsigma_{\ell,h}^{\text{abs}}\, J_{\ell,m}\, (\Delta\lambda)_\ell\f$ of the
+        radiation field absorbed by the dust mix of component \f$h\f$ in the dust cell with cell
+        number \f$m\f$. The result is cached as described in the class header. */
+    double meanAbsorbedWavelength(int m, int h) const;
+
+    /** This function returns the equilibrium temperature of the \f$c\f$'th population of the dust
+        mix of component \f$h\f$, embedded in the radiation field of the dust cell with cell number
+        \f$m\f$, as calculated by the DustMix::equilibrium() function. If the writeTemperature flag
+        is enabled, the result is cached as described in the class header. */
+    double equilibriumTemperature(int m, int h, int c) const;
+
     /** This function returns a vector with the total (bolometric) absorbed luminosity in each dust cell. */
     Array absorbedLuminosity() const;
 
@@ -196,8 +267,15 @@ public:
         results. If dust emission is turned off, this function does nothing. */
     void calculateDustEmission();
 
-    /** This function synchronizes the results of the absorption by calling the sync() function on the
-        absorption tables. **/
+    /** This function is similar to the function above, but it recalculates only the emission
+        spectra needed by the dust cells with a nonzero flag in the specified vector, which is
+        indexed on the absolute cell index. The emission spectra for the other cells are undefined
+        until the next full calculation. See DustLib::calculate() for more information. */
+    void calculateDustEmission(const vector<char>& updatev);
+
+    /** This function synchronizes the results of the absorption by switching the scheme of the
+        absorption tables, and invalidates the per-cell cache. The communication for both tables is
+        started before waiting for either of them, so that they proceed concurrently. **/
     void sumResults();
 
     /** This function returns the luminosity \f$L_\ell\f$ at the wavelength index \f$\ell\f$ in the
@@ -238,6 +316,25 @@ public:
         each wavelength \f$\lambda_\ell\f$ in the simulation's wavelength grid. */
     void write() const override;
 
+private:
+    /** This function returns the index in the per-cell cache for the dust cell with cell number
+        \f$m\f$. In data parallel mode, the cache holds only the cells assigned to this process, so
+        that the index is relative to this process. */
+    int cacheIndex(int m) const;
+
+    /** This function invalidates the per-cell cache described in the class header. */
+    void invalidateCache();
+
+    /** This function makes sure that the bolometric summaries of the radiation field for the dust
+        cell with cell number \f$m\f$ are present in the per-cell cache, calculating them if
+        needed. */
+    void cacheFieldSummaries(int m) const;
+
+    /** This function makes sure that the equilibrium temperatures of all dust populations in the
+        dust cell with cell number \f$m\f$ are present in the per-cell cache, calculating them if
+        needed. It should be called only if the temperature cache has been allocated. */
+    void cacheTemperatures(int m) const;
+
     //======================== Data Members ========================
 
 private:
@@ -249,6 +346,17 @@ private:
     bool _haveLabsDust{false};     // true if absorbed dust emission is relevant for this simulation
     const ProcessAssigner* _assigner{nullptr}; // determines which cells will be given to the DustLib
 
+    // per-cell cache for quantities derived from the radiation field, lazily filled by const functions;
+    // the state of each cell is 0 (empty), 1 (being filled by some thread) or 2 (filled)
+    ArrayTable<2> _sigmadlambdavv;          // sigma_abs * dlambda, indexed on h and ell
+    ArrayTable<2> _sigmalambdadlambdavv;    // sigma_abs * lambda * dlambda, indexed on h and ell
+    vector<int> _popOffsetv;                // index of the first population of each component, indexed on h
+    // (the cell index m is relative to this process in data parallel mode, see cacheIndex())
+    mutable Table<2> _summaryvv;            // Labs, J_bol, and planckabs and mean wavelength for each h; indexed on m
+    mutable vector<std::atomic<char>> _summaryStatev;  // cache state for _summaryvv, indexed on m
+    mutable Table<2> _Teqvv;                // equilibrium temperature, indexed on m and population
+    mutable vector<std::atomic<char>> _TeqStatev;      // cache state for _Teqvv, indexed on m
+
     // data member to remember whether emulation mode is enabled
     bool _emulationMode{false};
 };
@@ -12,6 +12,8 @@
 #include "ParallelFactory.hpp"
 #include "PeerToPeerCommunicator.hpp"
 #include "PhotonPackage.hpp"
+#include "ProcessAssigner.hpp"
+#include "Profiler.hpp"
 #include "Random.hpp"
 #include "StringUtils.hpp"
 #include "TimeLogger.hpp"
@@ -19,6 +21,14 @@
 
 ////////////////////////////////////////////////////////////////////
 
+namespace
+{
+    // the smallest fraction of the photon packages launched in an incremental self-absorption iteration
+    const double minIncrementalFraction = 0.01;
+}
+
+////////////////////////////////////////////////////////////////////
+
 void PanMonteCarloSimulation::setupSelfAfter()
 {
     MonteCarloSimulation::setupSelfAfter();
@@ -57,37 +67,114 @@ void PanMonteCarloSimulation::runDustSelfAbsorption()
     // Initialize the total absorbed luminosity in the previous iteration
     double prevLabsdusttot = 0.;
 
+    // Prepare for incremental mode if requested; initially no cells emit
+    // (the tables with the emitted luminosities hold only the wavelengths handled by this process)
+    _incremental = _pds->incrementalSelfAbsorption();
+    if (_incremental)
+    {
+        const ProcessAssigner* assigner = _lambdagrid->assigner();
+        int Nrows = assigner ? assigner->assigned() : _Nlambda;
+        _updatev.resize(_Ncells);
+        _Labssrcv.resize(_Ncells);
+        _Lsrcvv.resize(Nrows,_Ncells);
+        _Ltotv.resize(_Nlambda);
+        _dLtotv.resize(_Nlambda);
+    }
+
     // Iterate over the maximum number of iterations; the loop body returns from the function
     // when convergence is reached after the minimum number of iterations have been completed
     for (int iter = 1; iter<=maxIters; iter++)
     {
-        // Construct the dust emission spectra
+        // In incremental mode, select the cells for which the absorbed luminosity changed significantly
+        int Nupdate = 0;
+        if (_incremental)
+        {
+            _pds->sumResults();
+            _Labsbolv = _pds->absorbedLuminosity();
+            double threshold = _pds->incrementalThreshold();
+            for (int m=0; m<_Ncells; m++)
+            {
+                double Labsbol = max(_Labsbolv[m], 0.);
+                double Labssrc = _Labssrcv[m];
+                _updatev[m] = abs(Labsbol-Labssrc) > threshold*Labssrc;
+                if (_updatev[m])
+                {
+                    _Labssrcv[m] = Labsbol;
+                    Nupdate++;
+                }
+            }
+        }
+
+        // Construct the dust emission spectra; in incremental mode, only those needed for the selected cells
         {
             TimeLogger logger(log(), "calculation of emission spectra for dust self-absorption iteration "
                                             + std::to_string(iter));
-            _pds->calculateDustEmission();
+            if (_incremental) _pds->calculateDustEmission(_updatev);
+            else _pds->calculateDustEmission();
         }
 
         // Shoot the photons
         {
             TimeLogger logger(log(), "photon shooting for dust self-absorption iteration " + std::to_string(iter));
+            Parallel* parallel = find<ParallelFactory>()->parallel();
 
-            // Determine the bolometric luminosity that is absorbed in every cell (and that will hence be re-emitted).
-            _Labsbolv = _pds->absorbedLuminosity();
-            // Set the absorbed dust luminosity to zero in all cells
-            _pds->resetDustAbsorption();
+            if (_incremental)
+            {
+                // Determine the change in the emitted luminosity for each wavelength index
+                if (_lambdagrid->assigner())
+                    parallel->call(this, &PanMonteCarloSimulation::doDustSelfAbsorptionSources,
+                                   _lambdagrid->assigner());
+                else
+                    parallel->call(this, &PanMonteCarloSimulation::doDustSelfAbsorptionSources, _Nlambda);
+                double Ltot = _Ltotv.sum();
+                double dLtot = _dLtotv.sum();
+                if (_lambdagrid->assigner())
+                {
+                    communicator()->sumAll(Ltot);
+                    communicator()->sumAll(dLtot);
+                }
+
+                // Launch a number of photon packages proportional to the relative change in emitted luminosity
+                double fraction = Ltot > 0. ? min(1., max(minIncrementalFraction, dLtot/Ltot)) : 1.;
+                setChunkParams(numPackages()*fraction);
+                log()->info("Updating the emission of " + std::to_string(Nupdate) + " out of "
+                            + std::to_string(_Ncells) + " cells, using "
+                            + StringUtils::toString(fraction*100., 'f', 2) + "% of the photon packages");
+
+                // Accumulate the absorbed dust luminosity on top of that of the previous iterations
+                _pds->retainDustAbsorption();
+            }
+            else
+            {
+                // Determine the bolometric luminosity that is absorbed in every cell (and that will hence be re-emitted)
+                _Labsbolv = _pds->absorbedLuminosity();
+
+                // Set the absorbed dust luminosity to zero in all cells
+                _pds->resetDustAbsorption();
+            }
 
             // Perform dust self-absorption
             initProgress("dust self-absorption iteration " + std::to_string(iter));
-            Parallel* parallel = find<ParallelFactory>()->parallel();
             if (_lambdagrid->assigner())
                 parallel->call(this, &PanMonteCarloSimulation::doDustSelfAbsorptionChunk,
                                _lambdagrid->assigner(), _Nchunks);
             else
                 parallel->call(this, &PanMonteCarloSimulation::doDustSelfAbsorptionChunk, _Nlambda, _Nchunks);
 
+            // In incremental mode, remember the emitted luminosity now that all chunks have used the previous one
+            if (_incremental)
+            {
+                if (_lambdagrid->assigner())
+                    parallel->call(this, &PanMonteCarloSimulation::doDustSelfAbsorptionUpdate,
+                                   _lambdagrid->assigner());
+                else
+                    parallel->call(this, &PanMonteCarloSimulation::doDustSelfAbsorptionUpdate, _Nlambda);
+            }
+
             // Wait for the other processes to reach this point
             communicator()->wait("this self-absorption iteration");
+            profiler()->endPhase();
+            logLoadBalance();
             _pds->sumResults();
         }
 
@@ -153,17 +240,79 @@ void PanMonteCarloSimulation::runDustSelfAbsorption()
 
 ////////////////////////////////////////////////////////////////////
 
+void PanMonteCarloSimulation::doDustSelfAbsorptionSources(size_t index)
+{
+    int ell = index;
+
+    // Get the emitted luminosities for this wavelength index, indexed on the wavelength index relative to this process
+    const Array& Lsrcv = _Lsrcvv[_lambdagrid->assigner() ? _lambdagrid->assigner()->relativeIndex(ell) : ell];
+
+    // Determine the total emitted luminosity after updating the selected cells, and the total change
+    double Ltot = 0.;
+    double dLtot = 0.;
+    for (int m=0; m<_Ncells; m++)
+    {
+        double L = _updatev[m] ? updatedLuminosity(m,ell) : Lsrcv[m];
+        Ltot += L;
+        dLtot += abs(L - Lsrcv[m]);
+    }
+    _Ltotv[ell] = Ltot;
+    _dLtotv[ell] = dLtot;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void PanMonteCarloSimulation::doDustSelfAbsorptionUpdate(size_t index)
+{
+    int ell = index;
+
+    // Store the updated emitted luminosity for the selected cells
+    Array& Lsrcv = _Lsrcvv[_lambdagrid->assigner() ? _lambdagrid->assigner()->relativeIndex(ell) : ell];
+    for (int m=0; m<_Ncells; m++)
+    {
+        if (_updatev[m]) Lsrcv[m] = updatedLuminosity(m,ell);
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
+double PanMonteCarloSimulation::updatedLuminosity(int m, int ell) const
+{
+    double Labsbol = _Labssrcv[m];
+    return Labsbol>0.0 ? Labsbol * _pds->emittedDustLuminosity(m,ell) : 0.;
+}
+
+////////////////////////////////////////////////////////////////////
+
 void PanMonteCarloSimulation::doDustSelfAbsorptionChunk(size_t index)
 {
+    auto started = std::chrono::steady_clock::now();
+
     // Determine the wavelength index for this chunk
     int ell = index % _Nlambda;
 
-    // Determine the luminosity to be emitted at this wavelength index
+    // Determine the luminosity to be emitted at this wavelength index;
+    // in incremental mode, this is the absolute value of the change in emitted luminosity,
+    // calculated from the emitted luminosity stored for the previous iteration
     Array Lv(_Ncells);
-    for (int m=0; m<_Ncells; m++)
+    Array dLv;
+    if (_incremental)
     {
-        double Labsbol = _Labsbolv[m];
-        if (Labsbol>0.0) Lv[m] = Labsbol * _pds->emittedDustLuminosity(m,ell);
+        const Array& Lsrcv = _Lsrcvv[_lambdagrid->assigner() ? _lambdagrid->assigner()->relativeIndex(ell) : ell];
+        dLv.resize(_Ncells);
+        for (int m=0; m<_Ncells; m++)
+        {
+            if (_updatev[m]) dLv[m] = updatedLuminosity(m,ell) - Lsrcv[m];
+        }
+        Lv = abs(dLv);
+    }
+    else
+    {
+        for (int m=0; m<_Ncells; m++)
+        {
+            double Labsbol = _Labsbolv[m];
+            if (Labsbol>0.0) Lv[m] = Labsbol * _pds->emittedDustLuminosity(m,ell);
+        }
     }
     double Ltot = Lv.sum();
 
@@ -174,6 +323,7 @@ void PanMonteCarloSimulation::doDustSelfAbsorptionChunk(size_t index)
         NR::cdf(Xv, Lv);
 
         PhotonPackage pp;
+        Profiler::Slot* slot = profiler()->slot();
         double L = Ltot / _Npp;
         double Lthreshold = L / minWeightReduction();
 
@@ -187,23 +337,26 @@ void PanMonteCarloSimulation::doDustSelfAbsorptionChunk(size_t index)
                 int m = NR::locateClip(Xv,X);
                 Position bfr = _pds->randomPositionInCell(m);
                 Direction bfk = random()->direction();
-                pp.launch(L,ell,bfr,bfk);
+                pp.launch(_incremental && dLv[m]<0. ? -L : L, ell, bfr, bfk);
                 while (true)
                 {
-                    _pds->fillOpticalDepth(&pp);
-                    simulateEscapeAndAbsorption(&pp,true);
+                    _pds->fillOpticalDepth(&pp,slot);
+                    simulateEscapeAndAbsorption(&pp,true,slot);
                     double L = pp.luminosity();
                     if (L==0.0) break;
-                    if (L<=Lthreshold && pp.numScatt()>=minScattEvents()) break;
+                    if (abs(L)<=Lthreshold && pp.numScatt()>=minScattEvents()) break;
                     simulatePropagation(&pp);
-                    simulateScattering(&pp);
+                    simulateScattering(&pp,slot);
                 }
             }
+            if (slot) slot->count(Profiler::Counter::Launches, count);
             logProgress(count);
             remaining -= count;
         }
     }
     else logProgress(_chunksize);
+
+    recordChunkCost(ell, started);
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -237,6 +390,8 @@ void PanMonteCarloSimulation::runDustEmission()
 
         // Wait for the other processes to reach this point
         communicator()->wait("the dust emission phase");
+        profiler()->endPhase();
+        logLoadBalance();
     }
 }
 
@@ -244,6 +399,8 @@ void PanMonteCarloSimulation::runDustEmission()
 
 void PanMonteCarloSimulation::doDustEmissionChunk(size_t index)
 {
+    auto started = std::chrono::steady_clock::now();
+
     // Determine the wavelength index for this chunk
     int ell = index % _Nlambda;
 
@@ -270,6 +427,7 @@ void PanMonteCarloSimulation::doDustEmissionChunk(size_t index)
         NR::cdf(cumLv, Lv);
 
         PhotonPackage pp,ppp;
+        Profiler::Slot* slot = profiler()->slot();
         double Lmean = Ltot/_Ncells;
         double Lem = Ltot / _Npp;
         double Lthreshold = Lem / minWeightReduction();
@@ -296,25 +454,29 @@ void PanMonteCarloSimulation::doDustEmissionChunk(size_t index)
                 Position bfr = _pds->randomPositionInCell(m);
                 Direction bfk = random()->direction();
                 pp.launch(Lem*weight,ell,bfr,bfk);
-                peelOffEmission(&pp,&ppp);
+                peelOffEmission(&pp,&ppp,slot);
                 while (true)
                 {
-                    _pds->fillOpticalDepth(&pp);
-                    if (continuousScattering()) continuousPeelOffScattering(&pp,&ppp);
-                    simulateEscapeAndAbsorption(&pp,false);
+                    _pds->fillOpticalDepth(&pp,slot);
+                    if (continuousScattering()) continuousPeelOffScattering(&pp,&ppp,slot);
+                    simulateEscapeAndAbsorption(&pp,false,slot);
                     double L = pp.luminosity();
                     if (L==0.0) break;
                     if (L<=Lthreshold && pp.numScatt()>=minScattEvents()) break;
                     simulatePropagation(&pp);
-                    if (!continuousScattering()) peelOffScattering(&pp,&ppp);
-                    simulateScattering(&pp);
+                    if (!continuousScattering()) peelOffScattering(&pp,&ppp,slot);
+                    simulateScattering(&pp,slot);
                 }
             }
+            if (slot) slot->count(Profiler::Counter::Launches, count);
             logProgress(count);
             remaining -= count;
         }
+        if (peelOffCulling()) flushPeelOffCulling();
     }
     else logProgress(_chunksize);
+
+    recordChunkCost(ell, started);
 }
 
 ////////////////////////////////////////////////////////////////////
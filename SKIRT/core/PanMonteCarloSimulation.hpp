@@ -8,6 +8,7 @@
 
 #include "MonteCarloSimulation.hpp"
 #include "Array.hpp"
+#include "ArrayTable.hpp"
 #include "PanDustSystem.hpp"
 #include "PanWavelengthGrid.hpp"
 #include "StellarSystem.hpp"
@@ -80,9 +81,41 @@ private:
         as a random position in the cell \f$m\f$ chosen randomly from the cumulative luminosity
         distribution \f$X_m\f$. The remaining life cycle of a photon package in the dust emission
         phase is very similar to the life cycle described in
-        MonteCarloSimulation::runstellaremission(). */
+        MonteCarloSimulation::runstellaremission().
+
+        If the \em incrementalSelfAbsorption option of the PanDustSystem object is enabled, each
+        iteration re-emits only the change in the dust emission compared to the previous
+        iteration, while the absorbed dust luminosity is accumulated over the iterations (see
+        PanDustSystem::retainDustAbsorption()). The emission of a cell is updated only if its
+        absorbed luminosity has changed by more than a given fraction (the \em
+        incrementalThreshold option) since the emission was last updated; otherwise the cell keeps
+        its previous emission. Accordingly, the dust emission library recalculates only the
+        entries needed by the updated cells. The photon packages are then launched from the distribution of
+        the absolute change in emitted luminosity \f$|\Delta L_{\ell,m}|\f$, carrying a negative
+        luminosity for cells where the emission decreased, so that the accumulated absorption
+        remains an unbiased estimate of the absorption of the current emission. The number of
+        photon packages in each iteration is proportional to the fraction of the emitted
+        luminosity that changed, which becomes small once the iteration approaches convergence. */
     void runDustSelfAbsorption();
 
+    /** This function calculates the total emitted luminosity and the total absolute change in the
+        emitted luminosity over all dust cells at the wavelength index \f$\ell\f$ specified as
+        \em index, for the incremental mode of rundustselfabsorption(). The stored emitted
+        luminosities are not yet changed, so that the photon shooting loop can calculate the change
+        for each cell on the fly. */
+    void doDustSelfAbsorptionSources(size_t index);
+
+    /** This function stores the updated emitted luminosity of the selected dust cells at the
+        wavelength index \f$\ell\f$ specified as \em index, for the incremental mode of
+        rundustselfabsorption(). It must be called after all photon packages for the iteration have
+        been launched. */
+    void doDustSelfAbsorptionUpdate(size_t index);
+
+    /** This function returns the luminosity emitted by dust cell \f$m\f$ at wavelength index
+        \f$\ell\f$ for the absorbed luminosity for which the emission of the cell was last
+        updated, for the incremental mode of rundustselfabsorption(). */
+    double updatedLuminosity(int m, int ell) const;
+
     /** This function implements the loop body for rundustselfabsorption(). */
     void doDustSelfAbsorptionChunk(size_t index);
 
@@ -120,6 +153,15 @@ private:
     // data members used to communicate between rundustXXX() and the corresponding parallel loop
     int _Ncells{0};        // number of dust cells
     Array _Labsbolv;       // vector that contains the bolometric absorbed luminosity in each cell
+
+    // data members used to communicate between rundustselfabsorption() and the corresponding parallel loops
+    // in incremental mode
+    bool _incremental{false};  // true if the self-absorption iteration is performed in incremental mode
+    vector<char> _updatev;     // flag indicating whether the emission of each cell is updated in this iteration
+    Array _Labssrcv;           // absorbed luminosity for which the emission of each cell was last updated
+    ArrayTable<2> _Lsrcvv;     // emitted luminosity as last updated, indexed on ell (relative to this process) and m
+    Array _Ltotv;              // total emitted luminosity at each wavelength index
+    Array _dLtotv;             // total absolute change in emitted luminosity at each wavelength index
 };
 
 ////////////////////////////////////////////////////////////////////
@@ -54,8 +54,13 @@ std::shared_ptr<Array> ParallelDataCube::constructCompleteCube()
     // partial cube of equal size as total cube
     if (!_wavelengthAssigner || !_comm->isMultiProc())
     {
-        // sum the data to root
-        _comm->sum(*_partialCube);
+        // sum the data to root, or complete the summation if it was started
+        if (_summing)
+        {
+            _comm->finish(_request);
+            _summing = false;
+        }
+        else _comm->sum(*_partialCube);
 
         // give a handle to the summed cube at the root, and a dummy for the other processes
         return _comm->isRoot() ? _partialCube : std::make_shared<Array>();
@@ -80,6 +85,17 @@ std::shared_ptr<Array> ParallelDataCube::constructCompleteCube()
 
 ////////////////////////////////////////////////////////////////////
 
+void ParallelDataCube::startCompleteCube()
+{
+    if ((!_wavelengthAssigner || !_comm->isMultiProc()) && !_summing)
+    {
+        _request = _comm->startSum(*_partialCube);
+        _summing = true;
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
 double& ParallelDataCube::operator()(int ell, int pixel)
 {
     if (!_wavelengthAssigner)
@@ -52,6 +52,14 @@ public:
         return value is a pointer to an empty array for all non-root processes. */
     std::shared_ptr<Array> constructCompleteCube();
 
+    /** This function starts the summation performed by constructCompleteCube() in non-distributed
+        mode without waiting for the communication to complete, so that the communication for
+        several data cubes can proceed concurrently. A subsequent call to constructCompleteCube()
+        then merely waits for the summation to complete. In distributed mode, this function does
+        nothing, and the data is gathered by constructCompleteCube() as usual. All processes need
+        to call this function together. */
+    void startCompleteCube();
+
     /** This operator provides writable access to the contents of the ParallelDataCube. First it is
         checked if the specified wavelength is available at the calling process. If this is not the
         case, a \c FATALERROR is thrown. Then, the index is converted using the wavelength
@@ -73,6 +81,8 @@ private:
     size_t _Nframep{0};
 
     std::shared_ptr<Array> _partialCube;
+    int _request{0};            // the outstanding summation request started by startCompleteCube()
+    bool _summing{false};       // true if a summation has been started by startCompleteCube()
 };
 
 ////////////////////////////////////////////////////////////////////
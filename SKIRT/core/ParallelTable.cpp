@@ -7,12 +7,22 @@
 #include "FatalError.hpp"
 #include "PeerToPeerCommunicator.hpp"
 #include "ProcessAssigner.hpp"
+#include "ProcessManager.hpp"
 #include "StringUtils.hpp"
 #include "TimeLogger.hpp"
 
 namespace
 {
     typedef vector<vector<int>> IntTable;
+
+    // The targeted number of values stored in a single block at each process in distributed mode
+    const size_t blockSize = 4*1024*1024;
+
+    // Returns a pointer to the first value in the specified block, or null if the block is empty
+    double* blockData(Array& block)
+    {
+        return block.size() ? &block[0] : nullptr;
+    }
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -23,6 +33,14 @@ ParallelTable::ParallelTable()
 
 ////////////////////////////////////////////////////////////////////
 
+ParallelTable::~ParallelTable()
+{
+    // the communicator may have been destroyed already, so we release the datatypes directly
+    ProcessManager::freeDisplacedDoubles(_colTypes);
+}
+
+////////////////////////////////////////////////////////////////////
+
 void ParallelTable::initialize(string name, WriteState writeOn, const ProcessAssigner* colAssigner,
                                const ProcessAssigner* rowAssigner, PeerToPeerCommunicator* comm)
 {
@@ -48,20 +66,42 @@ void ParallelTable::initialize(string name, WriteState writeOn, const ProcessAss
                + std::to_string(_rowAssigner->assigned()) + "x" + std::to_string(_totalCols)
                + " (" + StringUtils::toMemSizeString(_rowAssigner->assigned()*_totalCols*sizeof(double)) + ")");
 
-    // Set the size of the relevant table
-    if (_writeOn == WriteState::COLUMN) allocateColumns();
-    else if (_writeOn == WriteState::ROW) allocateRows();
-    else throw FATALERROR("Invalid writeState for ParallelTable");
-
     // Cache the outcomes of the following function calls
     _isValidRowv.resize(_totalRows, false);
     for (size_t i=0; i<_totalRows; i++) _isValidRowv[i] = _rowAssigner->validIndex(i);
     _isValidColv.resize(_totalCols, false);
     for (size_t j=0; j<_totalCols; j++) _isValidColv[j] = _colAssigner->validIndex(j);
-    _relativeRowIndexv.resize(_totalRows, 0);
-    for (size_t i=0; i<_totalRows; i++) _relativeRowIndexv[i] = _rowAssigner->relativeIndex(i);
     _relativeColIndexv.resize(_totalCols, 0);
-    for (size_t j=0; j<_totalCols; j++) _relativeColIndexv[j] = _rowAssigner->relativeIndex(j);
+    for (size_t j=0; j<_totalCols; j++) _relativeColIndexv[j] = _colAssigner->relativeIndex(j);
+
+    // Divide the rows assigned to each process into blocks of limited size; the number of blocks is determined by
+    // the process with the most rows, so that it is the same for all processes
+    int Nprocs = _comm->size();
+    size_t maxAssigned = 0;
+    _rowIndicesvv.reserve(Nprocs);
+    for (int r=0; r<Nprocs; r++)
+    {
+        _rowIndicesvv.push_back(_rowAssigner->indicesForRank(r));
+        maxAssigned = max(maxAssigned, _rowIndicesvv.back().size());
+    }
+    _blockRows = max(static_cast<size_t>(1), blockSize/max(static_cast<size_t>(1), _totalCols));
+    _numBlocks = (maxAssigned + _blockRows - 1) / _blockRows;
+    _columnBlocks.resize(_numBlocks);
+    _rowBlocks.resize(_numBlocks);
+    _columnv.resize(_totalRows, nullptr);
+    _rowv.resize(_totalRows, nullptr);
+
+    // Create the datatypes that select the columns stored at each process from a complete row; they are reused for
+    // every block and every switch
+    IntTable colIndicesvv;
+    colIndicesvv.reserve(Nprocs);
+    for (int r=0; r<Nprocs; r++) colIndicesvv.push_back(_colAssigner->indicesForRank(r));
+    _colTypes = _comm->createDisplacedDoubles(colIndicesvv, _totalCols);
+
+    // Set the size of the relevant table
+    if (_writeOn == WriteState::COLUMN) allocateColumns();
+    else if (_writeOn == WriteState::ROW) allocateRows();
+    else throw FATALERROR("Invalid writeState for ParallelTable");
 
     _initialized = true;
     _distributed = true;
@@ -115,6 +155,14 @@ bool ParallelTable::distributed() const
 ////////////////////////////////////////////////////////////////////
 
 void ParallelTable::switchScheme()
+{
+    startSwitchScheme();
+    finishSwitchScheme();
+}
+
+////////////////////////////////////////////////////////////////////
+
+void ParallelTable::startSwitchScheme()
 {
     // If any of the processes has modified its paralleltable, all of them need to know this to participate in this
     // global communication
@@ -122,25 +170,46 @@ void ParallelTable::switchScheme()
 
     if (!_switched)
     {
-        TimeLogger logger(_log->verbose() && _comm->isMultiProc() ? _log : 0, "communication of " + _name);
-
         if (!_distributed)
         {
-            if (_modified) sumAll();
+            if (_modified) _request = startSumAll();
         }
-        else if (_writeOn == WriteState::COLUMN)
-        {
-            allocateRows();
-            if (_modified) columsToRows();
-            destroyColumns();
-        }
-        else if (_writeOn == WriteState::ROW)
+        else
         {
-            allocateColumns();
-            if (_modified) rowsToColums();
-            destroyRows();
+            TimeLogger logger(_log->verbose() && _comm->isMultiProc() ? _log : 0, "communication of " + _name);
+
+            if (_writeOn == WriteState::COLUMN)
+            {
+                if (_modified) columsToRows();
+                else
+                {
+                    destroyColumns();
+                    allocateRows();
+                }
+            }
+            else if (_writeOn == WriteState::ROW)
+            {
+                if (_modified) rowsToColums();
+                else
+                {
+                    destroyRows();
+                    allocateColumns();
+                }
+            }
         }
     }
+}
+
+////////////////////////////////////////////////////////////////////
+
+void ParallelTable::finishSwitchScheme()
+{
+    if (_request)
+    {
+        TimeLogger logger(_log->verbose() ? _log : 0, "communication of " + _name);
+        _comm->finish(_request);
+        _request = 0;
+    }
     _switched = true;
     _modified = false;
 }
@@ -173,6 +242,28 @@ void ParallelTable::reset()
 
 ////////////////////////////////////////////////////////////////////
 
+void ParallelTable::reopen()
+{
+    if (!_switched) return;
+
+    if (_distributed)
+    {
+        TimeLogger logger(_log->verbose() && _comm->isMultiProc() ? _log : 0, "communication of " + _name);
+
+        if (_writeOn == WriteState::COLUMN) rowsToColums();
+        else columsToRows();
+    }
+    else if (!_comm->isRoot())
+    {
+        _columns.setToZero();
+        _rows.setToZero();
+    }
+    _switched = false;
+    _modified = true;
+}
+
+////////////////////////////////////////////////////////////////////
+
 double& ParallelTable::operator()(size_t i, size_t j)
 {
     if (!_modified) _modified = true;
@@ -184,13 +275,13 @@ double& ParallelTable::operator()(size_t i, size_t j)
         {
             if (!_isValidColv[j])
                 throw FATALERROR(_name + " says: Column of ParallelTable not available on this process");
-            return _columns(i,_relativeColIndexv[j]);
+            return _columnv[i][_relativeColIndexv[j]];
         }
         else                    // Write on _rows
         {
             if (!_isValidRowv[i])
                 throw FATALERROR(_name + " says: Row of ParallelTable not available on this process");
-            return _rows(_relativeRowIndexv[i],j);
+            return _rowv[i][j];
         }
     }
     // WORKING NON-DISTRIBUTED: Reading and writing happens in the same table.
@@ -216,13 +307,13 @@ double ParallelTable::operator()(size_t i, size_t j) const
         {
             if (!_isValidRowv[i])
                 throw FATALERROR(_name + " says: Row of ParallelTable not available on this process");
-            return _rows(_relativeRowIndexv[i],j);
+            return _rowv[i][j];
         }
         else                    // read from _columns
         {
             if (!_isValidColv[j])
                 throw FATALERROR(_name + " says: Column of ParallelTable not available on this process");
-            return _columns(i,_relativeColIndexv[j]);
+            return _columnv[i][_relativeColIndexv[j]];
         }
     }
     // WORKING NON-DISTRIBUTED: Reading and writing happens in the same table.
@@ -249,7 +340,7 @@ double ParallelTable::sumColumn(size_t j) const
         {
             if(_isValidColv[j]) // we have the whole column
                 for (size_t i=0; i<_totalRows; i++)
-                    sum += _columns(i,_relativeColIndexv[j]);
+                    sum += _columnv[i][_relativeColIndexv[j]];
             else throw FATALERROR("Column not available.");
         }
     }
@@ -275,7 +366,7 @@ double ParallelTable::sumRow(size_t i) const
         {
             if (_isValidRowv[i]) // we have the whole row
                 for (size_t j=0; j<_totalCols; j++)
-                    sum += _rows(_relativeRowIndexv[i],j);
+                    sum += _rowv[i][j];
             else throw FATALERROR("Row not available.");
         }
     }
@@ -299,18 +390,17 @@ Array ParallelTable::stackColumns() const
     {
         if (_writeOn == WriteState::COLUMN) // use rows to get a part of the stacked column
         {
-            for (size_t iRel=0; iRel<_rows.size(0); iRel++)
+            for (size_t i : _rowIndicesvv[_comm->rank()])
             {
-                size_t i = _rowAssigner->absoluteIndex(iRel);
                 for (size_t j=0; j<_totalCols; j++)
-                    result[i] += _rows(iRel,j);
+                    result[i] += _rowv[i][j];
             }
         }
         else // sum the local columns
         {
             for (size_t i=0; i<_totalRows; i++)
-                for (size_t jRel=0; jRel<_columns.size(1); jRel++)
-                    result[i] += _columns(i,jRel);
+                for (size_t jRel=0; jRel<_colAssigner->assigned(); jRel++)
+                    result[i] += _columnv[i][jRel];
         }
         _comm->sumAll(result);
     }
@@ -335,16 +425,16 @@ Array ParallelTable::stackRows() const
         if (_writeOn == WriteState::COLUMN) // sum the local rows
         {
             for (size_t j=0; j<_totalCols; j++)
-                for (size_t iRel=0; iRel<_rows.size(0); iRel++)
-                    result[j] += _rows(iRel,j);
+                for (size_t i : _rowIndicesvv[_comm->rank()])
+                    result[j] += _rowv[i][j];
         }
         else // use columns to get a part of the stacked row
         {
-            for (size_t jRel=0; jRel<_columns.size(1); jRel++)
+            for (size_t jRel=0; jRel<_colAssigner->assigned(); jRel++)
             {
                 size_t j = _colAssigner->absoluteIndex(jRel);
                 for (size_t i=0; i<_totalRows; i++)
-                    result[j] += _columns(i,jRel);
+                    result[j] += _columnv[i][jRel];
             }
         }
         _comm->sumAll(result);
@@ -368,49 +458,58 @@ double ParallelTable::sumEverything() const
 
 ////////////////////////////////////////////////////////////////////
 
-void ParallelTable::sumAll()
+int ParallelTable::startSumAll()
 {
     if (_writeOn == WriteState::COLUMN)
     {
         Array& arr = _columns.data();
-        _comm->sumAll(arr);
+        return _comm->startSumAll(arr);
     }
     else
     {
         Array& arr = _rows.data();
-        _comm->sumAll(arr);
+        return _comm->startSumAll(arr);
     }
 }
 
-////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void ParallelTable::columsToRows()
 {
     int Nprocs = _comm->size();
+    int rank = _comm->rank();
+    size_t width = _colAssigner->assigned();
+
+    // For each block, the partial rows destined for each process are stored contiguously in the column block, so
+    // they can be sent without a derived datatype. At the receiving end, the values from each process are placed at
+    // the absolute indices of the columns stored by that process, by repeating the corresponding datatype for each
+    // of the complete rows in the row block. The communication of a block is started before waiting for the previous
+    // one, after which the column storage of the previous block is released.
+    int previous = 0;
+    for (size_t b=0; b!=_numBlocks; ++b)
+    {
+        vector<size_t> sendCounts(Nprocs);
+        vector<size_t> sendOffsets(Nprocs);
+        size_t offset = 0;
+        for (int r=0; r<Nprocs; r++)
+        {
+            sendCounts[r] = numBlockRows(r,b)*width;
+            sendOffsets[r] = offset;
+            offset += sendCounts[r];
+        }
 
-    // All the partial rows from _columns are sent in one block per receiving process. Therefore, the sendcount is 1.
-    // The rows to send are indicated by the absolute row-indices assigned to each process. As each block in the send
-    // pattern will represent a single partial row, the blocklength is equal to the width of _columns.
-    double* sendBuffer = &_columns(0,0);
-    IntTable sendDispvv;
-    sendDispvv.reserve(Nprocs);
-    for (int r=0; r<Nprocs; r++) sendDispvv.push_back(_rowAssigner->indicesForRank(r));
-    size_t sendBlockLength = _columns.size(1);
-    size_t sendExtent = _totalRows*sendBlockLength;
-
-    // All the complete rows stored at a process will be filled up by repeating the pattern used to fill a single one.
-    // The pattern consists of doubles displaced over a distance of their absolute column index. To ensure that the
-    // receive patterns are repeated correctly, the extent of each pattern should be equal to the length of a complete
-    // row, or the width of _rows.
-    double* recvBuffer = &_rows(0,0);
-    IntTable recvDispvv;
-    recvDispvv.reserve(Nprocs);
-    for (int r=0; r<Nprocs; r++) recvDispvv.push_back(_colAssigner->indicesForRank(r));
-    size_t recvCount = _rows.size(0);
-    size_t recvExtent = _totalCols;
-
-    _comm->displacedBlocksAllToAll(sendBuffer, 1, sendBlockLength, sendDispvv, sendExtent,
-                                   recvBuffer, recvCount, 1, recvDispvv, recvExtent);
+        allocateRowBlock(b);
+        int request = _comm->startBlocksToDisplaced(blockData(_columnBlocks[b]), sendCounts, sendOffsets,
+                                                    blockData(_rowBlocks[b]), numBlockRows(rank,b), _colTypes);
+        if (b)
+        {
+            _comm->finish(previous);
+            _columnBlocks[b-1].resize(0);
+        }
+        previous = request;
+    }
+    _comm->finish(previous);
+    destroyColumns();
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -418,51 +517,115 @@ void ParallelTable::columsToRows()
 void ParallelTable::rowsToColums()
 {
     int Nprocs = _comm->size();
+    int rank = _comm->rank();
+    size_t width = _colAssigner->assigned();
 
-    double* sendBuffer = &_rows(0,0);
-    IntTable sendDispvv;
-    sendDispvv.reserve(Nprocs);
-    for (int r=0; r<Nprocs; r++) sendDispvv.push_back(_colAssigner->indicesForRank(r));
-    int sendCount = _rows.size(0);
-    int sendExtent = _totalCols;
-
-    double* recvBuffer = &_columns(0,0);
-    IntTable recvDispvv;
-    recvDispvv.reserve(Nprocs);
-    for (int r=0; r<Nprocs; r++) recvDispvv.push_back(_rowAssigner->indicesForRank(r));
-    int recvBlockLength = _columns.size(1);
-    int recvExtent = _totalRows*recvBlockLength;
-
-    _comm->displacedBlocksAllToAll(sendBuffer, sendCount, 1, sendDispvv, sendExtent,
-                                   recvBuffer, 1, recvBlockLength, recvDispvv, recvExtent);
+    // The inverse of the communication pattern used by columsToRows()
+    int previous = 0;
+    for (size_t b=0; b!=_numBlocks; ++b)
+    {
+        vector<size_t> recvCounts(Nprocs);
+        vector<size_t> recvOffsets(Nprocs);
+        size_t offset = 0;
+        for (int r=0; r<Nprocs; r++)
+        {
+            recvCounts[r] = numBlockRows(r,b)*width;
+            recvOffsets[r] = offset;
+            offset += recvCounts[r];
+        }
+
+        allocateColumnBlock(b);
+        int request = _comm->startDisplacedToBlocks(blockData(_rowBlocks[b]), numBlockRows(rank,b), _colTypes,
+                                                    blockData(_columnBlocks[b]), recvCounts, recvOffsets);
+        if (b)
+        {
+            _comm->finish(previous);
+            _rowBlocks[b-1].resize(0);
+        }
+        previous = request;
+    }
+    _comm->finish(previous);
+    destroyRows();
+}
+
+////////////////////////////////////////////////////////////////////
+
+size_t ParallelTable::numBlockRows(int rank, size_t block) const
+{
+    size_t assigned = _rowIndicesvv[rank].size();
+    size_t first = block*_blockRows;
+    return first < assigned ? min(_blockRows, assigned-first) : 0;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void ParallelTable::allocateColumnBlock(size_t block)
+{
+    int Nprocs = _comm->size();
+    size_t width = _colAssigner->assigned();
+
+    size_t height = 0;
+    for (int r=0; r<Nprocs; r++) height += numBlockRows(r,block);
+    _columnBlocks[block].resize(height*width);
+
+    // Point each row of the block into the storage, grouped per process
+    double* data = blockData(_columnBlocks[block]);
+    for (int r=0; r<Nprocs; r++)
+    {
+        size_t first = block*_blockRows;
+        size_t last = first + numBlockRows(r,block);
+        for (size_t k=first; k<last; k++)
+        {
+            _columnv[_rowIndicesvv[r][k]] = data;
+            data += width;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
+void ParallelTable::allocateRowBlock(size_t block)
+{
+    int rank = _comm->rank();
+    size_t height = numBlockRows(rank,block);
+    _rowBlocks[block].resize(height*_totalCols);
+
+    // Point each row of the block into the storage
+    double* data = blockData(_rowBlocks[block]);
+    size_t first = block*_blockRows;
+    for (size_t k=first; k<first+height; k++)
+    {
+        _rowv[_rowIndicesvv[rank][k]] = data;
+        data += _totalCols;
+    }
 }
 
 ////////////////////////////////////////////////////////////////////
 
 void ParallelTable::allocateColumns()
 {
-    _columns.resize(_totalRows, _colAssigner->assigned());
+    for (size_t b=0; b!=_numBlocks; ++b) allocateColumnBlock(b);
 }
 
 ////////////////////////////////////////////////////////////////////
 
 void ParallelTable::allocateRows()
 {
-    _rows.resize(_rowAssigner->assigned(),_totalCols);
+    for (size_t b=0; b!=_numBlocks; ++b) allocateRowBlock(b);
 }
 
 ////////////////////////////////////////////////////////////////////
 
 void ParallelTable::destroyColumns()
 {
-    _columns.resize(0,0);
+    for (Array& block : _columnBlocks) block.resize(0);
 }
 
 ////////////////////////////////////////////////////////////////////
 
 void ParallelTable::destroyRows()
 {
-    _rows.resize(0,0);
+    for (Array& block : _rowBlocks) block.resize(0);
 }
 
 ////////////////////////////////////////////////////////////////////
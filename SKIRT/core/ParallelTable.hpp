@@ -42,9 +42,12 @@ class PeerToPeerCommunicator;
     ProcessAssigner implementations.
 
     The switching from a column-based to a row-based parallel storage scheme or vice versa is
-    implemented with a call to the alltoallw function of MPI. This is a very general communication
+    implemented with calls to the alltoallw function of MPI. This is a very general communication
     function, where every process can be made to send a certain set of data to every other process
-    (see \c switchScheme()).
+    (see \c switchScheme()). In distributed mode, the locally stored data is split into blocks that
+    each hold a limited number of rows, so that the transposition can proceed one block at a time.
+    While a block is being communicated, the next block is already posted, and the storage of
+    each source block is released as soon as its communication has completed.
 
     This class can also store data in a regular way, when data-parallelization is not desired. This
     way, the code can run with or without data parallelization using the same data structure. This
@@ -62,7 +65,8 @@ class PeerToPeerCommunicator;
 
     When the two assigners divide the columns and the rows evenly between the processes, the memory
     usage per process of a \c ParallelTable is expected to scale as 1/N, with N the number of
-    processes. During the switch, the memory usage temporarily becomes 2/N. */
+    processes. Because the data is transposed block by block, the memory usage during the switch
+    exceeds 1/N by no more than the size of two blocks. */
 class ParallelTable
 {
 public:
@@ -85,6 +89,16 @@ public:
         used, one of the \c initialize() functions needs to be called. */
     ParallelTable();
 
+    /** The destructor releases the MPI datatypes used for the communication in distributed mode.
+        */
+    ~ParallelTable();
+
+    /** The copy constructor is deleted because a ParallelTable owns communication resources. */
+    ParallelTable(const ParallelTable&) = delete;
+
+    /** The assignment operator is deleted because a ParallelTable owns communication resources. */
+    ParallelTable& operator=(const ParallelTable&) = delete;
+
     /** This function prepares the ParallelTable for use. This version of \c initialize should be
         used if one wants to activate the distributed storage of data (a.k.a data parallelization).
         As arguments it takes:
@@ -123,12 +137,13 @@ public:
 
     /** This function switches the the data storage from a scheme where each process holds a set of
         columns to a scheme where each process holds a set of rows (for \c COLUMN mode), or vice
-        versa (for \c ROW mode). This happens trough an MPI communication. First, a new table is
-        allocated, which will serve as the destination for the end result of the data exchange.
-        Then, a call to one of three private communication functions is made, depending on the mode
-        of operation. After the communication, the table that originally contained the data is
-        deleted, as it will be no longer used. This also means that during the communication, this
-        ParallelTable consumes roughly twice the memory. Before calling \c switchScheme(), only
+        versa (for \c ROW mode). This happens trough an MPI communication, performed by one of two
+        private communication functions depending on the mode of operation. The communication
+        proceeds one block of rows at a time: the destination storage for a block is allocated
+        just before its communication is started, and the source storage for a block is released
+        as soon as its communication has completed. As a result, the memory consumed by this
+        ParallelTable during the communication exceeds its regular size by at most two blocks.
+        Before calling \c switchScheme(), only
         the writing operator can be used. After the call, only reading is allowed. ParallelTable
         also keeps a flag (\c _modified) that indicates whether the write operator has already been
         callled. If it has not been called yet, this means that the data contained consists of
@@ -140,11 +155,35 @@ public:
         all cases, this function needs to be called collectively. */
     void switchScheme();
 
+    /** This function performs the first part of switchScheme(). When the table is running in
+        non-distributed mode, it starts the summation over all processes without waiting for it to
+        complete, so that the caller can perform other work (such as starting the communication of
+        another table) in the meantime. In distributed mode, the complete redistribution is
+        performed by this function. A call to this function must always be followed by a call to
+        finishSwitchScheme() before the table is used again. This function needs to be called
+        collectively. */
+    void startSwitchScheme();
+
+    /** This function completes the switch started by startSwitchScheme(), waiting for any
+        outstanding communication. After this function returns, the table is in the same state as
+        after a call to switchScheme(). */
+    void finishSwitchScheme();
+
     /** This function resets the ParallelTable, reverting it to the same state as if it was just
         initialized, and setting all data to zero. After resetting, only the writing operator can
         be called. */
     void reset();
 
+    /** This function reverts the ParallelTable to its writing state while preserving its
+        contents, so that further contributions can be accumulated on top of the values that have
+        been communicated by the most recent call to \c switchScheme(). In distributed mode, the
+        data is transposed back to the storage scheme used for writing. In non-distributed mode,
+        where \c switchScheme() sums the data over all processes, the summed values are kept only
+        at the root process, so that they are counted once by the next summation. The function
+        does nothing if \c switchScheme() has not been called since the table was initialized or
+        reset. It needs to be called collectively. */
+    void reopen();
+
     /** The non-const ()-operator returns a writable reference to an element of the ParallelTable,
         and will hence be called the writing operator. This operator should only be called \em
         before the invocation of \c switchScheme(). In \c COLUMN mode, this operator assumes that
@@ -204,30 +243,49 @@ public:
     double sumEverything() const;
 
 private:
-    /** Private function to sum the contained data over all processes, used during the
-        communication step in non-distributed mode. */
-    void sumAll();
+    /** Private function to start summing the contained data over all processes, used during the
+        communication step in non-distributed mode. It returns the identifier of the outstanding
+        communication request. */
+    int startSumAll();
 
     /** Performs a communication between all processes to switch from a column based to a row based
-        data distribution scheme. Both data members that serve for storage (\c _columns and \c
-        _rows) need to have their correct size when this function is called. */
+        data distribution scheme in distributed mode. The column storage must be allocated when
+        this function is called. The function allocates the row storage and releases the column
+        storage block by block, while the communication of the next block is in progress. */
     void columsToRows();
 
     /** The inverse operation of \c columnsToRows(). */
     void rowsToColums();
 
+    /** Returns the number of rows assigned to the process with the specified rank that are part of
+        the specified block. Block \f$b\f$ contains the rows with positions \f$b\,n_\text{b}\f$
+        up to \f$(b+1)\,n_\text{b}\f$ in the list of row indices assigned to each process, with
+        \f$n_\text{b}\f$ the number of rows per block. */
+    size_t numBlockRows(int rank, size_t block) const;
+
+    /** Allocates the column storage for the specified block in distributed mode. The block holds
+        the rows of the block for each process in turn, each row consisting of the values for the
+        columns stored at this process. */
+    void allocateColumnBlock(size_t block);
+
+    /** Allocates the row storage for the specified block in distributed mode. The block holds the
+        complete rows of the block that are assigned to this process. */
+    void allocateRowBlock(size_t block);
+
     /** Sets _columns to its correct size. Its height is set to encompass an entire column of the
-        ParallelTable, while its width is set to the number of columns stored at this process. */
+        ParallelTable, while its width is set to the number of columns stored at this process. In
+        distributed mode, all column blocks are allocated instead. */
     void allocateColumns();
 
     /** Sets _rows to its correct size. Its height is set to the number of rows stored at this
-        process, while its width is set to encompass an entire row of the ParallelTable. */
+        process, while its width is set to encompass an entire row of the ParallelTable. In
+        distributed mode, all row blocks are allocated instead. */
     void allocateRows();
 
-    /** Frees the memory occupied by _columns by resizing it to 0. */
+    /** Frees the memory occupied by the column storage. */
     void destroyColumns();
 
-    /** Frees the memory occupied by _rows by resizing it to 0. */
+    /** Frees the memory occupied by the row storage. */
     void destroyRows();
 
     //======================== Data Members ========================
@@ -248,13 +306,23 @@ private:
     bool _distributed{false};  // false if memory is not distributed
     bool _switched{false};     // true after switchScheme has been called, disallows the writing operator
     bool _modified{false};     // true if the table has been written to since initialization or resetting
+    int _request{0};           // identifier of the outstanding summation started by startSwitchScheme, or zero
 
-    // Storage of the data
+    // Storage of the data in non-distributed mode
     Table<2> _columns;  // the values distributed over processes column wise
     Table<2> _rows;     // the values distributed over processes row wise
 
+    // Storage of the data in distributed mode, split into blocks that are communicated one at a time
+    size_t _blockRows{0};                       // the maximum number of rows per process in a block
+    size_t _numBlocks{0};                       // the number of blocks
+    std::vector<std::vector<int>> _rowIndicesvv; // caches the values of _rowAssigner->indicesForRank(r)
+    std::vector<Array> _columnBlocks;           // the values distributed over processes column wise
+    std::vector<Array> _rowBlocks;              // the values distributed over processes row wise
+    std::vector<double*> _columnv;              // points to the locally stored part of row i in _columnBlocks
+    std::vector<double*> _rowv;                 // points to row i in _rowBlocks, if assigned to this process
+    int _colTypes{0};                           // identifies the datatypes selecting the columns of each process
+
     // Cached function outcomes for optimizing performance under frequent access
-    std::vector<size_t> _relativeRowIndexv; // caches the values of _rowAssigner->relativeIndex(i)
     std::vector<size_t> _relativeColIndexv; // caches the values of _colAssigner->relativeindex(j)
     std::vector<bool> _isValidRowv;         // caches the values of _rowAssigner->validIndex(i)
     std::vector<bool> _isValidColv;         // caches the values of _colAssigner->validIndex(j)
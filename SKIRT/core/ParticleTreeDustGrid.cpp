@@ -253,7 +253,10 @@ void ParticleTreeDustGrid::path(DustGridPath* path) const
         if (dsy>0 && dsy<ds) ds = dsy;
         if (dsz>0 && dsz<ds) ds = dsz;
         if (ds<DBL_MAX)
+        {
             path->addSegment(cellNumber(node), ds);
+            if (path->isComplete()) return;
+        }
         else
             ds = 0;
 
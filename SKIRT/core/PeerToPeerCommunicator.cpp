@@ -4,6 +4,7 @@
 ///////////////////////////////////////////////////////////////// */
 
 #include "PeerToPeerCommunicator.hpp"
+#include "FatalError.hpp"
 #include "Log.hpp"
 #include "ProcessManager.hpp"
 
@@ -30,6 +31,13 @@ void PeerToPeerCommunicator::setDataParallel(bool dataParallel)
 
 ////////////////////////////////////////////////////////////////////
 
+void PeerToPeerCommunicator::setSharedMemory(bool sharedMemory)
+{
+    _sharedMemory = sharedMemory && isMultiProc();
+}
+
+////////////////////////////////////////////////////////////////////
+
 void PeerToPeerCommunicator::sum(Array& arr)
 {
     if (!isMultiProc()) return;
@@ -43,7 +51,8 @@ void PeerToPeerCommunicator::sumAll(Array& arr)
 {
     if (!isMultiProc()) return;
 
-    ProcessManager::sumAll(&(arr[0]),arr.size());
+    if (_sharedMemory) ProcessManager::sumAllByNode(&(arr[0]),arr.size());
+    else ProcessManager::sumAll(&(arr[0]),arr.size());
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -55,6 +64,46 @@ void PeerToPeerCommunicator::sumAll(double& dbl)
     ProcessManager::sumAll(&dbl,1);
 }
 
+////////////////////////////////////////////////////////////////////
+
+int PeerToPeerCommunicator::startSum(Array& arr)
+{
+    if (!isMultiProc() || !arr.size()) return 0;
+
+    return ProcessManager::startSum(&(arr[0]),arr.size(),0);
+}
+
+////////////////////////////////////////////////////////////////////
+
+int PeerToPeerCommunicator::startSumAll(Array& arr)
+{
+    if (!isMultiProc() || !arr.size()) return 0;
+
+    // the hierarchical summation used in shared-memory mode is performed synchronously
+    if (_sharedMemory)
+    {
+        if (!_syncFallbackLogged)
+        {
+            find<Log>()->info("Non-blocking summations are performed synchronously in shared-memory mode");
+            _syncFallbackLogged = true;
+        }
+        ProcessManager::sumAllByNode(&(arr[0]),arr.size());
+        return 0;
+    }
+    return ProcessManager::startSumAll(&(arr[0]),arr.size());
+}
+
+////////////////////////////////////////////////////////////////////
+
+void PeerToPeerCommunicator::finish(int request)
+{
+    if (!isMultiProc()) return;
+
+    ProcessManager::finishRequest(request);
+}
+
+////////////////////////////////////////////////////////////////////
+
 void PeerToPeerCommunicator::orAll(bool& b)
 {
     if (!isMultiProc()) return;
@@ -108,6 +157,46 @@ void PeerToPeerCommunicator::displacedBlocksAllToAll(const double* sendBuffer, s
 
 ////////////////////////////////////////////////////////////////////
 
+int PeerToPeerCommunicator::createDisplacedDoubles(const std::vector<std::vector<int>>& displacements, size_t extent)
+{
+    if (!isMultiProc()) return 0;
+
+    return ProcessManager::createDisplacedDoubles(displacements, extent);
+}
+
+////////////////////////////////////////////////////////////////////
+
+void PeerToPeerCommunicator::freeDisplacedDoubles(int types)
+{
+    ProcessManager::freeDisplacedDoubles(types);
+}
+
+////////////////////////////////////////////////////////////////////
+
+int PeerToPeerCommunicator::startBlocksToDisplaced(const double* sendBuffer, const std::vector<size_t>& sendCounts,
+                                                   const std::vector<size_t>& sendOffsets, double* recvBuffer,
+                                                   size_t recvCount, int recvTypes)
+{
+    if (!isMultiProc()) return 0;
+
+    return ProcessManager::startBlocksToDisplaced(sendBuffer, sendCounts, sendOffsets, recvBuffer, recvCount,
+                                                  recvTypes);
+}
+
+////////////////////////////////////////////////////////////////////
+
+int PeerToPeerCommunicator::startDisplacedToBlocks(const double* sendBuffer, size_t sendCount, int sendTypes,
+                                                   double* recvBuffer, const std::vector<size_t>& recvCounts,
+                                                   const std::vector<size_t>& recvOffsets)
+{
+    if (!isMultiProc()) return 0;
+
+    return ProcessManager::startDisplacedToBlocks(sendBuffer, sendCount, sendTypes, recvBuffer, recvCounts,
+                                                  recvOffsets);
+}
+
+////////////////////////////////////////////////////////////////////
+
 int PeerToPeerCommunicator::root()
 {
     return ROOT;
@@ -139,3 +228,47 @@ bool PeerToPeerCommunicator::dataParallel()
 }
 
 ////////////////////////////////////////////////////////////////////
+
+bool PeerToPeerCommunicator::sharedMemory()
+{
+    return _sharedMemory;
+}
+
+////////////////////////////////////////////////////////////////////
+
+double* PeerToPeerCommunicator::allocateNodeShared(size_t nvalues, int& window)
+{
+    if (!_sharedMemory) throw FATALERROR("Node-shared memory can only be allocated in shared-memory mode");
+
+    return ProcessManager::allocateNodeShared(nvalues, window);
+}
+
+////////////////////////////////////////////////////////////////////
+
+void PeerToPeerCommunicator::freeNodeShared(int window)
+{
+    ProcessManager::freeNodeShared(window);
+}
+
+////////////////////////////////////////////////////////////////////
+
+bool PeerToPeerCommunicator::isNodeLeader()
+{
+    return _sharedMemory ? ProcessManager::isNodeLeader() : true;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void PeerToPeerCommunicator::waitNode()
+{
+    if (_sharedMemory) ProcessManager::nodeBarrier();
+}
+
+////////////////////////////////////////////////////////////////////
+
+void PeerToPeerCommunicator::sumAllNodeShared(double* arr, size_t nvalues)
+{
+    if (_sharedMemory) ProcessManager::sumAllNodeShared(arr, nvalues);
+}
+
+////////////////////////////////////////////////////////////////////
@@ -36,6 +36,14 @@ public:
         _dataParallel member to true if '-d' was specified on the commandline. */
     void setDataParallel(bool dataParallel);
 
+    /** This function should be used just after this object has been set up, to set the
+        _sharedMemory member to true if '-n' was specified on the commandline. In shared-memory
+        mode, the dust cell volumes and densities are stored only once per compute node (other
+        data structures, including the dust grid structure and the dust mix tables, are still
+        stored by each process), and array summations across processes are performed within each
+        node first. */
+    void setSharedMemory(bool sharedMemory);
+
     //====================== Other Functions =======================
 
 public:
@@ -54,6 +62,30 @@ public:
         all processes in the communicator. */
     void sumAll(double& dbl);
 
+    /** This function starts summing an Array element-wise across the different processes in the
+        communicator, without waiting for the communication to complete. The resulting values are
+        stored in the same Array, on the root process, once the request identifier returned by this
+        function has been passed to finish(). In the meantime, the Array must not be accessed or
+        resized. This allows the calling process to perform other work while the communication is
+        in progress. If there is only a single process, the function does nothing and returns
+        zero. */
+    int startSum(Array& arr);
+
+    /** This function starts summing an Array element-wise across the different processes in the
+        communicator, without waiting for the communication to complete. The resulting values are
+        stored in the same Array, on all processes, once the request identifier returned by this
+        function has been passed to finish(). In the meantime, the Array must not be accessed or
+        resized. If there is only a single process, the function does nothing and returns zero. In
+        shared-memory mode, the hierarchical summation is performed synchronously before the
+        function returns, and a message saying so is logged the first time this happens. */
+    int startSumAll(Array& arr);
+
+    /** This function waits for the completion of the communication started by startSum(),
+        startSumAll(), startBlocksToDisplaced() or startDisplacedToBlocks() with the specified
+        request identifier. The function does nothing if the
+        identifier is zero. */
+    void finish(int request);
+
     /** This function is used for performing the logical OR operation on a boolean across the different
     processes in the communicator. The resulting value is then stored in the boolean passed to this
     function, on all processes in the communicator. */
@@ -81,6 +113,30 @@ public:
                                  size_t recvLength, std::vector<std::vector<int>>& recvDisplacements,
                                  size_t recvExtent);
 
+    /** This function creates a set of committed datatypes, one for each process, each selecting
+        the double values at the listed displacements within a pattern of the specified extent.
+        The returned identifier can be used with startBlocksToDisplaced() and
+        startDisplacedToBlocks() for as long as needed, and must eventually be passed to
+        freeDisplacedDoubles(). If there is only a single process, the function does nothing and
+        returns zero. */
+    int createDisplacedDoubles(const std::vector<std::vector<int>>& displacements, size_t extent);
+
+    /** This function releases the datatypes created by createDisplacedDoubles(). */
+    void freeDisplacedDoubles(int types);
+
+    /** This function starts an all-to-all communication in which each process sends a contiguous
+        block of values to every other process, and places the values received from each process
+        according to the corresponding datatype in the given set, repeated \em recvCount times. The
+        returned request identifier must be passed to finish() before the buffers are accessed. If
+        there is only a single process, the function does nothing and returns zero. */
+    int startBlocksToDisplaced(const double* sendBuffer, const std::vector<size_t>& sendCounts,
+                               const std::vector<size_t>& sendOffsets, double* recvBuffer, size_t recvCount,
+                               int recvTypes);
+
+    /** This function starts the inverse communication of startBlocksToDisplaced(). */
+    int startDisplacedToBlocks(const double* sendBuffer, size_t sendCount, int sendTypes, double* recvBuffer,
+                               const std::vector<size_t>& recvCounts, const std::vector<size_t>& recvOffsets);
+
     /** This function returns the rank of the root process. */
     int root();
 
@@ -94,8 +150,41 @@ public:
     /** This function indicates whether data parallelization is enabled or not */
     bool dataParallel();
 
+    /** This function indicates whether node shared-memory mode is enabled or not. This is never
+        the case if there is only a single process. */
+    bool sharedMemory();
+
+    /** In shared-memory mode, this function allocates a block of memory for the specified number
+        of double values that is shared by all processes on the same compute node, and returns a
+        pointer to it. The second argument receives an identifier that must be passed to
+        freeNodeShared() to release the memory. The contents of the block are undefined after
+        allocation. This function must be called collectively, and only in shared-memory mode. */
+    double* allocateNodeShared(size_t nvalues, int& window);
+
+    /** This function releases a block of memory allocated by allocateNodeShared(). It must be
+        called collectively. */
+    void freeNodeShared(int window);
+
+    /** This function returns true if the calling process is responsible for writing node-shared
+        data, i.e. if it is the leader of its compute node. Outside of shared-memory mode, each
+        process is its own leader and the function always returns true. */
+    bool isNodeLeader();
+
+    /** In shared-memory mode, this function does not return before all processes on the same
+        compute node have called it, and it makes all writes to node-shared memory performed before
+        the call visible to the other processes on the node. Otherwise the function does nothing. */
+    void waitNode();
+
+    /** In shared-memory mode, this function sums a node-shared array, holding the contributions of
+        all processes on each node, element-wise across the compute nodes. After the function
+        returns, the array holds the total on all nodes. This function must be called collectively.
+        */
+    void sumAllNodeShared(double* arr, size_t nvalues);
+
 private:
     bool _dataParallel{false};
+    bool _sharedMemory{false};
+    bool _syncFallbackLogged{false};  // true if the synchronous summation in shared-memory mode has been logged
 };
 
 ////////////////////////////////////////////////////////////////////
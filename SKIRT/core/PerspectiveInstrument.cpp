@@ -6,6 +6,7 @@
 #include "PerspectiveInstrument.hpp"
 #include "FatalError.hpp"
 #include "FITSInOut.hpp"
+#include "InstrumentSystem.hpp"
 #include "LockFree.hpp"
 #include "Log.hpp"
 #include "PhotonPackage.hpp"
@@ -159,6 +160,13 @@ void PerspectiveInstrument::detect(PhotonPackage* pp)
 
 ////////////////////////////////////////////////////////////////////
 
+void PerspectiveInstrument::startCommunication()
+{
+    _ftotv.startCompleteCube();
+}
+
+////////////////////////////////////////////////////////////////////
+
 void PerspectiveInstrument::write()
 {
     Units* units = find<Units>();
@@ -179,12 +187,17 @@ void PerspectiveInstrument::write()
         (*completeCube)[m] = units->osurfacebrightness(lambda, (*completeCube)[m]*front/dlambda);
     }
 
-    // Write a FITS file containing the data cube
+    // Schedule writing a FITS file containing the data cube, concurrently with the files of other instruments
     string filename = instrumentName() + "_total";
     string description = "total flux";
-    FITSInOut::write(this, description, filename, *completeCube, _Nx, _Ny, Nlambda,
-                     units->olength(_s), units->olength(_s), 0., 0.,
-                     units->usurfacebrightness(), units->ulength());
+    int Nx = _Nx, Ny = _Ny;
+    double size = units->olength(_s);
+    string usb = units->usurfacebrightness(), ulength = units->ulength();
+    find<InstrumentSystem>()->scheduleOutput([=]()
+    {
+        FITSInOut::write(this, description, filename, *completeCube, Nx, Ny, Nlambda, size, size, 0., 0.,
+                         usb, ulength);
+    });
 }
 
 ////////////////////////////////////////////////////////////////////
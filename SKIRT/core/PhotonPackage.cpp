@@ -9,7 +9,7 @@
 ////////////////////////////////////////////////////////////////////
 
 PhotonPackage::PhotonPackage()
-    : _L(0), _ell(0), _nscatt(0), _stellar(-1), _ad(0)
+    : _L(0), _L0(0), _taucull(DBL_MAX), _ell(0), _nscatt(0), _stellar(-1), _culled(false), _ad(0)
 {
 }
 
@@ -18,12 +18,15 @@ PhotonPackage::PhotonPackage()
 void PhotonPackage::launch(double L, int ell, Position bfr, Direction bfk)
 {
     _L = L;
+    _L0 = L;
     _ell = ell;
     _bfr = bfr;
     _bfk = bfk;
     _nscatt = 0;
     _stellar = -1;
     _ad = 0;
+    _taucull = DBL_MAX;
+    _culled = false;
     setUnpolarized();
 }
 
@@ -32,12 +35,15 @@ void PhotonPackage::launch(double L, int ell, Position bfr, Direction bfk)
 void PhotonPackage::launchEmissionPeelOff(const PhotonPackage* pp, Direction bfk)
 {
     _L = pp->_L;
+    _L0 = pp->_L0;
     _ell = pp->_ell;
     _bfr = pp->_bfr;
     _bfk = bfk;
     _nscatt = 0;
     _stellar = pp->_stellar;
     _ad = 0;
+    _taucull = DBL_MAX;
+    _culled = false;
     setUnpolarized();
 
     // apply emission direction bias if not isotropic
@@ -49,12 +55,15 @@ void PhotonPackage::launchEmissionPeelOff(const PhotonPackage* pp, Direction bfk
 void PhotonPackage::launchScatteringPeelOff(const PhotonPackage* pp, Direction bfk, double w)
 {
     _L = pp->_L * w;
+    _L0 = pp->_L0;
     _ell = pp->_ell;
     _bfr = pp->_bfr;
     _bfk = bfk;
     _nscatt = pp->_nscatt + 1;
     _stellar = pp->_stellar;
     _ad = 0;
+    _taucull = DBL_MAX;
+    _culled = false;
     setUnpolarized();
 }
 
@@ -63,12 +72,15 @@ void PhotonPackage::launchScatteringPeelOff(const PhotonPackage* pp, Direction b
 void PhotonPackage::launchScatteringPeelOff(const PhotonPackage* pp, Position bfr, Direction bfk, double w)
 {
     _L = pp->_L * w;
+    _L0 = pp->_L0;
     _ell = pp->_ell;
     _bfr = bfr;
     _bfk = bfk;
     _nscatt = pp->_nscatt + 1;
     _stellar = pp->_stellar;
     _ad = 0;
+    _taucull = DBL_MAX;
+    _culled = false;
     setUnpolarized();
 }
 
@@ -110,3 +122,17 @@ void PhotonPackage::setLuminosity(double L)
 }
 
 ////////////////////////////////////////////////////////////////////
+
+void PhotonPackage::setCullingDepth(double tau)
+{
+    _taucull = tau;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void PhotonPackage::setCulled()
+{
+    _culled = true;
+}
+
+////////////////////////////////////////////////////////////////////
@@ -108,6 +108,16 @@ public:
     /** This function sets the luminosity of the photon package to a new value. */
     void setLuminosity(double L);
 
+    /** This function sets the culling depth of a peel off photon package, i.e. the optical depth
+        towards the instrument beyond which the peel off is subject to Russian roulette (see
+        Instrument::opticalDepth()). It should be called only just after launch. The launch
+        functions set the culling depth to DBL_MAX, which effectively disables culling. */
+    void setCullingDepth(double tau);
+
+    /** This function marks a peel off photon package as culled by Russian roulette, so that the
+        caller can keep track of the culling statistics. The launch functions clear the mark. */
+    void setCulled();
+
     // ------- Getting trivial properties -------
 
     /** This function returns true if the photon package has a stellar origin, false otherwise. */
@@ -121,6 +131,12 @@ public:
     /** This function returns the luminosity of the photon package. */
     double luminosity() const { return _L; }
 
+    /** This function returns the luminosity with which the photon package (or, for a peel off
+        photon package, its base photon package) was originally launched. Comparing this value to
+        the current luminosity yields the cumulative weight reduction experienced by the photon
+        package during its life cycle. */
+    double launchLuminosity() const { return _L0; }
+
     /** This function returns the wavelength index of the photon package. */
     int ell() const { return _ell; }
 
@@ -128,13 +144,24 @@ public:
         */
     int numScatt() const { return _nscatt; }
 
+    /** This function returns the culling depth of the photon package, as set by setCullingDepth().
+        */
+    double cullingDepth() const { return _taucull; }
+
+    /** This function returns true if the photon package was culled by Russian roulette since it
+        was launched, false otherwise. */
+    bool culled() const { return _culled; }
+
     // ------- Data members -------
 
 private:
     double _L;
+    double _L0;
+    double _taucull;
     int _ell;
     int _nscatt;
     int _stellar;
+    bool _culled;
     const AngularDistribution* _ad;
 };
 
@@ -0,0 +1,225 @@
+/*//////////////////////////////////////////////////////////////////
+////     The SKIRT project -- advanced radiative transfer       ////
+////       © Astronomical Observatory, Ghent University         ////
+///////////////////////////////////////////////////////////////// */
+
+#include "Profiler.hpp"
+#include "FilePaths.hpp"
+#include "Instrument.hpp"
+#include "InstrumentSystem.hpp"
+#include "Log.hpp"
+#include "ParallelFactory.hpp"
+#include "PeerToPeerCommunicator.hpp"
+#include "StringUtils.hpp"
+#include "System.hpp"
+
+////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    // the names of the counters and timers, in the order of the corresponding enumerations
+    const char* counterNames[] = { "launches", "paths", "pathSegments", "scatterings",
+                                   "absorptionWrites", "randomDraws" };
+    const char* timerNames[] = { "fillOpticalDepth", "detect", "absorb", "simulateScattering" };
+
+    // returns the specified string as a quoted JSON string
+    string quoted(string value)
+    {
+        string result = "\"";
+        for (char c : value)
+        {
+            if (c=='"' || c=='\\') result += '\\';
+            if (static_cast<unsigned char>(c) >= 0x20) result += c;
+        }
+        return result + "\"";
+    }
+
+    // returns the specified count as a JSON integer
+    string integer(double value)
+    {
+        return std::to_string(static_cast<uint64_t>(value));
+    }
+
+    // returns the specified floating point value as a JSON number
+    string number(double value)
+    {
+        return StringUtils::toString(value, 'e', 9);
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
+Profiler::Profiler(SimulationItem* parent)
+{
+    parent->addChild(this);
+}
+
+////////////////////////////////////////////////////////////////////
+
+void Profiler::enable(string producerInfo)
+{
+    _enabled = true;
+    _producerInfo = producerInfo;
+}
+
+////////////////////////////////////////////////////////////////////
+
+bool Profiler::enabled() const
+{
+    return _enabled;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void Profiler::beginPhase(string name)
+{
+    if (!_enabled) return;
+
+    // cache the items we need and the instrument names (the instrument system is optional)
+    _parfac = find<ParallelFactory>();
+    _instrumentNames.clear();
+    auto instrumentSystem = find<InstrumentSystem>(false);
+    if (instrumentSystem)
+        for (Instrument* instrument : instrumentSystem->instruments())
+            _instrumentNames.push_back(instrument->instrumentName());
+
+    // reset the statistics for all threads
+    int numThreads = _parfac->maxThreadCount();
+    _slots.assign(numThreads, Slot{});
+
+    // give each thread a cache-line-aligned range of peel-off counters, rounded up to whole lines
+    const size_t perLine = cacheLineSize / sizeof(uint64_t);
+    size_t stride = ((_instrumentNames.size() + perLine - 1) / perLine) * perLine;
+    _peelOffBuffer.assign(numThreads*stride + perLine, 0);
+    size_t misalignment = reinterpret_cast<uintptr_t>(_peelOffBuffer.data()) % cacheLineSize;
+    size_t offset = misalignment ? (cacheLineSize - misalignment) / sizeof(uint64_t) : 0;
+    for (int t=0; t!=numThreads; ++t) _slots[t].peelOffs = _peelOffBuffer.data() + offset + t*stride;
+
+    _phase = name;
+    _started = std::chrono::steady_clock::now();
+    _active = true;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void Profiler::endPhase()
+{
+    if (!_active) return;
+    _active = false;
+
+    Phase phase;
+    phase.name = _phase;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - _started;
+    phase.wallTime = elapsed.count();
+
+    // aggregate over all threads
+    phase.countv.resize(numCounters + 3*numTimers);
+    phase.peelOffv.resize(_instrumentNames.size());
+    for (const Slot& slot : _slots)
+    {
+        for (int c=0; c!=numCounters; ++c) phase.countv[c] += slot.counts[c];
+        for (int t=0; t!=numTimers; ++t)
+        {
+            phase.countv[numCounters + 3*t] += slot.calls[t];
+            phase.countv[numCounters + 3*t + 1] += slot.samples[t];
+            phase.countv[numCounters + 3*t + 2] += slot.seconds[t];
+        }
+        for (size_t i=0; i!=_instrumentNames.size(); ++i) phase.peelOffv[i] += slot.peelOffs[i];
+    }
+
+    // aggregate over all processes; report the wall time of the slowest process
+    auto comm = find<PeerToPeerCommunicator>();
+    comm->sumAll(phase.countv);
+    comm->sumAll(phase.peelOffv);
+    Array timev(comm->size());
+    timev[comm->rank()] = phase.wallTime;
+    comm->sumAll(timev);
+    phase.wallTime = timev.max();
+
+    _phases.push_back(phase);
+}
+
+////////////////////////////////////////////////////////////////////
+
+Profiler::Slot* Profiler::lookupSlot()
+{
+    return &_slots[_parfac->currentThreadIndex()];
+}
+
+////////////////////////////////////////////////////////////////////
+
+void Profiler::write() const
+{
+    if (!_enabled) return;
+
+    auto comm = find<PeerToPeerCommunicator>();
+    if (!comm->isRoot()) return;
+
+    string filepath = find<FilePaths>()->output("profile.json");
+    find<Log>()->info("Writing performance profile to " + filepath + "...");
+    std::ofstream out = System::ofstream(filepath);
+
+    out << "{\n";
+    out << "  \"producer\": " << quoted(_producerInfo) << ",\n";
+    out << "  \"simulation\": " << quoted(find<FilePaths>()->outputPrefix()) << ",\n";
+    out << "  \"processes\": " << comm->size() << ",\n";
+    out << "  \"threadsPerProcess\": " << find<ParallelFactory>()->maxThreadCount() << ",\n";
+    out << "  \"dataParallel\": " << (comm->dataParallel() ? "true" : "false") << ",\n";
+    out << "  \"sampleInterval\": " << sampleInterval << ",\n";
+    out << "  \"phases\": [";
+    for (size_t p=0; p!=_phases.size(); ++p)
+    {
+        const Phase& phase = _phases[p];
+        out << (p ? "," : "") << "\n    {\n";
+        out << "      \"name\": " << quoted(phase.name) << ",\n";
+        out << "      \"wallTime\": " << number(phase.wallTime) << ",\n";
+
+        out << "      \"counters\": {";
+        for (int c=0; c!=numCounters; ++c)
+            out << (c ? ", " : " ") << quoted(counterNames[c]) << ": " << integer(phase.countv[c]);
+        out << " },\n";
+
+        out << "      \"peelOffs\": {";
+        for (size_t i=0; i!=_instrumentNames.size(); ++i)
+            out << (i ? ", " : " ") << quoted(_instrumentNames[i]) << ": " << integer(phase.peelOffv[i]);
+        out << " },\n";
+
+        out << "      \"timers\": {";
+        for (int t=0; t!=numTimers; ++t)
+        {
+            double calls = phase.countv[numCounters + 3*t];
+            double samples = phase.countv[numCounters + 3*t + 1];
+            double seconds = phase.countv[numCounters + 3*t + 2];
+            double mean = samples ? seconds/samples : 0.;
+            out << (t ? "," : "") << "\n        " << quoted(timerNames[t]) << ": {"
+                << " \"calls\": " << integer(calls)
+                << ", \"samples\": " << integer(samples)
+                << ", \"sampledTime\": " << number(seconds)
+                << ", \"meanTime\": " << number(mean)
+                << ", \"estimatedTime\": " << number(mean*calls) << " }";
+        }
+        out << "\n      }\n    }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+////////////////////////////////////////////////////////////////////
+
+double Profiler::totalCount(Counter counter) const
+{
+    double total = 0.;
+    for (const Phase& phase : _phases) total += phase.countv[static_cast<int>(counter)];
+    return total;
+}
+
+////////////////////////////////////////////////////////////////////
+
+double Profiler::totalWallTime() const
+{
+    double total = 0.;
+    for (const Phase& phase : _phases) total += phase.wallTime;
+    return total;
+}
+
+////////////////////////////////////////////////////////////////////
+
@@ -0,0 +1,209 @@
+/*//////////////////////////////////////////////////////////////////
+////     The SKIRT project -- advanced radiative transfer       ////
+////       © Astronomical Observatory, Ghent University         ////
+///////////////////////////////////////////////////////////////// */
+
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include "Array.hpp"
+#include "SimulationItem.hpp"
+#include <chrono>
+class ParallelFactory;
+
+////////////////////////////////////////////////////////////////////
+
+/** The Profiler class collects low-overhead performance statistics for the photon shooting phases
+    of a simulation, and writes them to a machine-readable JSON file so that performance can be
+    tracked between SKIRT builds. Profiling is disabled by default; it is enabled through the
+    enable() function, which is invoked by the command line handler when requested.
+
+    For each photon shooting phase, delimited by calls to beginPhase() and endPhase(), the profiler
+    counts the photon packages launched, the paths calculated through the dust grid and the number
+    of path segments (i.e. cells crossed) on those paths, the peel-off photon packages detected by
+    each instrument, the scattering events, the absorption rates stored in the dust system, and the
+    random numbers drawn. In addition it keeps sampled timers for the hot-path operations listed in
+    the Timer enumeration: every call is counted, but only one in every sampleInterval calls is
+    actually timed, so that the overhead of reading the clock remains small. The estimated total
+    time for an operation is the mean sampled time multiplied by the number of calls. Note that
+    for very short operations the sampled time is dominated by the overhead of the clock itself.
+
+    To avoid locking and cache line contention, all statistics are stored in a separate Slot
+    for each execution thread. Code on the hot path obtains the slot for the current thread once
+    by calling slot(), and then updates it through the inline functions offered by the Slot
+    structure and the Sample class. When profiling is disabled or no phase is in progress, slot()
+    returns a null pointer, and these functions do nothing. At the end of each phase, the
+    statistics are aggregated over all threads and processes. */
+class Profiler : public SimulationItem
+{
+    //============= Public Types =============
+
+public:
+    /** This enumeration lists the event counters kept by the profiler. */
+    enum class Counter { Launches, Paths, PathSegments, Scatterings, AbsorptionWrites, RandomDraws };
+
+    /** This enumeration lists the sampled timers kept by the profiler. */
+    enum class Timer { FillOpticalDepth, Detect, Absorb, SimulateScattering };
+
+    /** The number of counters listed in the Counter enumeration. */
+    static const int numCounters = 6;
+
+    /** The number of timers listed in the Timer enumeration. */
+    static const int numTimers = 4;
+
+    /** The number of calls to a timed operation for each call that is actually timed. */
+    static const uint64_t sampleInterval = 16;
+
+    /** The assumed size in bytes of a cache line, used to keep the statistics for different
+        threads in separate cache lines. */
+    static const size_t cacheLineSize = 64;
+
+    /** A Slot holds the statistics for a single execution thread during the current phase. The
+        slots are stored in a single array, each padded with a cache line, so that the counters of
+        different threads never share a cache line. The peel-off counters, whose number depends on
+        the number of instruments, are stored in a separate buffer in which the counters for each
+        thread occupy their own cache-line-aligned range. */
+    struct Slot
+    {
+        /** This function adds the specified number of events to the specified counter. */
+        void count(Counter counter, uint64_t n = 1) { counts[static_cast<int>(counter)] += n; }
+
+        /** This function records a path through the dust grid with the specified number of
+            segments. */
+        void countPath(size_t segments)
+        {
+            counts[static_cast<int>(Counter::Paths)]++;
+            counts[static_cast<int>(Counter::PathSegments)] += segments;
+        }
+
+        /** This function records a peel-off detected by the instrument with the specified index. */
+        void countPeelOff(size_t instrument) { peelOffs[instrument]++; }
+
+        uint64_t counts[numCounters];   // the event counters
+        uint64_t calls[numTimers];      // the number of calls for each timed operation
+        uint64_t samples[numTimers];    // the number of calls actually timed for each operation
+        double seconds[numTimers];      // the total time spent in the calls actually timed
+        uint64_t* peelOffs;             // the number of peel-offs detected, indexed on instrument
+        char padding[cacheLineSize];    // avoids sharing cache lines between threads
+    };
+
+    /** An instance of the Sample class times a single call to one of the operations listed in
+        the Timer enumeration, from its construction to its destruction, if that call has been
+        selected for sampling. The constructor receives the slot for the current thread, or a null
+        pointer if profiling is not active, in which case the instance does nothing. */
+    class Sample
+    {
+    public:
+        /** The constructor counts the call and starts the clock if the call has been selected for
+            sampling. */
+        Sample(Slot* slot, Timer timer) : _slot(slot), _timer(static_cast<int>(timer))
+        {
+            if (_slot && (_slot->calls[_timer]++ % sampleInterval) == 0)
+            {
+                _sampled = true;
+                _started = std::chrono::steady_clock::now();
+            }
+        }
+
+        /** The destructor records the elapsed time if the call has been selected for sampling. */
+        ~Sample()
+        {
+            if (_sampled)
+            {
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - _started;
+                _slot->seconds[_timer] += elapsed.count();
+                _slot->samples[_timer]++;
+            }
+        }
+
+    private:
+        Slot* _slot;
+        int _timer;
+        bool _sampled{false};
+        std::chrono::steady_clock::time_point _started;
+    };
+
+    //============= Construction - Setup - Destruction =============
+
+public:
+    /** This constructor creates a profiler object that is hooked up as a child to the specified
+        parent in the simulation hierarchy, so that it will automatically be deleted. The setup()
+        function is \em not called by this constructor. */
+    explicit Profiler(SimulationItem* parent);
+
+    //======================== Other Functions =======================
+
+public:
+    /** This function enables profiling. The specified producer information (typically including
+        the SKIRT version and build time stamp) is included in the JSON report so that reports
+        from different builds can be told apart. */
+    void enable(string producerInfo);
+
+    /** This function returns true if profiling has been enabled. */
+    bool enabled() const;
+
+    /** If profiling is enabled, this function starts a new photon shooting phase with the
+        specified name, resetting the statistics for all threads. It must be called from the main
+        thread, outside of any parallel section. */
+    void beginPhase(string name);
+
+    /** If profiling is enabled, this function ends the current phase, aggregating the statistics
+        over all threads and all processes, and remembers the result for inclusion in the report.
+        It must be called by all processes, from the main thread. */
+    void endPhase();
+
+    /** This function returns the statistics slot for the current thread, or a null pointer if no
+        phase is in progress (which is always the case when profiling is disabled). Because it
+        looks up the index of the current thread, the function should be called once per chunk of
+        work, and the slot should be passed to the functions on the hot path. */
+    Slot* slot() { return _active ? lookupSlot() : nullptr; }
+
+    /** This function returns the statistics slot for the thread with the specified index, or a
+        null pointer if no phase is in progress (which is always the case when profiling is
+        disabled). */
+    Slot* slot(int thread) { return _active ? &_slots[thread] : nullptr; }
+
+    /** If profiling is enabled, this function writes the statistics for all phases ended so far
+        to a JSON file called <tt>prefix_profile.json</tt>. Only the root process writes the file.
+        */
+    void write() const;
+
+    /** This function returns the value of the specified counter, summed over all phases ended so
+        far. */
+    double totalCount(Counter counter) const;
+
+    /** This function returns the wall time, summed over all phases ended so far. */
+    double totalWallTime() const;
+
+private:
+    /** This function looks up the index of the current thread and returns the corresponding slot.
+        */
+    Slot* lookupSlot();
+
+    //======================== Data Members ========================
+
+private:
+    // the phase statistics aggregated over all threads and processes
+    struct Phase
+    {
+        string name;
+        double wallTime;
+        Array countv;      // counters, followed by calls, samples and seconds for each timer
+        Array peelOffv;    // the number of peel-offs for each instrument
+    };
+
+    bool _enabled{false};
+    bool _active{false};
+    string _producerInfo;
+    ParallelFactory* _parfac{nullptr};
+    vector<string> _instrumentNames;
+    vector<Slot> _slots;
+    vector<uint64_t> _peelOffBuffer;   // the peel-off counters for all slots, in aligned ranges
+    string _phase;
+    std::chrono::steady_clock::time_point _started;
+    vector<Phase> _phases;
+};
+
+////////////////////////////////////////////////////////////////////
+
+#endif
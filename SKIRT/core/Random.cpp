@@ -10,6 +10,7 @@
 #include "ParallelFactory.hpp"
 #include "PeerToPeerCommunicator.hpp"
 #include "Position.hpp"
+#include "Profiler.hpp"
 
 //////////////////////////////////////////////////////////////////////
 
@@ -18,6 +19,7 @@ void Random::setupSelfBefore()
     SimulationItem::setupSelfBefore();
 
     _parfac = find<ParallelFactory>();
+    _profiler = find<Profiler>(false);
     int Nthreads = _parfac->maxThreadCount();
     _mtv.resize(Nthreads);
     _mtiv.resize(Nthreads);
@@ -62,11 +64,33 @@ void Random::randomize()
 
 //////////////////////////////////////////////////////////////////////
 
+void Random::saveState()
+{
+    _savedMtv = _mtv;
+    _savedMtiv = _mtiv;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void Random::restoreState()
+{
+    if (_savedMtv.empty()) return;
+    _mtv = _savedMtv;
+    _mtiv = _savedMtiv;
+}
+
+//////////////////////////////////////////////////////////////////////
+
 double Random::uniform()
 {
     int thread = _parfac->currentThreadIndex();
     vector<unsigned long>& mt = _mtv[thread];
     int& mti = _mtiv[thread];
+    if (_profiler)
+    {
+        Profiler::Slot* slot = _profiler->slot(thread);
+        if (slot) slot->count(Profiler::Counter::RandomDraws);
+    }
     double ans = 0.0;
     do
     {
@@ -12,6 +12,7 @@ class Box;
 class Direction;
 class ParallelFactory;
 class Position;
+class Profiler;
 
 //////////////////////////////////////////////////////////////////////
 
@@ -57,6 +58,16 @@ public:
         called with the number of threads as an argument. */
     void randomize();
 
+    /** This function saves a copy of the current state of the random generators for all threads,
+        so that it can be restored later on by calling restoreState(). */
+    void saveState();
+
+    /** This function restores the state of the random generators for all threads to the state
+        saved by the most recent call to saveState(), so that a simulation that is run again
+        receives the same random sequences. If saveState() has never been called, the function
+        does nothing. */
+    void restoreState();
+
     /** This function generates a random uniform deviate, i.e. a random double precision number in
         the interval [0,1]. For details how this is exactly done, see the information at
         http://www.math.keio.ac.jp/matumoto/emt.html. */
@@ -119,8 +130,15 @@ private:
     vector<vector<unsigned long>> _mtv;
     vector<int> _mtiv;
 
+    // the state of the random generators saved by saveState()
+    vector<vector<unsigned long>> _savedMtv;
+    vector<int> _savedMtiv;
+
     // a cached pointer to the ParallelFactory instance associated with this simulation hierarchy
     ParallelFactory* _parfac{nullptr};
+
+    // a cached pointer to the Profiler instance associated with this simulation hierarchy, if any
+    Profiler* _profiler{nullptr};
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -33,6 +33,13 @@ void SEDInstrument::detect(PhotonPackage* pp)
 
 ////////////////////////////////////////////////////////////////////
 
+void SEDInstrument::startCommunication()
+{
+    beginSumResults({ &_Ftotv });
+}
+
+////////////////////////////////////////////////////////////////////
+
 void SEDInstrument::write()
 {
     // construct a list of SED array pointers and the corresponding column names
@@ -32,6 +32,9 @@ protected:
         See SimpleInstrument::detect() for more information. */
     void detect(PhotonPackage* pp) override;
 
+    /** This function starts the summation of the SED across processes. */
+    void startCommunication() override;
+
     /** This function calibrates and outputs the instrument data.
         See SimpleInstrument::write() for more information. */
     void write() override;
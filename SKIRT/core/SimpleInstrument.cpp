@@ -41,6 +41,14 @@ void SimpleInstrument::detect(PhotonPackage* pp)
 
 ////////////////////////////////////////////////////////////////////
 
+void SimpleInstrument::startCommunication()
+{
+    beginSumResults({ &_Ftotv });
+    _ftotv.startCompleteCube();
+}
+
+////////////////////////////////////////////////////////////////////
+
 void SimpleInstrument::write()
 {
     // construct a list of SED array pointers and the corresponding column names
@@ -55,7 +63,7 @@ void SimpleInstrument::write()
     std::shared_ptr<Array> completeCube = _ftotv.constructCompleteCube();
 
     // construct a list of data cube pointers and the corresponding file names
-    vector<Array*> farrays({ completeCube.get() });
+    vector<std::shared_ptr<Array>> farrays({ completeCube });
     vector<string> fnames({ "total" });
 
     // calibrate and output the result
@@ -44,6 +44,9 @@ protected:
         f-vector. */
     void detect(PhotonPackage* pp) override;
 
+    /** This function starts the summation of the SED and of the data cube across processes. */
+    void startCommunication() override;
+
     /** This function calibrates and outputs the instrument data.
         The calibration takes care of the conversion from bolometric luminosity units to flux
         density units (for the F-vector) and surface brightness units (for the f-vector). The
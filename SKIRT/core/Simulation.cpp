@@ -94,3 +94,10 @@ PeerToPeerCommunicator* Simulation::communicator() const
 }
 
 ////////////////////////////////////////////////////////////////////
+
+Profiler* Simulation::profiler() const
+{
+    return _profiler;
+}
+
+////////////////////////////////////////////////////////////////////
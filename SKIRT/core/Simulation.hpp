@@ -11,6 +11,7 @@
 #include "FilePaths.hpp"
 #include "ParallelFactory.hpp"
 #include "PeerToPeerCommunicator.hpp"
+#include "Profiler.hpp"
 #include "Random.hpp"
 #include "Units.hpp"
 
@@ -21,7 +22,7 @@
     Simulation instance holds a number of essential simulation-wide property instances. Some of
     these (a random number generator and a system of units) are discoverable and hence fully
     user-configurable. The other properties (a file paths object, a logging mechanism, a parallel
-    factory, and a peer-to-peer communicator) are not discoverable. When a Simulation instance is
+    factory, a peer-to-peer communicator, and a profiler) are not discoverable. When a Simulation instance is
     constructed, a default instance is created for each of these properties. A reference to these
     property instances can be retrieved through the corresponding getter, and in some cases, the
     property can be further configured under program control (e.g., to set the input and output
@@ -31,8 +32,9 @@
     an instance of the FilePaths class with default paths and no filename prefix; the \em log
     attribute is set to an instance of the Console class; the \em parallelFactory attribute is set
     to an instance of the ParallelFactory class with the default maximum number of parallel
-    threads; and the \em communicator attribute is set to an instance of the PeerToPeerCommunicator
-    class. */
+    threads; the \em communicator attribute is set to an instance of the PeerToPeerCommunicator
+    class; and the \em profiler attribute is set to an instance of the Profiler class, with
+    profiling disabled. */
 class Simulation : public SimulationItem
 {
     ITEM_ABSTRACT(Simulation, SimulationItem, "the simulation")
@@ -84,6 +86,9 @@ public:
     /** Returns the logging mechanism for this simulation hierarchy. */
     ParallelFactory* parallelFactory() const;
 
+    /** Returns the performance profiler for this simulation hierarchy. */
+    Profiler* profiler() const;
+
     //======================== Data Members ========================
 
 private:
@@ -92,6 +97,7 @@ private:
     Log* _log{ new ConsoleLog(this) };
     FilePaths* _paths{ new FilePaths(this) };
     ParallelFactory* _factory{ new ParallelFactory(this) };
+    Profiler* _profiler{ new Profiler(this) };
 };
 
 ////////////////////////////////////////////////////////////////////
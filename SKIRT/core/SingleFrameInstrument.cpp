@@ -5,7 +5,11 @@
 
 #include "SingleFrameInstrument.hpp"
 #include "FITSInOut.hpp"
+#include "InstrumentSystem.hpp"
 #include "Log.hpp"
+#include "Parallel.hpp"
+#include "ParallelFactory.hpp"
+#include "PeerToPeerCommunicator.hpp"
 #include "PhotonPackage.hpp"
 #include "Units.hpp"
 #include "WavelengthGrid.hpp"
@@ -49,76 +53,95 @@ int SingleFrameInstrument::pixelOnDetector(const PhotonPackage* pp) const
 
 ////////////////////////////////////////////////////////////////////
 
-void SingleFrameInstrument::calibrateAndWriteDataCubes(const vector<Array*>& farrays, const vector<string>& fnames)
+// Private class to calibrate the data cubes in parallel
+namespace
 {
-    WavelengthGrid* lambdagrid = find<WavelengthGrid>();
-    int Nlambda = lambdagrid->numWavelengths();
-
-    // calibration step 1: conversion from bolometric luminosities (units W) to monochromatic luminosities (units W/m)
-    for (int ell=0; ell<Nlambda; ell++)
+    // calibrates the frames for a given wavelength index in all data cubes
+    class DataCubeCalibrator : public ParallelTarget
     {
-        double dlambda = lambdagrid->dlambda(ell);
-        for (int i=0; i<_Nxp; i++)
+    private:
+        const vector<Array*>& _farrays;
+        WavelengthGrid* _lambdagrid;
+        Units* _units;
+        size_t _Nframep;
+        double _area, _fourpid2;
+
+    public:
+        DataCubeCalibrator(const vector<Array*>& farrays, WavelengthGrid* lambdagrid, Units* units, size_t Nframep,
+                           double area, double fourpid2)
+            : _farrays(farrays), _lambdagrid(lambdagrid), _units(units), _Nframep(Nframep),
+              _area(area), _fourpid2(fourpid2) { }
+
+        void body(size_t ell)
         {
-            for (int j=0; j<_Nyp; j++)
+            // the calibration factor combines the conversion from bolometric luminosities (W) to monochromatic
+            // luminosities (W/m), the correction for the area of the pixels (W/m/sr), the conversion to flux
+            // density (W/m3/sr) by taking into account the distance, and the conversion from program SI units to
+            // the correct output units (using lambda*flambda for the surface brightness, in units like W/m2/arcsec2)
+            double factor = _units->osurfacebrightness(_lambdagrid->lambda(ell), 1.)
+                            / (_lambdagrid->dlambda(ell) * _area * _fourpid2);
+            for (Array* farr : _farrays)
             {
-                size_t m = i + _Nxp*j + _Nframep*ell;
-                for (Array* farr : farrays)
+                if (farr->size())
                 {
-                    if (farr->size()) (*farr)[m] /= dlambda;
+                    double* frame = &(*farr)[_Nframep*ell];
+                    for (size_t m=0; m<_Nframep; m++) frame[m] *= factor;
                 }
             }
         }
-    }
+    };
+}
+
+////////////////////////////////////////////////////////////////////
+
+void SingleFrameInstrument::calibrateAndWriteDataCubes(const vector<std::shared_ptr<Array>>& fcubes,
+                                                       const vector<string>& fnames)
+{
+    vector<Array*> farrays;
+    for (const auto& fcube : fcubes) farrays.push_back(fcube.get());
+
+    WavelengthGrid* lambdagrid = find<WavelengthGrid>();
+    int Nlambda = lambdagrid->numWavelengths();
+    Units* units = find<Units>();
+    Parallel* parallel = find<ParallelFactory>()->parallel();
 
-    // calibration step 2: correction for the area of the pixels of the images; the units are now W/m/sr
+    // calibrate all data cubes in a single pass, parallelized over the wavelengths
     double xpsizang = 2.0*atan(_xpsiz/(2.0*distance()));
     double ypsizang = 2.0*atan(_ypsiz/(2.0*distance()));
     double area = xpsizang*ypsizang;
-    for (Array* farr : farrays)
-    {
-        (*farr) /= area;
-    }
-
-    // calibration step 3: conversion of the flux per pixel from monochromatic luminosity units (W/m/sr)
-    // to flux density units (W/m3/sr) by taking into account the distance
     double fourpid2 = 4.0*M_PI*distance()*distance();
-    for (Array* farr : farrays)
-    {
-        (*farr) /= fourpid2;
-    }
+    DataCubeCalibrator calibrator(farrays, lambdagrid, units, _Nframep, area, fourpid2);
+    parallel->call(&calibrator, Nlambda);
 
-    // conversion from program SI units (at this moment W/m3/sr) to the correct output units;
-    // we use lambda*flambda for the surface brightness (in units like W/m2/arcsec2)
-    Units* units = find<Units>();
-    for (int ell=0; ell<Nlambda; ell++)
+    // hand each array to the frame sink, if there is one
+    const InstrumentSystem::FrameSink& sink = find<InstrumentSystem>()->frameSink();
+    if (sink)
     {
-        // for performance reasons, determine the units scaling factor only once for each wavelength
-        double factor = units->osurfacebrightness(lambdagrid->lambda(ell), 1.);
-        for (int i=0; i<_Nxp; i++)
+        if (find<PeerToPeerCommunicator>()->isRoot())
         {
-            for (int j=0; j<_Nyp; j++)
-            {
-                size_t m = i + _Nxp*j + _Nframep*ell;
-                for (Array* farr : farrays)
-                {
-                    if (farr->size()) (*farr)[m] *= factor;
-                }
-            }
+            for (size_t q = 0; q < farrays.size(); q++)
+                if (farrays[q]->size()) sink(instrumentName() + "_" + fnames[q], *(farrays[q]));
         }
+        return;
     }
 
-    // Write a FITS file for each array
-    for (size_t q = 0; q < farrays.size(); q++)
+    // schedule writing a FITS file for each array, so that the files of all instruments are written concurrently
+    InstrumentSystem* instrumentSystem = find<InstrumentSystem>();
+    int Nxp = _Nxp, Nyp = _Nyp;
+    double xpsiz = units->olength(_xpsiz), ypsiz = units->olength(_ypsiz);
+    double xpc = units->olength(_xpc), ypc = units->olength(_ypc);
+    string usb = units->usurfacebrightness(), ulength = units->ulength();
+    for (size_t q = 0; q < fcubes.size(); q++)
     {
-        if (farrays[q]->size())
+        if (!fcubes[q]->size()) continue;
+        std::shared_ptr<Array> fcube = fcubes[q];
+        string filename = instrumentName() + "_" + fnames[q];
+        string description = fnames[q] + " flux";
+        instrumentSystem->scheduleOutput([=]()
         {
-            string filename = instrumentName() + "_" + fnames[q];
-            string description = fnames[q] + " flux";
-            FITSInOut::write(this, description, filename, *(farrays[q]), _Nxp, _Nyp, Nlambda,
-                             units->olength(_xpsiz), units->olength(_ypsiz), units->olength(_xpc), units->olength(_ypc),
-                             units->usurfacebrightness(), units->ulength());
-        }
+            FITSInOut::write(this, description, filename, *fcube, Nxp, Nyp, Nlambda,
+                             xpsiz, ypsiz, xpc, ypc, usb, ulength);
+        });
     }
 }
 
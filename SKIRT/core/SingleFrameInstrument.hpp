@@ -107,8 +107,15 @@ protected:
         care of the conversion from bolometric luminosity units to surface brightness units. The
         unit in which the surface brightness is written depends on the global units choice, but
         typically it is in \f$\text{W}\,\text{m}^{-2}\,\text{arcsec}^{-2}\f$. The calibration is
-        performed in-place in the arrays, so the incoming data is overwritten. */
-    void calibrateAndWriteDataCubes(const vector<Array*>& farrays, const vector<string>& fnames);
+        performed in-place in the arrays, so the incoming data is overwritten. It consists of a
+        single pass over the data, parallelized over the wavelengths, with a combined calibration
+        factor for each wavelength. The FITS files are not written immediately; instead they are
+        scheduled with the instrument system, which writes the files of the instrument
+        concurrently (see InstrumentSystem::scheduleOutput()). The arrays are passed as shared
+        pointers so that they stay alive until they have been written. If a frame sink has been
+        installed in the instrument system, the calibrated arrays are handed to the sink instead
+        (see InstrumentSystem::setFrameSink()). */
+    void calibrateAndWriteDataCubes(const vector<std::shared_ptr<Array>>& fcubes, const vector<string>& fnames);
 
     //======================== Data Members ========================
 
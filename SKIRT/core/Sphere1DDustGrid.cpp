@@ -133,6 +133,7 @@ void Sphere1DDustGrid::path(DustGridPath* path) const
             int m = i;
             double ds = qN-q;
             path->addSegment(m, ds);
+            if (path->isComplete()) return;
             i--;
             q = qN;
             rN = _rv[i];
@@ -149,6 +150,7 @@ void Sphere1DDustGrid::path(DustGridPath* path) const
         int m = i;
         double ds = qN-q;
         path->addSegment(m, ds);
+        if (path->isComplete()) return;
         i++;
         if (i>=_Nr) return;
         else
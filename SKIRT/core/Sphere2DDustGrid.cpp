@@ -297,6 +297,7 @@ void Sphere2DDustGrid::path(DustGridPath* path) const
         if (inext!=i || knext!=k)
         {
             path->addSegment(index(i,k), ds);
+            if (path->isComplete()) return;
             bfr += bfk*(ds+eps);
             i = inext;
             k = knext;
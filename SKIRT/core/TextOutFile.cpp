@@ -14,10 +14,25 @@
 
 ////////////////////////////////////////////////////////////////////
 
+namespace
+{
+    // The size of the text buffer that triggers writing to the output stream
+    const size_t textBufferSize = 1024*1024;
+
+    // The total number of values buffered over all columns that triggers writing to the binary file
+    const size_t columnBufferSize = 4*1024*1024;
+
+    // The size of the header of a binary file, which must be a multiple of 64 bytes for the .npy format
+    const size_t headerSize = 128;
+}
+
+////////////////////////////////////////////////////////////////////
+
 TextOutFile::TextOutFile(const SimulationItem* item, string filename, string description, bool overwrite)
 {
     _log = item->find<Log>();
     _filepath = item->find<FilePaths>()->output(filename + ".dat");
+    _binpath = item->find<FilePaths>()->output(filename + ".npy");
     _units = item->find<Units>();
 
     // Only open the output file if this is the root process
@@ -32,9 +47,41 @@ TextOutFile::TextOutFile(const SimulationItem* item, string filename, string des
 
 TextOutFile::~TextOutFile()
 {
+    // Complete the binary file, if it was opened by this process
+    if (_binout.is_open())
+    {
+        flushColumns();
+        if (_rowsWritten != _numRows)
+        {
+            _log->warning("Binary file " + _binpath + " received " + std::to_string(_rowsWritten) + " rows instead of "
+                          + std::to_string(_numRows));
+
+            // extend the file to its full size; the missing values are zero
+            _binout.seekp(headerSize + _ncolumns*_numRows*sizeof(double) - 1);
+            _binout.put(0);
+        }
+
+        // Write the .npy header: magic string, version 1.0, header length, and a dictionary padded with spaces
+        string dict = "{'descr': '<f8', 'fortran_order': True, 'shape': (" + std::to_string(_numRows) + ", "
+                      + std::to_string(_ncolumns) + "), }";
+        dict.resize(headerSize-10-1, ' ');
+        dict += '\n';
+        string header = "\x93NUMPY";
+        header += '\x01';
+        header += '\x00';
+        header += static_cast<char>(dict.size() & 0xFF);
+        header += static_cast<char>(dict.size() >> 8);
+        header += dict;
+        _binout.seekp(0);
+        _binout.write(header.data(), header.size());
+        _binout.close();
+        _log->info("File " + _binpath + " created.");
+    }
+
     // Close the output file, if it was opened by this process
     if (_out.is_open())
     {
+        flushText();
         _out.close();
         _log->info("File " + _filepath + " created.");
     }
@@ -42,10 +89,35 @@ TextOutFile::~TextOutFile()
 
 ////////////////////////////////////////////////////////////////////
 
+void TextOutFile::setBinaryColumns(size_t numRows)
+{
+    if (_ncolumns) throw FATALERROR("Binary columns must be requested before adding columns");
+
+    _binary = true;
+    _numRows = numRows;
+    if (_out.is_open())
+    {
+        // Open the binary file and reserve space for the header and all values
+        _binout.open(_binpath, std::ios_base::out | std::ios_base::binary);
+        if (!_binout) throw FATALERROR("Could not open the binary file " + _binpath);
+        writeLine("# The values for the columns listed below are stored in binary format in "
+                  + StringUtils::filename(_binpath));
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
 void TextOutFile::addColumn(string description, char format, int precision)
 {
+    // force 'd' and unknown formats to fixed point with zero digits after decimal point,
+    // and force the precision within range, as in StringUtils::toString()
+    if (format!='f' && format!='e' && format!='g')
+    {
+        format = 'f';
+        precision = 0;
+    }
     _formats.push_back(format);
-    _precisions.push_back(precision);
+    _precisions.push_back(min(max(precision,0),18));
 
     writeLine("# column " + std::to_string(++_ncolumns) + ": " + description);
 }
@@ -56,22 +128,68 @@ void TextOutFile::writeLine(string line)
 {
     if (_out.is_open())
     {
-        _out << line << std::endl;
+        _buffer += line;
+        _buffer += '\n';
+        if (_buffer.size() >= textBufferSize) flushText();
     }
 }
 
 ////////////////////////////////////////////////////////////////////
 
-void TextOutFile::writeRow(vector<double> values)
+void TextOutFile::writeRow(const vector<double>& values)
 {
     if (values.size() != _ncolumns) throw FATALERROR("Number of values in row does not match the number of columns");
+    if (!_out.is_open()) return;
+
+    // store the values in the column buffers for binary output
+    if (_binary)
+    {
+        if (_rowsWritten == _numRows) throw FATALERROR("Number of rows exceeds the number announced for binary output");
+        if (_columnv.empty()) _columnv.resize(_ncolumns);
+        for (size_t i=0; i<_ncolumns; i++) _columnv[i].push_back(values[i]);
+        _rowsWritten++;
+        if ((_rowsWritten-_rowsFlushed)*_ncolumns >= columnBufferSize) flushColumns();
+        return;
+    }
+
+    // format the values directly into the text buffer
+    char formatString[] = {'%', '1', '.', '*', 0, 0};
+    char result[30];
+    for (size_t i=0; i<_ncolumns; i++)
+    {
+        formatString[4] = _formats[i];
+        int n = snprintf(result, sizeof(result), formatString, _precisions[i], values[i]);
+        if (i) _buffer += ' ';
+        if (n < static_cast<int>(sizeof(result))) _buffer.append(result, n);
+        else _buffer += StringUtils::toString(values[i], _formats[i], _precisions[i]);
+    }
+    _buffer += '\n';
+    if (_buffer.size() >= textBufferSize) flushText();
+}
+
+////////////////////////////////////////////////////////////////////
+
+void TextOutFile::flushText()
+{
+    _out.write(_buffer.data(), _buffer.size());
+    _buffer.clear();
+}
+
+////////////////////////////////////////////////////////////////////
+
+void TextOutFile::flushColumns()
+{
+    if (_columnv.empty()) return;
 
-    string line;
+    // each column occupies a contiguous range in the file; write the buffered values at the appropriate position
+    size_t count = _rowsWritten - _rowsFlushed;
     for (size_t i=0; i<_ncolumns; i++)
     {
-        line += (i ? " " : "") + StringUtils::toString(values[i], _formats[i], _precisions[i]);
+        _binout.seekp(headerSize + (i*_numRows + _rowsFlushed)*sizeof(double));
+        _binout.write(reinterpret_cast<const char*>(_columnv[i].data()), count*sizeof(double));
+        _columnv[i].clear();
     }
-    writeLine(line);
+    _rowsFlushed = _rowsWritten;
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -18,7 +18,18 @@ class Units;
     its constructor. Text is written per line, by calling the writeLine() function. The file is
     automatically closed when the object is destructed. In a multiprocessing environment, only the
     root process will be allowed to write to the specified file; calls to writeLine() performed by
-    other processes will have no effect. */
+    other processes will have no effect.
+
+    The text is collected in an internal buffer that is written to the file in large pieces, so
+    that writing a table with many rows does not involve a system call for every row.
+
+    For large tables, the client can request binary columnar output by calling
+    setBinaryColumns() before adding any columns. In that case, the values passed to writeRow()
+    are stored as double precision floating point numbers in a separate file in NumPy \c .npy
+    format, with the extension \c .npy instead of \c .dat. The values for each column are stored
+    contiguously (i.e. the array has Fortran order), so that the table can be loaded with the
+    NumPy \c load() function without parsing. The text file still receives all lines written by
+    writeLine() and addColumn(), describing the columns in the binary file. */
 class TextOutFile
 {
     //=============== Construction - Destruction  ==================
@@ -48,6 +59,12 @@ public:
         is not the root, this function will have no effect. */
     void writeLine(string line);
 
+    /** This function switches the table values written by writeRow() to binary columnar output,
+        as described in the class header. The argument specifies the number of rows that will be
+        written, which determines the layout of the binary file. The function must be called
+        before the first call to addColumn(). */
+    void setBinaryColumns(size_t numRows);
+
     /** This function (virtually) adds a new column to the text file, characterized by a certain
         description and formatting. The format is 'd' for integer values, 'e' for scientific notation, 'f'
         for floating point notation and 'g' for the most concise 'e' or 'f'. For the
@@ -61,7 +78,15 @@ public:
         where adjecent values are seperated by a space. The values are formatted according to the
         'format' and 'precision' specified by the addColumn function. If the number of values in the
         list does not match the number of columns, a FatalError is thrown. */
-    void writeRow(vector<double> values);
+    void writeRow(const vector<double>& values);
+
+private:
+    /** This function writes the contents of the text buffer to the file and clears the buffer. */
+    void flushText();
+
+    /** This function writes the buffered binary column values to the binary file and clears the
+        buffers. */
+    void flushColumns();
 
     //======================== Data Members ========================
 
@@ -75,6 +100,16 @@ private:
     size_t _ncolumns{0};
     vector<char> _formats;
     vector<int> _precisions;
+    string _buffer;     // the text waiting to be written to the output stream
+
+    // binary columnar output, used only after setBinaryColumns() has been called
+    bool _binary{false};
+    string _binpath;
+    std::ofstream _binout;          // the output stream for the binary file
+    size_t _numRows{0};             // the number of rows announced by the client
+    size_t _rowsWritten{0};         // the number of rows passed to writeRow() so far
+    size_t _rowsFlushed{0};         // the number of rows already written to the binary file
+    vector<vector<double>> _columnv; // the buffered values for each column
 };
 
 ////////////////////////////////////////////////////////////////////
@@ -11,32 +11,13 @@
 #include "NR.hpp"
 #include "Table.hpp"
 #include "WavelengthGrid.hpp"
+#include <tuple>
 
 ////////////////////////////////////////////////////////////////////
 
 // container classes that are highly specialized to optimize the operations in this class
 namespace
 {
-    // square matrix
-    template<typename T> class Square
-    {
-    private:
-        size_t _n;
-        T* _v;
-
-    public:
-        // constructor sets maximum size and logical size
-        Square(size_t n) : _n(n), _v(new T[n*n]) { }
-        ~Square() { delete[] _v; }
-
-        // sets logical size, which must not be larger than maximum size set in constructor (is not checked)
-        // does not clear values; does not resize underlying memory
-        void resize(size_t n) { _n = n; }
-
-        // access to values  (const version currently not needed)
-        T& operator()(size_t i, size_t j) { return _v[i*_n+j]; }
-    };
-
     // square matrix with only items below the diagonal (i>j)
     template<typename T> class Triangle
     {
@@ -52,6 +33,39 @@ namespace
         // access to values; must have i>j (is not checked)
         const T& operator()(size_t i, size_t j) const { return _v[offset(i)+j]; }
         T& operator()(size_t i, size_t j) { return _v[offset(i)+j]; }
+
+        // returns the index of the first item in row i, as if the items were stored contiguously
+        static size_t rowOffset(size_t i) { return offset(i); }
+    };
+
+    // scratch memory for calculating the probabilities for a batch of K radiation fields at once;
+    // all values are stored with the field index k running fastest, so that the innermost loops
+    // of the calculation run over contiguous memory; the buffers only grow so that they can be
+    // reused for many calculations without reallocation
+    class Workspace
+    {
+    public:
+        int K{0};               // the number of radiation fields in the current batch
+        vector<double> Jv;      // the radiation fields (indexed on ell and k)
+        vector<double> Am;      // the transition matrix coefficients below the diagonal (indexed on f,i and k)
+        vector<double> Pv;      // the probabilities (indexed on i and k)
+        vector<double> sumv;    // partial sums (indexed on k)
+
+        // copies the radiation fields with the specified indices from the given table into the workspace
+        void setFields(const ArrayTable<2>& Jvv, const int* kv, int Nk)
+        {
+            K = Nk;
+            size_t Nlambda = K ? Jvv[kv[0]].size() : 0;
+            grow(Jv, Nlambda*K);
+            for (int k=0; k<K; k++)
+            {
+                const Array& Jfield = Jvv[kv[k]];
+                for (size_t ell=0; ell<Nlambda; ell++) Jv[ell*K+k] = Jfield[ell];
+            }
+        }
+
+        // makes sure that the specified buffer has at least the specified size
+        static void grow(vector<double>& v, size_t n) { if (v.size() < n) v.resize(n); }
     };
 }
 
@@ -173,82 +187,129 @@ public:
         }
     }
 
-    // calculate the probabilities
-    // Pv: the calculated probabilities (out)
-    // ioff: the index offset in the temperature grid used for this calculation (out)
-    // Am: scratch memory for the calculation (internal only)
-    // Tmin/Tmax: temperature range in which to perform the calculation (in), and
-    //            temperature range where the calculated probabilities are above a certain fraction of maximum (out)
-    // Jv: the radiation field (in)
-    void calcprobs(Array& Pv, int& ioff, Square<double>& Am, double& Tmin, double& Tmax, const Array& Jv) const
+    // determine the index range in the temperature grid used for calculating the probabilities
+    // Tmin/Tmax: temperature range in which to perform the calculation (in)
+    // ioff: the index offset in the temperature grid (out)
+    // NT: the number of temperature grid points (out)
+    void range(double Tmin, double Tmax, int& ioff, int& NT) const
     {
         ioff = NR::locateClip(_grid->_Tv, Tmin);
-        int NT = NR::locateClip(_grid->_Tv, Tmax) - ioff + 2;
+        NT = NR::locateClip(_grid->_Tv, Tmax) - ioff + 2;
+    }
 
-        // copy/calculate the transition matrix coefficients
-        Am.resize(NT);
+    // calculate the probabilities for the batch of radiation fields currently stored in the workspace
+    // ws: the radiation fields (in), the calculated probabilities (out), and scratch memory for the calculation
+    // ioff/NT: the index range in the temperature grid in which to perform the calculation, obtained from range() (in)
+    // Tminv/Tmaxv: for each field, the temperature range where the calculated probabilities are above
+    //              a certain fraction of maximum (out)
+    void calcprobs(Workspace& ws, int ioff, int NT, double* Tminv, double* Tmaxv) const
+    {
+        int K = ws.K;
+        Workspace::grow(ws.Am, Triangle<double>::rowOffset(NT)*K);
+        Workspace::grow(ws.Pv, NT*K);
+        Workspace::grow(ws.sumv, K);
+        const double* Jv = ws.Jv.data();
+        double* Am = ws.Am.data();
+        double* Pv = ws.Pv.data();
+        double* sumv = ws.sumv.data();
+
+        // copy/calculate the transition matrix coefficients below the diagonal
         for (int f=1; f<NT; f++)
         {
             const short* ELLv = &_ELLm(f+ioff,ioff);
             const double* HRv = &_HRm(f+ioff,ioff);
+            double* Afv = Am + Triangle<double>::rowOffset(f)*K;
             for (int i=0; i<f; i++)
             {
                 int ell = ELLv[i];
-                Am(f,i) = ell>=0 ? HRv[i] * Jv[ell] : 0.;
+                double* Afiv = Afv + i*K;
+                if (ell>=0)
+                {
+                    double HR = HRv[i];
+                    const double* Jellv = Jv + ell*K;
+                    for (int k=0; k<K; k++) Afiv[k] = HR * Jellv[k];
+                }
+                else
+                {
+                    for (int k=0; k<K; k++) Afiv[k] = 0.;
+                }
             }
         }
-        for (int i=1; i<NT; i++)
-        {
-            Am(i-1,i) = _CRv[i+ioff];
-        }
 
         // calculate the cumulative matrix coefficients, in place
         for (int f=NT-2; f>0; f--)
         {
-            for (int i=0; i<f; i++)
-            {
-                Am(f,i) += Am(f+1,i);
-            }
+            double* Afv = Am + Triangle<double>::rowOffset(f)*K;
+            const double* Af1v = Am + Triangle<double>::rowOffset(f+1)*K;
+            int n = f*K;
+            for (int j=0; j<n; j++) Afv[j] += Af1v[j];
         }
 
-        // calculate the probabilities
-        Pv.resize(NT);
-        Pv[0] = 1.;
+        // calculate the probabilities; the coefficients above the diagonal are the cooling rates,
+        // which do not depend on the radiation field
+        for (int k=0; k<K; k++) Pv[k] = 1.;
         for (int i=1; i<NT; i++)
         {
-            double sum = 0.;
-            for (int j=0; j<i; j++) sum += Am(i,j) * Pv[j];
-            Pv[i] = sum / Am(i-1,i);
+            const double* Aiv = Am + Triangle<double>::rowOffset(i)*K;
+            for (int k=0; k<K; k++) sumv[k] = 0.;
+            for (int j=0; j<i; j++)
+            {
+                const double* Aijv = Aiv + j*K;
+                const double* Pjv = Pv + j*K;
+                for (int k=0; k<K; k++) sumv[k] += Aijv[k] * Pjv[k];
+            }
+            double CR = _CRv[i+ioff];
+            double* Piv = Pv + i*K;
+            for (int k=0; k<K; k++) Piv[k] = sumv[k] / CR;
 
             // rescale if needed to keep infinities from happening
-            if (Pv[i] > 1e10) for (int j=0; j<=i; j++) Pv[j]/=Pv[i];
+            for (int k=0; k<K; k++)
+            {
+                if (Piv[k] > 1e10) for (int j=0; j<=i; j++) Pv[j*K+k] /= Piv[k];
+            }
         }
 
         // normalize probabilities to unity
-        Pv /= Pv.sum();
+        for (int k=0; k<K; k++) sumv[k] = 0.;
+        for (int i=0; i<NT; i++)
+        {
+            const double* Piv = Pv + i*K;
+            for (int k=0; k<K; k++) sumv[k] += Piv[k];
+        }
+        for (int i=0; i<NT; i++)
+        {
+            double* Piv = Pv + i*K;
+            for (int k=0; k<K; k++) Piv[k] /= sumv[k];
+        }
 
         // determine the temperature range where the probabability is above a given fraction of its maximum
-        double frac = 1e-20 * Pv.max();
-        int k;
-        for (k=0; k!=NT-2; k++) if (Pv[k]>frac) break;
-        Tmin = _grid->_Tv[k+ioff];
-        for (k=NT-2; k!=1; k--) if (Pv[k]>frac) break;
-        Tmax = _grid->_Tv[k+1+ioff];
+        for (int k=0; k<K; k++)
+        {
+            double Pmax = 0.;
+            for (int i=0; i<NT; i++) Pmax = max(Pmax, Pv[i*K+k]);
+            double frac = 1e-20 * Pmax;
+            int i;
+            for (i=0; i!=NT-2; i++) if (Pv[i*K+k]>frac) break;
+            Tminv[k] = _grid->_Tv[i+ioff];
+            for (i=NT-2; i!=1; i--) if (Pv[i*K+k]>frac) break;
+            Tmaxv[k] = _grid->_Tv[i+1+ioff];
+        }
     }
 
     // add the transient emissivity of the population
     // ev: the accumulated emissivity (in/out)
     // Tmin/Tmax: temperature range in which to add radiation (in)
-    // Pv: the probabilities calculated previously by this calculator (in)
+    // ws: the workspace holding the probabilities calculated previously by this calculator (in)
+    // k: the index of the radiation field in the batch for that previous calculation (in)
     // ioff: the index offset in the temperature grid used for that previous calculation (in)
-    void addtransient(Array& ev, double Tmin, double Tmax, const Array& Pv, int ioff) const
+    void addtransient(Array& ev, double Tmin, double Tmax, const Workspace& ws, int k, int ioff) const
     {
         int imin = NR::locateClip(_grid->_Tv, Tmin);
         int imax = NR::locateClip(_grid->_Tv, Tmax);
 
         for (int i=imin; i<=imax; i++)
         {
-            ev += _sigmaabsv * _grid->_Bvv[i] * Pv[i-ioff];
+            ev += _sigmaabsv * _grid->_Bvv[i] * ws.Pv[(i-ioff)*ws.K+k];
         }
     }
 
@@ -285,6 +346,10 @@ namespace
     // - the temperature range is smaller than a given delta-T (i.e. it resembles a delta function)
     // - the equilibrium temperature lies outside of the temperature range
     const double deltaTeq = 10.;    // the cutoff width of the temperature range
+
+    // the maximum number of transition matrix coefficients held in the workspace at any one time;
+    // this limits the number of radiation fields processed in a single batch for large temperature ranges
+    const size_t maxBatchCoefficients = 1<<21;
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -337,71 +402,137 @@ void TransientDustEmissivity::setupSelfBefore()
 ////////////////////////////////////////////////////////////////////
 
 Array TransientDustEmissivity::emissivity(const DustMix* mix, const Array& Jv) const
+{
+    ArrayTable<2> Jvv(1,_Nlambda);
+    Jvv[0] = Jv;
+    ArrayTable<2> evv;
+    emissivities(mix, Jvv, evv);
+    return evv[0];
+}
+
+////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    // calculates the probabilities for the radiation fields with the specified indices in a number of
+    // consecutive batches, limiting the size of each batch to conserve memory, and invokes the specified
+    // function for each field after the probabilities for its batch have been calculated;
+    // the function is passed the index of the field and its index in the current batch
+    template<typename F> void calcprobsInBatches(const TDE_Calculator* calculator, int ioff, int NT,
+                                                 const vector<int>& kv, const ArrayTable<2>& Jvv,
+                                                 Workspace& ws, vector<double>& Tminv, vector<double>& Tmaxv,
+                                                 F consume)
+    {
+        int Nk = kv.size();
+        int Kmax = max(static_cast<size_t>(1), maxBatchCoefficients/(Triangle<double>::rowOffset(NT)+NT));
+        for (int first=0; first<Nk; first+=Kmax)
+        {
+            int K = min(Kmax, Nk-first);
+            ws.setFields(Jvv, &kv[first], K);
+            calculator->calcprobs(ws, ioff, NT, &Tminv[first], &Tmaxv[first]);
+            for (int b=0; b<K; b++) consume(kv[first+b], b, Tminv[first+b], Tmaxv[first+b]);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
+void TransientDustEmissivity::emissivities(const DustMix* mix, const ArrayTable<2>& Jvv, ArrayTable<2>& evv) const
 {
     const MultiGrainDustMix* mgmix = mix->find<MultiGrainDustMix>();
+    int Nfields = Jvv.size(0);
+    evv.resize(Nfields,_Nlambda);
 
-    // This dictionary is updated as the loop over all dust populations in the mix proceeds.
+    // This dictionary is updated for each field as the loop over all dust populations in the mix proceeds.
     // For each type of grain composition, it keeps track of the grain mass above which
     // the dust population is most certainly in equilibrium.
-    std::map<string,double> eqMass;
+    vector<std::map<string,double>> eqMassv(Nfields);
 
-    // provide room for the probabilities calculated over each of the temperature grids
-    Array Pv;
-    Square<double> Am(static_cast<size_t>(ceil(Tuppermax))+1);
+    // provide room for the calculations, shared by all populations and temperature grids
+    Workspace ws;
+    vector<double> Teqv(Nfields);
+    vector<char> transientv(Nfields);
+    vector<int> kv;
+    vector<double> Tminv, Tmaxv;
 
     // accumulate the emissivities for all populations in the dust mix
-    Array ev(_Nlambda);
     int Npop = mix->numPopulations();
     for (int c=0; c<Npop; c++)
     {
         // get the coarse calculator for this population
         const TDE_Calculator* calculatorA = _calculatorsA.at(std::make_pair(mix,c));
-
-        // determine the equilibrium temperature for this population
-        double Teq = mix->equilibrium(Jv,c);
-
-        // consider transient calculation only if the mean mass for this population is below the cutoff mass
         string gcname = mgmix->grainCompositionName(c);
         double meanmass = mgmix->meanMass(c);
-        if (!eqMass.count(gcname) || meanmass < eqMass.at(gcname))
+
+        // determine the equilibrium temperature for this population in each field, and
+        // consider transient calculation only if the mean mass for this population is below the cutoff mass
+        kv.clear();
+        for (int k=0; k<Nfields; k++)
         {
-            // calculate the probabilities over the coarse temperature grid
-            double Tmin = 0;
-            double Tmax = Tuppermax;
-            int ioff = 0;
-            calculatorA->calcprobs(Pv, ioff, Am, Tmin, Tmax, Jv);
+            Teqv[k] = mix->equilibrium(Jvv[k],c);
+            transientv[k] = false;
+            if (!eqMassv[k].count(gcname) || meanmass < eqMassv[k].at(gcname)) kv.push_back(k);
+        }
 
+        // calculate the probabilities over the coarse temperature grid for all of these fields at once,
+        // and group the fields for which the population might be transient by the temperature grid and
+        // temperature range to be used for the refined calculation
+        std::map<std::tuple<const TDE_Calculator*,int,int>, vector<int>> groups;
+        Tminv.resize(kv.size());
+        Tmaxv.resize(kv.size());
+        int ioffA, NTA;
+        calculatorA->range(0, Tuppermax, ioffA, NTA);
+        calcprobsInBatches(calculatorA, ioffA, NTA, kv, Jvv, ws, Tminv, Tmaxv,
+                           [&] (int k, int, double Tmin, double Tmax)
+        {
             // if the population might be transient...
-            if (Tmax-Tmin > deltaTeq && Teq < Tmax)
+            if (Tmax-Tmin > deltaTeq && Teqv[k] < Tmax)
             {
                 // select the medium or fine temperature grid depending on the temperature range
                 const TDE_Calculator* calculator = (Tmax-Tmin > deltaTmedium)
                                                    ? _calculatorsB.at(std::make_pair(mix,c))
                                                    : _calculatorsC.at(std::make_pair(mix,c));
+                int ioff, NT;
+                calculator->range(Tmin, Tmax, ioff, NT);
+                groups[std::make_tuple(calculator,ioff,NT)].push_back(k);
+            }
+            // remember that all grains above this mass will be in equilibrium
+            else eqMassv[k][gcname] = meanmass;
+        });
 
-                // calculate the probabilities over the chosen grid, in the range determined by the coarse calculation
-                calculator->calcprobs(Pv, ioff, Am, Tmin, Tmax, Jv);
-
+        // for each group, calculate the probabilities over the chosen grid, in the range determined by the coarse calculation
+        for (const auto& group : groups)
+        {
+            const TDE_Calculator* calculator = std::get<0>(group.first);
+            int ioff = std::get<1>(group.first);
+            int NT = std::get<2>(group.first);
+            const vector<int>& gkv = group.second;
+            Tminv.resize(gkv.size());
+            Tmaxv.resize(gkv.size());
+            calcprobsInBatches(calculator, ioff, NT, gkv, Jvv, ws, Tminv, Tmaxv,
+                               [&] (int k, int b, double Tmin, double Tmax)
+            {
                 // if the population indeed is transient...
-                if (Tmax-Tmin > deltaTeq && Teq < Tmax)
+                if (Tmax-Tmin > deltaTeq && Teqv[k] < Tmax)
                 {
                     // add the transient emissivity of this population to the running total
-                    calculator->addtransient(ev, Tmin, Tmax, Pv, ioff);
-                    continue;
+                    calculator->addtransient(evv[k], Tmin, Tmax, ws, b, ioff);
+                    transientv[k] = true;
                 }
-            }
-
-            // remember that all grains above this mass will be in equilibrium
-            eqMass[gcname] = meanmass;
+                // remember that all grains above this mass will be in equilibrium
+                else eqMassv[k][gcname] = meanmass;
+            });
         }
 
         // otherwise, add the equilibrium emissivity of this population to the running total
-        calculatorA->addequilibrium(ev, Teq);
+        for (int k=0; k<Nfields; k++)
+        {
+            if (!transientv[k]) calculatorA->addequilibrium(evv[k], Teqv[k]);
+        }
     }
 
     // convert emissivity from "per hydrogen atom" to "per unit mass"
-    ev /= mix->mu();
-    return ev;
+    for (int k=0; k<Nfields; k++) evv[k] /= mix->mu();
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -89,6 +89,15 @@ public:
         field \f$J_\ell\f$, assuming the simulation's wavelength grid. */
     Array emissivity(const DustMix* mix, const Array& Jv) const override;
 
+    /** This function calculates the dust emissivities for a dust mix of the specified type
+        residing in each of a batch of mean radiation fields, as described for the
+        DustEmissivity::emissivities() function. The probability distributions for all fields in
+        the batch are calculated together for each dust population and temperature grid, with the
+        field index running fastest in the working memory, so that the innermost loops of the
+        calculation can be vectorized by the compiler. The results are identical to those obtained
+        by calling the emissivity() function for each field separately. */
+    void emissivities(const DustMix* mix, const ArrayTable<2>& Jvv, ArrayTable<2>& evv) const override;
+
     //========================= Data members =======================
 
 private:
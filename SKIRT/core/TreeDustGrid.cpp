@@ -8,6 +8,7 @@
 #include "DustGridPath.hpp"
 #include "DustGridPlotFile.hpp"
 #include "DustMassInBoxInterface.hpp"
+#include "DustSystem.hpp"
 #include "FatalError.hpp"
 #include "Log.hpp"
 #include "NR.hpp"
@@ -137,6 +138,8 @@ void TreeDustGrid::setupSelfBefore()
 
         // Create a text file
         TextOutFile file(this, "ds_tree", "dust grid tree data");
+        DustSystem* ds = find<DustSystem>(false);
+        if (ds && ds->writeBinaryTables()) file.setBinaryColumns(_Nnodes);
 
         // Write the header
         file.writeLine("# Tree dust grid data");
@@ -366,6 +369,7 @@ void TreeDustGrid::path(DustGridPath* path) const
             else if (dsy<=dsx && dsy<=dsz) ds = dsy;
             else ds = dsz;
             path->addSegment(cellNumber(node), ds);
+            if (path->isComplete()) return;
             x += (ds+_eps)*kx;
             y += (ds+_eps)*ky;
             z += (ds+_eps)*kz;
@@ -427,6 +431,7 @@ void TreeDustGrid::path(DustGridPath* path) const
                 wall = (kz<0.0) ? TreeNode::BOTTOM : TreeNode::TOP;
             }
             path->addSegment(cellNumber(node), ds);
+            if (path->isComplete()) return;
             x += (ds+_eps)*kx;
             y += (ds+_eps)*ky;
             z += (ds+_eps)*kz;
@@ -489,6 +494,7 @@ void TreeDustGrid::path(DustGridPath* path) const
             if (dsx<=dsy && dsx<=dsz)
             {
                 path->addSegment(_cellnumberv[l], dsx);
+                if (path->isComplete()) return;
                 x = xnext;
                 y += ky*dsx;
                 z += kz*dsx;
@@ -527,6 +533,7 @@ void TreeDustGrid::path(DustGridPath* path) const
             else if (dsy<dsx && dsy<=dsz)
             {
                 path->addSegment(_cellnumberv[l], dsy);
+                if (path->isComplete()) return;
                 x += kx*dsy;
                 y  = ynext;
                 z += kz*dsy;
@@ -564,6 +571,7 @@ void TreeDustGrid::path(DustGridPath* path) const
             else if (dsz< dsx && dsz< dsy)
             {
                 path->addSegment(_cellnumberv[l], dsz);
+                if (path->isComplete()) return;
                 x += kx*dsz;
                 y += ky*dsz;
                 z  = znext;
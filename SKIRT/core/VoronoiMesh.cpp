@@ -866,6 +866,7 @@ void VoronoiMesh::path(DustGridPath* path) const
         else
         {
             path->addSegment(mr, sq);
+            if (path->isComplete()) return;
             r += (sq+_eps)*bfk;
             mr = mq;
         }
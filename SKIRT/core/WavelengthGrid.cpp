@@ -4,10 +4,14 @@
 ///////////////////////////////////////////////////////////////// */
 
 #include "WavelengthGrid.hpp"
+#include "CostAssigner.hpp"
 #include "FatalError.hpp"
+#include "Log.hpp"
 #include "NR.hpp"
 #include "PeerToPeerCommunicator.hpp"
 #include "StaggeredAssigner.hpp"
+#include "StringUtils.hpp"
+#include "TextInFile.hpp"
 
 ////////////////////////////////////////////////////////////////////
 
@@ -25,7 +29,26 @@ void WavelengthGrid::setupSelfAfter()
     {
         if (comm->size() > Nlambda) throw FATALERROR("In data parallelization mode, the number of wavelengths "
                                                      "must be at least the number of processes.");
-        _assigner = new StaggeredAssigner(Nlambda, this);
+        if (assignmentCostsFilename().empty())
+        {
+            _assigner = new StaggeredAssigner(Nlambda, this);
+        }
+        else
+        {
+            // read the measured cost for each wavelength
+            TextInFile infile(this, assignmentCostsFilename(), "wavelength costs");
+            vector<Array> rows = infile.readAllRows(2);
+            if (static_cast<int>(rows.size()) != Nlambda)
+                throw FATALERROR("The number of rows in the wavelength costs file does not match the wavelength grid");
+            Array costv(Nlambda);
+            for (int ell=0; ell<Nlambda; ell++) costv[ell] = rows[ell][1];
+
+            // assign the wavelengths so that the cost is balanced across processes
+            CostAssigner* assigner = new CostAssigner(costv, this);
+            find<Log>()->info("Wavelengths assigned to balance measured costs; expected imbalance factor: "
+                              + StringUtils::toString(assigner->expectedImbalance(), 'f', 3));
+            _assigner = assigner;
+        }
     }
 }
 
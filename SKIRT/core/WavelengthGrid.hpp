@@ -19,13 +19,29 @@ class ProcessAssigner;
 class WavelengthGrid : public SimulationItem
 {
     ITEM_ABSTRACT(WavelengthGrid, SimulationItem, "a wavelength grid")
+
+    PROPERTY_STRING(assignmentCostsFilename, "the name of the file with measured costs per wavelength")
+        ATTRIBUTE_OPTIONAL(assignmentCostsFilename)
+        ATTRIBUTE_SILENT(assignmentCostsFilename)
+
     ITEM_END()
 
+    /** \fn assignmentCostsFilename
+        In data parallelization mode, the wavelengths are by default assigned to the processes in
+        a staggered pattern. If the optional assignmentCostsFilename property specifies the name
+        of a column text file listing a wavelength (first column) and the measured cost (second
+        column) for each wavelength in the grid, the wavelengths are instead assigned so that the
+        total cost per process is balanced (see the CostAssigner class). Such a file is written by
+        a Monte Carlo simulation running in data parallelization mode with its writeWavelengthCosts
+        property enabled, so that the measurements of a previous run (for example, a run with fewer
+        photon packages) can be used to balance the work of subsequent runs. */
+
     //============= Construction - Setup - Destruction =============
 
 protected:
     /** This function verifies that the wavelength bins have been initialized by a subclass calling
-        the setWavelengthBins() function of this class in their setupSelfBefore() function. */
+        the setWavelengthBins() function of this class in their setupSelfBefore() function. In data
+        parallelization mode, it also creates the process assigner for the wavelengths. */
     void setupSelfAfter() override;
 
     /** This function sets the wavelength grid to the central wavelengths and corresponding bin
@@ -7,6 +7,7 @@
 #include "BuildInfo.hpp"
 #include "Console.hpp"
 #include "ConsoleHierarchyCreator.hpp"
+#include "DustSystem.hpp"
 #include "FatalError.hpp"
 #include "FileLog.hpp"
 #include "FilePaths.hpp"
@@ -31,7 +32,7 @@
 namespace
 {
     // the allowed options list, in the format consumed by the CommandLineArguments constructor
-    static const char* allowedOptions = "-t* -s* -d -b -v -m -e -k -i* -o* -r -x";
+    static const char* allowedOptions = "-t* -s* -d -n -b -v -m -e -p -k -i* -o* -r -x";
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -290,6 +291,12 @@ void SkirtCommandLineHandler::doSimulation(size_t index)
             simulation->communicator()->setDataParallel(true);
         }
 
+        //  - the activation of node shared-memory mode
+        if (_args.isPresent("-n") && ProcessManager::isMultiProc())
+        {
+            simulation->communicator()->setSharedMemory(true);
+        }
+
         //  - the logging mechanisms
         FileLog* log = new FileLog();
         simulation->log()->setLinkedLog(log);
@@ -297,6 +304,9 @@ void SkirtCommandLineHandler::doSimulation(size_t index)
         simulation->log()->setMemoryLogging(_args.isPresent("-m"));
         if (_parallelSims > 1 || _args.isPresent("-b")) simulation->log()->setLowestLevel(Log::Level::Success);
 
+        //  - the performance profiler
+        if (_args.isPresent("-p")) simulation->profiler()->enable(_producerInfo);
+
         // output a ski file reflecting this simulation for later reference
         if (ProcessManager::isRoot())
         {
@@ -323,6 +333,10 @@ void SkirtCommandLineHandler::doSimulation(size_t index)
         {
             running = true;
             simulation->setupAndRun();
+
+            // release the node-shared memory while all processes are known to be at the same point
+            DustSystem* ds = simulation->find<DustSystem>(false);
+            if (ds) ds->releaseSharedMemory();
         }
         catch (FatalError& error)
         {
@@ -380,18 +394,20 @@ void SkirtCommandLineHandler::printHelp()
     _console.warning("To create a new ski file interactively:    skirt");
     _console.warning("To run a simulation with default options:  skirt <ski-filename>");
     _console.warning("");
-    _console.warning("  skirt [-t <threads>] [-s <simulations>] [-d]");
-    _console.warning("        [-b] [-v] [-m] [-e]");
+    _console.warning("  skirt [-t <threads>] [-s <simulations>] [-d] [-n]");
+    _console.warning("        [-b] [-v] [-m] [-e] [-p]");
     _console.warning("        [-k] [-i <dirpath>] [-o <dirpath>]");
     _console.warning("        [-r] {<filepath>}*");
     _console.warning("");
     _console.warning("  -t <threads> : the number of parallel threads for each simulation");
     _console.warning("  -s <simulations> : the number of parallel simulations per process");
     _console.warning("  -d : enable data parallelization mode for multiple processes");
+    _console.warning("  -n : share the dust cell volumes and densities between the processes on each node");
     _console.warning("  -b : force brief console logging");
     _console.warning("  -v : force verbose logging for multiple processes");
     _console.warning("  -m : state the amount of used memory at the start of each log message");
     _console.warning("  -e : run the simulation in emulation mode to get an estimate of the memory consumption");
+    _console.warning("  -p : write a performance profile for each photon shooting phase to a JSON file");
     _console.warning("  -k : make the input/output paths relative to the ski file being processed");
     _console.warning("  -i <dirpath> : the relative or absolute path for simulation input files");
     _console.warning("  -o <dirpath> : the relative or absolute path for simulation output files");
@@ -21,7 +21,7 @@ simulations in the ski files specified on the command line according to the foll
 
 \verbatim
  skirt [-t <threads>] [-s <simulations>] [-d]
-       [-b] [-v] [-m] [-e]
+       [-b] [-v] [-m] [-e] [-p]
        [-k] [-i <dirpath>] [-o <dirpath>]
        [-r] {<filepath>}*
 \endverbatim
@@ -47,6 +47,9 @@ simulations in the ski files specified on the command line according to the foll
 - The -e option activates emulation mode, which can be used to estimate the amount of memory used by
   a given simulation without actually performing the simulation.
 
+- The -p option enables the performance profiler, which counts hot-path events and samples the time spent in selected
+  operations during each photon shooting phase, and writes the results to a JSON file in the output directory.
+
 - The -k option causes the simulation input/output paths to be relative to the ski file being processed, rather than
   to the current directory. This is useful, for example, when processing multiple ski files organized in a nested
   directory hierarchy (see the -r option).
@@ -5,6 +5,9 @@
 
 #include "ProcessManager.hpp"
 #include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
 
 #ifdef BUILD_WITH_MPI
 #include <mpi.h>
@@ -75,6 +78,60 @@ namespace
 
 //////////////////////////////////////////////////////////////////////
 
+#ifdef BUILD_WITH_MPI
+namespace
+{
+    // The communicators for the processes on the same node and for the node leaders, created on first use
+    MPI_Comm nodeComm = MPI_COMM_NULL;
+    MPI_Comm leaderComm = MPI_COMM_NULL;
+    bool nodeLeader = true;
+
+    // The node-shared memory windows, indexed on the identifier handed out to the caller
+    std::map<int, MPI_Win> sharedWindows;
+    int lastWindow = 0;
+    std::mutex windowMutex;
+
+    // Creates the node and leader communicators if they do not yet exist; must be called collectively
+    void initNodeComms()
+    {
+        if (nodeComm != MPI_COMM_NULL) return;
+
+        int rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &nodeComm);
+
+        int nodeRank;
+        MPI_Comm_rank(nodeComm, &nodeRank);
+        nodeLeader = nodeRank == 0;
+        MPI_Comm_split(MPI_COMM_WORLD, nodeLeader ? 0 : MPI_UNDEFINED, rank, &leaderComm);
+    }
+
+    // Frees the node-shared memory windows that are still allocated and the node and leader communicators;
+    // must be called collectively
+    void releaseNodeResources()
+    {
+        for (auto& entry : sharedWindows)
+        {
+            MPI_Win_unlock_all(entry.second);
+            MPI_Win_free(&entry.second);
+        }
+        sharedWindows.clear();
+        if (leaderComm != MPI_COMM_NULL) MPI_Comm_free(&leaderComm);
+        if (nodeComm != MPI_COMM_NULL) MPI_Comm_free(&nodeComm);
+    }
+
+    // Performs an in-place MPI_Allreduce (sum) on the specified communicator, in pieces of limited size
+    void allreduceInPieces(double* my_array, size_t nvalues, MPI_Comm comm)
+    {
+        for (size_t offset = 0; offset < nvalues; offset += maxMessageSize)
+            MPI_Allreduce(MPI_IN_PLACE, my_array+offset, min(maxMessageSize, nvalues-offset),
+                          MPI_DOUBLE, MPI_SUM, comm);
+    }
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////
+
 void ProcessManager::initialize(int *argc, char ***argv)
 {
 #ifdef BUILD_WITH_MPI
@@ -94,6 +151,7 @@ void ProcessManager::initialize(int *argc, char ***argv)
 void ProcessManager::finalize()
 {
 #ifdef BUILD_WITH_MPI
+    releaseNodeResources();
     MPI_Finalize();
 #endif
 }
@@ -315,6 +373,354 @@ void ProcessManager::sumAll(double* my_array, size_t nvalues)
 
 //////////////////////////////////////////////////////////////////////
 
+#ifdef BUILD_WITH_MPI
+namespace
+{
+    // The outstanding non-blocking requests, indexed on the identifier handed out to the caller;
+    // a single identifier may represent multiple MPI requests when a large message is broken up
+    std::map<int, vector<MPI_Request>> pendingRequests;
+    int lastRequest = 0;
+    std::mutex requestMutex;
+
+    // The argument arrays of a non-blocking all-to-all communication, which must remain valid until completion
+    struct AllToAllArguments
+    {
+        vector<int> sendcnts, sdispls, recvcnts, rdispls;
+        vector<MPI_Datatype> sendtypes, recvtypes;
+    };
+
+    // The argument arrays of the outstanding non-blocking all-to-all requests, indexed on the request identifier
+    std::map<int, std::unique_ptr<AllToAllArguments>> pendingArguments;
+
+    // Registers the specified MPI requests (and optionally their argument arrays) and returns the corresponding
+    // identifier
+    int registerRequests(vector<MPI_Request>&& mpiRequests,
+                         std::unique_ptr<AllToAllArguments> arguments = std::unique_ptr<AllToAllArguments>())
+    {
+        std::unique_lock<std::mutex> lock(requestMutex);
+        int request = ++lastRequest;
+        pendingRequests.emplace(request, std::move(mpiRequests));
+        if (arguments) pendingArguments.emplace(request, std::move(arguments));
+        return request;
+    }
+
+    // The committed datatype sets created by createDisplacedDoubles(), indexed on the identifier handed out to the
+    // caller
+    std::map<int, vector<MPI_Datatype>> datatypeSets;
+    int lastDatatypeSet = 0;
+
+    // Converts the specified counts and offsets (in units of double) to the int arguments expected by MPI_Alltoallw
+    void setBlockArguments(const vector<size_t>& counts, const vector<size_t>& offsets,
+                           vector<int>& cnts, vector<int>& displs)
+    {
+        size_t size = counts.size();
+        cnts.resize(size);
+        displs.resize(size);
+        for (size_t r=0; r!=size; ++r)
+        {
+            // Alltoallw takes displacements in bytes, so we need to check for a possible integer overflow
+            if (counts[r] > INT_MAX) throw std::overflow_error("number of elements larger than INT_MAX");
+            if (offsets[r]*sizeof(double) > INT_MAX) throw std::overflow_error("displacement larger than INT_MAX");
+            cnts[r] = counts[r];
+            displs[r] = offsets[r]*sizeof(double);
+        }
+    }
+
+    // Sets the int arguments expected by MPI_Alltoallw for repeating a datatype the specified number of times
+    void setPatternArguments(int size, size_t count, vector<int>& cnts, vector<int>& displs)
+    {
+        if (count > INT_MAX) throw std::overflow_error("number of elements larger than INT_MAX");
+        cnts.assign(size, count);
+        displs.assign(size, 0);
+    }
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////
+
+int ProcessManager::startSum(double* my_array, size_t nvalues, int root)
+{
+#ifdef BUILD_WITH_MPI
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    vector<MPI_Request> mpiRequests;
+    for (size_t offset = 0; offset==0 || offset < nvalues; offset += maxMessageSize)
+    {
+        size_t count = min(maxMessageSize, nvalues-offset);
+        mpiRequests.emplace_back();
+        if (rank == root)
+            MPI_Ireduce(MPI_IN_PLACE, my_array+offset, count, MPI_DOUBLE, MPI_SUM, root, MPI_COMM_WORLD,
+                        &mpiRequests.back());
+        else
+            MPI_Ireduce(my_array+offset, my_array+offset, count, MPI_DOUBLE, MPI_SUM, root, MPI_COMM_WORLD,
+                        &mpiRequests.back());
+    }
+    return registerRequests(std::move(mpiRequests));
+#else
+    (void)my_array; (void)nvalues; (void)root;
+    return 0;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////
+
+int ProcessManager::startSumAll(double* my_array, size_t nvalues)
+{
+#ifdef BUILD_WITH_MPI
+    vector<MPI_Request> mpiRequests;
+    for (size_t offset = 0; offset==0 || offset < nvalues; offset += maxMessageSize)
+    {
+        size_t count = min(maxMessageSize, nvalues-offset);
+        mpiRequests.emplace_back();
+        MPI_Iallreduce(MPI_IN_PLACE, my_array+offset, count, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD,
+                       &mpiRequests.back());
+    }
+    return registerRequests(std::move(mpiRequests));
+#else
+    (void)my_array; (void)nvalues;
+    return 0;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////
+
+int ProcessManager::createDisplacedDoubles(const vector<vector<int>>& displacements, size_t extent)
+{
+#ifdef BUILD_WITH_MPI
+    vector<MPI_Datatype> types;
+    types.reserve(displacements.size());
+    for (const auto& displacementv : displacements)
+    {
+        MPI_Datatype newtype;
+        createDisplacedDoubleBlocks(1, displacementv, &newtype, extent);
+        types.push_back(newtype);
+    }
+
+    std::unique_lock<std::mutex> lock(requestMutex);
+    int handle = ++lastDatatypeSet;
+    datatypeSets.emplace(handle, std::move(types));
+    return handle;
+#else
+    (void)displacements; (void)extent;
+    return 0;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void ProcessManager::freeDisplacedDoubles(int types)
+{
+#ifdef BUILD_WITH_MPI
+    std::unique_lock<std::mutex> lock(requestMutex);
+    auto it = datatypeSets.find(types);
+    if (it == datatypeSets.end()) return;
+    for (auto& type : it->second) MPI_Type_free(&type);
+    datatypeSets.erase(it);
+#else
+    (void)types;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////
+
+int ProcessManager::startBlocksToDisplaced(const double* sendBuffer, const vector<size_t>& sendCounts,
+                                           const vector<size_t>& sendOffsets, double* recvBuffer, size_t recvCount,
+                                           int recvTypes)
+{
+#ifdef BUILD_WITH_MPI
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    std::unique_ptr<AllToAllArguments> args(new AllToAllArguments);
+    setBlockArguments(sendCounts, sendOffsets, args->sendcnts, args->sdispls);
+    args->sendtypes.assign(size, MPI_DOUBLE);
+    setPatternArguments(size, recvCount, args->recvcnts, args->rdispls);
+    {
+        std::unique_lock<std::mutex> lock(requestMutex);
+        args->recvtypes = datatypeSets.at(recvTypes);
+    }
+
+    vector<MPI_Request> mpiRequests(1);
+    MPI_Ialltoallw(const_cast<double*>(sendBuffer), args->sendcnts.data(), args->sdispls.data(),
+                   args->sendtypes.data(), recvBuffer, args->recvcnts.data(), args->rdispls.data(),
+                   args->recvtypes.data(), MPI_COMM_WORLD, &mpiRequests[0]);
+    return registerRequests(std::move(mpiRequests), std::move(args));
+#else
+    (void)sendBuffer; (void)sendCounts; (void)sendOffsets; (void)recvBuffer; (void)recvCount; (void)recvTypes;
+    return 0;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////
+
+int ProcessManager::startDisplacedToBlocks(const double* sendBuffer, size_t sendCount, int sendTypes,
+                                           double* recvBuffer, const vector<size_t>& recvCounts,
+                                           const vector<size_t>& recvOffsets)
+{
+#ifdef BUILD_WITH_MPI
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    std::unique_ptr<AllToAllArguments> args(new AllToAllArguments);
+    setPatternArguments(size, sendCount, args->sendcnts, args->sdispls);
+    {
+        std::unique_lock<std::mutex> lock(requestMutex);
+        args->sendtypes = datatypeSets.at(sendTypes);
+    }
+    setBlockArguments(recvCounts, recvOffsets, args->recvcnts, args->rdispls);
+    args->recvtypes.assign(size, MPI_DOUBLE);
+
+    vector<MPI_Request> mpiRequests(1);
+    MPI_Ialltoallw(const_cast<double*>(sendBuffer), args->sendcnts.data(), args->sdispls.data(),
+                   args->sendtypes.data(), recvBuffer, args->recvcnts.data(), args->rdispls.data(),
+                   args->recvtypes.data(), MPI_COMM_WORLD, &mpiRequests[0]);
+    return registerRequests(std::move(mpiRequests), std::move(args));
+#else
+    (void)sendBuffer; (void)sendCount; (void)sendTypes; (void)recvBuffer; (void)recvCounts; (void)recvOffsets;
+    return 0;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void ProcessManager::finishRequest(int request)
+{
+#ifdef BUILD_WITH_MPI
+    if (!request) return;
+
+    vector<MPI_Request> mpiRequests;
+    {
+        std::unique_lock<std::mutex> lock(requestMutex);
+        auto it = pendingRequests.find(request);
+        if (it == pendingRequests.end()) return;
+        mpiRequests = std::move(it->second);
+        pendingRequests.erase(it);
+    }
+    MPI_Waitall(mpiRequests.size(), mpiRequests.data(), MPI_STATUSES_IGNORE);
+
+    std::unique_lock<std::mutex> lock(requestMutex);
+    pendingArguments.erase(request);
+#else
+    (void)request;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////
+
+double* ProcessManager::allocateNodeShared(size_t nvalues, int& window)
+{
+#ifdef BUILD_WITH_MPI
+    initNodeComms();
+
+    // only the node leader contributes memory to the window
+    MPI_Aint size = nodeLeader ? nvalues*sizeof(double) : 0;
+    double* base = nullptr;
+    MPI_Win win;
+    MPI_Win_allocate_shared(size, sizeof(double), MPI_INFO_NULL, nodeComm, &base, &win);
+
+    // all processes obtain a pointer to the leader's segment
+    int dispUnit;
+    MPI_Win_shared_query(win, 0, &size, &dispUnit, &base);
+
+    // open a passive-target epoch for the lifetime of the window so that MPI_Win_sync can be used
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+
+    std::unique_lock<std::mutex> lock(windowMutex);
+    window = ++lastWindow;
+    sharedWindows.emplace(window, win);
+    return base;
+#else
+    (void)nvalues;
+    window = 0;
+    return nullptr;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void ProcessManager::freeNodeShared(int window)
+{
+#ifdef BUILD_WITH_MPI
+    std::unique_lock<std::mutex> lock(windowMutex);
+    auto it = sharedWindows.find(window);
+    if (it == sharedWindows.end()) return;
+    MPI_Win_unlock_all(it->second);
+    MPI_Win_free(&it->second);
+    sharedWindows.erase(it);
+#else
+    (void)window;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////
+
+bool ProcessManager::isNodeLeader()
+{
+#ifdef BUILD_WITH_MPI
+    initNodeComms();
+    return nodeLeader;
+#else
+    return true;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void ProcessManager::nodeBarrier()
+{
+#ifdef BUILD_WITH_MPI
+    initNodeComms();
+    std::unique_lock<std::mutex> lock(windowMutex);
+    for (auto& entry : sharedWindows) MPI_Win_sync(entry.second);
+    MPI_Barrier(nodeComm);
+    for (auto& entry : sharedWindows) MPI_Win_sync(entry.second);
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void ProcessManager::sumAllByNode(double* my_array, size_t nvalues)
+{
+#ifdef BUILD_WITH_MPI
+    initNodeComms();
+
+    // reduce within the node to the node leader
+    for (size_t offset = 0; offset < nvalues; offset += maxMessageSize)
+    {
+        size_t count = min(maxMessageSize, nvalues-offset);
+        if (nodeLeader)
+            MPI_Reduce(MPI_IN_PLACE, my_array+offset, count, MPI_DOUBLE, MPI_SUM, 0, nodeComm);
+        else
+            MPI_Reduce(my_array+offset, my_array+offset, count, MPI_DOUBLE, MPI_SUM, 0, nodeComm);
+    }
+
+    // reduce across the node leaders
+    if (nodeLeader) allreduceInPieces(my_array, nvalues, leaderComm);
+
+    // broadcast the result within the node
+    for (size_t offset = 0; offset < nvalues; offset += maxMessageSize)
+        MPI_Bcast(my_array+offset, min(maxMessageSize, nvalues-offset), MPI_DOUBLE, 0, nodeComm);
+#else
+    (void)my_array; (void)nvalues;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void ProcessManager::sumAllNodeShared(double* shared_array, size_t nvalues)
+{
+#ifdef BUILD_WITH_MPI
+    nodeBarrier();
+    if (nodeLeader) allreduceInPieces(shared_array, nvalues, leaderComm);
+    nodeBarrier();
+#else
+    (void)shared_array; (void)nvalues;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////
+
 void ProcessManager::orAll(bool* boolean)
 {
 #ifdef BUILD_WITH_MPI
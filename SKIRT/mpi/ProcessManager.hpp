@@ -117,6 +117,40 @@ public:
                                         double* recvBuffer, size_t recvCount, size_t recvLength,
                                         const vector<vector<int>>& recvDisplacements, size_t recvExtent);
 
+    /** This function creates and commits a set of derived datatypes, one for each process,
+        selecting individual double values at the displacements listed for that process. The
+        extent of each datatype is set to the specified value (in units of double), so that a
+        count larger than one repeats the pattern at that interval. The datatypes remain available
+        for use with startBlocksToDisplaced() and startDisplacedToBlocks() until they are released
+        by calling freeDisplacedDoubles() with the identifier returned by this function. If MPI is
+        not present, the function does nothing and returns zero. */
+    static int createDisplacedDoubles(const vector<vector<int>>& displacements, size_t extent);
+
+    /** This function releases the datatypes created by createDisplacedDoubles(). If the identifier
+        is zero, the function does nothing. */
+    static void freeDisplacedDoubles(int types);
+
+    /** This function starts a non-blocking all-to-all communication in which each process sends a
+        contiguous block of double values to every other process, and receives the blocks into its
+        receive buffer according to a set of datatypes created by createDisplacedDoubles(). The
+        block for process r starts at the offset sendOffsets[r] in the send buffer and contains
+        sendCounts[r] values. The data received from process r is placed by repeating the r'th
+        datatype recvCount times. The function returns immediately with a request identifier that
+        must be passed to finishRequest(); the buffers must not be accessed before that. All
+        processes must call this function for the communication to proceed. If MPI is not
+        present, the function does nothing and returns zero. */
+    static int startBlocksToDisplaced(const double* sendBuffer, const vector<size_t>& sendCounts,
+                                      const vector<size_t>& sendOffsets, double* recvBuffer, size_t recvCount,
+                                      int recvTypes);
+
+    /** This function performs the inverse operation of startBlocksToDisplaced(): the data sent to
+        process r is selected from the send buffer by repeating the r'th datatype sendCount times,
+        and the data received from process r is stored contiguously in the receive buffer,
+        starting at offset recvOffsets[r] and containing recvCounts[r] values. */
+    static int startDisplacedToBlocks(const double* sendBuffer, size_t sendCount, int sendTypes,
+                                      double* recvBuffer, const vector<size_t>& recvCounts,
+                                      const vector<size_t>& recvOffsets);
+
     /** The purpose of this function is to sum a particular array of double values element-wise
         across the different processes. The resulting values are stored in the array passed as the
         second argument 'result_array', only on the process that is assigned as root. The rank of
@@ -130,6 +164,73 @@ public:
         communication to proceed. */
     static void sumAll(double* my_array, size_t nvalues);
 
+    /** This function starts a non-blocking element-wise summation of an array of double values
+        across the different processes, with the same semantics as the sum() function. It returns
+        immediately with a positive request identifier that must be passed to finishRequest(). The
+        array should not be accessed before the request has been finished. All processes must call
+        this function, in the same order relative to other collective operations, for the
+        communication to proceed. If MPI is not present, the function does nothing and returns zero.
+        */
+    static int startSum(double* my_array, size_t nvalues, int root);
+
+    /** This function starts a non-blocking element-wise summation of an array of double values
+        across the different processes, with the same semantics as the sumAll() function. It
+        returns immediately with a positive request identifier that must be passed to
+        finishRequest(). The array should not be accessed before the request has been finished. All
+        processes must call this function, in the same order relative to other collective
+        operations, for the communication to proceed. If MPI is not present, the function does
+        nothing and returns zero. */
+    static int startSumAll(double* my_array, size_t nvalues);
+
+    /** This function blocks until the non-blocking communication identified by the specified
+        request identifier, as returned by startSum(), startSumAll(), startBlocksToDisplaced() or
+        startDisplacedToBlocks(), has completed. After this function returns, the buffers involved
+        in the communication hold the result. If the identifier is zero, the function does nothing.
+        */
+    static void finishRequest(int request);
+
+    /** This function allocates a block of memory for the specified number of double values that is
+        shared by all processes running on the same compute node, using an MPI-3 shared-memory
+        window. The memory is physically allocated only once per node, by the node leader (the
+        process with the lowest rank on the node), and the function returns a pointer to the start
+        of the block in the address space of the calling process. The contents of the block are
+        undefined after allocation. The second argument receives an identifier for the window,
+        which must be passed to freeNodeShared() to release the memory. All processes must call
+        this function for the allocation to proceed. If MPI is not present, the function returns a
+        null pointer and sets the identifier to zero. */
+    static double* allocateNodeShared(size_t nvalues, int& window);
+
+    /** This function releases a block of node-shared memory allocated by allocateNodeShared(). All
+        processes must call this function. If the identifier is zero, the function does nothing. */
+    static void freeNodeShared(int window);
+
+    /** This function returns true if the calling process is the node leader, i.e. the process with
+        the lowest rank among the processes running on the same compute node. If MPI is not
+        present, the function returns true. */
+    static bool isNodeLeader();
+
+    /** If this function is called, a process remains idle until all other processes on the same
+        compute node have called it too. The function also synchronizes the public and private
+        copies of all node-shared memory blocks, so that writes by one process on the node before
+        the call are visible to all other processes on the node after the call. */
+    static void nodeBarrier();
+
+    /** The purpose of this function is to sum a particular array of double values element-wise
+        across the different processes, with the same result as the sumAll() function. The
+        summation is performed hierarchically: the values are first reduced to the node leader
+        within each compute node, the partial sums are then reduced across the node leaders, and
+        the result is finally broadcast within each node. This limits the inter-node traffic to a
+        single message stream per node. All processes must call this function for the
+        communication to proceed. */
+    static void sumAllByNode(double* my_array, size_t nvalues);
+
+    /** The purpose of this function is to sum a node-shared array of double values, allocated with
+        allocateNodeShared(), element-wise across the compute nodes. Each node's shared array is
+        assumed to hold the contributions of all processes on that node; after the function
+        returns, the shared array on each node holds the total over all nodes. All processes must
+        call this function for the communication to proceed. */
+    static void sumAllNodeShared(double* shared_array, size_t nvalues);
+
     /** This function performs a reduction of a given boolean, by applying the logical OR operator
         across all processes. The result will overwrite the original boolean to which a pointer was
         passed. All processes must call this function for the communication to proceed. */
@@ -73,6 +73,14 @@ void Item::destroyChild(Item* child)
 
 ////////////////////////////////////////////////////////////////////
 
+void Item::releaseChild(Item* child)
+{
+    removeChild(child);
+    child->setParent(nullptr);
+}
+
+////////////////////////////////////////////////////////////////////
+
 Item* Item::parent() const
 {
     return _parent;
@@ -141,6 +141,14 @@ public:
         destroy items removed from the property. */
     void destroyChild(Item* child);
 
+    /** Removes the specified item from the list of children without destroying it, and clears its
+        parent, handing over ownership of the item (and its children) to the caller. The item or
+        item list property referring to the released item is \em not updated, so this item should
+        no longer be used other than for destroying it. This function is intended for moving a
+        partial hierarchy from one item hierarchy to another, i.e. the caller usually hands the
+        released item to a property of another item right away. */
+    void releaseChild(Item* child);
+
     /** Returns the parent item of this item, or the null pointer if the parent has not been set. */
     Item* parent() const;
 
@@ -0,0 +1,335 @@
+#!/bin/bash
+# (use "chmod +rx scriptname" to make script executable)
+#
+# For use on any Linux system (or Mac OS X), without the need for a cluster
+#
+# Execute this script to measure how well a simulation scales with the number
+# of parallel threads and MPI processes on a single computer. The script runs
+# skirt on the specified ski file for each combination in a matrix of thread
+# counts (-t option of skirt), process counts (launched through mpirun) and
+# numbers of parallel simulations (-s option of skirt), optionally in data
+# parallelization mode (-d option of skirt). For each run, it gathers the
+# wall time of each simulation phase from the log file(s) written by skirt,
+# and the peak memory usage reported by skirt. It then calculates the parallel
+# efficiency for each phase relative to the first run in the matrix, and
+# writes the results as a text table and in JSON format.
+#
+# Usage:
+#   scaleSKIRT.sh [-e <skirt>] [-t "<threads>"] [-p "<processes>"] [-s "<sims>"]
+#                 [-d] [-w] [-m "<mpirun>"] [-o <dirpath>] <skifile>
+#
+#   -e  path to the skirt executable; default is ../release/SKIRT/main/skirt
+#       relative to this script, or skirt in the default path
+#   -t  list of thread counts per process; default is the powers of two up to
+#       the number of logical cores, and the number of logical cores itself
+#   -p  list of MPI process counts; default is "1"; process counts larger than
+#       one require skirt to be built with MPI support
+#   -s  list of simulation counts to be run in parallel; default is "1"
+#   -d  use data parallelization mode for multiple processes
+#   -w  weak scaling: the number of photon packages is multiplied by the number
+#       of threads times processes relative to the first run; the default is
+#       strong scaling, with a fixed number of photon packages
+#   -m  command used to launch multiple processes; default is "mpirun"
+#       (e.g. use "mpirun --oversubscribe" to allow more processes than cores)
+#   -o  output directory for the skirt output and the scaling results;
+#       default is "scaling" in the current directory
+#
+# The efficiency for each phase is calculated as (t0 c0 / w0) / (t c / w), where
+# t is the wall time of the phase, c is the number of cores in use (processes
+# times threads times parallel simulations), and w is the amount of work (the
+# number of parallel simulations times the photon package multiplication
+# factor), and where the subscript 0 refers to the first run. For strong scaling
+# with a single simulation, this reduces to t0 c0 / (t c); for weak scaling, it
+# reduces to t0 / t. Note that the setup and write phases do not depend on the
+# number of photon packages, so their weak scaling efficiency decreases by
+# design. Because skirt reports phase times with a resolution of 0.1 s, the
+# simulation should run for at least several seconds in each configuration.
+#
+# The peak memory usage is reported by skirt at the end of the run. The table and
+# JSON file list the largest value for a single process and the total for all
+# processes. For runs with multiple processes, the total is only available for a
+# single simulation, because skirt is then invoked in verbose mode so that each
+# process reports its own peak memory usage in its log file. Otherwise the total
+# equals the value for a single process.
+#
+
+# --------------------------------------------------------------------
+
+# Determine the number of logical cores
+NCORES="$(nproc 2>/dev/null || sysctl -n hw.ncpu 2>/dev/null || echo 1)"
+
+# Set the default options
+SKIRT=""
+THREADLIST=""
+PROCLIST="1"
+SIMLIST="1"
+DATAPARALLEL=""
+WEAK=""
+MPIRUN="mpirun"
+OUTDIR="scaling"
+
+# Parse the command line options
+while getopts "e:t:p:s:dwm:o:" OPTION
+do
+    case $OPTION in
+        e) SKIRT="$OPTARG" ;;
+        t) THREADLIST="$OPTARG" ;;
+        p) PROCLIST="$OPTARG" ;;
+        s) SIMLIST="$OPTARG" ;;
+        d) DATAPARALLEL="-d" ;;
+        w) WEAK="yes" ;;
+        m) MPIRUN="$OPTARG" ;;
+        o) OUTDIR="$OPTARG" ;;
+        *) echo "Usage: $0 [-e <skirt>] [-t \"<threads>\"] [-p \"<processes>\"] [-s \"<sims>\"]" \
+                "[-d] [-w] [-m \"<mpirun>\"] [-o <dirpath>] <skifile>"
+           exit 1 ;;
+    esac
+done
+shift $((OPTIND-1))
+SKIFILE="$1"
+if [ "$SKIFILE" == "" ] || [ ! -f "$SKIFILE" ]
+then
+    echo "Fatal error: specify an existing ski file"
+    exit 1
+fi
+
+# Locate the skirt executable
+if [ "$SKIRT" == "" ]
+then
+    SKIRT="$(cd "$(dirname "$0")" && pwd)/../release/SKIRT/main/skirt"
+    if [ ! -x "$SKIRT" ]
+    then
+        SKIRT="$(which skirt)"
+    fi
+fi
+if [ "$SKIRT" == "" ] || [ ! -x "$SKIRT" ]
+then
+    echo "Fatal error: could not locate the skirt executable; use the -e option"
+    exit 1
+fi
+SKIRT="$(cd "$(dirname "$SKIRT")" && pwd)/$(basename "$SKIRT")"
+
+# Build the default list of thread counts
+if [ "$THREADLIST" == "" ]
+then
+    THREADS=1
+    while [ $THREADS -lt $NCORES ]
+    do
+        THREADLIST="$THREADLIST $THREADS"
+        THREADS=$((THREADS*2))
+    done
+    THREADLIST="$THREADLIST $NCORES"
+fi
+
+# Prepare the output directory
+mkdir -p "$OUTDIR" || exit 1
+OUTDIR="$(cd "$OUTDIR" && pwd)"
+SKINAME="$(basename "$SKIFILE" .ski)"
+RESULTS="$OUTDIR/results.txt"
+: > "$RESULTS"
+
+# --------------------------------------------------------------------
+
+# Extracts the phase times (in seconds), averaged over the specified root log files,
+# and prints them on a single line in the order: setup stellar selfabs dustem write total
+phasetimes()
+{
+    awk '
+        /Finished setup in /                           { phase = 1 }
+        /Finished the stellar emission phase in /      { phase = 2 }
+        /Finished the dust self-absorption phase in /  { phase = 3 }
+        /Finished the dust emission phase in /         { phase = 4 }
+        /Finished writing results in /                 { phase = 5 }
+        /Finished simulation .* in /                   { phase = 6; ++numlogs }
+        phase && match($0, / in [0-9.]+ s/) { sum[phase] += substr($0, RSTART+4, RLENGTH-6); phase = 0 }
+        END {
+            if (numlogs == 0) numlogs = 1
+            for (p = 1; p <= 6; ++p) printf("%.3f ", sum[p]/numlogs)
+            printf("\n")
+        }' "$@"
+}
+
+# Prints the peak memory usage (in MB) reported in the specified files; the first argument
+# specifies whether to print the sum ("sum") or the maximum ("max") of the reported values
+peakmemory()
+{
+    MODE="$1"
+    shift
+    awk -v mode=$MODE '
+        match($0, /Peak memory usage: [0-9.]+ [KMGT]B/) {
+            split(substr($0, RSTART+19, RLENGTH-19), value, " ")
+            factor = 1
+            if (value[2] == "KB") factor = 1./1024
+            if (value[2] == "GB") factor = 1024
+            if (value[2] == "TB") factor = 1024*1024
+            memory = value[1]*factor
+            sum += memory
+            if (memory > max) max = memory
+        }
+        END { printf("%.1f\n", (mode == "sum" ? sum : max)) }' "$@"
+}
+
+# Prints the number of processes mentioned in the "Finished simulation" message in the specified log file
+processcount()
+{
+    awk '
+        /Finished simulation / {
+            count = 1
+            if (match($0, /for each of [0-9]+ processes/)) count = substr($0, RSTART+12, RLENGTH-22)
+        }
+        END { print count+0 }' "$1"
+}
+
+# --------------------------------------------------------------------
+
+# Perform the runs
+FIRSTCORES=""
+for PROCS in $PROCLIST
+do
+    for THREADS in $THREADLIST
+    do
+        for SIMS in $SIMLIST
+        do
+            CORES=$((PROCS*THREADS*SIMS))
+            if [ "$FIRSTCORES" == "" ]
+            then
+                FIRSTCORES=$((PROCS*THREADS))
+            fi
+
+            # in weak scaling mode, scale the number of photon packages with the number of cores per simulation
+            FACTOR=1
+            if [ "$WEAK" == "yes" ]
+            then
+                FACTOR=$(awk "BEGIN { printf(\"%.6g\", $((PROCS*THREADS))/$FIRSTCORES) }")
+            fi
+
+            # create a fresh run directory with a copy of the ski file for each parallel simulation
+            RUNNAME="p${PROCS}_t${THREADS}_s${SIMS}"
+            RUNDIR="$OUTDIR/$RUNNAME"
+            rm -rf "$RUNDIR"
+            mkdir -p "$RUNDIR"
+            SKIFILES=""
+            for ((SIM=1; SIM<=SIMS; SIM++))
+            do
+                awk -v factor=$FACTOR '
+                    match($0, /numPackages="[^"]*"/) {
+                        value = substr($0, RSTART+13, RLENGTH-14)*factor
+                        $0 = substr($0, 1, RSTART-1) sprintf("numPackages=\"%.6g\"", value) substr($0, RSTART+RLENGTH)
+                    }
+                    { print }' "$SKIFILE" > "$RUNDIR/${SKINAME}_$SIM.ski"
+                SKIFILES="$SKIFILES $RUNDIR/${SKINAME}_$SIM.ski"
+            done
+
+            # run skirt, through mpirun if there are multiple processes
+            OPTIONS="-t $THREADS -s $SIMS -o $RUNDIR"
+            if [ $PROCS -gt 1 ]
+            then
+                if [ $SIMS -eq 1 ]
+                then
+                    OPTIONS="$OPTIONS -v"
+                fi
+                echo "Running $MPIRUN -np $PROCS skirt $OPTIONS $DATAPARALLEL..."
+                $MPIRUN -np $PROCS "$SKIRT" $OPTIONS $DATAPARALLEL $SKIFILES > "$RUNDIR/console.txt" 2>&1
+            else
+                echo "Running skirt $OPTIONS..."
+                "$SKIRT" $OPTIONS $SKIFILES > "$RUNDIR/console.txt" 2>&1
+            fi
+            if [ $? -ne 0 ] || grep -q "\*\*\* Error" "$RUNDIR/console.txt"
+            then
+                echo "Fatal error: skirt failed; see $RUNDIR/console.txt"
+                exit 1
+            fi
+
+            # gather the results
+            TIMES=$(phasetimes "$RUNDIR"/*_log.txt)
+            PROCMEMORY=$(peakmemory max "$RUNDIR/console.txt")
+            TOTALMEMORY=$PROCMEMORY
+            if [ $PROCS -gt 1 ] && [ $SIMS -eq 1 ]
+            then
+                TOTALMEMORY=$(peakmemory sum "$RUNDIR"/*_log*.txt)
+            fi
+            ACTUALPROCS=$(processcount "$RUNDIR/${SKINAME}_1_log.txt")
+            if [ $ACTUALPROCS -ne $PROCS ]
+            then
+                echo "Warning: skirt used $ACTUALPROCS instead of $PROCS processes; is it built with MPI support?"
+            fi
+            echo "$PROCS $THREADS $SIMS $CORES $FACTOR $ACTUALPROCS $TIMES $PROCMEMORY $TOTALMEMORY" >> "$RESULTS"
+        done
+    done
+done
+
+# --------------------------------------------------------------------
+
+# Calculate the efficiencies and write the table and JSON files
+awk -v skifile="$SKIFILE" -v skirt="$SKIRT" -v host="$(hostname)" -v ncores=$NCORES \
+    -v mode="$([ "$WEAK" == "yes" ] && echo weak || echo strong)" \
+    -v dataparallel="$([ "$DATAPARALLEL" == "" ] && echo false || echo true)" \
+    -v table="$OUTDIR/scaling.txt" -v json="$OUTDIR/scaling.json" '
+    BEGIN {
+        split("setup stellarEmission selfAbsorption dustEmission write total", names, " ")
+    }
+    {
+        n = NR
+        procs[n] = $1; threads[n] = $2; sims[n] = $3; cores[n] = $4; factor[n] = $5; actual[n] = $6
+        for (p = 1; p <= 6; ++p) times[n,p] = $(6+p)
+        procmem[n] = $13; totalmem[n] = $14
+    }
+    function efficiency(r, p)
+    {
+        if (times[1,p] <= 0 || times[r,p] <= 0) return -1
+        return (times[1,p]*cores[1]/(sims[1]*factor[1])) / (times[r,p]*cores[r]/(sims[r]*factor[r]))
+    }
+    END {
+        # the text table
+        printf("%s scaling for %s on %s (%d logical cores)\n\n", mode, skifile, host, ncores) > table
+        printf("%5s %7s %4s %5s |%8s %8s %8s %8s %8s %8s |%6s %6s %6s %6s %6s %6s |%9s %9s\n",
+               "procs", "threads", "sims", "cores", "setup", "stellar", "selfabs", "dustem", "write", "total",
+               "setup", "stell", "selfab", "dustem", "write", "total", "procMB", "totalMB") > table
+        printf("%s\n", "--------------------------+-------------------------------------------------------+" \
+                       "-------------------------------------------+--------------------") > table
+        for (r = 1; r <= n; ++r)
+        {
+            printf("%5d %7d %4d %5d |", procs[r], threads[r], sims[r], cores[r]) > table
+            for (p = 1; p <= 6; ++p) printf(" %8.1f", times[r,p]) > table
+            printf(" |") > table
+            for (p = 1; p <= 6; ++p)
+            {
+                e = efficiency(r, p)
+                if (e < 0) printf(" %6s", "-") > table
+                else printf(" %5.0f%%", 100*e) > table
+            }
+            printf(" | %9.1f %9.1f\n", procmem[r], totalmem[r]) > table
+        }
+        printf("\nPhase times in seconds; efficiencies relative to the first row.\n") > table
+
+        # the JSON file
+        printf("{\n") > json
+        printf("  \"skifile\": \"%s\",\n", skifile) > json
+        printf("  \"skirt\": \"%s\",\n", skirt) > json
+        printf("  \"host\": \"%s\",\n", host) > json
+        printf("  \"logicalCores\": %d,\n", ncores) > json
+        printf("  \"mode\": \"%s\",\n", mode) > json
+        printf("  \"dataParallel\": %s,\n", dataparallel) > json
+        printf("  \"runs\": [") > json
+        for (r = 1; r <= n; ++r)
+        {
+            printf("%s\n    {\n", (r > 1 ? "," : "")) > json
+            printf("      \"processes\": %d, \"actualProcesses\": %d, \"threads\": %d, \"simulations\": %d, ",
+                   procs[r], actual[r], threads[r], sims[r]) > json
+            printf("\"cores\": %d, \"packageFactor\": %s,\n", cores[r], factor[r]) > json
+            printf("      \"times\": {") > json
+            for (p = 1; p <= 6; ++p) printf("%s \"%s\": %s", (p > 1 ? "," : ""), names[p], times[r,p]) > json
+            printf(" },\n      \"efficiency\": {") > json
+            for (p = 1; p <= 6; ++p)
+            {
+                e = efficiency(r, p)
+                printf("%s \"%s\": %s", (p > 1 ? "," : ""), names[p], (e < 0 ? "null" : sprintf("%.4f", e))) > json
+            }
+            printf(" },\n      \"peakMemoryMB\": { \"process\": %s, \"total\": %s }\n    }", procmem[r], totalmem[r]) > json
+        }
+        printf("\n  ]\n}\n") > json
+    }' "$RESULTS"
+
+cat "$OUTDIR/scaling.txt"
+echo
+echo "Scaling results written to $OUTDIR/scaling.txt and $OUTDIR/scaling.json"